@@ -53,6 +53,75 @@ void write_image(const char* filename, int width, int height,
   stbi_write_png(filename, width, height, 1, output, width);
 }
 
+#if defined(__INTEL_COMPILER) || defined(__INTEL_LLVM_COMPILER)
+// Zoom region of the benchmark: rectangle (x0, y0) - (x1, y1) and max depth
+struct ZoomRegion {
+  const char* name;
+  double x0, y0, x1, y1;
+  int max_depth;
+};
+
+// Compares omp_mandelbrot with isa_mandelbrot for every instruction set the
+// CPU supports, on zoom regions from uniform to highly divergent depths
+void zoom_benchmark(int width, int height) {
+  const ZoomRegion regions[] = {
+      {"exterior (all points escape early)", 0.5, 0.5, 1.5, 1.0, 1000},
+      {"main cardioid (all points bounded)", -0.4, -0.2, 0.0, 0.0, 1000},
+      {"full set", -2.5, -0.875, 1.0, 0.875, 1000},
+      {"seahorse valley (boundary)", -0.7485, 0.0965, -0.7425, 0.0995, 1000},
+  };
+  const MandelbrotIsa isas[] = {kIsaOmpSimd, kIsaAvx2, kIsaAvx512};
+  MandelbrotIsa best = detect_mandelbrot_isa();
+  int lanes = (best == kIsaAvx512) ? 8 : 4;
+  CUtilTimer timer;
+
+  printf("\nZoom region benchmark, best instruction set: %s\n",
+         mandelbrot_isa_name(best));
+
+  // Warm up the OpenMP threads
+  _mm_free(omp_mandelbrot(-2.5, -0.875, 1.0, 0.875, width, height, 100));
+
+  for (const ZoomRegion& r : regions) {
+    printf("\n%s: (%g, %g) - (%g, %g), max depth %d\n", r.name, r.x0, r.y0,
+           r.x1, r.y1, r.max_depth);
+
+    timer.start();
+    unsigned char* reference =
+        omp_mandelbrot(r.x0, r.y0, r.x1, r.y1, width, height, r.max_depth);
+    timer.stop();
+    double omp_time = timer.get_time();
+    double utilization = simd_lane_utilization(
+        r.x0, r.y0, r.x1, r.y1, width, height, r.max_depth, lanes);
+    printf("  %-24s %9.1fms %8s  lane utilization %5.1f%% (%d lanes)\n",
+           "OpenMP SIMD + Parallel", omp_time * 1000.0, "", utilization * 100,
+           lanes);
+
+    for (MandelbrotIsa isa : isas) {
+      if (isa > best) break;
+
+      timer.start();
+      unsigned char* output =
+          isa_mandelbrot(r.x0, r.y0, r.x1, r.y1, width, height, r.max_depth,
+                         isa, &utilization);
+      timer.stop();
+
+      // Points on the boundary may differ by rounding (e.g., FMA contraction)
+      int differences = 0;
+      for (int i = 0; i < width * height; ++i)
+        differences += (output[i] != reference[i]);
+      _mm_free(output);
+
+      printf("  %-24s %9.1fms %7.2fx", mandelbrot_isa_name(isa),
+             timer.get_time() * 1000.0, omp_time / timer.get_time());
+      if (isa != kIsaOmpSimd)
+        printf("  lane utilization %5.1f%%", utilization * 100);
+      printf("  %d pixels differ\n", differences);
+    }
+    _mm_free(reference);
+  }
+}
+#endif
+
 int main(int argc, char* argv[]) {
   double x0 = -2.5;
   double y0 = -0.875;
@@ -103,7 +172,8 @@ int main(int argc, char* argv[]) {
           "would like to use.\n");
       printf(
           "[0] all tests\n[1] serial/scalar\n[2] OpenMP SIMD\n[3] OpenMP "
-          "Parallel\n[4] OpenMP Both\n  > ");
+          "Parallel\n[4] OpenMP Both\n[5] AVX2/AVX-512 runtime dispatch\n"
+          "[6] zoom region benchmark\n  > ");
       return 0;
     } else {
       option = atoi(argv[1]);
@@ -117,18 +187,20 @@ int main(int argc, char* argv[]) {
         "like to use.\n");
     printf(
         "[0] all tests\n[1] serial/scalar\n[2] OpenMP SIMD\n[3] OpenMP "
-        "Parallel\n[4] OpenMP Both\n  > ");
+        "Parallel\n[4] OpenMP Both\n[5] AVX2/AVX-512 runtime dispatch\n"
+        "[6] zoom region benchmark\n  > ");
     scanf("%i", &option);
   }
 #endif  // !PERF_NUM
 
   CUtilTimer timer;
-  double serial_time, omp_simd_time, omp_parallel_time, omp_both_time;
+  double serial_time, omp_simd_time, omp_parallel_time, omp_both_time,
+      isa_time;
   unsigned char* output;
   switch (option) {
     case 0: {
 #ifdef PERF_NUM
-      double avg_time[4] = {0.0};
+      double avg_time[5] = {0.0};
       for (int i = 0; i < 5; ++i) {
 #endif
         printf("\nRunning all tests\n");
@@ -176,6 +248,18 @@ int main(int argc, char* argv[]) {
         printf("Saving image as mandelbrot_simd_parallel.png\n");
         write_image("mandelbrot_simd_parallel.png", width, height, output);
         _mm_free(output);
+
+        printf("\nStarting %s + Parallel Mandelbrot...\n",
+               mandelbrot_isa_name(kIsaAuto));
+        timer.start();
+        output = isa_mandelbrot(x0, y0, x1, y1, width, height, max_depth);
+        timer.stop();
+        isa_time = timer.get_time();
+        printf("Calculation finished. Processing time was %.0fms\n",
+               isa_time * 1000.0);
+        printf("Saving image as mandelbrot_isa.png\n");
+        write_image("mandelbrot_isa.png", width, height, output);
+        _mm_free(output);
 #ifndef PERF_NUM
       }
 #endif
@@ -184,6 +268,7 @@ int main(int argc, char* argv[]) {
       avg_time[1] += omp_simd_time;
       avg_time[2] += omp_parallel_time;
       avg_time[3] += omp_both_time;
+      avg_time[4] += isa_time;
     }
       printf("\navg time (serial)            : %.0fms\n",
              avg_time[0] * 1000.0 / 5);
@@ -191,8 +276,10 @@ int main(int argc, char* argv[]) {
              avg_time[1] * 1000.0 / 5);
       printf("avg time (parallel)          : %.0fms\n",
              avg_time[2] * 1000.0 / 5);
-      printf("avg time (simd+parallel)     : %.0fms\n\n",
+      printf("avg time (simd+parallel)     : %.0fms\n",
              avg_time[3] * 1000.0 / 5);
+      printf("avg time (isa+parallel)      : %.0fms (%s)\n\n",
+             avg_time[4] * 1000.0 / 5, mandelbrot_isa_name(kIsaAuto));
   }
 #endif
   break;
@@ -249,6 +336,25 @@ int main(int argc, char* argv[]) {
     break;
   }
 
+  case 5: {
+    printf("\nStarting %s + Parallel Mandelbrot...\n",
+           mandelbrot_isa_name(kIsaAuto));
+    timer.start();
+    output = isa_mandelbrot(x0, y0, x1, y1, width, height, max_depth);
+    timer.stop();
+    printf("Calculation finished. Processing time was %.0fms\n",
+           timer.get_time() * 1000.0);
+    printf("Saving image as mandelbrot_isa.png\n");
+    write_image("mandelbrot_isa.png", width, height, output);
+    _mm_free(output);
+    break;
+  }
+
+  case 6: {
+    zoom_benchmark(width, height);
+    break;
+  }
+
   default: {
     printf("Please pick a valid option\n");
     break;
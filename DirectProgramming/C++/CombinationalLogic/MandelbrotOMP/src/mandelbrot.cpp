@@ -24,16 +24,24 @@
 
 // Each of these methods calculate how deeply numbers on a complex plane remains
 // in the Mandelbrot set. On top of the serial/scalar version, there is a
-// cilk_for version, a pragma simd version, and a combined cilk_for/pragma simd
-// version
+// cilk_for version, a pragma simd version, a combined cilk_for/pragma simd
+// version, and a version with explicit AVX2/AVX-512 kernels selected at runtime
 
 #include "mandelbrot.hpp"
 
+#include <algorithm>
 #include <complex>
 #if defined(__INTEL_COMPILER) || defined(__INTEL_LLVM_COMPILER)
 #include <omp.h>
 #endif
 #include <emmintrin.h>
+#if defined(_WIN32)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "mandelbrot_kernels.hpp"
 // Description:
 // Determines how deeply points in the complex plane, spaced on a uniform grid,
 // remain in the Mandelbrot set. The uniform grid is specified by the rectangle
@@ -251,4 +259,217 @@ unsigned char* omp_mandelbrot(double x0, double y0, double x1, double y1,
   return output;
 }
 
+// Width and height of the tiles of isa_mandelbrot
+#define TILE_WIDTH 64
+#define TILE_HEIGHT 8
+
+// Runs the CPUID instruction, regs receives eax, ebx, ecx and edx
+static void cpuid(unsigned int leaf, unsigned int subleaf,
+                  unsigned int regs[4]) {
+#if defined(_WIN32)
+  __cpuidex(reinterpret_cast<int*>(regs), leaf, subleaf);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Returns the register state components saved by the OS (XCR0)
+static unsigned long long xgetbv0() {
+#if defined(_WIN32)
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+// Description:
+// Returns the best instruction set of isa_mandelbrot supported by the CPU. The
+// CPU must support the instructions (CPUID leaf 7), and the OS must save the
+// AVX registers (XCR0 bits 1-2), and the AVX-512 registers (XCR0 bits 5-7).
+MandelbrotIsa detect_mandelbrot_isa() {
+  unsigned int regs[4];
+
+  cpuid(0, 0, regs);
+  if (regs[0] < 7) return kIsaOmpSimd;
+
+  cpuid(1, 0, regs);
+  bool osxsave = regs[2] & (1u << 27);
+  bool avx = regs[2] & (1u << 28);
+  if (!osxsave || !avx) return kIsaOmpSimd;
+
+  unsigned long long xcr0 = xgetbv0();
+  if ((xcr0 & 0x6) != 0x6) return kIsaOmpSimd;
+
+  cpuid(7, 0, regs);
+  bool avx2 = regs[1] & (1u << 5);
+  bool avx512f = regs[1] & (1u << 16);
+
+  if (avx512f && (xcr0 & 0xe6) == 0xe6) return kIsaAvx512;
+  if (avx2) return kIsaAvx2;
+  return kIsaOmpSimd;
+}
+
+const char* mandelbrot_isa_name(MandelbrotIsa isa) {
+  switch (isa) {
+    case kIsaOmpSimd:
+      return "OpenMP SIMD";
+    case kIsaAvx2:
+      return "AVX2";
+    case kIsaAvx512:
+      return "AVX-512";
+    default:
+      return mandelbrot_isa_name(detect_mandelbrot_isa());
+  }
+}
+
+// Description:
+// Determines how deeply the points of a tile remain in the Mandelbrot set with
+// the OpenMP SIMD loop of omp_mandelbrot. Used by isa_mandelbrot when the CPU
+// supports neither AVX2 nor AVX-512.
+static void omp_simd_mandelbrot_tile(const MandelbrotTile& tile, double x0,
+                                     double y0, double xstep, double ystep,
+                                     int width, int max_depth,
+                                     unsigned char* output) {
+  for (int j = tile.row_begin; j < tile.row_end; ++j) {
+#pragma omp simd  // vectorize code
+    for (int i = tile.col_begin; i < tile.col_end; ++i) {
+      double z_real = x0 + i * xstep;
+      double z_imaginary = y0 + j * ystep;
+      double c_real = z_real;
+      double c_imaginary = z_imaginary;
+
+      double depth = 0;
+      while (depth < max_depth) {
+        if (z_real * z_real + z_imaginary * z_imaginary > 4.0) {
+          break;  // Escape from a circle of radius 2
+        }
+        double temp_real = z_real * z_real - z_imaginary * z_imaginary;
+        double temp_imaginary = 2.0 * z_real * z_imaginary;
+        z_real = c_real + temp_real;
+        z_imaginary = c_imaginary + temp_imaginary;
+
+        ++depth;
+      }
+      output[j * width + i] = static_cast<unsigned char>(
+          static_cast<double>(depth) / max_depth * 255);
+    }
+  }
+}
+
+// Description:
+// Determines how deeply points in the complex plane, spaced on a uniform grid,
+// remain in the Mandelbrot set. The uniform grid is specified by the rectangle
+// (x1, y1) - (x0, y0). Mandelbrot set is determined by remaining bounded after
+// iteration of z_n+1 = z_n^2 + c, up to max_depth.
+//
+// Optimized with explicit AVX2 or AVX-512 kernels, selected at runtime with
+// CPUID unless isa is given. The image is split in TILE_WIDTH x TILE_HEIGHT
+// tiles, scheduled dynamically on the OpenMP threads: tiles inside the set
+// take much longer than tiles outside of it.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth, isa
+// [out]: output (caller must deallocate), lane_utilization
+unsigned char* isa_mandelbrot(double x0, double y0, double x1, double y1,
+                              int width, int height, int max_depth,
+                              MandelbrotIsa isa, double* lane_utilization) {
+  double xstep = (x1 - x0) / width;
+  double ystep = (y1 - y0) / height;
+  unsigned char* output = static_cast<unsigned char*>(
+      _mm_malloc(width * height * sizeof(unsigned char), 64));
+
+  if (isa == kIsaAuto) isa = detect_mandelbrot_isa();
+
+  int tiles_x = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+  int tiles_y = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+  unsigned long long iterations = 0;
+  unsigned long long depth_sum = 0;
+
+  omp_set_num_threads(NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 1) \
+    reduction(+ : iterations, depth_sum)
+  for (int t = 0; t < tiles_x * tiles_y; ++t) {
+    MandelbrotTile tile;
+    tile.row_begin = (t / tiles_x) * TILE_HEIGHT;
+    tile.row_end = std::min(tile.row_begin + TILE_HEIGHT, height);
+    tile.col_begin = (t % tiles_x) * TILE_WIDTH;
+    tile.col_end = std::min(tile.col_begin + TILE_WIDTH, width);
+
+    unsigned long long tile_depth_sum = 0;
+    switch (isa) {
+      case kIsaAvx512:
+        iterations +=
+            avx512_mandelbrot_tile(tile, x0, y0, xstep, ystep, width,
+                                   max_depth, output, &tile_depth_sum);
+        break;
+      case kIsaAvx2:
+        iterations += avx2_mandelbrot_tile(tile, x0, y0, xstep, ystep, width,
+                                           max_depth, output, &tile_depth_sum);
+        break;
+      default:
+        omp_simd_mandelbrot_tile(tile, x0, y0, xstep, ystep, width, max_depth,
+                                 output);
+        break;
+    }
+    depth_sum += tile_depth_sum;
+  }
+
+  if (lane_utilization) {
+    int lanes = (isa == kIsaAvx512) ? 8 : 4;
+    *lane_utilization =
+        iterations ? static_cast<double>(depth_sum) / (lanes * iterations)
+                   : 0.0;
+  }
+  return output;
+}
+
+// Description:
+// Returns the fraction of the lane iterations that compute a pixel in the
+// OpenMP SIMD loops, assuming that groups of lanes consecutive pixels of a row
+// iterate until all of them have escaped.
+//
+// [in]: x0, y0, x1, y1, width, height, max_depth, lanes
+double simd_lane_utilization(double x0, double y0, double x1, double y1,
+                             int width, int height, int max_depth, int lanes) {
+  double xstep = (x1 - x0) / width;
+  double ystep = (y1 - y0) / height;
+  unsigned long long depth_sum = 0;
+  unsigned long long lane_iterations = 0;
+
+  omp_set_num_threads(NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 1) \
+    reduction(+ : depth_sum, lane_iterations)
+  for (int j = 0; j < height; ++j) {
+    for (int i = 0; i < width; i += lanes) {
+      int group_depth = 0;
+      for (int k = i; k < std::min(i + lanes, width); ++k) {
+        double z_real = x0 + k * xstep;
+        double z_imaginary = y0 + j * ystep;
+        double c_real = z_real;
+        double c_imaginary = z_imaginary;
+
+        int depth = 0;
+        while (depth < max_depth) {
+          if (z_real * z_real + z_imaginary * z_imaginary > 4.0) {
+            break;  // Escape from a circle of radius 2
+          }
+          double temp_real = z_real * z_real - z_imaginary * z_imaginary;
+          double temp_imaginary = 2.0 * z_real * z_imaginary;
+          z_real = c_real + temp_real;
+          z_imaginary = c_imaginary + temp_imaginary;
+
+          ++depth;
+        }
+        depth_sum += depth;
+        group_depth = std::max(group_depth, depth);
+      }
+      lane_iterations += static_cast<unsigned long long>(group_depth) * lanes;
+    }
+  }
+
+  return lane_iterations ? static_cast<double>(depth_sum) / lane_iterations
+                         : 1.0;
+}
+
 #endif  // __INTEL_COMPILER or __INTEL_LLVM_COMPILER
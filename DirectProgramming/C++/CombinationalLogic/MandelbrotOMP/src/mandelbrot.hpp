@@ -53,4 +53,33 @@ unsigned char* parallel_mandelbrot(double x0, double y0, double x1, double y1,
 unsigned char* omp_mandelbrot(double x0, double y0, double x1, double y1,
                               int width, int height, int max_depth);
 
+// Instruction sets of the SIMD kernels of isa_mandelbrot. kIsaOmpSimd is the
+// OpenMP SIMD loop, used when the CPU supports neither AVX2 nor AVX-512
+enum MandelbrotIsa { kIsaAuto, kIsaOmpSimd, kIsaAvx2, kIsaAvx512 };
+
+// Returns the best instruction set supported by the CPU and the OS, from CPUID
+MandelbrotIsa detect_mandelbrot_isa();
+
+// Returns the name of an instruction set of isa_mandelbrot
+const char* mandelbrot_isa_name(MandelbrotIsa isa);
+
+// Checks how many iterations of the complex quadratic polynomial z_n+1 = z_n^2
+// + c keeps a set of complex numbers bounded, to a certain max depth. Mapping
+// of these depths to a complex plane will result in the telltale mandelbrot set
+// image Uses explicit AVX2 or AVX-512 kernels, selected at runtime, on tiles
+// scheduled dynamically with OpenMP. Each SIMD lane moves on to the next pixel
+// of its tile as soon as its pixel escapes, instead of waiting for the slowest
+// lane. If lane_utilization is not null, it receives the fraction of the lane
+// iterations that computed a pixel (or 0 for kIsaOmpSimd)
+unsigned char* isa_mandelbrot(double x0, double y0, double x1, double y1,
+                              int width, int height, int max_depth,
+                              MandelbrotIsa isa = kIsaAuto,
+                              double* lane_utilization = 0);
+
+// Returns the fraction of the lane iterations that compute a pixel when
+// groups of lanes consecutive pixels of a row iterate until all of them have
+// escaped, like in the OpenMP SIMD loops of simd_mandelbrot and omp_mandelbrot
+double simd_lane_utilization(double x0, double y0, double x1, double y1,
+                             int width, int height, int max_depth, int lanes);
+
 #endif  // MANDELBROT_H
@@ -0,0 +1,132 @@
+//==============================================================
+//
+// Copyright 2020 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// ===============================================================
+
+// AVX2 kernel of isa_mandelbrot. This file is compiled for AVX2 (see the
+// Makefile), the kernel is only called after a runtime check of the CPU.
+
+#include <immintrin.h>
+
+#include "mandelbrot_kernels.hpp"
+
+// Description:
+// Determines how deeply the points of a tile remain in the Mandelbrot set,
+// 4 points at a time. Each lane iterates its own point: when a point escapes
+// or reaches max_depth, its lane is masked, the depth is written and the lane
+// is refilled with the next point of the tile. Lanes without a point left stay
+// masked, and the tile ends when all lanes are masked.
+//
+// [in]: tile, x0, y0, xstep, ystep, width, max_depth
+// [out]: output, depth_sum, returns the number of vector iterations
+unsigned long long avx2_mandelbrot_tile(const MandelbrotTile& tile, double x0,
+                                        double y0, double xstep, double ystep,
+                                        int width, int max_depth,
+                                        unsigned char* output,
+                                        unsigned long long* depth_sum) {
+  const int lanes = 4;
+  const int count =
+      (tile.row_end - tile.row_begin) * (tile.col_end - tile.col_begin);
+  const __m256d four = _mm256_set1_pd(4.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d max = _mm256_set1_pd(max_depth);
+
+  alignas(32) double z_real[lanes] = {0}, z_imaginary[lanes] = {0};
+  alignas(32) double c_real[lanes] = {0}, c_imaginary[lanes] = {0};
+  alignas(32) double depth[lanes] = {0};
+  int pixel[lanes];
+  int next = 0;
+  int active = 0;  // Mask of the lanes with a point
+
+  for (int lane = 0; lane < lanes && next < count; ++lane, ++next) {
+    pixel[lane] = next;
+    tile_point(tile, next, x0, y0, xstep, ystep, &c_real[lane],
+               &c_imaginary[lane]);
+    z_real[lane] = c_real[lane];
+    z_imaginary[lane] = c_imaginary[lane];
+    active |= 1 << lane;
+  }
+
+  __m256d zr = _mm256_load_pd(z_real);
+  __m256d zi = _mm256_load_pd(z_imaginary);
+  __m256d cr = _mm256_load_pd(c_real);
+  __m256d ci = _mm256_load_pd(c_imaginary);
+  __m256d d = _mm256_load_pd(depth);
+  unsigned long long iterations = 0;
+  unsigned long long sum = 0;
+
+  while (active) {
+    __m256d zr2 = _mm256_mul_pd(zr, zr);
+    __m256d zi2 = _mm256_mul_pd(zi, zi);
+
+    // Lanes that escaped from a circle of radius 2 or reached max_depth
+    __m256d done =
+        _mm256_or_pd(_mm256_cmp_pd(_mm256_add_pd(zr2, zi2), four, _CMP_GT_OQ),
+                     _mm256_cmp_pd(d, max, _CMP_GE_OQ));
+    int finished = _mm256_movemask_pd(done) & active;
+
+    if (finished) {
+      _mm256_store_pd(z_real, zr);
+      _mm256_store_pd(z_imaginary, zi);
+      _mm256_store_pd(c_real, cr);
+      _mm256_store_pd(c_imaginary, ci);
+      _mm256_store_pd(depth, d);
+
+      for (int lane = 0; lane < lanes; ++lane) {
+        if (!(finished & (1 << lane))) continue;
+
+        tile_store(tile, pixel[lane], width, depth[lane], max_depth, output);
+        sum += static_cast<unsigned long long>(depth[lane]);
+        if (next < count) {
+          pixel[lane] = next;
+          tile_point(tile, next++, x0, y0, xstep, ystep, &c_real[lane],
+                     &c_imaginary[lane]);
+          z_real[lane] = c_real[lane];
+          z_imaginary[lane] = c_imaginary[lane];
+        } else {
+          // Masked lane, iterates z = 0 until the tile ends
+          c_real[lane] = c_imaginary[lane] = 0.0;
+          z_real[lane] = z_imaginary[lane] = 0.0;
+          active &= ~(1 << lane);
+        }
+        depth[lane] = 0.0;
+      }
+
+      zr = _mm256_load_pd(z_real);
+      zi = _mm256_load_pd(z_imaginary);
+      cr = _mm256_load_pd(c_real);
+      ci = _mm256_load_pd(c_imaginary);
+      d = _mm256_load_pd(depth);
+      continue;
+    }
+
+    // z = z^2 + c for all lanes
+    zi = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, zr), zi), ci);
+    zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+    d = _mm256_add_pd(d, one);
+    ++iterations;
+  }
+
+  *depth_sum = sum;
+  return iterations;
+}
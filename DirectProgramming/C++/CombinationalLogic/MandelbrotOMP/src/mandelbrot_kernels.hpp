@@ -0,0 +1,74 @@
+//==============================================================
+//
+// Copyright 2020 Intel Corporation
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+// THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+// ===============================================================
+
+#ifndef MANDELBROT_KERNELS_H
+#define MANDELBROT_KERNELS_H
+
+// Tile of the image computed by one task of isa_mandelbrot: rows [row_begin,
+// row_end) and columns [col_begin, col_end)
+struct MandelbrotTile {
+  int row_begin, row_end;
+  int col_begin, col_end;
+};
+
+// The helpers below are static: this header is included by translation units
+// compiled for different instruction sets, and the linker would otherwise
+// merge their inline definitions into one (an ODR violation)
+
+// Returns the point c of pixel number pixel of a tile, numbered row by row
+static inline void tile_point(const MandelbrotTile& tile, int pixel, double x0,
+                              double y0, double xstep, double ystep,
+                              double* c_real, double* c_imaginary) {
+  int tile_width = tile.col_end - tile.col_begin;
+  *c_real = x0 + (tile.col_begin + pixel % tile_width) * xstep;
+  *c_imaginary = y0 + (tile.row_begin + pixel / tile_width) * ystep;
+}
+
+// Writes the depth of pixel number pixel of a tile to the image
+static inline void tile_store(const MandelbrotTile& tile, int pixel, int width,
+                              double depth, int max_depth,
+                              unsigned char* output) {
+  int tile_width = tile.col_end - tile.col_begin;
+  output[(tile.row_begin + pixel / tile_width) * width + tile.col_begin +
+         pixel % tile_width] =
+      static_cast<unsigned char>(depth / max_depth * 255);
+}
+
+// Compute the depths of the pixels of a tile with AVX2 (4 lanes) or AVX-512
+// (8 lanes). They return the number of vector iterations, and the sum of the
+// depths of the pixels (the lane iterations that computed a pixel) in
+// depth_sum. These are compiled for their instruction set, and must only be
+// called if the CPU supports it
+unsigned long long avx2_mandelbrot_tile(const MandelbrotTile& tile, double x0,
+                                        double y0, double xstep, double ystep,
+                                        int width, int max_depth,
+                                        unsigned char* output,
+                                        unsigned long long* depth_sum);
+unsigned long long avx512_mandelbrot_tile(const MandelbrotTile& tile, double x0,
+                                          double y0, double xstep,
+                                          double ystep, int width,
+                                          int max_depth, unsigned char* output,
+                                          unsigned long long* depth_sum);
+
+#endif  // MANDELBROT_KERNELS_H
@@ -3,11 +3,19 @@
 
 #include <algorithm>
 #include <chrono>
+#include <climits>
 #include <iostream>
 
 constexpr int task_threshold = 5000;
 constexpr int n = 100000000;
 
+// Parallel merge version: merges of at least merge_task_threshold numbers are
+// split into tasks of merge_chunk_size numbers, and lists of up to
+// base_case_size numbers are sorted with a sorting network.
+constexpr int merge_task_threshold = 1 << 16;
+constexpr int merge_chunk_size = 1 << 15;
+constexpr int base_case_size = 16;
+
 // Description:
 // Initializes the array, and shuffle all elements in it.
 //
@@ -89,6 +97,178 @@ void MergeSort(int a[], int tmp_a[], int first, int last) {
   }
 }
 
+// Description:
+// Sorts up to base_case_size numbers with a bitonic sorting network. The list
+// is padded to base_case_size numbers with INT_MAX. Every step of the network
+// computes all of its compare-exchanges at once, with the same min/max
+// operations on every lane, so the steps are vectorized with SIMD.
+//
+// [in]:  src     Numbers to be sorted.
+//        count   Number of numbers to be sorted (at most base_case_size).
+// [out]: dst     Sorted numbers. May be the same array as src.
+void SortingNetwork(const int src[], int dst[], int count) {
+  int v[base_case_size];
+  int w[base_case_size];
+  for (int i = 0; i < base_case_size; ++i)
+    v[i] = (i < count) ? src[i] : INT_MAX;
+
+  // k is the size of the bitonic sequences being merged, j the distance
+  // between the numbers compared by this step
+  for (int k = 2; k <= base_case_size; k *= 2) {
+    for (int j = k / 2; j > 0; j /= 2) {
+#pragma omp simd
+      for (int i = 0; i < base_case_size; ++i) {
+        int partner = v[i ^ j];
+        // The lower lane of a pair gets the minimum in ascending sequences
+        bool take_min = ((i & k) == 0) == ((i & j) == 0);
+        w[i] = take_min ? std::min(v[i], partner) : std::max(v[i], partner);
+      }
+      for (int i = 0; i < base_case_size; ++i) v[i] = w[i];
+    }
+  }
+
+  for (int i = 0; i < count; ++i) dst[i] = v[i];
+}
+
+// Description:
+// Merges two sorted lists into dst. Like Merge, takes the number from the
+// second list when two numbers are equal.
+//
+// [in]:  a       First sorted list.
+//        na      Length of first list.
+//        b       Second sorted list.
+//        nb      Length of second list.
+// [out]: dst     Merged list of na + nb numbers.
+void MergeLists(const int a[], int na, const int b[], int nb, int dst[]) {
+  int p1 = 0;
+  int p2 = 0;
+  int p = 0;
+  while (p1 < na && p2 < nb) {
+    if (a[p1] < b[p2]) {
+      dst[p++] = a[p1++];
+    } else {
+      dst[p++] = b[p2++];
+    }
+  }
+  while (p1 < na) dst[p++] = a[p1++];
+  while (p2 < nb) dst[p++] = b[p2++];
+}
+
+// Description:
+// Co-ranking: finds how many of the first k numbers of the merge of two
+// sorted lists come from the first list, with a binary search over both
+// lists. The first k merged numbers are a[0:i-1] and b[0:k-i-1].
+//
+// [in]:  k       Rank in the merged list.
+//        a       First sorted list.
+//        na      Length of first list.
+//        b       Second sorted list.
+//        nb      Length of second list.
+// [out]: Return i, the number of merged numbers taken from the first list.
+int CoRank(int k, const int a[], int na, const int b[], int nb) {
+  int lo = std::max(0, k - nb);
+  int hi = std::min(k, na);
+  while (lo < hi) {
+    int i = lo + (hi - lo) / 2;
+    int j = k - i;
+    // a[i] is merged before b[j-1], so more numbers come from a
+    if (a[i] < b[j - 1]) {
+      lo = i + 1;
+    } else {
+      hi = i;
+    }
+  }
+  return lo;
+}
+
+// Description:
+// Merges two sublists of src into dst. Big merges are split into tasks that
+// each merge merge_chunk_size numbers of dst, finding the numbers they merge
+// with CoRank.
+//
+// [in]:  src     Array holding the sorted sublists.
+//        first   Index of first element of first sublist to be merged.
+//        middle  Index of first element of second sublist to be merged.
+//        last    Index of last element of second sublist to be merged.
+// [out]: dst     Array to hold the merged list, from first to last.
+void ParallelMerge(const int src[], int dst[], int first, int middle,
+                   int last) {
+  const int *a = src + first;
+  const int *b = src + middle;
+  int na = middle - first;
+  int nb = last - middle + 1;
+  int count = na + nb;
+
+  if (count < merge_task_threshold) {
+    MergeLists(a, na, b, nb, dst + first);
+    return;
+  }
+
+  for (int start = 0; start < count; start += merge_chunk_size) {
+#pragma omp task firstprivate(start)
+    {
+      int end = std::min(start + merge_chunk_size, count);
+      int i_start = CoRank(start, a, na, b, nb);
+      int i_end = CoRank(end, a, na, b, nb);
+      MergeLists(a + i_start, i_end - i_start, b + start - i_start,
+                 (end - i_end) - (start - i_start), dst + first + start);
+    }
+  }
+#pragma omp taskwait
+}
+
+// Description:
+// OpenMP Task version of merge_sort with parallel merges. The two arrays are
+// used as ping-pong buffers: the sublists are sorted into the other array and
+// merged into the array the list must be sorted into, so the merged numbers
+// are never copied back.
+//
+// [in]:  a         Array to be sorted.
+//        tmp_a     Temporary array.
+//        first     Index of first element of the list to be sorted in array a.
+//        last      Index of last element of the list to be sorted in array a.
+//        into_tmp  Whether the sorted list goes to tmp_a instead of a.
+// [out]: a or tmp_a
+void MergeSortParallelMerge(int a[], int tmp_a[], int first, int last,
+                            bool into_tmp) {
+  int count = last - first + 1;
+  int *dst = into_tmp ? tmp_a : a;
+  if (count <= base_case_size) {
+    // The numbers to be sorted are still in a
+    SortingNetwork(a + first, dst + first, count);
+    return;
+  }
+
+  int middle = (first + last + 1) / 2;  // = first + (last - first + 1) / 2;
+  // Sorts the sublists into the other array
+  if (count < task_threshold) {
+    MergeSortParallelMerge(a, tmp_a, first, middle - 1, !into_tmp);
+    MergeSortParallelMerge(a, tmp_a, middle, last, !into_tmp);
+  } else {
+#pragma omp task
+    MergeSortParallelMerge(a, tmp_a, first, middle - 1, !into_tmp);
+#pragma omp task
+    MergeSortParallelMerge(a, tmp_a, middle, last, !into_tmp);
+#pragma omp taskwait
+  }
+  ParallelMerge(into_tmp ? a : tmp_a, dst, first, middle, last);
+}
+
+// Description:
+// Sorts array a with MergeSortParallelMerge using num_threads threads, and
+// returns the elapsed time in seconds.
+double RunMergeSortParallelMerge(int a[], int tmp_a[], int num_threads) {
+  auto start = std::chrono::system_clock::now();
+#pragma omp parallel num_threads(num_threads)
+  {
+#pragma omp single
+    { MergeSortParallelMerge(a, tmp_a, 0, n - 1, false); }
+  }
+  std::chrono::duration<double> elapsed_seconds =
+      std::chrono::system_clock::now() - start;
+  return elapsed_seconds.count();
+}
+
 // Description:
 // OpenMP Task version of merge_sort
 void MergeSortOpenMP(int a[], int tmp_a[], int first, int last) {
@@ -115,6 +295,7 @@ void MergeSortOpenMP(int a[], int tmp_a[], int first, int last) {
 int main(int argc, char *argv[]) {
   std::chrono::time_point<std::chrono::system_clock> start1, start2, end1, end2;
   std::chrono::duration<double> elapsed_seconds_serial, elapsed_seconds_openmp;
+  double elapsed_seconds_parallel_merge;
   printf("N = %d\n", n);
 
   int *a = new int[n];
@@ -129,6 +310,8 @@ int main(int argc, char *argv[]) {
     if (argv[1][0] == 'h') {
       printf("Merge Sort Sample\n");
       printf("[0] all tests\n[1] serial\n[2] OpenMP Task\n");
+      printf("[3] OpenMP Task with parallel merge\n");
+      printf("[4] strong scaling of OpenMP Task with parallel merge\n");
 #ifdef _WIN32
       system("PAUSE");
 #endif  // _WIN32
@@ -143,12 +326,14 @@ int main(int argc, char *argv[]) {
   else {
     printf("Merge Sort Sample\n");
     printf("[0] all tests\n[1] serial\n[2] OpenMP Task\n");
+    printf("[3] OpenMP Task with parallel merge\n");
+    printf("[4] strong scaling of OpenMP Task with parallel merge\n");
     scanf("%i", &option);
   }
 #else   // !PERF_NUM
 
   //#ifdef PERF_NUM
-  double avg_time[2];
+  double avg_time[3] = {0.0, 0.0, 0.0};
 #endif  // PERF_NUM
 
   switch (option) {
@@ -192,15 +377,32 @@ int main(int argc, char *argv[]) {
         }
         std::cout << "Sort succeeded in " << elapsed_seconds_openmp.count()
                   << " seconds.\n";
+        std::cout << "\nOpenMP Task Version with parallel merge:\n";
+        InitializeArray(a, n);
+        printf("Sorting\n");
+        elapsed_seconds_parallel_merge =
+            RunMergeSortParallelMerge(a, tmp_a, omp_get_max_threads());
+
+        // Confirm that a is sorted and that each element contains the index.
+        if (CheckArray(a, n)) {
+          delete[] tmp_a;
+          delete[] a;
+          return 1;
+        }
+        std::cout << "Sort succeeded in " << elapsed_seconds_parallel_merge
+                  << " seconds.\n";
 #ifdef PERF_NUM
         avg_time[0] += elapsed_seconds_serial.count();
         avg_time[1] += elapsed_seconds_openmp.count();
+        avg_time[2] += elapsed_seconds_parallel_merge;
       }
       printf("\n");
       printf("avg time of serial version: %.0fms\n",
              avg_time[0] * 1000.0 / 5);
       printf("avg time of OpenMP Task version: %.0fms\n",
              avg_time[1] * 1000.0 / 5);
+      printf("avg time of OpenMP Task version with parallel merge: %.0fms\n",
+             avg_time[2] * 1000.0 / 5);
 #endif  // PERF_NUM
       break;
 
@@ -245,6 +447,48 @@ int main(int argc, char *argv[]) {
                 << " seconds.\n";
       break;
 
+    case 3:
+      printf("\nOpenMP version with parallel merge:\n");
+      InitializeArray(a, n);
+      printf("Sorting\n");
+      elapsed_seconds_parallel_merge =
+          RunMergeSortParallelMerge(a, tmp_a, omp_get_max_threads());
+
+      // Confirm that a is sorted and that each element contains the index.
+      if (CheckArray(a, n)) {
+        delete[] tmp_a;
+        delete[] a;
+        return 1;
+      }
+      std::cout << "Sort succeeded in " << elapsed_seconds_parallel_merge
+                << " seconds.\n";
+      break;
+
+    case 4: {
+      // Strong scaling: the same problem size with 1, 2, 4, ... threads, up
+      // to the number of threads OpenMP uses by default
+      printf("\nStrong scaling of OpenMP version with parallel merge:\n");
+      int max_threads = omp_get_max_threads();
+      double time_one_thread = 0.0;
+      for (int threads = 1;; threads = std::min(threads * 2, max_threads)) {
+        InitializeArray(a, n);
+        printf("Sorting with %d threads\n", threads);
+        double seconds = RunMergeSortParallelMerge(a, tmp_a, threads);
+        if (CheckArray(a, n)) {
+          delete[] tmp_a;
+          delete[] a;
+          return 1;
+        }
+        if (threads == 1) time_one_thread = seconds;
+        printf("Sort succeeded in %.3f seconds, speedup %.2fx, "
+               "efficiency %.0f%%\n",
+               seconds, time_one_thread / seconds,
+               100.0 * time_one_thread / seconds / threads);
+        if (threads == max_threads) break;
+      }
+      break;
+    }
+
     default:
       printf("Please pick a valid option\n");
       break;
@@ -50,3 +50,12 @@ bool VerifyResults(float* next_base, float* prev_base, float* vel_base,
 bool ValidateInput(size_t n1, size_t n2, size_t n3,
                    size_t n1_block, size_t n2_block,
                    size_t n3_block, size_t num_iterations);
+
+void Iso3dfdVerify(float* ptr_next, float* ptr_prev, float* ptr_vel,
+                   float* coeff, size_t n1, size_t n2,
+                   size_t n3, size_t nreps, size_t n1_block,
+                   size_t n2_block, size_t n3_block);
+
+bool Iso3dfdCpu(float* coeff, size_t n1, size_t n2, size_t n3,
+                size_t num_iterations, size_t n1_block, size_t n2_block,
+                size_t n3_block, size_t time_block);
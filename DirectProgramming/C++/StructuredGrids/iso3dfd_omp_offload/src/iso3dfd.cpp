@@ -347,17 +347,20 @@ void Iso3dfd(float *ptr_next, float *ptr_prev, float *ptr_vel, float *coeff,
 }
 
 int main(int argc, char *argv[]) {
-  // Arrays used to update the wavefield
+#ifndef USE_CPU
+  // Arrays used to update the wavefield (the CPU path allocates its own)
   float *prev_base;
   float *next_base;
   // Array to store wave velocity
   float *vel_base;
+#endif
 
   bool error = false;
 
   size_t n1, n2, n3;
   size_t n1_block, n2_block, n3_block;
   size_t num_iterations;
+  size_t time_block = 0;
 
   try {
     n1 = std::stoi(argv[1]) + (2 * kHalfLength);
@@ -367,6 +370,7 @@ int main(int argc, char *argv[]) {
     n2_block = std::stoi(argv[5]);
     n3_block = std::stoi(argv[6]);
     num_iterations = std::stoi(argv[7]);
+    if (argc > 8) time_block = std::stoi(argv[8]);
   }
 
   catch (...) {
@@ -380,6 +384,7 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+#ifndef USE_CPU
   // Check for available omp offload capable device
   int num_devices = omp_get_num_devices();
   if (num_devices <= 0) {
@@ -388,13 +393,10 @@ int main(int argc, char *argv[]) {
     Usage(argv[0]);
     return 1;
   }
+#endif
 
   auto nsize = n1 * n2 * n3;
 
-  prev_base = new float[nsize];
-  next_base = new float[nsize];
-  vel_base = new float[nsize];
-
   // Compute coefficients to be used in wavefield update
   float coeff[kHalfLength + 1] = {-3.0548446,   +1.7777778,     -3.1111111e-1,
                                   +7.572087e-2, -1.76767677e-2, +3.480962e-3,
@@ -406,6 +408,23 @@ int main(int argc, char *argv[]) {
     coeff[i] = coeff[i] / (dxyz * dxyz);
   }
 
+#ifdef USE_CPU
+  std::cout << "Grid Sizes: " << n1 - 2 * kHalfLength << " "
+            << n2 - 2 * kHalfLength << " " << n3 - 2 * kHalfLength << "\n";
+  std::cout << "Block sizes: " << n1_block << " " << n2_block << " "
+            << n3_block << "\n";
+  std::cout << "Using OpenMP CPU code with " << omp_get_max_threads()
+            << " threads\n";
+  std::cout << "Memory Usage (MBytes): "
+            << ((6 * nsize * sizeof(float)) / (1024 * 1024)) << "\n";
+
+  error = Iso3dfdCpu(coeff, n1, n2, n3, num_iterations, n1_block, n2_block,
+                     n3_block, time_block);
+#else
+  prev_base = new float[nsize];
+  next_base = new float[nsize];
+  vel_base = new float[nsize];
+
   Initialize(prev_base, next_base, vel_base, n1, n2, n3);
 
   std::cout << "Grid Sizes: " << n1 - 2 * kHalfLength << " "
@@ -448,6 +467,7 @@ int main(int argc, char *argv[]) {
   delete[] prev_base;
   delete[] next_base;
   delete[] vel_base;
+#endif
 
   return error ? 1 : 0;
 }
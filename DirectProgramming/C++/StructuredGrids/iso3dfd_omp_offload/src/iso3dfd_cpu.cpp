@@ -0,0 +1,279 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#include "../include/iso3dfd.h"
+
+/*
+ * Candidate slab thicknesses and time block sizes tried by the autotuner,
+ * and the number of timesteps of each trial (a multiple of every time block)
+ */
+constexpr size_t kTuneSlabs[] = {8, 16, 32};
+constexpr size_t kTuneTimeBlocks[] = {1, 2, 4};
+constexpr size_t kTuneSteps = 4;
+
+/*
+ * Host-Code
+ * Utility function to find the interior rows (in the y-dimension) of the
+ * calling OpenMP thread. The rows are split statically among the threads, so
+ * a thread always updates the same rows of every plane, and the first touch
+ * of these rows by the same thread places them in its NUMA node.
+ */
+static void GetThreadRows(size_t n2, size_t& y_begin, size_t& y_end) {
+  size_t rows = n2 - 2 * kHalfLength;
+  size_t num_threads = omp_get_num_threads();
+  size_t tid = omp_get_thread_num();
+  y_begin = kHalfLength + (rows * tid) / num_threads;
+  y_end = kHalfLength + (rows * (tid + 1)) / num_threads;
+}
+
+/*
+ * Host-Code
+ * Initialization with NUMA-aware first touch. Memory pages are placed in the
+ * NUMA node of the thread that first writes them, so every thread first
+ * writes the rows it updates in Iso3dfdWavefront. The first and last threads
+ * also touch the halo rows. The values are then set by Initialize, which does
+ * not move the pages.
+ */
+void InitializeFirstTouch(float* ptr_prev, float* ptr_next, float* ptr_vel,
+                          size_t n1, size_t n2, size_t n3) {
+  auto dimn1n2 = n1 * n2;
+
+#pragma omp parallel default(shared)
+  {
+    size_t y_begin, y_end;
+    GetThreadRows(n2, y_begin, y_end);
+    if (omp_get_thread_num() == 0) y_begin = 0;
+    if (omp_get_thread_num() == omp_get_num_threads() - 1) y_end = n2;
+
+    for (size_t iz = 0; iz < n3; iz++) {
+      auto offset = iz * dimn1n2 + y_begin * n1;
+      auto count = (y_end - y_begin) * n1;
+      memset(ptr_prev + offset, 0, count * sizeof(float));
+      memset(ptr_next + offset, 0, count * sizeof(float));
+      memset(ptr_vel + offset, 0, count * sizeof(float));
+    }
+  }
+
+  Initialize(ptr_prev, ptr_next, ptr_vel, n1, n2, n3);
+}
+
+/*
+ * Host-Code
+ * Updates the planes [z_begin, z_end) and rows [y_begin, y_end) of
+ * ptr_next_base for one timestep, with n1_block x n2_block cache blocks
+ */
+static void Iso3dfdCpuSlab(float* ptr_next_base, float* ptr_prev_base,
+                           float* ptr_vel_base, float* coeff, size_t n1,
+                           size_t n2, size_t z_begin, size_t z_end,
+                           size_t y_begin, size_t y_end, size_t n1_block,
+                           size_t n2_block) {
+  auto dimn1n2 = n1 * n2;
+  auto n1_end = n1 - kHalfLength;
+
+  for (auto by = y_begin; by < y_end; by += n2_block) {
+    for (auto bx = kHalfLength; bx < n1_end; bx += n1_block) {
+      auto iy_end = std::min(by + n2_block, y_end);
+      auto ix_end = std::min(bx + n1_block, n1_end);
+      for (auto iz = z_begin; iz < z_end; iz++) {
+        for (auto iy = by; iy < iy_end; iy++) {
+          float* ptr_next = ptr_next_base + iz * dimn1n2 + iy * n1;
+          float* ptr_prev = ptr_prev_base + iz * dimn1n2 + iy * n1;
+          float* ptr_vel = ptr_vel_base + iz * dimn1n2 + iy * n1;
+#pragma omp simd
+          for (auto ix = bx; ix < ix_end; ix++) {
+            float value = 0.0f;
+            value += ptr_prev[ix] * coeff[0];
+            value += STENCIL_LOOKUP(1);
+            value += STENCIL_LOOKUP(2);
+            value += STENCIL_LOOKUP(3);
+            value += STENCIL_LOOKUP(4);
+            value += STENCIL_LOOKUP(5);
+            value += STENCIL_LOOKUP(6);
+            value += STENCIL_LOOKUP(7);
+            value += STENCIL_LOOKUP(8);
+            ptr_next[ix] =
+                2.0f * ptr_prev[ix] - ptr_next[ix] + value * ptr_vel[ix];
+          }
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Host-Code
+ * Driver function for ISO3DFD OpenMP CPU code with wavefront temporal
+ * blocking. Uses ptr_next and ptr_prev as ping-pong buffers like Iso3dfd.
+ *
+ * The timesteps are processed in blocks of time_block timesteps. Within a
+ * block, a wavefront sweeps the z-dimension in slabs of slab planes: at each
+ * position of the wavefront, every timestep of the block updates one slab,
+ * and each timestep trails the previous one by kHalfLength planes. So a
+ * timestep only reads planes that the previous timestep has already updated,
+ * and only overwrites planes that the previous timestep no longer reads.
+ * The planes a block touches stay in cache between its timesteps, instead
+ * of the whole grid being streamed from memory every timestep.
+ *
+ * Within a slab, the rows are split among the threads like in
+ * InitializeFirstTouch, so threads mostly access their own NUMA node.
+ */
+void Iso3dfdWavefront(float* ptr_next, float* ptr_prev, float* ptr_vel,
+                      float* coeff, size_t n1, size_t n2, size_t n3,
+                      size_t nreps, size_t n1_block, size_t n2_block,
+                      size_t slab, size_t time_block) {
+  auto n3_end = n3 - kHalfLength;
+
+#pragma omp parallel default(shared)
+  {
+    size_t y_begin, y_end;
+    GetThreadRows(n2, y_begin, y_end);
+
+    for (size_t t = 0; t < nreps; t += time_block) {
+      auto steps = std::min(time_block, nreps - t);
+      auto wave_end = n3_end + (steps - 1) * kHalfLength;
+
+      for (auto w = kHalfLength; w < wave_end; w += slab) {
+        for (size_t s = 0; s < steps; s++) {
+          // Planes of this timestep at this position of the wavefront
+          size_t lag = s * kHalfLength;
+          size_t z_begin = std::max(w, kHalfLength + lag) - lag;
+          size_t z_end = std::min(w + slab - std::min(lag, w + slab), n3_end);
+
+          // Even timesteps update ptr_next, odd timesteps update ptr_prev
+          bool even = ((t + s) % 2 == 0);
+          if (z_begin < z_end)
+            Iso3dfdCpuSlab(even ? ptr_next : ptr_prev,
+                           even ? ptr_prev : ptr_next, ptr_vel, coeff, n1, n2,
+                           z_begin, z_end, y_begin, y_end, n1_block,
+                           n2_block);
+#pragma omp barrier
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Host-Code
+ * Autotuner for the wavefront: runs kTuneSteps timesteps with every
+ * candidate slab thickness and time block size, and selects the fastest.
+ * The wavefields are modified, so they must be initialized again afterwards.
+ */
+void TuneWavefront(float* ptr_next, float* ptr_prev, float* ptr_vel,
+                   float* coeff, size_t n1, size_t n2, size_t n3,
+                   size_t n1_block, size_t n2_block, size_t& slab,
+                   size_t& time_block) {
+  double best_time = 0.0;
+
+  std::cout << "Autotuning slab and time block sizes ...\n";
+  for (auto candidate_slab : kTuneSlabs) {
+    for (auto candidate_time_block : kTuneTimeBlocks) {
+      auto start = std::chrono::steady_clock::now();
+      Iso3dfdWavefront(ptr_next, ptr_prev, ptr_vel, coeff, n1, n2, n3,
+                       kTuneSteps, n1_block, n2_block, candidate_slab,
+                       candidate_time_block);
+      auto end = std::chrono::steady_clock::now();
+      double time = std::chrono::duration<double>(end - start).count();
+
+      std::cout << "  slab " << candidate_slab << ", time block "
+                << candidate_time_block << " : " << time * 1e3 << " ms\n";
+      if (best_time == 0.0 || time < best_time) {
+        best_time = time;
+        slab = candidate_slab;
+        time_block = candidate_time_block;
+      }
+    }
+  }
+}
+
+/*
+ * Host-Code
+ * Runs the current OpenMP CPU code (Iso3dfdVerify, initialized by the main
+ * thread) and the wavefront version with NUMA-aware first touch, reports the
+ * throughput of both and checks that they compute the same wavefields.
+ * If time_block is 0, the slab thickness and time block size are selected by
+ * the autotuner, otherwise the slab thickness is n3_block.
+ */
+bool Iso3dfdCpu(float* coeff, size_t n1, size_t n2, size_t n3,
+                size_t num_iterations, size_t n1_block, size_t n2_block,
+                size_t n3_block, size_t time_block) {
+  auto nsize = n1 * n2 * n3;
+
+  // Current OpenMP CPU code
+  float* prev_base = new float[nsize];
+  float* next_base = new float[nsize];
+  float* vel_base = new float[nsize];
+
+  Initialize(prev_base, next_base, vel_base, n1, n2, n3);
+
+  std::cout << "--OpenMP CPU with cache blocking\n";
+  auto start = std::chrono::steady_clock::now();
+  Iso3dfdVerify(next_base, prev_base, vel_base, coeff, n1, n2, n3,
+                num_iterations, n1_block, n2_block, n3_block);
+  auto end = std::chrono::steady_clock::now();
+  auto time_blocked =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+          .count();
+  PrintStats(time_blocked, n1, n2, n3, num_iterations);
+
+  // Wavefront version, with newly allocated (not yet touched) wavefields
+  float* prev_wave = new float[nsize];
+  float* next_wave = new float[nsize];
+  float* vel_wave = new float[nsize];
+
+  InitializeFirstTouch(prev_wave, next_wave, vel_wave, n1, n2, n3);
+
+  size_t slab = n3_block;
+  if (time_block == 0) {
+    TuneWavefront(next_wave, prev_wave, vel_wave, coeff, n1, n2, n3, n1_block,
+                  n2_block, slab, time_block);
+    InitializeFirstTouch(prev_wave, next_wave, vel_wave, n1, n2, n3);
+  }
+
+  std::cout << "--OpenMP CPU with NUMA first touch and wavefront temporal "
+               "blocking\n";
+  std::cout << "Slab size: " << slab << ", time block size: " << time_block
+            << "\n";
+  start = std::chrono::steady_clock::now();
+  Iso3dfdWavefront(next_wave, prev_wave, vel_wave, coeff, n1, n2, n3,
+                   num_iterations, n1_block, n2_block, slab, time_block);
+  end = std::chrono::steady_clock::now();
+  auto time_wave =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+          .count();
+  PrintStats(time_wave, n1, n2, n3, num_iterations);
+
+  if (time_wave > 0)
+    std::cout << "Speedup over cache blocking: "
+              << (double)time_blocked / time_wave << "x\n";
+
+  // The last timestep is in next if the number of timesteps is odd
+  bool error;
+  if (num_iterations % 2)
+    error = WithinEpsilon(next_wave, next_base, n1, n2, n3, kHalfLength, 0,
+                          0.1f);
+  else
+    error = WithinEpsilon(prev_wave, prev_base, n1, n2, n3, kHalfLength, 0,
+                          0.1f);
+
+  if (error) {
+    std::cout << "Final wavefields from wavefront and cache blocking CPU "
+              << "code are not equivalent: Fail\n";
+  } else {
+    std::cout << "Final wavefields from wavefront and cache blocking CPU "
+              << "code are equivalent: Success\n";
+  }
+  std::cout << "--------------------------------------\n";
+
+  delete[] prev_base;
+  delete[] next_base;
+  delete[] vel_base;
+  delete[] prev_wave;
+  delete[] next_wave;
+  delete[] vel_wave;
+
+  return error;
+}
@@ -15,11 +15,14 @@ void Usage(const std::string& programName) {
   std::cout << " Incorrect parameters \n";
   std::cout << " Usage: ";
   std::cout << programName
-            << " n1 n2 n3 n1_block n2_block n3_block Iterations\n\n";
+            << " n1 n2 n3 n1_block n2_block n3_block Iterations"
+            << " [time_block]\n\n";
   std::cout << " n1 n2 n3      			: Grid sizes for the stencil\n";
   std::cout << " n1_block n2_block n3_block     : cache block sizes for CPU\n";
   std::cout << " 	       			: TILE sizes for OMP Offload\n";
   std::cout << " Iterations    			: No. of timesteps.\n";
+  std::cout << " time_block    			: (CPU version only) timesteps\n";
+  std::cout << " 	       			  per wavefront, 0 to autotune\n";
   std::cout << "--------------------------------------\n";
   std::cout << "--------------------------------------\n";
 }
@@ -39,6 +39,110 @@ using namespace sycl;
 
 #include "sorting_networks_common.h"
 
+////////////////////////////////////////////////////////////////////////////////
+// Throughput comparison of odd-even merge sort and merge path sort on single
+// arrays of 1M to maxLength key/value pairs. Lengths that do not fit into
+// device or host memory are skipped
+////////////////////////////////////////////////////////////////////////////////
+int compareThroughput(queue &q, size_t maxLength, uint dir, uint numValues) {
+  StopWatchInterface *hTimer = NULL;
+  size_t globalMem = q.get_device().get_info<info::device::global_mem_size>();
+  size_t maxAlloc =
+      q.get_device().get_info<info::device::max_mem_alloc_size>();
+  int flag = 1;
+
+  sdkCreateTimer(&hTimer);
+  printf("Comparing throughput of odd-even merge sort and merge path sort...\n\n");
+  printf("%12s %22s %22s\n", "Pairs", "odd-even (MPairs/s)",
+         "merge path (MPairs/s)");
+
+  for (size_t length = 1048576; length <= maxLength; length *= 4) {
+    size_t bytes = length * sizeof(uint);
+
+    // Input, output and scratch keys and values
+    if (bytes > maxAlloc || 6 * bytes > globalMem) {
+      printf("%12zu %22s %22s\n", length, "skipped", "skipped");
+      continue;
+    }
+
+    uint *h_Key = (uint *)malloc(bytes);
+    uint *h_Val = (uint *)malloc(bytes);
+    uint *h_ResKey = (uint *)malloc(bytes);
+    uint *h_ResVal = (uint *)malloc(bytes);
+
+    if (!h_Key || !h_Val || !h_ResKey || !h_ResVal) {
+      printf("%12zu %22s %22s\n", length, "skipped", "skipped");
+      free(h_Key);
+      free(h_Val);
+      free(h_ResKey);
+      free(h_ResVal);
+      continue;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+      h_Key[i] = rand() % numValues;
+      h_Val[i] = i;
+    }
+
+    uint *d_Key = malloc_device<uint>(length, q);
+    uint *d_Val = malloc_device<uint>(length, q);
+    uint *d_ResKey = malloc_device<uint>(length, q);
+    uint *d_ResVal = malloc_device<uint>(length, q);
+    uint *d_BufKey = malloc_device<uint>(length, q);
+    uint *d_BufVal = malloc_device<uint>(length, q);
+
+    q.memcpy(d_Key, h_Key, bytes).wait();
+    q.memcpy(d_Val, h_Val, bytes).wait();
+
+    // Both sorts run once before being timed, to exclude the JIT compilation
+    double time[2];
+
+    for (int method = 0; method < 2; method++) {
+      for (int timed = 0; timed < 2; timed++) {
+        q.wait_and_throw();
+        sdkResetTimer(&hTimer);
+        sdkStartTimer(&hTimer);
+
+        if (method == 0)
+          oddEvenMergeSort(d_ResKey, d_ResVal, d_Key, d_Val, 1, length, dir, q);
+        else
+          mergePathSort(d_ResKey, d_ResVal, d_Key, d_Val, d_BufKey, d_BufVal,
+                        1, length, dir, q);
+
+        q.wait_and_throw();
+        sdkStopTimer(&hTimer);
+      }
+      time[method] = 1.0e-3 * sdkGetTimerValue(&hTimer);
+    }
+
+    printf("%12zu %22.2f %22.2f\n", length, 1.0e-6 * length / time[0],
+           1.0e-6 * length / time[1]);
+
+    // Results of the merge path sort, the last one run
+    q.memcpy(h_ResKey, d_ResKey, bytes).wait();
+    q.memcpy(h_ResVal, d_ResVal, bytes).wait();
+    int keysFlag =
+        validateSortedKeys(h_ResKey, h_Key, 1, length, numValues, dir);
+    int valuesFlag = validateValues(h_ResKey, h_ResVal, h_Key, 1, length);
+    flag = flag && keysFlag && valuesFlag;
+
+    free(d_BufVal, q);
+    free(d_BufKey, q);
+    free(d_ResVal, q);
+    free(d_ResKey, q);
+    free(d_Val, q);
+    free(d_Key, q);
+    free(h_ResVal);
+    free(h_ResKey);
+    free(h_Val);
+    free(h_Key);
+  }
+
+  printf("\n");
+  sdkDeleteTimer(&hTimer);
+  return flag;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Test driver
 ////////////////////////////////////////////////////////////////////////////////
@@ -50,6 +154,7 @@ int main(int argc, char **argv) try {
             << "\n";
   uint *h_InputKey, *h_InputVal, *h_OutputKeyGPU, *h_OutputValGPU;
   uint *d_InputKey, *d_InputVal, *d_OutputKey, *d_OutputVal;
+  uint *d_BufKey, *d_BufVal;
   StopWatchInterface *hTimer = NULL;
 
   const uint N = 1048576;
@@ -57,6 +162,13 @@ int main(int argc, char **argv) try {
   const uint numValues = 65536;
   const uint numIterations = 1;
 
+  // Arbitrary array lengths sorted by the merge path sort
+  const uint mergePathLengths[] = {1, 500, 1000, 4097, 65535, 100003, N - 1};
+
+  // Largest array length of the throughput comparison
+  size_t maxLength = 268435456;
+  if (argc > 1) maxLength = strtoull(argv[1], NULL, 10);
+
   printf("Allocating and initializing host arrays...\n\n");
   sdkCreateTimer(&hTimer);
   h_InputKey = (uint *)malloc(N * sizeof(uint));
@@ -76,6 +188,9 @@ int main(int argc, char **argv) try {
   d_OutputKey = malloc_device<uint>(N, q);
   d_OutputVal = malloc_device<uint>(N, q);
 
+  d_BufKey = malloc_device<uint>(N, q);
+  d_BufVal = malloc_device<uint>(N, q);
+
   q.memcpy(d_InputKey, h_InputKey, N * sizeof(uint)).wait();
   q.memcpy(d_InputVal, h_InputVal, N * sizeof(uint)).wait();
 
@@ -130,8 +245,50 @@ int main(int argc, char **argv) try {
     printf("\n");
   }
 
+  printf("Running GPU merge path sort (%u identical iterations)...\n\n",
+         numIterations);
+
+  for (uint arrayLength : mergePathLengths) {
+    uint batchSize = N / arrayLength;
+    printf("Testing array length %u (%u arrays per batch)...\n", arrayLength,
+           batchSize);
+
+    q.wait_and_throw();
+
+    sdkResetTimer(&hTimer);
+    sdkStartTimer(&hTimer);
+
+    for (uint i = 0; i < numIterations; i++)
+      mergePathSort(d_OutputKey, d_OutputVal, d_InputKey, d_InputVal, d_BufKey,
+                    d_BufVal, batchSize, arrayLength, DIR, q);
+
+    q.wait_and_throw();
+
+    sdkStopTimer(&hTimer);
+    printf("Average time: %f ms\n\n",
+           sdkGetTimerValue(&hTimer) / numIterations);
+
+    printf("\nValidating the results...\n");
+    printf("...reading back GPU results\n");
+
+    q.memcpy(h_OutputKeyGPU, d_OutputKey, N * sizeof(uint)).wait();
+    q.memcpy(h_OutputValGPU, d_OutputVal, N * sizeof(uint)).wait();
+
+    int keysFlag = validateSortedKeys(h_OutputKeyGPU, h_InputKey, batchSize,
+                                      arrayLength, numValues, DIR);
+    int valuesFlag = validateValues(h_OutputKeyGPU, h_OutputValGPU, h_InputKey,
+                                    batchSize, arrayLength);
+    flag = flag && keysFlag && valuesFlag;
+
+    printf("\n");
+  }
+
+  flag = compareThroughput(q, maxLength, DIR, numValues) && flag;
+
   printf("Shutting down...\n");
   sdkDeleteTimer(&hTimer);
+  free(d_BufVal, q);
+  free(d_BufKey, q);
   free(d_OutputVal, q);
   free(d_OutputKey, q);
   free(d_InputVal, q);
@@ -140,7 +297,6 @@ int main(int argc, char **argv) try {
   free(h_OutputKeyGPU);
   free(h_InputVal);
   free(h_InputKey);
-  flag = 1;
   exit(flag ? EXIT_SUCCESS : EXIT_FAILURE);
 } catch (exception const &exc) {
   std::cerr << exc.what() << "Exception caught at file:" << __FILE__
@@ -135,6 +135,119 @@ void oddEvenMergeGlobal(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Merge path sort tile kernel: sorts the SHARED_SIZE_LIMIT element tiles of
+// arrays of any length with the odd-even merge network. The last tile of an
+// array may be partial, the missing elements are padded with keys that sort
+// after every element. Each key is sorted together with its rank in the tile,
+// which makes the network stable and keeps the padding after the elements
+// with the same key. The values are gathered by rank once the tile is sorted
+////////////////////////////////////////////////////////////////////////////////
+void oddEvenMergeSortTile(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
+                          uint *d_SrcVal, uint arrayLength, uint tilesPerArray,
+                          uint dir, nd_item<3> item, uint64_t *s_key) {
+  uint tile = item.get_group(2) % tilesPerArray;
+  uint tileBase = (item.get_group(2) / tilesPerArray) * arrayLength +
+                  tile * SHARED_SIZE_LIMIT;
+  uint count = sycl::min(SHARED_SIZE_LIMIT,
+                         arrayLength - tile * SHARED_SIZE_LIMIT);
+
+  // In descending order the ranks are reversed, so that equal keys still keep
+  // their order
+  for (uint i = item.get_local_id(2); i < SHARED_SIZE_LIMIT;
+       i += SHARED_SIZE_LIMIT / 2) {
+    uint key = (i < count) ? d_SrcKey[tileBase + i] : (dir ? ~0U : 0U);
+    uint rank = dir ? i : SHARED_SIZE_LIMIT - 1 - i;
+    s_key[i] = ((uint64_t)key << 32) | rank;
+  }
+
+  for (uint size = 2; size <= SHARED_SIZE_LIMIT; size <<= 1) {
+    uint stride = size / 2;
+    uint offset = item.get_local_id(2) & (stride - 1);
+
+    {
+      item.barrier();
+      uint pos =
+          2 * item.get_local_id(2) - (item.get_local_id(2) & (stride - 1));
+      Comparator(s_key[pos + 0], s_key[pos + stride], dir);
+      stride >>= 1;
+    }
+
+    for (; stride > 0; stride >>= 1) {
+      item.barrier();
+      uint pos =
+          2 * item.get_local_id(2) - (item.get_local_id(2) & (stride - 1));
+
+      if (offset >= stride)
+        Comparator(s_key[pos - stride], s_key[pos + 0], dir);
+    }
+  }
+
+  item.barrier();
+  for (uint i = item.get_local_id(2); i < count; i += SHARED_SIZE_LIMIT / 2) {
+    uint rank = (uint)s_key[i];
+    d_DstKey[tileBase + i] = (uint)(s_key[i] >> 32);
+    d_DstVal[tileBase + i] =
+        d_SrcVal[tileBase + (dir ? rank : SHARED_SIZE_LIMIT - 1 - rank)];
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Merge path iteration kernel: merges pairs of sorted runs of width elements
+// into runs of 2 * width elements. Each work-item produces MERGE_PATH_ITEMS
+// consecutive outputs: it finds where its first output splits the two runs
+// with a binary search along the merge path, then merges sequentially. Ties
+// are taken from the first run, so the merge is stable
+////////////////////////////////////////////////////////////////////////////////
+void mergePathGlobal(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
+                     uint *d_SrcVal, uint arrayLength, uint width,
+                     uint chunksPerArray, uint numChunks, uint dir,
+                     nd_item<3> item) {
+  uint chunk =
+      item.get_group(2) * item.get_local_range().get(2) + item.get_local_id(2);
+  if (chunk >= numChunks) return;
+
+  uint arrayBase = (chunk / chunksPerArray) * arrayLength;
+  d_SrcKey += arrayBase;
+  d_SrcVal += arrayBase;
+  d_DstKey += arrayBase;
+  d_DstVal += arrayBase;
+
+  // First run is [aBegin, aEnd), second run is [aEnd, bEnd)
+  uint pos = (chunk % chunksPerArray) * MERGE_PATH_ITEMS;
+  uint aBegin = pos - pos % (2 * width);
+  uint aEnd = sycl::min(aBegin + width, arrayLength);
+  uint bEnd = sycl::min(aEnd + width, arrayLength);
+  uint outEnd = sycl::min(pos + MERGE_PATH_ITEMS, bEnd);
+
+  // Number of elements of the first run among the first diag outputs
+  uint diag = pos - aBegin;
+  uint lo = (diag > bEnd - aEnd) ? diag - (bEnd - aEnd) : 0;
+  uint hi = sycl::min(diag, aEnd - aBegin);
+
+  while (lo < hi) {
+    uint mid = (lo + hi) / 2;
+
+    if (Precedes(d_SrcKey[aEnd + diag - 1 - mid], d_SrcKey[aBegin + mid], dir))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  uint a = aBegin + lo;
+  uint b = aEnd + diag - lo;
+
+  for (; pos < outEnd; pos++) {
+    if (b >= bEnd || (a < aEnd && !Precedes(d_SrcKey[b], d_SrcKey[a], dir))) {
+      d_DstKey[pos] = d_SrcKey[a];
+      d_DstVal[pos] = d_SrcVal[a++];
+    } else {
+      d_DstKey[pos] = d_SrcKey[b];
+      d_DstVal[pos] = d_SrcVal[b++];
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Interface function
 ////////////////////////////////////////////////////////////////////////////////
@@ -213,9 +326,73 @@ extern "C" uint oddEvenMergeSort(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
               oddEvenMergeGlobal(d_DstKey, d_DstVal, d_DstKey, d_DstVal,
                                  arrayLength, size, stride, dir, item);
             });
-        break;
       }
   }
 
   return workgroup_size;
 }
+
+extern "C" uint mergePathSort(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
+                              uint *d_SrcVal, uint *d_BufKey, uint *d_BufVal,
+                              uint batchSize, uint arrayLength, uint dir,
+                              queue &q) {
+  // Nothing to sort
+  if (!batchSize || !arrayLength) return 0;
+
+  dir = (dir != 0);
+
+  uint tilesPerArray =
+      (arrayLength + SHARED_SIZE_LIMIT - 1) / SHARED_SIZE_LIMIT;
+  uint workgroup_size = SHARED_SIZE_LIMIT / 2;
+
+  // Each merge pass doubles the width of the sorted runs, so there are
+  // log2(arrayLength / SHARED_SIZE_LIMIT) passes, instead of the
+  // O(log^2(arrayLength)) passes of oddEvenMergeGlobal
+  uint numPasses = 0;
+  for (size_t width = SHARED_SIZE_LIMIT; width < arrayLength; width <<= 1)
+    numPasses++;
+
+  // The passes ping-pong between the destination and the scratch arrays,
+  // starting from the one that makes the last pass write the destination
+  uint *keys[2] = {d_DstKey, d_BufKey};
+  uint *vals[2] = {d_DstVal, d_BufVal};
+  uint cur = numPasses % 2;
+
+  q.submit([&](handler &h) {
+    local_accessor<uint64_t, 1> s_key_acc(range<1>(SHARED_SIZE_LIMIT), h);
+    uint *dstKey = keys[cur];
+    uint *dstVal = vals[cur];
+
+    h.parallel_for(nd_range<3>(range<3>(1, 1, batchSize * tilesPerArray) *
+                                   range<3>(1, 1, workgroup_size),
+                               range<3>(1, 1, workgroup_size)),
+                   [=](nd_item<3> item) {
+                     oddEvenMergeSortTile(dstKey, dstVal, d_SrcKey, d_SrcVal,
+                                          arrayLength, tilesPerArray, dir,
+                                          item, s_key_acc.get_pointer());
+                   });
+  });
+
+  uint chunksPerArray =
+      (arrayLength + MERGE_PATH_ITEMS - 1) / MERGE_PATH_ITEMS;
+  uint numChunks = batchSize * chunksPerArray;
+  uint num_workgroups = (numChunks + workgroup_size - 1) / workgroup_size;
+  uint width = SHARED_SIZE_LIMIT;
+
+  for (uint pass = 0; pass < numPasses; pass++, width <<= 1) {
+    uint *srcKey = keys[cur], *srcVal = vals[cur];
+    uint *dstKey = keys[cur ^ 1], *dstVal = vals[cur ^ 1];
+
+    q.parallel_for(nd_range<3>(range<3>(1, 1, num_workgroups) *
+                                   range<3>(1, 1, workgroup_size),
+                               range<3>(1, 1, workgroup_size)),
+                   [=](nd_item<3> item) {
+                     mergePathGlobal(dstKey, dstVal, srcKey, srcVal,
+                                     arrayLength, width, chunksPerArray,
+                                     numChunks, dir, item);
+                   });
+    cur ^= 1;
+  }
+
+  return workgroup_size;
+}
@@ -56,3 +56,11 @@ extern "C" int validateValues(uint *resKey, uint *resVal, uint *srcKey,
 extern "C" uint oddEvenMergeSort(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
                                  uint *d_SrcVal, uint batchSize,
                                  uint arrayLength, uint dir, queue &q);
+
+// Stable sort of batchSize arrays of any arrayLength. d_BufKey and d_BufVal
+// are scratch arrays of batchSize * arrayLength elements. The kernels are
+// submitted in order, so q must be an in-order queue
+extern "C" uint mergePathSort(uint *d_DstKey, uint *d_DstVal, uint *d_SrcKey,
+                              uint *d_SrcVal, uint *d_BufKey, uint *d_BufVal,
+                              uint batchSize, uint arrayLength, uint dir,
+                              queue &q);
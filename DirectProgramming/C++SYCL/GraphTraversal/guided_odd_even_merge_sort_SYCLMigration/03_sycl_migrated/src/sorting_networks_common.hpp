@@ -53,4 +53,24 @@ inline void Comparator(uint &keyA, uint &valA, uint &keyB, uint &valB,
   }
 }
 
+// Number of consecutive outputs merged by each work-item of the merge path
+// sort. Must divide SHARED_SIZE_LIMIT
+#define MERGE_PATH_ITEMS 16U
+
+// Comparator for the composite (key, rank) keys of the merge path tile sort
+inline void Comparator(uint64_t &keyA, uint64_t &keyB, uint dir) {
+  uint64_t t;
+
+  if ((keyA > keyB) == dir) {
+    t = keyA;
+    keyA = keyB;
+    keyB = t;
+  }
+}
+
+// True if keyA must be placed before keyB in a strict sort order
+inline bool Precedes(uint keyA, uint keyB, uint dir) {
+  return dir ? (keyA < keyB) : (keyA > keyB);
+}
+
 #endif
@@ -43,7 +43,12 @@
 #include <helper_functions.h>  // Helper functions (utilities, parsing, timing)
 #include <multithreading.h>
 using namespace sycl;
+#include <algorithm>
 #include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "MonteCarlo_common.h"
 
@@ -189,6 +194,285 @@ static void multiSolver(TOptionPlan *plan, int nPlans) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Dynamic load-balanced scheduler
+////////////////////////////////////////////////////////////////////////////////
+struct TScheduler;
+
+// A worker drives one SYCL device or sub-device. It owns a double-ended
+// queue of option chunks: the worker takes chunks from the front of its own
+// queue, and other workers steal chunks from the back when theirs is empty.
+struct TWorker {
+  sycl::device device;
+  TScheduler *scheduler;
+  // Solver config, allocated once for a full chunk, with persistent RNG
+  // states that are reused for all the chunks of the worker
+  TOptionPlan plan;
+
+  std::deque<int> chunks;
+  std::mutex lock;
+
+  // Statistics
+  int optionCount;
+  int chunkCount;
+  int stolenCount;
+  double busyTime;
+};
+
+struct TScheduler {
+  TWorker *workers;
+  int workerN;
+  TOptionData *optionData;
+  TOptionValue *callValue;
+  int optionN;
+  int chunkSize;
+};
+
+/// Utility function to list the devices used as workers. The same device
+/// listed by several platforms (backends) is used only once. CPU devices are
+/// partitioned into sub-devices: with cpuPartition compute units each, or by
+/// NUMA node if cpuPartition is 0.
+std::vector<sycl::device> getWorkerDevices(int cpuPartition) {
+  std::vector<sycl::device> devices;
+  std::vector<std::string> previousPlatformNames;
+
+  for (auto &platform : sycl::platform::get_platforms()) {
+    std::vector<std::string> platformNames;
+
+    for (auto &device : platform.get_devices()) {
+      std::string name = device.get_info<sycl::info::device::name>();
+      platformNames.push_back(name);
+
+      if (std::find(previousPlatformNames.begin(), previousPlatformNames.end(),
+                    name) != previousPlatformNames.end()) {
+        continue;
+      }
+
+      if (device.is_cpu()) {
+        std::vector<sycl::device> subDevices;
+
+        try {
+          if (cpuPartition > 0) {
+            subDevices = device.create_sub_devices<
+                sycl::info::partition_property::partition_equally>(
+                cpuPartition);
+          } else {
+            subDevices = device.create_sub_devices<
+                sycl::info::partition_property::partition_by_affinity_domain>(
+                sycl::info::partition_affinity_domain::numa);
+          }
+        } catch (sycl::exception const &e) {
+          // Partitioning is not supported, use the whole device
+        }
+
+        if (subDevices.size() > 1) {
+          devices.insert(devices.end(), subDevices.begin(), subDevices.end());
+          continue;
+        }
+      }
+
+      devices.push_back(device);
+    }
+
+    previousPlatformNames.insert(previousPlatformNames.end(),
+                                 platformNames.begin(), platformNames.end());
+  }
+
+  return devices;
+}
+
+/// Take the next chunk of a worker: from the front of its own queue, or
+/// else from the back of the longest queue of the other workers
+static bool takeChunk(TWorker *worker, int &chunk) {
+  {
+    std::lock_guard<std::mutex> guard(worker->lock);
+
+    if (!worker->chunks.empty()) {
+      chunk = worker->chunks.front();
+      worker->chunks.pop_front();
+      return true;
+    }
+  }
+
+  TScheduler *scheduler = worker->scheduler;
+
+  while (true) {
+    TWorker *victim = NULL;
+    size_t victimSize = 0;
+
+    for (int i = 0; i < scheduler->workerN; i++) {
+      TWorker *other = &scheduler->workers[i];
+      std::lock_guard<std::mutex> guard(other->lock);
+
+      if (other->chunks.size() > victimSize) {
+        victim = other;
+        victimSize = other->chunks.size();
+      }
+    }
+
+    if (victim == NULL) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> guard(victim->lock);
+
+    // The queue may have been emptied since it was selected
+    if (!victim->chunks.empty()) {
+      chunk = victim->chunks.back();
+      victim->chunks.pop_back();
+      worker->stolenCount++;
+      return true;
+    }
+  }
+}
+
+static CUT_THREADPROC dynamicWorkerThread(TWorker *worker) {
+  TScheduler *scheduler = worker->scheduler;
+  TOptionPlan *plan = &worker->plan;
+
+  auto exception_handler = [](exception_list exceptions) {
+    for (std::exception_ptr const &e : exceptions) {
+      try {
+        std::rethrow_exception(e);
+      } catch (exception const &e) {
+        std::cout << "Caught asynchronous SYCL exception during ASUM:\n"
+                  << e.what() << std::endl;
+      }
+    }
+  };
+  sycl::queue stream = sycl::queue(worker->device, exception_handler,
+                                   property::queue::in_order());
+
+  // Allocate memory for a full chunk and initialize RNG states once
+  initMonteCarloGPU(plan, &stream);
+  stream.wait_and_throw();
+
+  int chunk;
+
+  while (takeChunk(worker, chunk)) {
+    auto start = std::chrono::steady_clock::now();
+
+    int optionBase = chunk * scheduler->chunkSize;
+    plan->optionCount =
+        std::min(scheduler->chunkSize, scheduler->optionN - optionBase);
+    plan->optionData = scheduler->optionData + optionBase;
+    plan->callValue = scheduler->callValue + optionBase;
+
+    MonteCarloGPU(plan, &stream);
+    stream.wait_and_throw();
+    getMonteCarloResultsGPU(plan);
+
+    auto stop = std::chrono::steady_clock::now();
+    worker->busyTime +=
+        std::chrono::duration<double, std::milli>(stop - start).count();
+    worker->optionCount += plan->optionCount;
+    worker->chunkCount++;
+  }
+
+  freeMonteCarloGPU(plan, &stream);
+  stream.wait();
+
+  CUT_THREADEND;
+}
+
+static void dynamicSolver(TOptionData *optionData, TOptionValue *callValue,
+                          int optionN, int pathN, int chunkSize,
+                          int cpuPartition) {
+  std::vector<sycl::device> devices = getWorkerDevices(cpuPartition);
+  int workerN = devices.size();
+  int chunkN = (optionN + chunkSize - 1) / chunkSize;
+
+  TScheduler scheduler;
+  scheduler.workers = new TWorker[workerN];
+  scheduler.workerN = workerN;
+  scheduler.optionData = optionData;
+  scheduler.callValue = callValue;
+  scheduler.optionN = optionN;
+  scheduler.chunkSize = chunkSize;
+
+  CUTThread *threadID = new CUTThread[workerN];
+
+  printf("Number of workers       = %d\n", workerN);
+  printf("Options per chunk       = %d\n", chunkSize);
+
+  int seedBase = 0;
+
+  for (int i = 0; i < workerN; i++) {
+    TWorker *worker = &scheduler.workers[i];
+    worker->device = devices[i];
+    worker->scheduler = &scheduler;
+    worker->optionCount = 0;
+    worker->chunkCount = 0;
+    worker->stolenCount = 0;
+    worker->busyTime = 0.0;
+
+    worker->plan.device = i;
+    worker->plan.optionCount = std::min(chunkSize, optionN);
+    worker->plan.pathN = pathN;
+    int maxGridSize =
+        devices[i].get_info<sycl::info::device::max_compute_units>() * 40;
+    worker->plan.gridSize = std::min(worker->plan.optionCount, maxGridSize);
+
+    // The RNG states of a worker are seeded once and reused for every chunk
+    // it takes, so they cannot be tied to the options of one chunk. Instead,
+    // the blocks of all the workers are numbered globally, which gives each
+    // block its own seed whatever the grid sizes of the devices are.
+    worker->plan.seedBase = seedBase;
+    seedBase += worker->plan.gridSize;
+
+    // Initial even split of contiguous chunks, rebalanced by work stealing
+    for (int chunk = chunkN * i / workerN; chunk < chunkN * (i + 1) / workerN;
+         chunk++) {
+      worker->chunks.push_back(chunk);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < workerN; i++) {
+    threadID[i] = cutStartThread((CUT_THREADROUTINE)dynamicWorkerThread,
+                                 &scheduler.workers[i]);
+  }
+
+  printf("main(): waiting for worker results...\n");
+  cutWaitForThreads(threadID, workerN);
+
+  auto stop = std::chrono::steady_clock::now();
+  double time = std::chrono::duration<double, std::milli>(stop - start).count();
+
+  printf("main(): device statistics, dynamic\n");
+
+  for (int i = 0; i < workerN; i++) {
+    TWorker *worker = &scheduler.workers[i];
+    bool subDevice =
+        worker->device
+            .get_info<sycl::info::device::partition_type_property>() !=
+        sycl::info::partition_property::no_partition;
+    printf("Worker #%i: ", i);
+    std::cout << worker->device.get_info<sycl::info::device::name>()
+              << (subDevice ? " (sub-device)" : "") << "\n";
+    printf("Compute units   : %i\n",
+           (int)worker->device
+               .get_info<sycl::info::device::max_compute_units>());
+    printf("Options         : %i\n", worker->optionCount);
+    printf("Chunks (stolen) : %i (%i)\n", worker->chunkCount,
+           worker->stolenCount);
+    printf("Busy time (ms.) : %f\n", worker->busyTime);
+    printf("Options per sec.: %f\n",
+           worker->busyTime > 0
+               ? worker->optionCount / (worker->busyTime * 0.001)
+               : 0.0);
+  }
+
+  printf("\nTotal time (ms.): %f\n", time);
+  printf("\tNote: This is elapsed time for all to compute, including "
+         "initialization.\n");
+  printf("Options per sec.: %f\n", optionN / (time * 0.001));
+
+  delete[] threadID;
+  delete[] scheduler.workers;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Main program
 ///////////////////////////////////////////////////////////////////////////////
@@ -198,12 +482,53 @@ static void multiSolver(TOptionPlan *plan, int nPlans) {
 #define PRINT_RESULTS
 #undef PRINT_RESULTS
 
+/// Compare the Monte Carlo results with the Black-Scholes formula: the sums
+/// of the absolute differences and of the absolute reference values, and the
+/// average ratio of the confidence width to the difference
+static void compareWithBlackScholes(TOptionData *optionData,
+                                    TOptionValue *callValueGPU,
+                                    float *callValueBS, int optionN,
+                                    double &sumDelta, double &sumRef,
+                                    double &sumReserve) {
+  printf("main(): comparing Monte Carlo and Black-Scholes results...\n");
+  sumDelta = 0;
+  sumRef = 0;
+  sumReserve = 0;
+
+  for (int i = 0; i < optionN; i++) {
+    BlackScholesCall(callValueBS[i], optionData[i]);
+    double delta = fabs(callValueBS[i] - callValueGPU[i].Expected);
+    double ref = callValueBS[i];
+    sumDelta += delta;
+    sumRef += fabs(ref);
+
+    if (delta > 1e-6) {
+      sumReserve += callValueGPU[i].Confidence / delta;
+    }
+
+#ifdef PRINT_RESULTS
+    printf("BS: %f; delta: %E\n", callValueBS[i], delta);
+#endif
+  }
+
+  sumReserve /= optionN;
+}
+
 void usage() {
-  printf("--method=[threaded,streamed] --scaling=[strong,weak] [--help]\n");
+  printf(
+      "--method=[threaded,streamed,dynamic] --scaling=[strong,weak] "
+      "[--chunk=N] [--cpu_partition=N] [--help]\n");
   printf("Method=threaded: 1 CPU thread for each GPU     [default]\n");
   printf(
       "       streamed: 1 CPU thread handles all GPUs (requires CUDA 4.0 or "
       "newer)\n");
+  printf(
+      "       dynamic : every SYCL device and CPU sub-device is a worker,\n"
+      "                 workers take chunks of options with work stealing\n");
+  printf("Chunk=N        : options per chunk for dynamic method [1024]\n");
+  printf(
+      "Cpu_partition=N: compute units per CPU sub-device for dynamic method,\n"
+      "                 0 to partition CPUs by NUMA node [0]\n");
   printf("Scaling=strong : constant problem size\n");
   printf(
       "        weak   : problem size scales with number of available GPUs "
@@ -214,6 +539,9 @@ int main(int argc, char **argv) {
   char *multiMethodChoice = NULL;
   char *scalingChoice = NULL;
   bool use_threads = true;
+  bool use_dynamic = false;
+  int chunkSize = 1024;
+  int cpuPartition = 0;
   bool bqatest = false;
   bool strongScaling = false;
 
@@ -242,12 +570,29 @@ int main(int argc, char **argv) {
   } else {
     if (!strcasecmp(multiMethodChoice, "threaded")) {
       use_threads = true;
+    } else if (!strcasecmp(multiMethodChoice, "dynamic")) {
+      use_threads = false;
+      use_dynamic = true;
     } else {
       use_threads = false;
     }
   }
 
-  if (use_threads == false) {
+  if (checkCmdLineFlag(argc, (const char **)argv, "chunk")) {
+    chunkSize = getCmdLineArgumentInt(argc, (const char **)argv, "chunk");
+
+    if (chunkSize <= 0) {
+      usage();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (checkCmdLineFlag(argc, (const char **)argv, "cpu_partition")) {
+    cpuPartition =
+        getCmdLineArgumentInt(argc, (const char **)argv, "cpu_partition");
+  }
+
+  if (use_threads == false && use_dynamic == false) {
     printf("Using single CPU thread for multiple GPUs\n");
   }
 
@@ -298,12 +643,12 @@ int main(int argc, char **argv) {
 
   float time;
 
-  double delta, ref, sumDelta, sumRef, sumReserve;
+  double sumDelta, sumRef, sumReserve;
 
   printf("MonteCarloMultiGPU\n");
   printf("==================\n");
   printf("Parallelization method  = %s\n",
-         use_threads ? "threaded" : "streamed");
+         use_threads ? "threaded" : (use_dynamic ? "dynamic" : "streamed"));
   printf("Problem scaling         = %s\n", strongScaling ? "strong" : "weak");
   printf("Number of GPUs          = %d\n", GPU_N);
   printf("Total number of options = %d\n", OPT_N);
@@ -344,6 +689,10 @@ int main(int argc, char **argv) {
     optionSolver[i].pathN = PATH_N;
     optionSolver[i].gridSize =
         adjustGridSize(optionSolver[i].device, optionSolver[i].optionCount);
+    // The grid is never larger than the option count, so seeding the blocks
+    // from the global index of the first option of the GPU gives each block
+    // of every GPU its own seed
+    optionSolver[i].seedBase = gpuBase;
     gpuBase += optionSolver[i].optionCount;
   }
 
@@ -372,31 +721,11 @@ int main(int argc, char **argv) {
       printf("Options per sec.: %f\n", OPT_N / (time * 0.001));
     }
 
-    printf("main(): comparing Monte Carlo and Black-Scholes results...\n");
-    sumDelta = 0;
-    sumRef = 0;
-    sumReserve = 0;
-
-    for (i = 0; i < OPT_N; i++) {
-      BlackScholesCall(callValueBS[i], optionData[i]);
-      delta = fabs(callValueBS[i] - callValueGPU[i].Expected);
-      ref = callValueBS[i];
-      sumDelta += delta;
-      sumRef += fabs(ref);
-
-      if (delta > 1e-6) {
-        sumReserve += callValueGPU[i].Confidence / delta;
-      }
-
-#ifdef PRINT_RESULTS
-      printf("BS: %f; delta: %E\n", callValueBS[i], delta);
-#endif
-    }
-
-    sumReserve /= OPT_N;
+    compareWithBlackScholes(optionData, callValueGPU, callValueBS, OPT_N,
+                            sumDelta, sumRef, sumReserve);
   }
 
-  if (!use_threads || bqatest) {
+  if ((!use_threads && !use_dynamic) || bqatest) {
     multiSolver(optionSolver, GPU_N);
 
     printf("main(): GPU statistics, streamed\n");
@@ -415,28 +744,16 @@ int main(int argc, char **argv) {
     printf("\tNote: This is elapsed time for all to compute.\n");
     printf("Options per sec.: %f\n", OPT_N / (time * 0.001));
 
-    printf("main(): comparing Monte Carlo and Black-Scholes results...\n");
-    sumDelta = 0;
-    sumRef = 0;
-    sumReserve = 0;
-
-    for (i = 0; i < OPT_N; i++) {
-      BlackScholesCall(callValueBS[i], optionData[i]);
-      delta = fabs(callValueBS[i] - callValueGPU[i].Expected);
-      ref = callValueBS[i];
-      sumDelta += delta;
-      sumRef += fabs(ref);
-
-      if (delta > 1e-6) {
-        sumReserve += callValueGPU[i].Confidence / delta;
-      }
+    compareWithBlackScholes(optionData, callValueGPU, callValueBS, OPT_N,
+                            sumDelta, sumRef, sumReserve);
+  }
 
-#ifdef PRINT_RESULTS
-      printf("BS: %f; delta: %E\n", callValueBS[i], delta);
-#endif
-    }
+  if (use_dynamic || bqatest) {
+    dynamicSolver(optionData, callValueGPU, OPT_N, PATH_N, chunkSize,
+                  cpuPartition);
 
-    sumReserve /= OPT_N;
+    compareWithBlackScholes(optionData, callValueGPU, callValueBS, OPT_N,
+                            sumDelta, sumRef, sumReserve);
   }
 
 #ifdef DO_CPU
@@ -447,8 +764,8 @@ int main(int argc, char **argv) {
 
   for (i = 0; i < OPT_N; i++) {
     MonteCarloCPU(callValueCPU, optionData[i], NULL, PATH_N);
-    delta = fabs(callValueCPU.Expected - callValueGPU[i].Expected);
-    ref = callValueCPU.Expected;
+    double delta = fabs(callValueCPU.Expected - callValueGPU[i].Expected);
+    double ref = callValueCPU.Expected;
     sumDelta += delta;
     sumRef += fabs(ref);
     printf("Exp : %f | %f\t", callValueCPU.Expected, callValueGPU[i].Expected);
@@ -91,10 +91,17 @@ typedef struct sycl_type_814637 {
   float time;
 
   int gridSize;
+
+  // Seed of the first thread block of the plan. Block b is seeded with
+  // seedBase + b, so the plans must have disjoint [seedBase,
+  // seedBase + gridSize) ranges
+  int seedBase;
 } TOptionPlan;
 
 extern "C" void initMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream = 0);
 extern "C" void MonteCarloGPU(TOptionPlan *plan, sycl::queue *stream = 0);
 extern "C" void closeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream = 0);
+extern "C" void getMonteCarloResultsGPU(TOptionPlan *plan);
+extern "C" void freeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream = 0);
 
 #endif
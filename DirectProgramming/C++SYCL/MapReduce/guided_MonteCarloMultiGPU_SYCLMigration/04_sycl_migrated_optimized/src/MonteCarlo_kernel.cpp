@@ -136,17 +136,21 @@ static void MonteCarloOneBlockPerOption(
     sumReduce<real, SUM_N, THREAD_N>(s_SumCall, s_Sum2Call, cta, tile32,
                                      &d_CallValue[optionIndex], item_ct1);
   }
+
+  // Save random number state, so that the next call on the same states
+  // continues the random number sequence
+  rngStates[tid] = localState;
 }
 
 static void rngSetupStates(oneapi::mkl::rng::device::philox4x32x10<1> *rngState,
-                           int device_id, sycl::nd_item<3> item_ct1) {
+                           int seedBase, sycl::nd_item<3> item_ct1) {
   // determine global thread id
   int tid = item_ct1.get_local_id(2) +
             item_ct1.get_group(2) * item_ct1.get_local_range(2);
   // Each threadblock gets different seed,
   // Threads within a threadblock get different sequence numbers
   rngState[tid] = oneapi::mkl::rng::device::philox4x32x10<1>(
-      item_ct1.get_group(2) + item_ct1.get_group_range(2) * device_id,
+      seedBase + item_ct1.get_group(2),
       {0, static_cast<std::uint64_t>(item_ct1.get_local_id(2) * 8)});
 }
 
@@ -182,20 +186,20 @@ extern "C" void initMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
   // place each device pathN random numbers apart on the random number sequence
   stream->submit([&](sycl::handler &cgh) {
     auto plan_rngStates_ct0 = plan->rngStates;
-    auto plan_device_ct1 = plan->device;
+    auto plan_seedBase_ct1 = plan->seedBase;
 
     cgh.parallel_for(sycl::nd_range<3>(sycl::range<3>(1, 1, plan->gridSize) *
                                            sycl::range<3>(1, 1, THREAD_N),
                                        sycl::range<3>(1, 1, THREAD_N)),
                      [=](sycl::nd_item<3> item_ct1) {
-                       rngSetupStates(plan_rngStates_ct0, plan_device_ct1,
+                       rngSetupStates(plan_rngStates_ct0, plan_seedBase_ct1,
                                       item_ct1);
                      });
   });
 }
 
-// Compute statistics and deallocate internal device memory
-extern "C" void closeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
+// Compute statistics
+extern "C" void getMonteCarloResultsGPU(TOptionPlan *plan) {
   for (int i = 0; i < plan->optionCount; i++) {
     const double RT = plan->optionData[i].R * plan->optionData[i].T;
     const double sum = plan->h_CallValue[i].Expected;
@@ -210,7 +214,10 @@ extern "C" void closeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
     plan->callValue[i].Confidence =
         (float)(exp(-RT) * 1.96 * stdDev / sqrt(pathN));
   }
+}
 
+// Deallocate internal device memory
+extern "C" void freeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
   sycl::free(plan->rngStates, *stream);
 
   sycl::free(plan->h_CallValue, *stream);
@@ -222,6 +229,12 @@ extern "C" void closeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
   sycl::free(plan->d_OptionData, *stream);
 }
 
+// Compute statistics and deallocate internal device memory
+extern "C" void closeMonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
+  getMonteCarloResultsGPU(plan);
+  freeMonteCarloGPU(plan, stream);
+}
+
 // Main computations
 extern "C" void MonteCarloGPU(TOptionPlan *plan, sycl::queue *stream) {
   __TOptionValue *h_CallValue = plan->h_CallValue;
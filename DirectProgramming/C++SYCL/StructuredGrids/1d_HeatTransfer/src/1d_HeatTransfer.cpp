@@ -39,6 +39,7 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 // dpc_common.hpp can be found in the dev-utilities include folder.
 // e.g., $ONEAPI_ROOT/dev-utilities/<version>/include/dpc_common.hpp
 #include "dpc_common.hpp"
@@ -51,6 +52,12 @@ constexpr float dx = 0.01f;
 constexpr float k = 0.025f;
 constexpr float initial_temperature = 100.0f; // Initial temperature.
 
+// Temporal blocking: points updated per work-group, work-group size and the
+// depths (timesteps per kernel) used by the sweep
+constexpr size_t tile_size = 1024;
+constexpr size_t tile_work_group_size = 256;
+constexpr size_t sweep_depths[] = {1, 2, 4, 8, 16, 32, 64};
+
 int failures = 0;
 
 //
@@ -59,9 +66,13 @@ int failures = 0;
 void Usage(const string &programName) {
   cout << " Incorrect parameters \n";
   cout << " Usage: ";
-  cout << programName << " <n> <i>\n\n";
+  cout << programName << " <n> <i> [k|sweep]\n\n";
   cout << " n : Number of points to simulate \n";
   cout << " i : Number of timesteps \n";
+  cout << " k : (optional) Also run the temporal blocking version, advancing "
+          "k timesteps per kernel \n";
+  cout << " sweep : (optional) Also run the temporal blocking version for "
+          "k = 1, 2, 4, ..., 64 \n";
 }
 
 //
@@ -221,6 +232,121 @@ void ComputeHeatUSM(float C, size_t num_p, size_t num_iter, float *arr_CPU) {
   free(arr_next, q);
 }
 
+//
+// Compute heat on the device using temporal blocking (overlapped tiling).
+//
+// The per-timestep kernels above read and write the whole array every
+// timestep, so they are bound by memory bandwidth. Here, each work-group loads
+// a tile of tile_size points plus a halo of depth points on each side into
+// local memory, and advances the tile depth timesteps before writing it back.
+// After each timestep, one more point on each side of the halo is out of date,
+// so after depth timesteps exactly the tile is valid. The halos overlap the
+// neighboring tiles and are computed redundantly by both work-groups, in
+// exchange for reading and writing the array only once every depth timesteps.
+//
+// Returns the elapsed time in seconds.
+//
+double ComputeHeatTemporalBlocking(float C, size_t num_p, size_t num_iter,
+                                   size_t depth, float *arr_CPU) {
+  // Timesteps depend on each other, so make the queue inorder
+  property_list properties{property::queue::in_order()};
+
+  queue q(default_selector_v, properties);
+  cout << "Using temporal blocking, k = " << depth << "\n";
+  cout << "  Kernel runs on " << q.get_device().get_info<info::device::name>()
+       << "\n";
+
+  // Temperatures of the current and next iteration
+  float *arr = malloc_shared<float>(num_p + 2, q);
+  float *arr_next = malloc_shared<float>(num_p + 2, q);
+
+  Initialize(arr, arr_next, num_p + 2);
+
+  // The tiles cover points 1 to num_p + 1 (point 0 never changes)
+  size_t num_tiles = (num_p + 1 + tile_size - 1) / tile_size;
+  size_t local_size = tile_size + 2 * depth;
+
+  // Start timer
+  dpc_common::TimeInterval time;
+
+  // for each block of depth timesteps
+  for (size_t i = 0; i < num_iter; i += depth) {
+    size_t steps = std::min(depth, num_iter - i);
+
+    q.submit([&](auto &h) {
+      // the tile for the current and next timestep
+      accessor<float, 1, access::mode::read_write, access::target::local>
+          tile(range<1>(2 * local_size), h);
+
+      auto block = [=](nd_item<1> it) {
+        size_t lid = it.get_local_id(0);
+
+        // global index of the first point in the tile, including the halo
+        long first = 1 + (long)(it.get_group(0) * tile_size) - (long)depth;
+
+        // load the tile and its halo, points outside of the array are never
+        // used to update a point inside of it
+        for (size_t j = lid; j < local_size; j += tile_work_group_size) {
+          long g = first + (long)j;
+          tile[j] = (g >= 0 && g <= (long)num_p + 1) ? arr[g] : 0.0f;
+        }
+        it.barrier(access::fence_space::local_space);
+
+        // advance the tile 'steps' timesteps. After timestep s, points s to
+        // local_size - s - 1 are up to date.
+        size_t cur = 0;
+        for (size_t s = 1; s <= steps; s++) {
+          size_t next = local_size - cur;
+          for (size_t j = s + lid; j < local_size - s;
+               j += tile_work_group_size) {
+            long g = first + (long)j;
+            float value;
+            if (g <= 0 || g > (long)num_p + 1)
+              value = tile[cur + j];
+            else if (g == (long)num_p + 1)
+              value = tile[cur + j - 1];
+            else
+              value = C * (tile[cur + j + 1] - 2 * tile[cur + j] +
+                           tile[cur + j - 1]) +
+                      tile[cur + j];
+            tile[next + j] = value;
+          }
+          it.barrier(access::fence_space::local_space);
+          cur = next;
+        }
+
+        // write back the tile (without the halo)
+        for (size_t j = depth + lid; j < depth + tile_size;
+             j += tile_work_group_size) {
+          long g = first + (long)j;
+          if (g <= (long)num_p + 1) arr_next[g] = tile[cur + j];
+        }
+      };
+
+      h.parallel_for(nd_range<1>(num_tiles * tile_work_group_size,
+                                 tile_work_group_size),
+                     block);
+    });
+
+    // Swap arrays for next block of timesteps
+    swap(arr, arr_next);
+  }
+
+  // Wait for all the timesteps to complete
+  q.wait_and_throw();
+
+  // Display time used to process all time steps
+  double elapsed = time.Elapsed();
+  cout << "  Elapsed time: " << elapsed << " sec\n";
+
+  CompareResults("temporal_k" + to_string(depth), arr, arr_CPU, num_p, C);
+
+  free(arr, q);
+  free(arr_next, q);
+
+  return elapsed;
+}
+
 //
 // Compute heat serially on the host
 //
@@ -249,6 +375,7 @@ int main(int argc, char *argv[]) {
   size_t n_point; // The number of points in 1D space
   size_t
       n_iteration; // The number of iterations to simulate the heat propagation
+  vector<size_t> depths; // The temporal blocking depths to run, if any
 
   // Read input parameters
   try {
@@ -260,6 +387,19 @@ int main(int argc, char *argv[]) {
     }
     n_point = np;
     n_iteration = ni;
+
+    if (argc > 3) {
+      if (string(argv[3]) == "sweep") {
+        depths.assign(begin(sweep_depths), end(sweep_depths));
+      } else {
+        int nk = stoi(argv[3]);
+        if (nk < 1) {
+          Usage(argv[0]);
+          return -1;
+        }
+        depths.push_back(nk);
+      }
+    }
   } catch (...) {
     Usage(argv[0]);
     return (-1);
@@ -282,6 +422,22 @@ int main(int argc, char *argv[]) {
   try {
     ComputeHeatBuffer(C, n_point, n_iteration, final_CPU);
     ComputeHeatUSM(C, n_point, n_iteration, final_CPU);
+
+    // The effective bandwidth counts the bytes a kernel per timestep reads
+    // and writes (one read and one write of the array per timestep)
+    vector<double> times;
+    for (size_t depth : depths)
+      times.push_back(ComputeHeatTemporalBlocking(C, n_point, n_iteration,
+                                                  depth, final_CPU));
+
+    if (!depths.empty()) {
+      double bytes = 2.0 * sizeof(float) * (n_point + 2) * n_iteration;
+      cout << "Temporal blocking summary\n";
+      cout << "  k\ttime (sec)\teffective bandwidth (GB/s)\n";
+      for (size_t d = 0; d < depths.size(); d++)
+        cout << "  " << depths[d] << "\t" << times[d] << "\t"
+             << bytes / times[d] * 1e-9 << "\n";
+    }
   } catch (sycl::exception e) {
     cout << "SYCL exception caught: " << e.what() << "\n";
     failures++;
@@ -31,9 +31,11 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <sycl/sycl.hpp>
+#include <cstring>
 #include <iostream>
 
 #include "common.h"
+#include "flowSYCL.h"
 
 // include kernels
 #include "addKernel.hpp"
@@ -44,219 +46,375 @@
 #include "warpingKernel.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief method logic
+/// \brief allocates all memory for a resolution and number of levels
 ///
-/// handles memory allocations, control flow
-/// \param[in]  I0           source image
-/// \param[in]  I1           tracked image
+/// \param[in]  q            in-order queue for computations
 /// \param[in]  width        images width
 /// \param[in]  height       images height
 /// \param[in]  stride       images stride
-/// \param[in]  alpha        degree of displacement field smoothness
 /// \param[in]  nLevels      number of levels in a pyramid
-/// \param[in]  nWarpIters   number of warping iterations per pyramid level
-/// \param[in]  nSolverIters number of solver iterations (Jacobi iterations)
-/// \param[out] u            horizontal displacement
-/// \param[out] v            vertical displacement
 ///////////////////////////////////////////////////////////////////////////////
-void ComputeFlowSYCL(const float *I0, const float *I1, int width, int height,
-                     int stride, float alpha, int nLevels, int nWarpIters,
-                     int nSolverIters, float *u, float *v) {
-  auto exception_handler = [](exception_list exceptions) {
-    for (std::exception_ptr const &e : exceptions) {
-      try {
-        std::rethrow_exception(e);
-      } catch (exception const &e) {
-        std::cout << "Caught asynchronous SYCL exception during ASUM:\n"
-                  << e.what() << std::endl;
-      }
-    }
-  };
-
-  queue q{default_selector_v, exception_handler, property::queue::in_order()};
-  printf("Computing optical flow on GPU...\n");
-  std::cout << "\nRunning on "
-            << q.get_device().get_info<sycl::info::device::name>() << "\n";
+OpticalFlowContext::OpticalFlowContext(queue &q, int width, int height,
+                                       int stride, int nLevels)
+    : q_(q),
+      upload_q_(q.get_context(), q.get_device(), property::queue::in_order()),
+      nLevels_(nLevels),
+      dataSize_(stride * height * sizeof(float)),
+      hasReference_(false),
+      firstPending_(0),
+      numPending_(0) {
+  pW_ = new int[nLevels];
+  pH_ = new int[nLevels];
+  pS_ = new int[nLevels];
+
+  pRef_ = new float *[nLevels];
+  pCur_ = new float *[nLevels];
+
+  // pyramid levels sizes
+  pW_[nLevels - 1] = width;
+  pH_[nLevels - 1] = height;
+  pS_[nLevels - 1] = stride;
+
+  for (int level = nLevels - 1; level > 0; --level) {
+    pW_[level - 1] = pW_[level] / 2;
+    pH_[level - 1] = pH_[level] / 2;
+    pS_[level - 1] = iAlignUp(pW_[level - 1]);
+  }
 
-  // pI0 and pI1 will hold device pointers
-  const float **pI0 = new const float *[nLevels];
-  const float **pI1 = new const float *[nLevels];
-
-  int *pW = new int[nLevels];
-  int *pH = new int[nLevels];
-  int *pS = new int[nLevels];
-
-  // device memory pointers
-  float *d_tmp;
-  float *d_du0;
-  float *d_dv0;
-  float *d_du1;
-  float *d_dv1;
-
-  float *d_Ix;
-  float *d_Iy;
-  float *d_Iz;
-
-  float *d_u;
-  float *d_v;
-  float *d_nu;
-  float *d_nv;
-
-  const int dataSize = stride * height * sizeof(float);
-
-  d_tmp = (float *)sycl::malloc_device(dataSize, q);
-  d_du0 = (float *)sycl::malloc_device(dataSize, q);
-  d_dv0 = (float *)sycl::malloc_device(dataSize, q);
-  d_du1 = (float *)sycl::malloc_device(dataSize, q);
-  d_dv1 = (float *)sycl::malloc_device(dataSize, q);
-  d_Ix = (float *)sycl::malloc_device(dataSize, q);
-  d_Iy = (float *)sycl::malloc_device(dataSize, q);
-  d_Iz = (float *)sycl::malloc_device(dataSize, q);
-  d_u = (float *)sycl::malloc_device(dataSize, q);
-  d_v = (float *)sycl::malloc_device(dataSize, q);
-  d_nu = (float *)sycl::malloc_device(dataSize, q);
-  d_nv = (float *)sycl::malloc_device(dataSize, q);
+  // allocate GPU memory for pyramids
+  pRef_[nLevels - 1] = (float *)sycl::malloc_device(dataSize_, q);
+  pCur_[nLevels - 1] = (float *)sycl::malloc_device(dataSize_, q);
 
-  // prepare pyramid
+  for (int level = 0; level < nLevels - 1; ++level) {
+    pRef_[level] = (float *)sycl::malloc_device(
+        pS_[level] * pH_[level] * sizeof(sycl::float4), q);
+    pCur_[level] = (float *)sycl::malloc_device(
+        pS_[level] * pH_[level] * sizeof(sycl::float4), q);
+  }
 
-  int currentLevel = nLevels - 1;
-  // allocate GPU memory for input images
-  *(pI0 + currentLevel) = (const float *)sycl::malloc_device(dataSize, q);
-  *(pI1 + currentLevel) = (const float *)sycl::malloc_device(dataSize, q);
+  // frames are uploaded from pinned host memory, so that copies run
+  // asynchronously
+  for (int i = 0; i < kMaxPendingFrames; ++i) {
+    frame_h_[i] = (float *)sycl::malloc_host(dataSize_, q);
+    frame_d_[i] = (float *)sycl::malloc_device(dataSize_, q);
+  }
 
-  float *pI0_h =
-      (float *)sycl::malloc_host(stride * height * sizeof(sycl::float4), q);
-  float *I0_h = (float *)sycl::malloc_host(dataSize, q);
+  pI0_h_ = (float *)sycl::malloc_host(stride * height * sizeof(sycl::float4), q);
+  I0_h_ = (float *)sycl::malloc_host(dataSize_, q);
 
-  float *pI1_h =
-      (float *)sycl::malloc_host(stride * height * sizeof(sycl::float4), q);
-  float *I1_h = (float *)sycl::malloc_host(dataSize, q);
+  pI1_h_ = (float *)sycl::malloc_host(stride * height * sizeof(sycl::float4), q);
+  I1_h_ = (float *)sycl::malloc_host(dataSize_, q);
 
-  float *src_d0 =
+  src_d0_ =
       (float *)sycl::malloc_device(stride * height * sizeof(sycl::float4), q);
-  float *src_d1 =
+  src_d1_ =
       (float *)sycl::malloc_device(stride * height * sizeof(sycl::float4), q);
 
-  q.memcpy((void *)I0_h, I0, dataSize);
-  q.memcpy((void *)I1_h, I1, dataSize);
+  d_tmp_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_du0_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_dv0_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_du1_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_dv1_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_Ix_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_Iy_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_Iz_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_u_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_v_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_nu_ = (float *)sycl::malloc_device(dataSize_, q);
+  d_nv_ = (float *)sycl::malloc_device(dataSize_, q);
+}
+
+OpticalFlowContext::~OpticalFlowContext() {
+  q_.wait();
+  upload_q_.wait();
+
+  for (int i = 0; i < nLevels_; ++i) {
+    sycl::free(pRef_[i], q_);
+    sycl::free(pCur_[i], q_);
+  }
 
-  q.memcpy((void *)pI0[currentLevel], I0, dataSize);
-  q.memcpy((void *)pI1[currentLevel], I1, dataSize);
+  delete[] pRef_;
+  delete[] pCur_;
+  delete[] pW_;
+  delete[] pH_;
+  delete[] pS_;
 
-  q.wait();
+  for (int i = 0; i < kMaxPendingFrames; ++i) {
+    sycl::free(frame_h_[i], q_);
+    sycl::free(frame_d_[i], q_);
+  }
 
-  pW[currentLevel] = width;
-  pH[currentLevel] = height;
-  pS[currentLevel] = stride;
+  sycl::free(pI0_h_, q_);
+  sycl::free(I0_h_, q_);
+  sycl::free(pI1_h_, q_);
+  sycl::free(I1_h_, q_);
+  sycl::free(src_d0_, q_);
+  sycl::free(src_d1_, q_);
+
+  sycl::free(d_tmp_, q_);
+  sycl::free(d_du0_, q_);
+  sycl::free(d_dv0_, q_);
+  sycl::free(d_du1_, q_);
+  sycl::free(d_dv1_, q_);
+  sycl::free(d_Ix_, q_);
+  sycl::free(d_Iy_, q_);
+  sycl::free(d_Iz_, q_);
+  sycl::free(d_nu_, q_);
+  sycl::free(d_nv_, q_);
+  sycl::free(d_u_, q_);
+  sycl::free(d_v_, q_);
+}
 
-  for (; currentLevel > 0; --currentLevel) {
-    int nw = pW[currentLevel] / 2;
-    int nh = pH[currentLevel] / 2;
-    int ns = iAlignUp(nw);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief starts uploading a frame to the device
+///
+/// The frame is copied to pinned host memory, and then to the device on the
+/// upload queue, which does not wait for the computations on the other queue
+/// \param[in]  I            frame
+/// \return false if kMaxPendingFrames frames are already uploaded but not
+///         processed
+///////////////////////////////////////////////////////////////////////////////
+bool OpticalFlowContext::UploadFrame(const float *I) {
+  if (numPending_ == kMaxPendingFrames) {
+    printf("Too many frames uploaded and not processed\n");
+    return false;
+  }
 
-    *(pI0 + currentLevel - 1) =
-        (const float *)sycl::malloc_device(ns * nh * sizeof(sycl::float4), q);
-    *(pI1 + currentLevel - 1) =
-        (const float *)sycl::malloc_device(ns * nh * sizeof(sycl::float4), q);
+  int slot = (firstPending_ + numPending_) % kMaxPendingFrames;
 
-    Downscale(pI0[currentLevel], pI0_h, I0_h, src_d0, pW[currentLevel],
-              pH[currentLevel], pS[currentLevel], nw, nh, ns,
-              (float *)pI0[currentLevel - 1], q);
+  // the previous upload from this slot is complete, as the frame was
+  // processed, so the pinned host memory can be reused
+  memcpy(frame_h_[slot], I, dataSize_);
+  uploadEvent_[slot] = upload_q_.memcpy(frame_d_[slot], frame_h_[slot],
+                                        dataSize_);
+  ++numPending_;
 
-    Downscale(pI1[currentLevel], pI0_h, I0_h, src_d0, pW[currentLevel],
-              pH[currentLevel], pS[currentLevel], nw, nh, ns,
-              (float *)pI1[currentLevel - 1], q);
+  return true;
+}
 
-    pW[currentLevel - 1] = nw;
-    pH[currentLevel - 1] = nh;
-    pS[currentLevel - 1] = ns;
+///////////////////////////////////////////////////////////////////////////////
+/// \brief builds the lower levels of a pyramid from its finest level
+///
+/// \param[in]  pI           pyramid levels
+///////////////////////////////////////////////////////////////////////////////
+void OpticalFlowContext::BuildPyramid(float **pI) {
+  for (int level = nLevels_ - 1; level > 0; --level) {
+    Downscale(pI[level], pI0_h_, I0_h_, src_d0_, pW_[level], pH_[level],
+              pS_[level], pW_[level - 1], pH_[level - 1], pS_[level - 1],
+              pI[level - 1], q_);
   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief method logic
+///
+/// handles control flow for one frame: builds the pyramid of the oldest
+/// uploaded frame and computes the flow from the reference frame to it
+/// \param[in]  alpha        degree of displacement field smoothness
+/// \param[in]  nWarpIters   number of warping iterations per pyramid level
+/// \param[in]  nSolverIters number of solver iterations (Jacobi iterations)
+/// \param[out] u            horizontal displacement
+/// \param[out] v            vertical displacement
+/// \return false if there was no reference frame (u and v are not written)
+///////////////////////////////////////////////////////////////////////////////
+bool OpticalFlowContext::ProcessFrame(float alpha, int nWarpIters,
+                                      int nSolverIters, float *u, float *v) {
+  if (numPending_ == 0) {
+    printf("No frame uploaded\n");
+    return false;
+  }
+
+  // the finest level of the pyramid is the uploaded frame itself
+  int slot = firstPending_;
+  uploadEvent_[slot].wait();
+  Swap(pCur_[nLevels_ - 1], frame_d_[slot]);
+  firstPending_ = (firstPending_ + 1) % kMaxPendingFrames;
+  --numPending_;
+
+  // prepare pyramid
+  BuildPyramid(pCur_);
+
+  if (!hasReference_) {
+    Swap(pRef_, pCur_);
+    hasReference_ = true;
+    return false;
+  }
+
+  // pI0 and pI1 hold device pointers
+  const float *const *pI0 = pRef_;
+  const float *const *pI1 = pCur_;
 
-  q.memset(d_u, 0, stride * height * sizeof(float));
-  q.memset(d_v, 0, stride * height * sizeof(float));
+  q_.memset(d_u_, 0, dataSize_);
+  q_.memset(d_v_, 0, dataSize_);
 
-  q.wait();
+  q_.wait();
 
   // compute flow
-  for (; currentLevel < nLevels; ++currentLevel) {
+  for (int currentLevel = 0; currentLevel < nLevels_; ++currentLevel) {
     for (int warpIter = 0; warpIter < nWarpIters; ++warpIter) {
-      q.memset(d_du0, 0, dataSize);
-      q.memset(d_dv0, 0, dataSize);
+      q_.memset(d_du0_, 0, dataSize_);
+      q_.memset(d_dv0_, 0, dataSize_);
 
-      q.memset(d_du1, 0, dataSize);
-      q.memset(d_dv1, 0, dataSize);
+      q_.memset(d_du1_, 0, dataSize_);
+      q_.memset(d_dv1_, 0, dataSize_);
 
-      q.wait();
+      q_.wait();
 
       // on current level we compute optical flow
       // between frame 0 and warped frame 1
-      WarpImage(pI1[currentLevel], pI0_h, I0_h, src_d0, pW[currentLevel],
-                pH[currentLevel], pS[currentLevel], d_u, d_v, d_tmp, q);
+      WarpImage(pI1[currentLevel], pI0_h_, I0_h_, src_d0_, pW_[currentLevel],
+                pH_[currentLevel], pS_[currentLevel], d_u_, d_v_, d_tmp_, q_);
 
-      ComputeDerivatives(pI0[currentLevel], d_tmp, pI0_h, pI1_h, I0_h, I1_h,
-                         src_d0, src_d1, pW[currentLevel], pH[currentLevel],
-                         pS[currentLevel], d_Ix, d_Iy, d_Iz, q);
+      ComputeDerivatives(pI0[currentLevel], d_tmp_, pI0_h_, pI1_h_, I0_h_,
+                         I1_h_, src_d0_, src_d1_, pW_[currentLevel],
+                         pH_[currentLevel], pS_[currentLevel], d_Ix_, d_Iy_,
+                         d_Iz_, q_);
 
       for (int iter = 0; iter < nSolverIters; ++iter) {
-        SolveForUpdate(d_du0, d_dv0, d_Ix, d_Iy, d_Iz, pW[currentLevel],
-                       pH[currentLevel], pS[currentLevel], alpha, d_du1, d_dv1,
-                       q);
+        SolveForUpdate(d_du0_, d_dv0_, d_Ix_, d_Iy_, d_Iz_, pW_[currentLevel],
+                       pH_[currentLevel], pS_[currentLevel], alpha, d_du1_,
+                       d_dv1_, q_);
 
-        Swap(d_du0, d_du1);
-        Swap(d_dv0, d_dv1);
+        Swap(d_du0_, d_du1_);
+        Swap(d_dv0_, d_dv1_);
       }
 
       // update u, v
-      Add(d_u, d_du0, pH[currentLevel] * pS[currentLevel], d_u, q);
-      Add(d_v, d_dv0, pH[currentLevel] * pS[currentLevel], d_v, q);
+      Add(d_u_, d_du0_, pH_[currentLevel] * pS_[currentLevel], d_u_, q_);
+      Add(d_v_, d_dv0_, pH_[currentLevel] * pS_[currentLevel], d_v_, q_);
     }
 
-    if (currentLevel != nLevels - 1) {
+    if (currentLevel != nLevels_ - 1) {
       // prolongate solution
-      float scaleX = (float)pW[currentLevel + 1] / (float)pW[currentLevel];
+      float scaleX = (float)pW_[currentLevel + 1] / (float)pW_[currentLevel];
 
-      Upscale(d_u, pI0_h, I0_h, src_d0, pW[currentLevel], pH[currentLevel],
-              pS[currentLevel], pW[currentLevel + 1], pH[currentLevel + 1],
-              pS[currentLevel + 1], scaleX, d_nu, q);
+      Upscale(d_u_, pI0_h_, I0_h_, src_d0_, pW_[currentLevel],
+              pH_[currentLevel], pS_[currentLevel], pW_[currentLevel + 1],
+              pH_[currentLevel + 1], pS_[currentLevel + 1], scaleX, d_nu_, q_);
 
-      float scaleY = (float)pH[currentLevel + 1] / (float)pH[currentLevel];
+      float scaleY = (float)pH_[currentLevel + 1] / (float)pH_[currentLevel];
 
-      Upscale(d_v, pI0_h, I0_h, src_d0, pW[currentLevel], pH[currentLevel],
-              pS[currentLevel], pW[currentLevel + 1], pH[currentLevel + 1],
-              pS[currentLevel + 1], scaleY, d_nv, q);
+      Upscale(d_v_, pI0_h_, I0_h_, src_d0_, pW_[currentLevel],
+              pH_[currentLevel], pS_[currentLevel], pW_[currentLevel + 1],
+              pH_[currentLevel + 1], pS_[currentLevel + 1], scaleY, d_nv_, q_);
 
-      Swap(d_u, d_nu);
-      Swap(d_v, d_nv);
+      Swap(d_u_, d_nu_);
+      Swap(d_v_, d_nv_);
     }
   }
 
-  q.memcpy(u, d_u, dataSize);
-  q.memcpy(v, d_v, dataSize);
+  q_.memcpy(u, d_u_, dataSize_);
+  q_.memcpy(v, d_v_, dataSize_);
 
-  q.wait();
+  q_.wait();
 
-  // cleanup
-  for (int i = 0; i < nLevels; ++i) {
-    sycl::free((void *)pI0[i], q);
-    sycl::free((void *)pI1[i], q);
-  }
+  // this frame is the reference for the next one, its pyramid is reused
+  Swap(pRef_, pCur_);
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief creates the queue used for computations
+///////////////////////////////////////////////////////////////////////////////
+queue CreateQueue() {
+  auto exception_handler = [](exception_list exceptions) {
+    for (std::exception_ptr const &e : exceptions) {
+      try {
+        std::rethrow_exception(e);
+      } catch (exception const &e) {
+        std::cout << "Caught asynchronous SYCL exception during ASUM:\n"
+                  << e.what() << std::endl;
+      }
+    }
+  };
+
+  return queue{default_selector_v, exception_handler,
+               property::queue::in_order()};
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief computes the flow between two images
+///
+/// handles memory allocations, control flow
+/// \param[in]  I0           source image
+/// \param[in]  I1           tracked image
+/// \param[in]  width        images width
+/// \param[in]  height       images height
+/// \param[in]  stride       images stride
+/// \param[in]  alpha        degree of displacement field smoothness
+/// \param[in]  nLevels      number of levels in a pyramid
+/// \param[in]  nWarpIters   number of warping iterations per pyramid level
+/// \param[in]  nSolverIters number of solver iterations (Jacobi iterations)
+/// \param[out] u            horizontal displacement
+/// \param[out] v            vertical displacement
+///////////////////////////////////////////////////////////////////////////////
+void ComputeFlowSYCL(const float *I0, const float *I1, int width, int height,
+                     int stride, float alpha, int nLevels, int nWarpIters,
+                     int nSolverIters, float *u, float *v) {
+  queue q = CreateQueue();
+  printf("Computing optical flow on GPU...\n");
+  std::cout << "\nRunning on "
+            << q.get_device().get_info<sycl::info::device::name>() << "\n";
+
+  ComputeFlowSYCL(q, I0, I1, width, height, stride, alpha, nLevels,
+                  nWarpIters, nSolverIters, u, v);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief computes the flow between two images on an existing queue
+///
+/// same as above, without creating a queue, so repeated calls on the same
+/// queue do not pay for a new context and kernel compilation
+/// \param[in]  q            queue used for computations
+///////////////////////////////////////////////////////////////////////////////
+void ComputeFlowSYCL(queue &q, const float *I0, const float *I1, int width,
+                     int height, int stride, float alpha, int nLevels,
+                     int nWarpIters, int nSolverIters, float *u, float *v) {
+  OpticalFlowContext context(q, width, height, stride, nLevels);
+
+  context.UploadFrame(I0);
+  context.UploadFrame(I1);
+  context.ProcessFrame(alpha, nWarpIters, nSolverIters, u, v);
+  context.ProcessFrame(alpha, nWarpIters, nSolverIters, u, v);
+}
 
-  delete[] pI0;
-  delete[] pI1;
-  delete[] pW;
-  delete[] pH;
-  delete[] pS;
-
-  sycl::free(d_tmp, q);
-  sycl::free(d_du0, q);
-  sycl::free(d_dv0, q);
-  sycl::free(d_du1, q);
-  sycl::free(d_dv1, q);
-  sycl::free(d_Ix, q);
-  sycl::free(d_Iy, q);
-  sycl::free(d_Iz, q);
-  sycl::free(d_nu, q);
-  sycl::free(d_nv, q);
-  sycl::free(d_u, q);
-  sycl::free(d_v, q);
+///////////////////////////////////////////////////////////////////////////////
+/// \brief computes the flow between consecutive frames of a video sequence
+///
+/// memory is allocated once for the sequence, the upload of each frame
+/// overlaps with the computation of the flow to the previous frame
+/// \param[in]  q            queue used for computations
+/// \param[in]  frames       video frames
+/// \param[in]  nFrames      number of frames
+/// \param[in]  width        images width
+/// \param[in]  height       images height
+/// \param[in]  stride       images stride
+/// \param[in]  alpha        degree of displacement field smoothness
+/// \param[in]  nLevels      number of levels in a pyramid
+/// \param[in]  nWarpIters   number of warping iterations per pyramid level
+/// \param[in]  nSolverIters number of solver iterations (Jacobi iterations)
+/// \param[out] u            horizontal displacements, (nFrames - 1) images
+/// \param[out] v            vertical displacements, (nFrames - 1) images
+///////////////////////////////////////////////////////////////////////////////
+void ComputeFlowSequenceSYCL(queue &q, const float *const *frames, int nFrames,
+                             int width, int height, int stride, float alpha,
+                             int nLevels, int nWarpIters, int nSolverIters,
+                             float *u, float *v) {
+  OpticalFlowContext context(q, width, height, stride, nLevels);
+
+  // the first frame is only the reference for the second one
+  context.UploadFrame(frames[0]);
+  context.ProcessFrame(alpha, nWarpIters, nSolverIters, u, v);
+
+  if (nFrames > 1) context.UploadFrame(frames[1]);
+
+  for (int i = 1; i < nFrames; ++i) {
+    // upload the next frame while the flow to this frame is computed
+    if (i + 1 < nFrames) context.UploadFrame(frames[i + 1]);
+
+    context.ProcessFrame(alpha, nWarpIters, nSolverIters,
+                         u + (i - 1) * stride * height,
+                         v + (i - 1) * stride * height);
+  }
 }
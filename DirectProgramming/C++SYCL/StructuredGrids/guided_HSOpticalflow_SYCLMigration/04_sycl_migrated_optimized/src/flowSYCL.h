@@ -34,6 +34,90 @@
 #ifndef FLOW_SYCL_H
 #define FLOW_SYCL_H
 
+#include <sycl/sycl.hpp>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief persistent state for computing optical flow on a video sequence
+///
+/// All device and host memory is allocated once, for a given resolution and
+/// number of pyramid levels. Frames are uploaded asynchronously on a separate
+/// queue, so the upload of the next frame overlaps with the solver. The
+/// pyramid of each frame is built once: after the flow to frame N is
+/// computed, the pyramid of frame N becomes the reference for frame N+1.
+///////////////////////////////////////////////////////////////////////////////
+class OpticalFlowContext {
+ public:
+  // maximum number of frames uploaded but not yet processed
+  static const int kMaxPendingFrames = 2;
+
+  OpticalFlowContext(sycl::queue &q, int width, int height, int stride,
+                     int nLevels);
+  ~OpticalFlowContext();
+
+  OpticalFlowContext(const OpticalFlowContext &) = delete;
+  OpticalFlowContext &operator=(const OpticalFlowContext &) = delete;
+
+  // starts uploading a frame, returns false if kMaxPendingFrames frames are
+  // already waiting to be processed
+  bool UploadFrame(const float *I);
+
+  // processes the oldest uploaded frame; returns false if there was no
+  // reference frame yet (first frame), otherwise writes the flow from the
+  // reference frame to this frame in u and v
+  bool ProcessFrame(float alpha, int nWarpIters, int nSolverIters, float *u,
+                    float *v);
+
+ private:
+  void BuildPyramid(float **pI);
+
+  sycl::queue &q_;
+  sycl::queue upload_q_;
+
+  int nLevels_;
+  int dataSize_;
+
+  // pyramid levels sizes
+  int *pW_;
+  int *pH_;
+  int *pS_;
+
+  // pyramids of the reference frame and of the processed frame
+  float **pRef_;
+  float **pCur_;
+  bool hasReference_;
+
+  // ring of frames being uploaded
+  float *frame_h_[kMaxPendingFrames];
+  float *frame_d_[kMaxPendingFrames];
+  sycl::event uploadEvent_[kMaxPendingFrames];
+  int firstPending_;
+  int numPending_;
+
+  // host scratch memory for images
+  float *pI0_h_;
+  float *I0_h_;
+  float *pI1_h_;
+  float *I1_h_;
+
+  // device memory
+  float *src_d0_;
+  float *src_d1_;
+  float *d_tmp_;
+  float *d_du0_;
+  float *d_dv0_;
+  float *d_du1_;
+  float *d_dv1_;
+  float *d_Ix_;
+  float *d_Iy_;
+  float *d_Iz_;
+  float *d_u_;
+  float *d_v_;
+  float *d_nu_;
+  float *d_nv_;
+};
+
+sycl::queue CreateQueue();
+
 void ComputeFlowSYCL(
     const float *I0,   // source frame
     const float *I1,   // tracked frame
@@ -46,4 +130,32 @@ void ComputeFlowSYCL(
     int nSolverIters,  // number of solver iterations (for linear system)
     float *u,          // output horizontal flow
     float *v);         // output vertical flow
+
+void ComputeFlowSYCL(
+    sycl::queue &q,    // queue used for computations
+    const float *I0,   // source frame
+    const float *I1,   // tracked frame
+    int width,         // frame width
+    int height,        // frame height
+    int stride,        // row access stride
+    float alpha,       // smoothness coefficient
+    int nLevels,       // number of levels in pyramid
+    int nWarpIters,    // number of warping iterations per pyramid level
+    int nSolverIters,  // number of solver iterations (for linear system)
+    float *u,          // output horizontal flow
+    float *v);         // output vertical flow
+
+void ComputeFlowSequenceSYCL(
+    sycl::queue &q,              // queue used for computations
+    const float *const *frames,  // video frames
+    int nFrames,                 // number of frames
+    int width,                   // frame width
+    int height,                  // frame height
+    int stride,                  // row access stride
+    float alpha,                 // smoothness coefficient
+    int nLevels,                 // number of levels in pyramid
+    int nWarpIters,    // number of warping iterations per pyramid level
+    int nSolverIters,  // number of solver iterations (for linear system)
+    float *u,          // output horizontal flows, one per pair of frames
+    float *v);         // output vertical flows, one per pair of frames
 #endif
@@ -34,7 +34,9 @@
 #include <CL/sycl.hpp>
 #include <cmath>
 #include <cstring>
+#include <stdexcept>
 #include <stdio.h>
+#include <vector>
 
 #include "dpc_common.hpp"
 
@@ -52,6 +54,16 @@ constexpr float DT = 0.002f;
 constexpr float DXY = 20.0f;
 constexpr unsigned int half_length = 1;
 
+/*
+ * Parameters for the temporal blocking kernel
+ * tile_size: Rows and columns of the output tile of a work-group
+ * tile_wg_size: Rows and columns of the work-group
+ * sweep_depths: Timesteps per kernel tried with the 'sweep' option
+ */
+constexpr size_t tile_size = 32;
+constexpr size_t tile_wg_size = 16;
+constexpr unsigned int sweep_depths[] = {1, 2, 4, 8};
+
 /*
  * Host-Code
  * Utility function to display input arguments
@@ -59,9 +71,13 @@ constexpr unsigned int half_length = 1;
 void Usage(const string &program_name) {
   cout << " Incorrect parameters\n";
   cout << " Usage: ";
-  cout << program_name << " n1 n2 Iterations\n\n";
+  cout << program_name << " n1 n2 Iterations [k|sweep]\n\n";
   cout << " n1 n2      : Grid sizes for the stencil\n";
   cout << " Iterations : No. of timesteps.\n";
+  cout << " k          : (optional) Also run the temporal blocking kernel,\n";
+  cout << "              advancing k timesteps per kernel.\n";
+  cout << " sweep      : (optional) Also run the temporal blocking kernel for\n";
+  cout << "              k = 1, 2, 4, 8.\n";
 }
 
 /*
@@ -223,6 +239,223 @@ void Iso2dfdIterationGlobal(id<2> it, float* next, float* prev,
   }
 }
 
+/*
+ * Device-Code - GPU
+ * SYCL implementation of depth iterations of iso2dfd kernel using temporal
+ * blocking (overlapped tiling)
+ *
+ * The kernel above reads and writes the wavefields once per timestep, so it
+ * is bound by memory bandwidth. Here, each work-group loads a tile of
+ * tile_size x tile_size points plus a halo of depth points on each side into
+ * local memory, and advances the tile depth timesteps before writing it back.
+ * After each timestep, the outermost ring of the updated region is out of
+ * date, so after depth timesteps exactly the tile is valid. The halos are
+ * computed redundantly by neighboring work-groups, in exchange for reading
+ * and writing the wavefields once every depth timesteps.
+ *
+ * A new value only depends on the older value of the same point, so the older
+ * wavefield in local memory is updated in place and the roles of the two
+ * wavefields alternate every timestep, like the global arrays of the kernel
+ * above. Points in the halo of the grid are never updated.
+ *
+ * Reads the wavefields at timesteps t and t - 1 from 'cur' and 'old' and
+ * writes the wavefields at timesteps t + steps and t + steps - 1 to 'cur_out'
+ * and 'old_out'.
+ */
+template <typename InAccessor, typename OutAccessor, typename VelAccessor,
+          typename LocalAccessor>
+void Iso2dfdIterationTemporal(nd_item<2> it, InAccessor cur, InAccessor old,
+                              OutAccessor cur_out, OutAccessor old_out,
+                              VelAccessor vel, LocalAccessor tile_a,
+                              LocalAccessor tile_b, LocalAccessor tile_vel,
+                              const float dtDIVdxy, int n_rows, int n_cols,
+                              int depth, int steps) {
+  const int local_size = tile_size + 2 * depth;
+  const int lid_row = it.get_local_id(0);
+  const int lid_col = it.get_local_id(1);
+
+  // Global position of the first point of the tile, including the halo
+  const int first_row = (int)(it.get_group(0) * tile_size) - depth;
+  const int first_col = (int)(it.get_group(1) * tile_size) - depth;
+
+  // Load the tile and its halo. Points outside of the grid are never used to
+  // update a point inside of it.
+  for (int i = lid_row; i < local_size; i += tile_wg_size) {
+    for (int j = lid_col; j < local_size; j += tile_wg_size) {
+      int row = first_row + i;
+      int col = first_col + j;
+      int lidx = i * local_size + j;
+      if (row >= 0 && row < n_rows && col >= 0 && col < n_cols) {
+        size_t gid = (size_t)row * n_cols + col;
+        tile_a[lidx] = cur[gid];
+        tile_b[lidx] = old[gid];
+        tile_vel[lidx] = vel[gid];
+      } else {
+        tile_a[lidx] = 0.0f;
+        tile_b[lidx] = 0.0f;
+        tile_vel[lidx] = 0.0f;
+      }
+    }
+  }
+  it.barrier(access::fence_space::local_space);
+
+  // Advance the tile 'steps' timesteps. After timestep s, the points in rows
+  // and columns s to local_size - s - 1 are up to date.
+  for (int s = 1; s <= steps; s++) {
+    auto prev = (s % 2 == 1) ? tile_a : tile_b;
+    auto next = (s % 2 == 1) ? tile_b : tile_a;
+
+    for (int i = s + lid_row; i < local_size - s; i += tile_wg_size) {
+      for (int j = s + lid_col; j < local_size - s; j += tile_wg_size) {
+        int row = first_row + i;
+        int col = first_col + j;
+        if (row >= (int)half_length && row < n_rows - (int)half_length &&
+            col >= (int)half_length && col < n_cols - (int)half_length) {
+          int lidx = i * local_size + j;
+          float value = 0.0;
+          value += prev[lidx + 1] - 2.0 * prev[lidx] + prev[lidx - 1];
+          value += prev[lidx + local_size] - 2.0 * prev[lidx] +
+                   prev[lidx - local_size];
+          value *= dtDIVdxy * tile_vel[lidx];
+          next[lidx] = 2.0f * prev[lidx] - next[lidx] + value;
+        }
+      }
+    }
+    it.barrier(access::fence_space::local_space);
+  }
+
+  // Write back the tile (without the halo)
+  auto newest = (steps % 2 == 1) ? tile_b : tile_a;
+  auto older = (steps % 2 == 1) ? tile_a : tile_b;
+  for (int i = depth + lid_row; i < depth + (int)tile_size;
+       i += tile_wg_size) {
+    for (int j = depth + lid_col; j < depth + (int)tile_size;
+         j += tile_wg_size) {
+      int row = first_row + i;
+      int col = first_col + j;
+      if (row < n_rows && col < n_cols) {
+        size_t gid = (size_t)row * n_cols + col;
+        int lidx = i * local_size + j;
+        cur_out[gid] = newest[lidx];
+        old_out[gid] = older[lidx];
+      }
+    }
+  }
+}
+
+/*
+ * Host-Code
+ * Runs n_iterations iterations of iso2dfd on the device with the temporal
+ * blocking kernel, advancing depth timesteps per kernel. On return, 'next'
+ * and 'prev' hold the same wavefields as with the kernel above.
+ * Returns the elapsed time in seconds, or a negative value if the device does
+ * not have enough local memory for the tile.
+ */
+double Iso2dfdTemporalBlocking(queue& q, float* next, float* prev, float* vel,
+                               const float dtDIVdxy, size_t n_rows,
+                               size_t n_cols, unsigned int n_iterations,
+                               unsigned int depth) {
+  cout << "Computing wavefield in device using temporal blocking, k = "
+       << depth << " ..\n";
+
+  // Check that the two wavefields and the velocity of the tile fit in local
+  // memory
+  size_t local_size = tile_size + 2 * depth;
+  size_t local_bytes = 3 * local_size * local_size * sizeof(float);
+  size_t device_local_bytes =
+      q.get_device().get_info<info::device::local_mem_size>();
+  if (local_bytes > device_local_bytes) {
+    cout << " The tile needs " << local_bytes << " bytes of local memory, the "
+         << "device has " << device_local_bytes << ": Skipped\n\n";
+    return -1.0;
+  }
+
+  size_t n_size = n_rows * n_cols;
+
+  // The wavefields at timesteps t and t - 1 (the kernel above starts with
+  // the wavefield at timestep 0 in 'prev'), and the output wavefields of
+  // every other kernel
+  float* cur_a = new float[n_size];
+  float* old_a = new float[n_size];
+  float* cur_b = new float[n_size];
+  float* old_b = new float[n_size];
+  memcpy(cur_a, prev, n_size * sizeof(float));
+  memcpy(old_a, next, n_size * sizeof(float));
+
+  auto tiles_range = range<2>((n_rows + tile_size - 1) / tile_size,
+                              (n_cols + tile_size - 1) / tile_size);
+  auto wg_range = range<2>(tile_wg_size, tile_wg_size);
+
+  // Start timer
+  dpc_common::TimeInterval t_offload;
+
+  unsigned int n_blocks = 0;
+  {  // Begin buffer scope
+    buffer cur_a_buf(cur_a, range(n_size));
+    buffer old_a_buf(old_a, range(n_size));
+    buffer cur_b_buf(cur_b, range(n_size));
+    buffer old_b_buf(old_b, range(n_size));
+    buffer vel_buf(vel, range(n_size));
+
+    // Iterate over blocks of depth time steps
+    for (unsigned int k = 0; k < n_iterations; k += depth, n_blocks++) {
+      int steps = min(depth, n_iterations - k);
+
+      // Alternate the input and output wavefields every block
+      auto& in_cur = (n_blocks % 2 == 0) ? cur_a_buf : cur_b_buf;
+      auto& in_old = (n_blocks % 2 == 0) ? old_a_buf : old_b_buf;
+      auto& out_cur = (n_blocks % 2 == 0) ? cur_b_buf : cur_a_buf;
+      auto& out_old = (n_blocks % 2 == 0) ? old_b_buf : old_a_buf;
+
+      q.submit([&](auto& h) {
+        accessor cur_acc(in_cur, h, read_only);
+        accessor old_acc(in_old, h, read_only);
+        accessor cur_out_acc(out_cur, h, write_only, no_init);
+        accessor old_out_acc(out_old, h, write_only, no_init);
+        accessor vel_acc(vel_buf, h, read_only);
+
+        // Local memory for the wavefields and the velocity of the tile
+        accessor<float, 1, access::mode::read_write, access::target::local>
+            tile_a(range<1>(local_size * local_size), h);
+        accessor<float, 1, access::mode::read_write, access::target::local>
+            tile_b(range<1>(local_size * local_size), h);
+        accessor<float, 1, access::mode::read_write, access::target::local>
+            tile_vel(range<1>(local_size * local_size), h);
+
+        int n_rows_k = n_rows;
+        int n_cols_k = n_cols;
+        int depth_k = depth;
+        h.parallel_for(nd_range<2>(tiles_range * wg_range, wg_range),
+                       [=](nd_item<2> it) {
+                         Iso2dfdIterationTemporal(
+                             it, cur_acc, old_acc, cur_out_acc, old_out_acc,
+                             vel_acc, tile_a, tile_b, tile_vel, dtDIVdxy,
+                             n_rows_k, n_cols_k, depth_k, steps);
+                       });
+      });
+    }  // end for
+  }  // buffer scope
+
+  q.wait_and_throw();
+  auto time = t_offload.Elapsed();
+  cout << "Offload time: " << time << " s\n\n";
+
+  // Place the wavefields at timesteps n_iterations and n_iterations - 1 in
+  // 'next' and 'prev', like the kernel above, which writes the wavefield at
+  // odd timesteps to 'next'
+  float* cur = (n_blocks % 2 == 0) ? cur_a : cur_b;
+  float* old = (n_blocks % 2 == 0) ? old_a : old_b;
+  memcpy(next, (n_iterations % 2 == 1) ? cur : old, n_size * sizeof(float));
+  memcpy(prev, (n_iterations % 2 == 1) ? old : cur, n_size * sizeof(float));
+
+  delete[] cur_a;
+  delete[] old_a;
+  delete[] cur_b;
+  delete[] old_b;
+
+  return time;
+}
+
 int main(int argc, char* argv[]) {
   // Arrays used to update the wavefield
   float* prev_base;
@@ -235,12 +468,24 @@ int main(int argc, char* argv[]) {
 
   size_t n_rows, n_cols;
   unsigned int n_iterations;
+  // Timesteps per kernel of the temporal blocking runs, if any
+  vector<unsigned int> depths;
 
   // Read parameters
   try {
     n_rows = stoi(argv[1]);
     n_cols = stoi(argv[2]);
     n_iterations = stoi(argv[3]);
+
+    if (argc > 4) {
+      if (string(argv[4]) == "sweep") {
+        depths.assign(begin(sweep_depths), end(sweep_depths));
+      } else {
+        int depth = stoi(argv[4]);
+        if (depth < 1) throw invalid_argument("k");
+        depths.push_back(depth);
+      }
+    }
   }
 
   catch (...) {
@@ -323,6 +568,7 @@ int main(int argc, char* argv[]) {
 
   // Compute and display time used by device
   auto time = t_offload.Elapsed();
+  auto global_time = time;
 
   cout << "Offload time: " << time << " s\n\n";
 
@@ -366,11 +612,50 @@ int main(int argc, char* argv[]) {
   out_file.close();
 
   cout << "Final wavefields (from device and CPU) written to disk\n";
+
+  // Run the temporal blocking kernel, validating each run against the CPU
+  if (!depths.empty()) {
+    // The effective bandwidth counts the bytes the kernel above reads and
+    // writes per timestep (reads of both wavefields and the velocity, and a
+    // write of one wavefield)
+    double bytes = 4.0 * sizeof(float) * n_size * n_iterations;
+    vector<double> times;
+
+    for (auto depth : depths) {
+      Initialize(prev_base, next_base, vel_base, n_rows, n_cols);
+      double t = Iso2dfdTemporalBlocking(q, next_base, prev_base, vel_base,
+                                         dtDIVdxy, n_rows, n_cols,
+                                         n_iterations, depth);
+      times.push_back(t);
+      if (t < 0) continue;
+
+      if (WithinEpsilon(next_base, next_cpu, n_rows, n_cols, half_length,
+                        0.1f)) {
+        cout << "Final wavefields from device (k = " << depth
+             << ") and CPU are different: Error\n\n";
+        error = true;
+      } else {
+        cout << "Final wavefields from device (k = " << depth
+             << ") and CPU are equivalent: Success\n\n";
+      }
+    }
+
+    cout << "Temporal blocking summary\n";
+    cout << " k\ttime (s)\teffective bandwidth (GB/s)\n";
+    cout << " -\t" << global_time << "\t" << bytes / global_time * 1e-9
+         << "\n";
+    for (size_t d = 0; d < depths.size(); d++) {
+      if (times[d] < 0) continue;
+      cout << " " << depths[d] << "\t" << times[d] << "\t"
+           << bytes / times[d] * 1e-9 << "\n";
+    }
+  }
   cout << "Finished.\n";
 
   // Cleanup
   delete[] prev_base;
   delete[] next_base;
+  delete[] next_cpu;
   delete[] vel_base;
 
   return error ? 1 : 0;
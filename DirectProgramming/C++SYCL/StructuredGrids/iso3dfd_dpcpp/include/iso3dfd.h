@@ -12,6 +12,8 @@ using namespace sycl;
 #include <cstring>
 #include <ctime>
 #include <fstream>
+#include <sstream>
+#include <string>
 #include <algorithm>
 /*
  * Parameters to define coefficients
@@ -29,12 +31,33 @@ constexpr unsigned int kHalfLength = 8;
  */
 constexpr unsigned int kPad = 0;
 
+/*
+ * File where the autotuner stores the best configuration for each device
+ * and grid size, so that later runs start tuned
+ */
+constexpr char kTuneCacheFile[] = "iso3dfd_tune.txt";
+
 bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
                      float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
                      size_t n3, size_t n1_block, size_t n2_block,
-                     size_t n3_block, size_t end_z, unsigned int num_iterations);
+                     size_t n3_block, size_t end_z, unsigned int num_iterations,
+                     bool use_shared);
+
+bool Iso3dfdTune(sycl::queue &q, float *ptr_next, float *ptr_prev,
+                 float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
+                 size_t n3, size_t &n1_block, size_t &n2_block,
+                 size_t &n3_block, bool &use_shared);
+
+bool LoadTunedConfig(const std::string &device_name, size_t n1, size_t n2,
+                     size_t n3, size_t &n1_block, size_t &n2_block,
+                     size_t &n3_block, bool &use_shared);
+
+void SaveTunedConfig(const std::string &device_name, size_t n1, size_t n2,
+                     size_t n3, size_t n1_block, size_t n2_block,
+                     size_t n3_block, bool use_shared);
 
-void PrintTargetInfo(sycl::queue &q, unsigned int dim_x, unsigned int dim_y);
+void PrintTargetInfo(sycl::queue &q, unsigned int dim_x, unsigned int dim_y,
+                     unsigned int dim_z, bool use_shared);
 
 void Usage(const std::string &program_name);
 
@@ -166,6 +166,12 @@ int main(int argc, char* argv[]) {
   bool omp = true;
   bool error = false;
   bool is_gpu = true;
+  bool tune = false;
+#ifdef USE_SHARED
+  bool use_shared = true;
+#else
+  bool use_shared = false;
+#endif
 
   size_t n1, n2, n3;
   size_t n1_block, n2_block, n3_block;
@@ -202,6 +208,12 @@ int main(int argc, char* argv[]) {
       is_gpu = true;
     } else if (arg_value == "cpu") {
       is_gpu = false;
+    } else if (arg_value == "slm") {
+      use_shared = true;
+    } else if (arg_value == "global") {
+      use_shared = false;
+    } else if (arg_value == "tune") {
+      tune = true;
     } else {
       Usage(argv[0]);
       return 1;
@@ -295,9 +307,40 @@ int main(int argc, char* argv[]) {
     // device selector
     queue q(device_sel);
 
-    // Validate if the block sizes selected are
-    // within range for the selected SYCL device
-    if (CheckBlockDimension(q, n1_block, n2_block)) {
+    // Block sizes for the SYCL version, which are replaced by the
+    // autotuned ones in tune mode
+    size_t sycl_n1_block = n1_block;
+    size_t sycl_n2_block = n2_block;
+    size_t sycl_n3_block = n3_block;
+
+    if (tune) {
+      // Use the configuration cached for this device and grid size if
+      // there is one, otherwise search for the best one and cache it.
+      // The block sizes for the OpenMP version are not changed
+      auto device_name = q.get_device().get_info<info::device::name>();
+      if (LoadTunedConfig(device_name, n1 - 2 * kHalfLength,
+                          n2 - 2 * kHalfLength, n3 - 2 * kHalfLength,
+                          sycl_n1_block, sycl_n2_block, sycl_n3_block,
+                          use_shared)) {
+        std::cout << " Using tuned configuration from " << kTuneCacheFile
+                  << "\n";
+      } else {
+        if (!Iso3dfdTune(q, next_base, prev_base, vel_base, coeff, n1, n2, n3,
+                         sycl_n1_block, sycl_n2_block, sycl_n3_block,
+                         use_shared)) {
+          return 1;
+        }
+        SaveTunedConfig(device_name, n1 - 2 * kHalfLength,
+                        n2 - 2 * kHalfLength, n3 - 2 * kHalfLength,
+                        sycl_n1_block, sycl_n2_block, sycl_n3_block,
+                        use_shared);
+
+        // Autotuning modified the wavefields
+        Initialize(prev_base, next_base, vel_base, n1, n2, n3);
+      }
+    } else if (CheckBlockDimension(q, n1_block, n2_block)) {
+      // Validate if the block sizes selected are
+      // within range for the selected SYCL device
       Usage(argv[0]);
       return 1;
     }
@@ -308,8 +351,8 @@ int main(int argc, char* argv[]) {
     // Invoke the driver function to perform 3D wave propogation
     // using SYCL version on the selected device
     Iso3dfdDevice(q, next_base, prev_base, vel_base, coeff, n1, n2, n3,
-                  n1_block, n2_block, n3_block, n3 - kHalfLength,
-                  num_iterations);
+                  sycl_n1_block, sycl_n2_block, sycl_n3_block, n3 - kHalfLength,
+                  num_iterations, use_shared);
     // Wait for the commands to complete. Enforce synchronization on the command
     // queue
     q.wait_and_throw();
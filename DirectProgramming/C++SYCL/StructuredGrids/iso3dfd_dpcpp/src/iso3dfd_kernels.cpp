@@ -273,6 +273,143 @@ void Iso3dfdIterationGlobal(sycl::nd_item<3> it, float *next, float *prev,
   }
 }
 
+/*
+ * Candidate block sizes searched by the autotuner in each dimension, and
+ * the number of timed iterations of each trial (after one warm-up
+ * iteration)
+ */
+constexpr size_t kTuneBlocks1[] = {8, 16, 32, 64, 128, 256};
+constexpr size_t kTuneBlocks2[] = {1, 2, 4, 8, 16, 32};
+constexpr size_t kTuneBlocks3[] = {1, 4, 16, 64};
+constexpr unsigned int kTuneIterations = 2;
+
+/*
+ * Host-side SYCL Code
+ *
+ * Submits a single iteration of the iso3dfd kernel. Even iterations
+ * update b_ptr_next from b_ptr_prev and odd iterations the reverse, which
+ * effectively swaps their content at every iteration.
+ *
+ * use_shared selects the kernel with shared local memory optimizations
+ * (Iso3dfdIterationSLM) instead of the global memory kernel
+ * (Iso3dfdIterationGlobal)
+ */
+void Iso3dfdSubmit(sycl::queue &q, buffer<float, 1> &b_ptr_next,
+                   buffer<float, 1> &b_ptr_prev, buffer<float, 1> &b_ptr_vel,
+                   buffer<float, 1> &b_ptr_coeff, size_t n1, size_t n2,
+                   size_t n3, size_t n1_block, size_t n2_block,
+                   size_t n3_block, size_t end_z, unsigned int i,
+                   bool use_shared) {
+  auto nx = n1;
+  auto nxy = n1 * n2;
+
+  auto bx = kHalfLength;
+  auto by = kHalfLength;
+
+  // Submit command group for execution
+  q.submit([&](auto &h) {
+    // Create accessors
+    accessor next(b_ptr_next, h);
+    accessor prev(b_ptr_prev, h);
+    accessor vel(b_ptr_vel, h, read_only);
+    accessor coeff(b_ptr_coeff, h, read_only);
+
+    // Define local and global range
+
+    // Define local ND range of work-items
+    // Size of each SYCL work-group selected here is a product of
+    // n2_block and n1_block which can be controlled by the input
+    // command line arguments
+    auto local_nd_range = range(1, n2_block, n1_block);
+
+    // Define global ND range of work-items
+    // Size of total number of work-items is selected based on the
+    // total grid size in first and second dimensions (XY-plane)
+    //
+    // Each of the work-item then works on computing
+    // one or more grid points. This value can be controlled by the
+    // input command line argument n3_block
+    //
+    // Effectively this implementation enables slicing of the full
+    // grid into smaller grid slices which can be computed in parallel
+    // to allow auto-scaling of the total number of work-items
+    // spawned to achieve full occupancy for small or larger accelerator
+    // devices
+    auto global_nd_range =
+        range((n3 - 2 * kHalfLength) / n3_block, (n2 - 2 * kHalfLength),
+              (n1 - 2 * kHalfLength));
+
+    if (use_shared) {
+      // Using 3D-stencil kernel with Shared Local Memory (SLM)
+      // optimizations (SYCL) to improve effective FLOPS to BYTES
+      // ratio. By default, SLM code path is disabled in this
+      // code sample.
+      // SLM code path can be enabled with the "slm" command line
+      // argument, or by default by recompiling the SYCL source
+      // as follows:
+      // cmake -DSHARED_KERNEL=1 ..
+      // make -j`nproc`
+
+      // Define a range for SLM Buffer
+      // Padding can be used to avoid SLM bank conflicts
+      // By default padding is disabled in the sample code
+      auto local_range = range((n1_block + (2 * kHalfLength) + kPad) *
+                               (n2_block + (2 * kHalfLength)));
+
+      //  Create an accessor for SLM buffer
+      accessor<float, 1, access::mode::read_write, access::target::local> tab(
+          local_range, h);
+
+      // Send a SYCL kernel (lambda) for parallel execution
+      // The function that executes a single iteration is called
+      // "Iso3dfdIterationSLM"
+      // alternating the 'next' and 'prev' parameters which effectively
+      // swaps their content at every iteration.
+      if (i % 2 == 0)
+        h.parallel_for(
+            nd_range(global_nd_range, local_nd_range), [=](auto it) {
+              Iso3dfdIterationSLM(it, next.get_pointer(), prev.get_pointer(),
+                                  vel.get_pointer(), coeff.get_pointer(),
+                                  tab.get_pointer(), nx, nxy, bx, by,
+                                  n3_block, end_z);
+            });
+      else
+        h.parallel_for(
+            nd_range(global_nd_range, local_nd_range), [=](auto it) {
+              Iso3dfdIterationSLM(it, prev.get_pointer(), next.get_pointer(),
+                                  vel.get_pointer(), coeff.get_pointer(),
+                                  tab.get_pointer(), nx, nxy, bx, by,
+                                  n3_block, end_z);
+            });
+    } else {
+      // Use Global Memory version of the 3D-Stencil kernel.
+      // This code path is enabled by default
+
+      // Send a SYCL kernel (lambda) for parallel execution
+      // The function that executes a single iteration is called
+      // "Iso3dfdIterationGlobal"
+      // alternating the 'next' and 'prev' parameters which effectively
+      // swaps their content at every iteration.
+      if (i % 2 == 0)
+        h.parallel_for(
+            nd_range(global_nd_range, local_nd_range), [=](auto it) {
+              Iso3dfdIterationGlobal(it, next.get_pointer(),
+                                     prev.get_pointer(), vel.get_pointer(),
+                                     coeff.get_pointer(), nx, nxy, bx, by,
+                                     n3_block, end_z);
+            });
+      else
+        h.parallel_for(
+            nd_range(global_nd_range, local_nd_range), [=](auto it) {
+              Iso3dfdIterationGlobal(it, prev.get_pointer(),
+                                     next.get_pointer(), vel.get_pointer(),
+                                     coeff.get_pointer(), nx, nxy, bx, by,
+                                     n3_block, end_z);
+            });
+    }
+  });
+}
+
 /*
  * Host-side SYCL Code
  *
@@ -288,17 +425,11 @@ void Iso3dfdIterationGlobal(sycl::nd_item<3> it, float *next, float *prev,
 bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
                    float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
                    size_t n3, size_t n1_block, size_t n2_block, size_t n3_block,
-                   size_t end_z, unsigned int nIterations) {
-  auto nx = n1;
-  auto nxy = n1 * n2;
-
-  auto bx = kHalfLength;
-  auto by = kHalfLength;
-
+                   size_t end_z, unsigned int nIterations, bool use_shared) {
   // Display information about the selected device
-  PrintTargetInfo(q, n1_block, n2_block);
+  PrintTargetInfo(q, n1_block, n2_block, n3_block, use_shared);
 
-  auto grid_size = nxy * n3;
+  auto grid_size = n1 * n2 * n3;
 
   {  // Begin buffer scope
     // Create buffers using SYCL class buffer
@@ -309,110 +440,130 @@ bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
 
     // Iterate over time steps
     for (auto i = 0; i < nIterations; i += 1) {
-      // Submit command group for execution
-      q.submit([&](auto &h) {
-        // Create accessors
-        accessor next(b_ptr_next, h);
-        accessor prev(b_ptr_prev, h);
-        accessor vel(b_ptr_vel, h, read_only);
-        accessor coeff(b_ptr_coeff, h, read_only);
-
-        // Define local and global range
-
-        // Define local ND range of work-items
-        // Size of each SYCL work-group selected here is a product of
-        // n2_block and n1_block which can be controlled by the input
-        // command line arguments
-        auto local_nd_range = range(1, n2_block, n1_block);
-
-        // Define global ND range of work-items
-        // Size of total number of work-items is selected based on the
-        // total grid size in first and second dimensions (XY-plane)
-        //
-        // Each of the work-item then works on computing
-        // one or more grid points. This value can be controlled by the
-        // input command line argument n3_block
-        //
-        // Effectively this implementation enables slicing of the full
-        // grid into smaller grid slices which can be computed in parallel
-        // to allow auto-scaling of the total number of work-items
-        // spawned to achieve full occupancy for small or larger accelerator
-        // devices
-        auto global_nd_range =
-            range((n3 - 2 * kHalfLength) / n3_block, (n2 - 2 * kHalfLength),
-                  (n1 - 2 * kHalfLength));
-
-#ifdef USE_SHARED
-        // Using 3D-stencil kernel with Shared Local Memory (SLM)
-        // optimizations (SYCL) to improve effective FLOPS to BYTES
-        // ratio. By default, SLM code path is disabled in this
-        // code sample.
-        // SLM code path can be enabled by recompiling the SYCL source
-        // as follows:
-        // cmake -DSHARED_KERNEL=1 ..
-        // make -j`nproc`
-
-        // Define a range for SLM Buffer
-        // Padding can be used to avoid SLM bank conflicts
-        // By default padding is disabled in the sample code
-        auto local_range = range((n1_block + (2 * kHalfLength) + kPad) *
-                                 (n2_block + (2 * kHalfLength)));
-
-        //  Create an accessor for SLM buffer
-        accessor<float, 1, access::mode::read_write, access::target::local> tab(
-            local_range, h);
-
-        // Send a SYCL kernel (lambda) for parallel execution
-        // The function that executes a single iteration is called
-        // "Iso3dfdIterationSLM"
-        // alternating the 'next' and 'prev' parameters which effectively
-        // swaps their content at every iteration.
-        if (i % 2 == 0)
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationSLM(it, next.get_pointer(), prev.get_pointer(),
-                                    vel.get_pointer(), coeff.get_pointer(),
-                                    tab.get_pointer(), nx, nxy, bx, by,
-                                    n3_block, end_z);
-              });
-        else
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationSLM(it, prev.get_pointer(), next.get_pointer(),
-                                    vel.get_pointer(), coeff.get_pointer(),
-                                    tab.get_pointer(), nx, nxy, bx, by,
-                                    n3_block, end_z);
-              });
-
-#else
-
-        // Use Global Memory version of the 3D-Stencil kernel.
-        // This code path is enabled by default
-
-        // Send a SYCL kernel (lambda) for parallel execution
-        // The function that executes a single iteration is called
-        // "Iso3dfdIterationGlobal"
-        // alternating the 'next' and 'prev' parameters which effectively
-        // swaps their content at every iteration.
-        if (i % 2 == 0)
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationGlobal(it, next.get_pointer(),
-                                       prev.get_pointer(), vel.get_pointer(),
-                                       coeff.get_pointer(), nx, nxy, bx, by,
-                                       n3_block, end_z);
-              });
-        else
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationGlobal(it, prev.get_pointer(),
-                                       next.get_pointer(), vel.get_pointer(),
-                                       coeff.get_pointer(), nx, nxy, bx, by,
-                                       n3_block, end_z);
-              });
-#endif
-      });
+      Iso3dfdSubmit(q, b_ptr_next, b_ptr_prev, b_ptr_vel, b_ptr_coeff, n1, n2,
+                    n3, n1_block, n2_block, n3_block, end_z, i, use_shared);
+    }
+  }  // end buffer scope
+  return true;
+}
+
+/*
+ * Host-Code
+ * Utility function to check if a configuration can run on the device:
+ * the block sizes must divide the grid sizes, the work-group must not
+ * exceed the maximum work-group size, and the SLM kernel needs
+ * work-groups of at least kHalfLength work-items in X and Y (to copy the
+ * halos) and enough shared local memory for its buffer
+ */
+static bool IsLegalConfig(sycl::device &device, size_t n1, size_t n2,
+                          size_t n3, size_t n1_block, size_t n2_block,
+                          size_t n3_block, bool use_shared) {
+  auto max_block_size =
+      device.get_info<sycl::info::device::max_work_group_size>();
+  auto local_mem_size = device.get_info<sycl::info::device::local_mem_size>();
+
+  if ((n1 - 2 * kHalfLength) % n1_block || (n2 - 2 * kHalfLength) % n2_block ||
+      (n3 - 2 * kHalfLength) % n3_block)
+    return false;
+  if (n1_block * n2_block > max_block_size) return false;
+
+  if (use_shared) {
+    if (n1_block < kHalfLength || n2_block < kHalfLength) return false;
+    auto slm_size = (n1_block + 2 * kHalfLength + kPad) *
+                    (n2_block + 2 * kHalfLength) * sizeof(float);
+    if (slm_size > local_mem_size) return false;
+  }
+
+  return true;
+}
+
+/*
+ * Host-side SYCL Code
+ *
+ * Autotuner for the SYCL version. Runs a few iterations of every legal
+ * combination of the candidate block sizes, with the global memory
+ * kernel and, on GPU, with the SLM kernel, and returns the fastest
+ * configuration in n1_block, n2_block, n3_block and use_shared.
+ *
+ * The wavefields are modified, so they must be initialized again
+ * afterwards. Returns false if no configuration could run.
+ */
+bool Iso3dfdTune(sycl::queue &q, float *ptr_next, float *ptr_prev,
+                 float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
+                 size_t n3, size_t &n1_block, size_t &n2_block,
+                 size_t &n3_block, bool &use_shared) {
+  auto device = q.get_device();
+  auto grid_size = n1 * n2 * n3;
+  auto end_z = n3 - kHalfLength;
+
+  double best_time = 0.0, worst_time = 0.0;
+  unsigned int num_trials = 0;
+
+  std::cout << " Autotuning on " << device.get_info<sycl::info::device::name>()
+            << " ...\n";
+
+  {  // Begin buffer scope
+    buffer b_ptr_next(ptr_next, range(grid_size));
+    buffer b_ptr_prev(ptr_prev, range(grid_size));
+    buffer b_ptr_vel(ptr_vel, range(grid_size));
+    buffer b_ptr_coeff(ptr_coeff, range(kHalfLength + 1));
+
+    // The SLM kernel is optimized for GPU only
+    for (auto shared : {false, true}) {
+      if (shared && !device.is_gpu()) continue;
+
+      for (auto b1 : kTuneBlocks1) {
+        for (auto b2 : kTuneBlocks2) {
+          for (auto b3 : kTuneBlocks3) {
+            if (!IsLegalConfig(device, n1, n2, n3, b1, b2, b3, shared))
+              continue;
+
+            // The configuration is skipped if the device cannot run it,
+            // e.g. because the kernel needs too many registers
+            try {
+              // Warm-up iteration, which includes copying the buffers to
+              // the device and compiling the kernel the first time
+              Iso3dfdSubmit(q, b_ptr_next, b_ptr_prev, b_ptr_vel, b_ptr_coeff,
+                            n1, n2, n3, b1, b2, b3, end_z, 0, shared);
+              q.wait_and_throw();
+
+              auto start = std::chrono::steady_clock::now();
+              for (unsigned int i = 1; i <= kTuneIterations; i++)
+                Iso3dfdSubmit(q, b_ptr_next, b_ptr_prev, b_ptr_vel,
+                              b_ptr_coeff, n1, n2, n3, b1, b2, b3, end_z, i,
+                              shared);
+              q.wait_and_throw();
+              auto end = std::chrono::steady_clock::now();
+              double time = std::chrono::duration<double>(end - start).count();
+
+              num_trials++;
+              if (best_time == 0.0 || time < best_time) {
+                best_time = time;
+                n1_block = b1;
+                n2_block = b2;
+                n3_block = b3;
+                use_shared = shared;
+              }
+              worst_time = std::max(worst_time, time);
+            } catch (sycl::exception const &e) {
+              continue;
+            }
+          }
+        }
+      }
     }
   }  // end buffer scope
+
+  if (num_trials == 0) {
+    std::cout << " ERROR: Autotuning found no configuration that runs on "
+                 "the device\n";
+    return false;
+  }
+
+  std::cout << " Tried " << num_trials << " configurations, the best is "
+            << n1_block << " x " << n2_block << " x " << n3_block << " with the "
+            << (use_shared ? "SLM" : "global memory") << " kernel ("
+            << best_time * 1e3 / kTuneIterations << " ms per iteration, "
+            << worst_time / best_time << "x faster than the worst)\n";
   return true;
 }
@@ -55,7 +55,8 @@ bool CheckBlockDimension(sycl::queue& q, unsigned int dim_x,
  * Host-Code
  * Utility function to print device info
  */
-void PrintTargetInfo(sycl::queue& q, unsigned int dim_x, unsigned int dim_y) {
+void PrintTargetInfo(sycl::queue& q, unsigned int dim_x, unsigned int dim_y,
+                     unsigned int dim_z, bool use_shared) {
   auto device = q.get_device();
   auto max_block_size =
       device.get_info<sycl::info::device::max_work_group_size>();
@@ -70,12 +71,65 @@ void PrintTargetInfo(sycl::queue& q, unsigned int dim_x, unsigned int dim_y) {
   std::cout << " The Device Max EUCount is : " << max_exec_unit_count << "\n";
   std::cout << " The blockSize x is : " << dim_x << "\n";
   std::cout << " The blockSize y is : " << dim_y << "\n";
-#ifdef USE_SHARED
-  std::cout << " Using Shared Local Memory Kernel\n";
-#else
-  std::cout << " Using Global Memory Kernel\n";
+  std::cout << " The blockSize z is : " << dim_z << "\n";
+  if (use_shared)
+    std::cout << " Using Shared Local Memory Kernel\n";
+  else
+    std::cout << " Using Global Memory Kernel\n";
+}
+
+/*
+ * Host-Code
+ * Utility function to look up the tuned configuration of a device and grid
+ * size in the autotuning cache file. Each line of the file holds one
+ * configuration:
+ *   n1 n2 n3 n1_block n2_block n3_block slm|global device name
+ * Returns false if there is no matching line (or no file).
+ */
+bool LoadTunedConfig(const std::string& device_name, size_t n1, size_t n2,
+                     size_t n3, size_t& n1_block, size_t& n2_block,
+                     size_t& n3_block, bool& use_shared) {
+  std::ifstream cache_file(kTuneCacheFile);
+  std::string line;
+
+  while (std::getline(cache_file, line)) {
+    std::istringstream fields(line);
+    size_t c1, c2, c3, b1, b2, b3;
+    std::string kernel, name;
+
+    if (!(fields >> c1 >> c2 >> c3 >> b1 >> b2 >> b3 >> kernel)) continue;
+    std::getline(fields >> std::ws, name);
+
+    if (name == device_name && c1 == n1 && c2 == n2 && c3 == n3) {
+      n1_block = b1;
+      n2_block = b2;
+      n3_block = b3;
+      use_shared = (kernel == "slm");
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Host-Code
+ * Utility function to append a tuned configuration to the autotuning cache
+ * file
+ */
+void SaveTunedConfig(const std::string& device_name, size_t n1, size_t n2,
+                     size_t n3, size_t n1_block, size_t n2_block,
+                     size_t n3_block, bool use_shared) {
+  std::ofstream cache_file(kTuneCacheFile, std::ios::app);
+  if (!cache_file) {
+    std::cout << " WARNING: Could not write the tuned configuration to "
+              << kTuneCacheFile << "\n";
+    return;
+  }
 
-#endif
+  cache_file << n1 << " " << n2 << " " << n3 << " " << n1_block << " "
+             << n2_block << " " << n3_block << " "
+             << (use_shared ? "slm" : "global") << " " << device_name << "\n";
 }
 
 /*
@@ -86,7 +140,8 @@ void Usage(const std::string& programName) {
   std::cout << " Incorrect parameters \n";
   std::cout << " Usage: ";
   std::cout << programName
-            << " n1 n2 n3 b1 b2 b3 Iterations [omp|sycl] [gpu|cpu] \n\n";
+            << " n1 n2 n3 b1 b2 b3 Iterations [omp|sycl] [gpu|cpu]"
+            << " [slm|global] [tune] \n\n";
   std::cout << " n1 n2 n3      : Grid sizes for the stencil \n";
   std::cout << " b1 b2 b3      : cache block sizes for cpu openmp version.\n";
   std::cout << " Iterations    : No. of timesteps. \n";
@@ -94,7 +149,12 @@ void Usage(const std::string& programName) {
             << " Default is to use both for validation \n";
   std::cout
       << " [gpu|cpu]     : Optional: Device to run the SYCL version"
-      << " Default is to use the GPU if available, if not fallback to CPU \n\n";
+      << " Default is to use the GPU if available, if not fallback to CPU \n";
+  std::cout << " [slm|global]  : Optional: Kernel of the SYCL version, with or"
+            << " without shared local memory. Default is set at build time \n";
+  std::cout << " [tune]        : Optional: Autotune the block sizes and kernel"
+            << " of the SYCL version, or use the ones cached in "
+            << kTuneCacheFile << " \n\n";
 }
 
 /*
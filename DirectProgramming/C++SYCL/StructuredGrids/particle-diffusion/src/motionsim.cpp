@@ -232,6 +232,7 @@ int main(int argc, char* argv[]) {
   int seed = 777;
   unsigned int cpu_flag = 0;
   unsigned int grid_output_flag = 1;
+  unsigned int rng_mode = 0;
 
   cout << "\n";
   if (argc == 1)
@@ -241,10 +242,10 @@ int main(int argc, char* argv[]) {
 // Detect OS type and read in command line arguments
 #if !WINDOWS
     rc = ParseArgs(argc, argv, &n_iterations, &n_particles, &grid_size, &seed,
-                   &cpu_flag, &grid_output_flag);
+                   &cpu_flag, &grid_output_flag, &rng_mode);
 #elif WINDOWS  // WINDOWS
     rc = ParseArgsWindows(argc, argv, &n_iterations, &n_particles, &grid_size,
-                          &seed, &cpu_flag, &grid_output_flag);
+                          &seed, &cpu_flag, &grid_output_flag, &rng_mode);
 #else          // WINDOWS
     cout << "Error. Failed to detect operating system. Exiting.\n";
     return 1;
@@ -260,9 +261,12 @@ int main(int argc, char* argv[]) {
   float* particle_Y = new float[n_particles];
   // Total number of motion events
   const size_t n_moves = n_particles * n_iterations;
-  // Declare vectors to store random values for X and Y directions
-  float* random_X = new float[n_moves];
-  float* random_Y = new float[n_moves];
+  // Declare vectors to store random values for X and Y directions. They are
+  // not needed when the random values are generated in the kernel (unless
+  // the CPU computation needs them)
+  const bool pregenerate = (rng_mode != 1 || cpu_flag == 1);
+  float* random_X = pregenerate ? new float[n_moves] : nullptr;
+  float* random_Y = pregenerate ? new float[n_moves] : nullptr;
   // Grid center
   const float center = grid_size / 2;
   // Initialize the particle starting positions to the grid center
@@ -308,16 +312,95 @@ int main(int argc, char* argv[]) {
   // Create a device queue using SYCL class queue
   queue q(default_selector_v);
 
-  // Start timers
-  dpc_common::TimeInterval t_offload;
-  // Call device simulation function
-  ParticleMotion(q, seed, particle_X, particle_Y, random_X, random_Y, grid,
-                 grid_size, planes, n_particles, n_iterations, radius);
-  q.wait_and_throw();
-  auto device_time = t_offload.Elapsed();
-  // End timers
+  // Device memory used by the particle positions and the grid, and by the
+  // pre-generated random values
+  const size_t state_bytes =
+      2 * n_particles * sizeof(float) + grid_size * grid_size * planes *
+                                            sizeof(size_t);
+  const size_t random_bytes = 2 * n_moves * sizeof(float);
+  // Prints the memory footprint and the throughput of a device run
+  auto print_performance = [&](const char* name, double time, size_t bytes) {
+    cout << name << " memory footprint: " << bytes / (1024.0 * 1024.0)
+         << " MB\n";
+    cout << name << " throughput: " << n_moves / time * 1e-6
+         << " million moves/s\n\n";
+  };
+
+  // Grid and final particle positions of the run with random values
+  // generated in the kernel, when both runs are compared
+  size_t* grid_rng = nullptr;
+  float* particle_X_rng = nullptr;
+  float* particle_Y_rng = nullptr;
+
+  if (rng_mode != 1) {
+    // Start timers
+    dpc_common::TimeInterval t_offload;
+    // Call device simulation function
+    ParticleMotion(q, seed, particle_X, particle_Y, random_X, random_Y, grid,
+                   grid_size, planes, n_particles, n_iterations, radius);
+    q.wait_and_throw();
+    auto device_time = t_offload.Elapsed();
+    // End timers
+
+    cout << "\nDevice Offload time: " << device_time << " s\n";
+    print_performance("Pre-generated RNG", device_time,
+                      state_bytes + random_bytes);
+  }
 
-  cout << "\nDevice Offload time: " << device_time << " s\n\n";
+  if (rng_mode != 0) {
+    if (rng_mode == 2) {
+      // Keep the results of the first run and re-initialize the particles
+      grid_rng = new size_t[grid_size * grid_size * planes]();
+      particle_X_rng = new float[n_particles];
+      particle_Y_rng = new float[n_particles];
+      for (size_t i = 0; i < n_particles; ++i) {
+        particle_X_rng[i] = center;
+        particle_Y_rng[i] = center;
+      }
+    } else {
+      grid_rng = grid;
+      particle_X_rng = particle_X;
+      particle_Y_rng = particle_Y;
+    }
+
+    // Start timers
+    dpc_common::TimeInterval t_offload;
+    // Call device simulation function
+    ParticleMotionDeviceRng(q, seed, particle_X_rng, particle_Y_rng, grid_rng,
+                            grid_size, planes, n_particles, n_iterations,
+                            radius);
+    q.wait_and_throw();
+    auto device_time = t_offload.Elapsed();
+    // End timers
+
+    cout << "\nDevice Offload time: " << device_time << " s\n";
+    print_performance("Device RNG", device_time, state_bytes);
+  }
+
+  if (rng_mode == 2) {
+    // Both runs draw the same random values, so the results must be
+    // bit-identical
+    bool identical =
+        ValidateDeviceComputation(grid, grid_rng, grid_size, planes) &&
+        memcmp(particle_X, particle_X_rng, n_particles * sizeof(float)) == 0 &&
+        memcmp(particle_Y, particle_Y_rng, n_particles * sizeof(float)) == 0;
+    if (identical) {
+      cout << "Pre-generated and device RNG results are bit-identical.\n\n";
+    } else {
+      cout << "Error: pre-generated and device RNG results differ.\n\n";
+    }
+    delete[] grid_rng;
+    delete[] particle_X_rng;
+    delete[] particle_Y_rng;
+    if (!identical) {
+      delete[] grid;
+      delete[] random_X;
+      delete[] random_Y;
+      delete[] particle_X;
+      delete[] particle_Y;
+      return 1;
+    }
+  }
 
   size_t* grid_cpu;
   // If user wants to perform cpu computation, for comparison with device
@@ -24,6 +24,7 @@ constexpr float sigma = 0.03f;  // Standard Deviation
 
 #include <CL/sycl.hpp>
 #include <cmath>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 // dpc_common.hpp can be found in the dev-utilities include folder.
@@ -33,6 +34,7 @@ constexpr float sigma = 0.03f;  // Standard Deviation
 #if __has_include("oneapi/mkl.hpp")
 #include "oneapi/mkl.hpp"
 #include "oneapi/mkl/rng.hpp"
+#include "oneapi/mkl/rng/device.hpp"
 #else  // __has_include("oneapi/mkl.hpp")
 #include <mkl.h>
 #include "mkl_sycl.hpp"
@@ -41,6 +43,9 @@ constexpr float sigma = 0.03f;  // Standard Deviation
 void ParticleMotion(sycl::queue&, const int, float*, float*, float*, float*,
                     size_t*, const size_t, const size_t, const size_t,
                     const size_t, const float);
+void ParticleMotionDeviceRng(sycl::queue&, const int, float*, float*, size_t*,
+                             const size_t, const size_t, const size_t,
+                             const size_t, const float);
 void CPUParticleMotion(const int, float*, float*, float*, float*, size_t*,
                        const size_t, const size_t, const size_t, unsigned int,
                        const float);
@@ -58,9 +63,9 @@ template <typename T>
 void PrintVectorAsMatrix(T*, const size_t, const size_t);
 
 int ParseArgs(const int, char* [], size_t*, size_t*, size_t*, int*,
-              unsigned int*, unsigned int*);
+              unsigned int*, unsigned int*, unsigned int*);
 int ParseArgsWindows(int, char* [], size_t*, size_t*, size_t*, int*,
-                     unsigned int*, unsigned int*);
+                     unsigned int*, unsigned int*, unsigned int*);
 void PrintGrids(const size_t*, const size_t*, const size_t, const unsigned int,
                 const unsigned int);
 void PrintValidationResults(const size_t*, const size_t*, const size_t,
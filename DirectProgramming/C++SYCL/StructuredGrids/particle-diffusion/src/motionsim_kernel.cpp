@@ -15,19 +15,169 @@ using namespace oneapi;
 using namespace sycl;
 using namespace std;
 
-// This function distributes simulation work
-void ParticleMotion(queue& q, const int seed, float* particle_X,
-                    float* particle_Y, float* random_X, float* random_Y,
-                    size_t* grid, const size_t grid_size, const size_t planes,
-                    const size_t n_particles, const size_t n_iterations,
-                    const float radius) {
+// This function displaces a particle once and updates the counters of the
+// grid. The state of the particle (position, whether it is inside a cell and
+// the coordinates of that cell) is updated in place.
+template <typename GridAccessor>
+void MoveParticle(const float displacement_X, const float displacement_Y,
+                  float& particle_X, float& particle_Y, bool& inside_cell,
+                  unsigned int& prev_known_cell_coordinate_X,
+                  unsigned int& prev_known_cell_coordinate_Y,
+                  GridAccessor grid_a, const size_t grid_size,
+                  const float radius) {
+  // Grid size squared
+  const size_t gs2 = grid_size * grid_size;
+
+  // Displace particles
+  particle_X += displacement_X;
+  particle_Y += displacement_Y;
+  // Compute distances from particle position to grid point i.e.,
+  // the particle's distance from center of cell. Subtract the
+  // integer value from floating point value to get just the
+  // decimal portion. Use this value to later determine if the
+  // particle is inside or outside of the cell
+  float dX = sycl::abs(particle_X - sycl::round(particle_X));
+  float dY = sycl::abs(particle_Y - sycl::round(particle_Y));
+  /* Grid point indices closest the particle, defined by the following:
+  ------------------------------------------------------------------
+  |               Condition               |         Result         |
+  |---------------------------------------|------------------------|
+  |particle_X + 0.5 >= ceiling(particle_X)|iX = ceiling(particle_X)|
+  |---------------------------------------|------------------------|
+  |particle_Y + 0.5 >= ceiling(particle_Y)|iY = ceiling(particle_Y)|
+  |---------------------------------------|------------------------|
+  |particle_X + 0.5 < ceiling(particle_X) |iX = floor(particle_X)  |
+  |---------------------------------------|------------------------|
+  |particle_Y + 0.5 < ceiling(particle_Y) |iY = floor(particle_Y)  |
+  ------------------------------------------------------------------  */
+  int iX = sycl::floor(particle_X + 0.5);
+  int iY = sycl::floor(particle_Y + 0.5);
+
+  /* There are 5 cases when considering particle movement about the
+     grid.
+
+     All 5 cases are distinct from one another; i.e., any particle's
+     motion falls under one and only one of the following cases:
+
+       Case 1: Particle moves from outside cell to inside cell
+               --Increment counters 1-3
+               --Turn on inside_cell flag
+               --Store the coordinates of the
+                 particle's new cell location
+
+       Case 2: Particle moves from inside cell to outside
+               cell (and possibly outside of the grid)
+               --Decrement counter 2 for old cell
+               --Turn off inside_cell flag
+
+       Case 3: Particle moves from inside one cell to inside
+               another cell
+               --Decrement counter 2 for old cell
+               --Increment counters 1-3 for new cell
+               --Store the coordinates of the particle's new cell
+                 location
+
+       Case 4: Particle moves and remains inside original
+               cell (does not leave cell)
+               --Increment counter 1
+
+       Case 5: Particle moves and remains outside of cell
+               --No action.                                      */
+
+  // Atomic operations flags
+  bool increment_C1 = false;
+  bool increment_C2 = false;
+  bool increment_C3 = false;
+  bool decrement_C2_for_previous_cell = false;
+  bool update_coordinates = false;
+
+  // Check if particle's grid indices are still inside computation grid
+  if ((iX < grid_size) && (iY < grid_size) && (iX >= 0) && (iY >= 0)) {
+    // Compare the radius to particle's distance from center of cell
+    if (radius >= sycl::sqrt(dX * dX + dY * dY)) {
+      // Satisfies counter 1 requirement for cases 1, 3, 4
+      increment_C1 = true;
+      // Case 1
+      if (!inside_cell) {
+        increment_C2 = true;
+        increment_C3 = true;
+        inside_cell = true;
+        update_coordinates = true;
+      }
+      // Case 3
+      else if (prev_known_cell_coordinate_X != iX ||
+               prev_known_cell_coordinate_Y != iY) {
+        increment_C2 = true;
+        increment_C3 = true;
+        update_coordinates = true;
+        decrement_C2_for_previous_cell = true;
+      }
+      // Else: Case 4 --No action required. Counter 1 already updated
+
+    }  // End inside cell if statement
+
+    // Case 2a --Particle remained inside grid and moved outside cell
+    else if (inside_cell) {
+      inside_cell = false;
+      decrement_C2_for_previous_cell = true;
+    }
+    // Else: Case 5a --Particle remained inside grid and outside cell
+    // --No action required
+
+  }  // End inside grid if statement
+
+  // Case 2b --Particle moved outside grid and outside cell
+  else if (inside_cell) {
+    inside_cell = false;
+    decrement_C2_for_previous_cell = true;
+  }
+  // Else: Case 5b --Particle remained outside of grid.
+  // --No action required
+
+  // Index variable for 3rd dimension of grid
+  size_t layer;
+  // Current and previous cell coordinates
+  size_t curr_coordinates = iX + iY * grid_size;
+  size_t prev_coordinates = prev_known_cell_coordinate_X +
+                            prev_known_cell_coordinate_Y * grid_size;
+  // gs2 variable (used below) equals grid_size * grid_size
+  //
+
+  // Counter 2 layer of the grid (1 * grid_size * grid_size)
+  layer = gs2;
+  if (decrement_C2_for_previous_cell)
+    atomic_fetch_sub<size_t>(grid_a[prev_coordinates + layer], 1);
+
+  if (update_coordinates) {
+    prev_known_cell_coordinate_X = iX;
+    prev_known_cell_coordinate_Y = iY;
+  }
+
+  // Counter 1 layer of the grid (0 * grid_size * grid_size)
+  layer = 0;
+  if (increment_C1)
+    atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
+
+  // Counter 2 layer of the grid (1 * grid_size * grid_size)
+  layer = gs2;
+  if (increment_C2)
+    atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
+
+  // Counter 3 layer of the grid (2 * grid_size * grid_size)
+  layer = gs2 + gs2;
+  if (increment_C3)
+    atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
+
+}  // End of function MoveParticle()
+
+// This function prints the device and the simulation parameters
+static void PrintSimulationInfo(queue& q, const int seed,
+                                const size_t grid_size,
+                                const size_t n_particles,
+                                const size_t n_iterations) {
   auto device = q.get_device();
   auto maxBlockSize = device.get_info<info::device::max_work_group_size>();
   auto maxEUCount = device.get_info<info::device::max_compute_units>();
-  // Total number of motion events
-  const size_t n_moves = n_particles * n_iterations;
-  // Grid size squared
-  const size_t gs2 = grid_size * grid_size;
 
   cout << "Running on: " << device.get_info<info::device::name>() << "\n";
   cout << "Device Max Work Group Size: " << maxBlockSize << "\n";
@@ -36,6 +186,18 @@ void ParticleMotion(queue& q, const int seed, float* particle_X,
   cout << "Number of particles: " << n_particles << "\n";
   cout << "Size of the grid: " << grid_size << "\n";
   cout << "Random number seed: " << seed << "\n";
+}
+
+// This function distributes simulation work
+void ParticleMotion(queue& q, const int seed, float* particle_X,
+                    float* particle_Y, float* random_X, float* random_Y,
+                    size_t* grid, const size_t grid_size, const size_t planes,
+                    const size_t n_particles, const size_t n_iterations,
+                    const float radius) {
+  // Total number of motion events
+  const size_t n_moves = n_particles * n_iterations;
+
+  PrintSimulationInfo(q, seed, grid_size, n_particles, n_iterations);
 
   // Declare basic random number generator (BRNG) for random vector
   mkl::rng::philox4x32x10 engine(q, seed);
@@ -89,148 +251,92 @@ void ParticleMotion(queue& q, const int seed, float* particle_X,
           // Set the displacements to the random numbers
           float displacement_X = random_X_a[iter * n_particles + p];
           float displacement_Y = random_Y_a[iter * n_particles + p];
-          // Displace particles
-          particle_X_a[p] += displacement_X;
-          particle_Y_a[p] += displacement_Y;
-          // Compute distances from particle position to grid point i.e.,
-          // the particle's distance from center of cell. Subtract the
-          // integer value from floating point value to get just the
-          // decimal portion. Use this value to later determine if the
-          // particle is inside or outside of the cell
-          float dX = sycl::abs(particle_X_a[p] - sycl::round(particle_X_a[p]));
-          float dY = sycl::abs(particle_Y_a[p] - sycl::round(particle_Y_a[p]));
-          /* Grid point indices closest the particle, defined by the following:
-          ------------------------------------------------------------------
-          |               Condition               |         Result         |
-          |---------------------------------------|------------------------|
-          |particle_X + 0.5 >= ceiling(particle_X)|iX = ceiling(particle_X)|
-          |---------------------------------------|------------------------|
-          |particle_Y + 0.5 >= ceiling(particle_Y)|iY = ceiling(particle_Y)|
-          |---------------------------------------|------------------------|
-          |particle_X + 0.5 < ceiling(particle_X) |iX = floor(particle_X)  |
-          |---------------------------------------|------------------------|
-          |particle_Y + 0.5 < ceiling(particle_Y) |iY = floor(particle_Y)  |
-          ------------------------------------------------------------------  */
-          int iX = sycl::floor(particle_X_a[p] + 0.5);
-          int iY = sycl::floor(particle_Y_a[p] + 0.5);
-
-          /* There are 5 cases when considering particle movement about the
-             grid.
-
-             All 5 cases are distinct from one another; i.e., any particle's
-             motion falls under one and only one of the following cases:
-
-               Case 1: Particle moves from outside cell to inside cell
-                       --Increment counters 1-3
-                       --Turn on inside_cell flag
-                       --Store the coordinates of the
-                         particle's new cell location
-
-               Case 2: Particle moves from inside cell to outside
-                       cell (and possibly outside of the grid)
-                       --Decrement counter 2 for old cell
-                       --Turn off inside_cell flag
-
-               Case 3: Particle moves from inside one cell to inside
-                       another cell
-                       --Decrement counter 2 for old cell
-                       --Increment counters 1-3 for new cell
-                       --Store the coordinates of the particle's new cell
-                         location
-
-               Case 4: Particle moves and remains inside original
-                       cell (does not leave cell)
-                       --Increment counter 1
-
-               Case 5: Particle moves and remains outside of cell
-                       --No action.                                      */
-
-          // Atomic operations flags
-          bool increment_C1 = false;
-          bool increment_C2 = false;
-          bool increment_C3 = false;
-          bool decrement_C2_for_previous_cell = false;
-          bool update_coordinates = false;
-
-          // Check if particle's grid indices are still inside computation grid
-          if ((iX < grid_size) && (iY < grid_size) && (iX >= 0) && (iY >= 0)) {
-            // Compare the radius to particle's distance from center of cell
-            if (radius >= sycl::sqrt(dX * dX + dY * dY)) {
-              // Satisfies counter 1 requirement for cases 1, 3, 4
-              increment_C1 = true;
-              // Case 1
-              if (!inside_cell) {
-                increment_C2 = true;
-                increment_C3 = true;
-                inside_cell = true;
-                update_coordinates = true;
-              }
-              // Case 3
-              else if (prev_known_cell_coordinate_X != iX ||
-                       prev_known_cell_coordinate_Y != iY) {
-                increment_C2 = true;
-                increment_C3 = true;
-                update_coordinates = true;
-                decrement_C2_for_previous_cell = true;
-              }
-              // Else: Case 4 --No action required. Counter 1 already updated
-
-            }  // End inside cell if statement
-
-            // Case 2a --Particle remained inside grid and moved outside cell
-            else if (inside_cell) {
-              inside_cell = false;
-              decrement_C2_for_previous_cell = true;
-            }
-            // Else: Case 5a --Particle remained inside grid and outside cell
-            // --No action required
-
-          }  // End inside grid if statement
-
-          // Case 2b --Particle moved outside grid and outside cell
-          else if (inside_cell) {
-            inside_cell = false;
-            decrement_C2_for_previous_cell = true;
-          }
-          // Else: Case 5b --Particle remained outside of grid.
-          // --No action required
-
-          // Index variable for 3rd dimension of grid
-          size_t layer;
-          // Current and previous cell coordinates
-          size_t curr_coordinates = iX + iY * grid_size;
-          size_t prev_coordinates = prev_known_cell_coordinate_X +
-                                    prev_known_cell_coordinate_Y * grid_size;
-          // gs2 variable (used below) equals grid_size * grid_size
-          //
-
-          // Counter 2 layer of the grid (1 * grid_size * grid_size)
-          layer = gs2;
-          if (decrement_C2_for_previous_cell)
-            atomic_fetch_sub<size_t>(grid_a[prev_coordinates + layer], 1);
-
-          if (update_coordinates) {
-            prev_known_cell_coordinate_X = iX;
-            prev_known_cell_coordinate_Y = iY;
-          }
-
-          // Counter 1 layer of the grid (0 * grid_size * grid_size)
-          layer = 0;
-          if (increment_C1)
-            atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
-
-          // Counter 2 layer of the grid (1 * grid_size * grid_size)
-          layer = gs2;
-          if (increment_C2)
-            atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
-
-          // Counter 3 layer of the grid (2 * grid_size * grid_size)
-          layer = gs2 + gs2;
-          if (increment_C3)
-            atomic_fetch_add<size_t>(grid_a[curr_coordinates + layer], 1);
-
+          // Displace particle and update the grid
+          MoveParticle(displacement_X, displacement_Y, particle_X_a[p],
+                       particle_Y_a[p], inside_cell,
+                       prev_known_cell_coordinate_X,
+                       prev_known_cell_coordinate_Y, grid_a, grid_size,
+                       radius);
         }  // Next iteration
       });  // End parallel for
     });    // End queue submit. End accessor scope
   }        // End buffer scope
 }  // End of function ParticleMotion()
+
+// This function distributes simulation work like ParticleMotion(), but the
+// random displacements are generated inside the motion loop with the oneMKL
+// device API instead of being pre-generated into n_particles * n_iterations
+// arrays, so the memory used does not grow with the number of iterations.
+//
+// ParticleMotion() fills random_X and then random_Y from a single Philox
+// stream, so the X displacement of particle p at iteration iter is the number
+// at offset iter * n_particles + p of the stream, and the Y displacement is
+// the number at offset n_moves + iter * n_particles + p. Each work-item
+// starts two engines at its first offsets and skips ahead n_particles - 1
+// numbers after each draw. Philox is a counter-based engine, so skipping
+// ahead only updates the counter, and the displacements (and therefore the
+// results) are bit-identical to ParticleMotion().
+void ParticleMotionDeviceRng(queue& q, const int seed, float* particle_X,
+                             float* particle_Y, size_t* grid,
+                             const size_t grid_size, const size_t planes,
+                             const size_t n_particles,
+                             const size_t n_iterations, const float radius) {
+  // Total number of motion events
+  const size_t n_moves = n_particles * n_iterations;
+
+  PrintSimulationInfo(q, seed, grid_size, n_particles, n_iterations);
+
+  // Begin buffer scope
+  {
+    // Create buffers using SYCL buffer class
+    buffer particle_X_buf(particle_X, range(n_particles));
+    buffer particle_Y_buf(particle_Y, range(n_particles));
+    buffer grid_buf(grid, range(grid_size * grid_size * planes));
+
+    // Submit command group for execution
+    // h is a handler type
+    q.submit([&](auto& h) {
+      // Declare accessors
+      accessor particle_X_a(particle_X_buf, h);  // Read/write access
+      accessor particle_Y_a(particle_Y_buf, h);
+      // Use SYCL atomic access mode to create atomic accessors
+      accessor grid_a = grid_buf.get_access<access::mode::atomic>(h);
+
+      // Send a SYCL kernel (lambda) for parallel execution
+      h.parallel_for(range(n_particles), [=](auto item) {
+        // Particle number (used for indexing)
+        size_t p = item.get_id(0);
+        // True when particle is found to be in a cell
+        bool inside_cell = false;
+        // Coordinates of the last known cell this particle resided in
+        unsigned int prev_known_cell_coordinate_X;
+        unsigned int prev_known_cell_coordinate_Y;
+
+        // Device basic random number generators (BRNG) for this particle,
+        // positioned at its displacements of the first iteration
+        mkl::rng::device::philox4x32x10<1> engine_X(seed, p);
+        mkl::rng::device::philox4x32x10<1> engine_Y(seed, n_moves + p);
+        // Distribution object
+        mkl::rng::device::gaussian<float,
+                                   mkl::rng::device::gaussian_method::icdf>
+            distr(alpha, sigma);
+
+        // Each particle performs this loop
+        for (size_t iter = 0; iter < n_iterations; ++iter) {
+          // Generate the displacements, then skip the displacements of the
+          // other particles in this iteration
+          float displacement_X = mkl::rng::device::generate(distr, engine_X);
+          float displacement_Y = mkl::rng::device::generate(distr, engine_Y);
+          mkl::rng::device::skip_ahead(engine_X, n_particles - 1);
+          mkl::rng::device::skip_ahead(engine_Y, n_particles - 1);
+          // Displace particle and update the grid
+          MoveParticle(displacement_X, displacement_Y, particle_X_a[p],
+                       particle_Y_a[p], inside_cell,
+                       prev_known_cell_coordinate_X,
+                       prev_known_cell_coordinate_Y, grid_a, grid_size,
+                       radius);
+        }  // Next iteration
+      });  // End parallel for
+    });    // End queue submit. End accessor scope
+  }        // End buffer scope
+}  // End of function ParticleMotionDeviceRng()
@@ -25,12 +25,15 @@ void Usage() {
        << "\n|-r   | seed             | [-inf, inf]| [default=777]  |"
        << "\n|-c   | cpu_flag         | [0, 1]     | [default=0]    |"
        << "\n|-o   | grid_output_flag | [0, 1]     | [default=1]    |"
-       << "\n--------------------------------------------------------\n\n";
+       << "\n|-m   | rng_mode         | [0, 2]     | [default=0]    |"
+       << "\n--------------------------------------------------------"
+       << "\nrng_mode: 0 = pre-generated random numbers, 1 = random numbers"
+       << "\n          generated in the kernel, 2 = run both and compare\n\n";
 #else   // WINDOWS
   cout << "\nUsage: ";
   cout << "./<binary_name> <Number of Iterations> <Number of Particles> "
        << "<Size of Square Grid> <Seed for RNG> <1/0 Flag for CPU Comparison> "
-       << "<1/0 Flag for Grid Output>"
+       << "<1/0 Flag for Grid Output> [RNG Mode]"
        << "\n--------------------------------------------------------"
        << "\n|Argument name           | Range      | Default value  |"
        << "\n|------------------------|------------|----------------|"
@@ -40,7 +43,10 @@ void Usage() {
        << "\n|Seed for RNG            | [-inf, inf]| [default=777]  |"
        << "\n|Flag for CPU comparison | [0, 1]     | [default=0]    |"
        << "\n|Flag for Grid Output    | [0, 1]     | [default=1]    |"
-       << "\n--------------------------------------------------------\n\n";
+       << "\n|RNG Mode                | [0, 2]     | [default=0]    |"
+       << "\n--------------------------------------------------------"
+       << "\nRNG Mode: 0 = pre-generated random numbers, 1 = random numbers"
+       << "\n          generated in the kernel, 2 = run both and compare\n\n";
 #endif  // WINDOWS
 }
 
@@ -112,12 +118,13 @@ void PrintVectorAsMatrix(const T* vector, const size_t size_X,
 // Command line argument parser
 int ParseArgs(const int argc, char* argv[], size_t* n_iterations,
               size_t* n_particles, size_t* grid_size, int* seed,
-              unsigned int* cpu_flag, unsigned int* grid_output_flag) {
+              unsigned int* cpu_flag, unsigned int* grid_output_flag,
+              unsigned int* rng_mode) {
   int retv = 0;
   int negative_seed = 0;
   int cl_option;
   // Parse user-specified parameters
-  while ((cl_option = getopt(argc, argv, "i:p:g:r:c:o:h")) != -1 && retv == 0) {
+  while ((cl_option = getopt(argc, argv, "i:p:g:r:c:o:m:h")) != -1 && retv == 0) {
     if (optarg) {
       if (cl_option == 'r' && optarg[0] == '-') negative_seed = 1;
       if (negative_seed == 0) retv = IsNum(optarg);
@@ -142,6 +149,9 @@ int ParseArgs(const int argc, char* argv[], size_t* n_iterations,
       case 'o':
         *grid_output_flag = stoul(optarg);
         break;
+      case 'm':
+        *rng_mode = stoul(optarg);
+        break;
       case 'h':
       case ':':
       case '?':
@@ -154,7 +164,7 @@ int ParseArgs(const int argc, char* argv[], size_t* n_iterations,
   }
   if ((*cpu_flag != 1 && *cpu_flag != 0) ||
       (*grid_output_flag != 1 && *grid_output_flag != 0) ||
-      (*n_iterations == 0))
+      (*rng_mode > 2) || (*n_iterations == 0))
     retv = 1;
   if (retv == 1) Usage();
   return retv;
@@ -163,7 +173,8 @@ int ParseArgs(const int argc, char* argv[], size_t* n_iterations,
 // Windows command line argument parser
 int ParseArgsWindows(int argc, char* argv[], size_t* n_iterations,
                      size_t* n_particles, size_t* grid_size, int* seed,
-                     unsigned int* cpu_flag, unsigned int* grid_output_flag) {
+                     unsigned int* cpu_flag, unsigned int* grid_output_flag,
+                     unsigned int* rng_mode) {
   int retv = 0;
   // Parse user-specified parameters
   try {
@@ -175,12 +186,13 @@ int ParseArgsWindows(int argc, char* argv[], size_t* n_iterations,
     *seed = stoi(argv[4]);
     *cpu_flag = stoul(argv[5]);
     *grid_output_flag = stoul(argv[6]);
+    if (argc > 7) *rng_mode = stoul(argv[7]);
   } catch (...) {
     retv = 1;
   }
   if ((*cpu_flag != 1 && *cpu_flag != 0) ||
       (*grid_output_flag != 1 && *grid_output_flag != 0) ||
-      (*n_iterations == 0))
+      (*rng_mode > 2) || (*n_iterations == 0))
     retv = 1;
   if (retv == 1) Usage();
   return retv;
@@ -39,8 +39,12 @@
 
 #include <CL/sycl.hpp>
 #include <chrono>
+#include <vector>
 using namespace sycl;
 
+// Number of work-items of the small kernels of the scheduling benchmark
+#define SMALL_KERNEL_SIZE 32
+
 // This is a kernel that does no real work but runs at least for a specified
 // number of clocks
 void clock_block(clock_t *d_o, clock_t clock_count, sycl::nd_item<3> item_ct1) {
@@ -79,12 +83,263 @@ void sum(clock_t *d_clocks, int N, sycl::nd_item<3> item_ct1,
   d_clocks[0] = s_clocks[0];
 }
 
+// Small kernel of the scheduling benchmark. Each kernel of a chain increments
+// the counters of the chain, so it depends on the previous kernel of the chain
+void small_kernel(int *d_counters, sycl::nd_item<1> item_ct1) {
+  d_counters[item_ct1.get_local_id(0)] += 1;
+}
+
+// Results of a submission strategy of the scheduling benchmark
+struct SchedulingResult {
+  double submit_us;    // host submission cost per kernel
+  double frame_ms;     // time from the first submission to frame completion
+  double latency_us;   // mean time from submission to start of a kernel,
+                       // including the time queued behind earlier kernels
+  double kernel_us;    // mean execution time of a kernel
+  double concurrency;  // kernel execution time divided by frame device time
+};
+
+// Submits one frame of the scheduling benchmark: nsmall small kernels in
+// nchains independent chains of dependent kernels, interleaved. The kernels of
+// a chain are submitted to queues[chain % queues.size()]. In-order queues
+// order the kernels of a chain by themselves, on out-of-order queues each
+// kernel depends on the event of the previous kernel of its chain
+void submit_frame(std::vector<sycl::queue> &queues, int *d_counters,
+                  int nsmall, int nchains, std::vector<sycl::event> *events) {
+  std::vector<sycl::event> last(nchains);
+
+  for (int i = 0; i < nsmall; i++) {
+    int chain = i % nchains;
+    sycl::queue &q = queues[chain % queues.size()];
+    int *d_chain = d_counters + chain * SMALL_KERNEL_SIZE;
+    bool depends = !q.is_in_order() && i >= nchains;
+
+    sycl::event e = q.submit([&](sycl::handler &cgh) {
+      if (depends) cgh.depends_on(last[chain]);
+
+      cgh.parallel_for(sycl::nd_range<1>(sycl::range<1>(SMALL_KERNEL_SIZE),
+                                         sycl::range<1>(SMALL_KERNEL_SIZE)),
+                       [=](sycl::nd_item<1> item_ct1) {
+                         small_kernel(d_chain, item_ct1);
+                       });
+    });
+
+    last[chain] = e;
+    if (events) events->push_back(e);
+  }
+}
+
+// Runs one untimed frame (JIT compilation, graph upload) and nframes timed
+// frames, and returns the mean host submission time and frame time in ms
+template <typename Submit, typename Wait>
+void time_frames(Submit submit, Wait wait, int nframes, double &submit_ms,
+                 double &frame_ms) {
+  submit();
+  wait();
+
+  submit_ms = 0;
+  frame_ms = 0;
+  for (int f = 0; f < nframes; f++) {
+    auto start = std::chrono::steady_clock::now();
+    submit();
+    auto submitted = std::chrono::steady_clock::now();
+    wait();
+    auto end = std::chrono::steady_clock::now();
+
+    submit_ms +=
+        std::chrono::duration<double, std::milli>(submitted - start).count();
+    frame_ms += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  submit_ms /= nframes;
+  frame_ms /= nframes;
+}
+
+// Returns the mean submission to start latency, in us, and the sum of the
+// execution times and the device time span of the events, in ns
+void profile_events(std::vector<sycl::event> &events, double &latency_us,
+                    double &busy_ns, double &span_ns) {
+  uint64_t first_start = UINT64_MAX, last_end = 0;
+
+  latency_us = 0;
+  busy_ns = 0;
+  for (auto &e : events) {
+    uint64_t submit =
+        e.get_profiling_info<sycl::info::event_profiling::command_submit>();
+    uint64_t start =
+        e.get_profiling_info<sycl::info::event_profiling::command_start>();
+    uint64_t end =
+        e.get_profiling_info<sycl::info::event_profiling::command_end>();
+
+    latency_us += (start - submit) * 1e-3;
+    busy_ns += end - start;
+    first_start = std::min(first_start, start);
+    last_end = std::max(last_end, end);
+  }
+  latency_us /= events.size();
+  span_ns = last_end - first_start;
+}
+
+// Checks the counters after nruns frames
+bool check_counters(sycl::queue &q, int *d_counters, int nsmall, int nchains,
+                    int nruns) {
+  std::vector<int> counters(nchains * SMALL_KERNEL_SIZE);
+  q.memcpy(counters.data(), d_counters, counters.size() * sizeof(int)).wait();
+
+  for (int chain = 0; chain < nchains; chain++) {
+    int expected = nruns * (nsmall / nchains + (chain < nsmall % nchains));
+
+    for (int i = 0; i < SMALL_KERNEL_SIZE; i++)
+      if (counters[chain * SMALL_KERNEL_SIZE + i] != expected) return false;
+  }
+  return true;
+}
+
+// Scheduling benchmark: frames of nsmall small dependent kernels, in nchains
+// independent chains, submitted with an in-order queue, an out-of-order queue,
+// one in-order queue per chain and a recorded command graph. Profiling is
+// only enabled on separate queues for one extra frame, so that it does not
+// add to the host submission cost
+bool scheduling_benchmark(sycl::queue &q, int nsmall, int nchains,
+                          int nframes) {
+  sycl::context ctx = q.get_context();
+  sycl::device dev = q.get_device();
+  sycl::property_list in_order{sycl::property::queue::in_order()};
+  sycl::property_list in_order_profiling{
+      sycl::property::queue::in_order(),
+      sycl::property::queue::enable_profiling()};
+  sycl::property_list profiling{sycl::property::queue::enable_profiling()};
+
+  const char *names[] = {"in-order queue", "out-of-order queue",
+                         "queue per chain", "command graph"};
+  SchedulingResult results[4];
+  bool has_result[4] = {true, true, true, false};
+  bool passed = true;
+
+  int *d_counters = sycl::malloc_device<int>(nchains * SMALL_KERNEL_SIZE, q);
+
+  printf("\nScheduling benchmark: %d small kernels per frame in %d chains, "
+         "%d frames\n",
+         nsmall, nchains, nframes);
+
+  for (int s = 0; s < 3; s++) {
+    std::vector<sycl::queue> queues, prof_queues;
+    int nqueues = (s == 2) ? nchains : 1;
+
+    for (int i = 0; i < nqueues; i++) {
+      queues.push_back(sycl::queue(ctx, dev, s == 1 ? sycl::property_list{}
+                                                    : in_order));
+      prof_queues.push_back(
+          sycl::queue(ctx, dev, s == 1 ? profiling : in_order_profiling));
+    }
+
+    q.memset(d_counters, 0, nchains * SMALL_KERNEL_SIZE * sizeof(int)).wait();
+
+    double submit_ms, frame_ms;
+    time_frames(
+        [&]() { submit_frame(queues, d_counters, nsmall, nchains, nullptr); },
+        [&]() {
+          for (auto &sq : queues) sq.wait_and_throw();
+        },
+        nframes, submit_ms, frame_ms);
+
+    std::vector<sycl::event> events;
+    submit_frame(prof_queues, d_counters, nsmall, nchains, &events);
+    for (auto &pq : prof_queues) pq.wait_and_throw();
+
+    double busy_ns, span_ns;
+    profile_events(events, results[s].latency_us, busy_ns, span_ns);
+    results[s].submit_us = submit_ms * 1e3 / nsmall;
+    results[s].frame_ms = frame_ms;
+    results[s].kernel_us = busy_ns * 1e-3 / nsmall;
+    results[s].concurrency = busy_ns / span_ns;
+
+    passed = passed &&
+             check_counters(q, d_counters, nsmall, nchains, nframes + 2);
+  }
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+  // The compiler may support the extension while the device does not, in
+  // which case creating or submitting the graph throws
+  try {
+    namespace sycl_exp = sycl::ext::oneapi::experimental;
+
+    // The frame is recorded once from an out-of-order queue, so the graph
+    // keeps the chains independent, then replayed every frame
+    sycl::queue q_graph(ctx, dev);
+    sycl::queue q_prof(ctx, dev, profiling);
+    std::vector<sycl::queue> recorded{q_graph};
+    sycl_exp::command_graph graph(ctx, dev);
+
+    graph.begin_recording(q_graph);
+    submit_frame(recorded, d_counters, nsmall, nchains, nullptr);
+    graph.end_recording(q_graph);
+    auto exec = graph.finalize();
+
+    q.memset(d_counters, 0, nchains * SMALL_KERNEL_SIZE * sizeof(int)).wait();
+
+    double submit_ms, frame_ms;
+    time_frames([&]() { q_graph.ext_oneapi_graph(exec); },
+                [&]() { q_graph.wait_and_throw(); }, nframes, submit_ms,
+                frame_ms);
+
+    // The kernels of a graph have no events, so the latency and the device
+    // time span are those of the whole graph
+    std::vector<sycl::event> events{q_prof.ext_oneapi_graph(exec)};
+    q_prof.wait_and_throw();
+
+    double busy_ns, span_ns;
+    profile_events(events, results[3].latency_us, busy_ns, span_ns);
+    results[3].submit_us = submit_ms * 1e3 / nsmall;
+    results[3].frame_ms = frame_ms;
+    // The kernels of the in-order queue do not overlap, which gives the
+    // execution time of a kernel of the graph
+    results[3].kernel_us = results[0].kernel_us;
+    results[3].concurrency = results[0].kernel_us * 1e3 * nsmall / span_ns;
+    has_result[3] = true;
+
+    passed = passed &&
+             check_counters(q, d_counters, nsmall, nchains, nframes + 2);
+  } catch (sycl::exception const &e) {
+    printf("Command graph skipped, not supported by the device: %s\n",
+           e.what());
+  }
+#endif
+
+  printf("%-20s %14s %12s %14s %12s %12s %12s\n", "Strategy",
+         "submit us/krn", "frame ms", "frame us/krn", "latency us",
+         "kernel us", "concurrency");
+  for (int s = 0; s < 4; s++) {
+    if (!has_result[s]) {
+      printf("%-20s %14s\n", names[s], "not supported");
+      continue;
+    }
+    printf("%-20s %14.2f %12.3f %14.2f %12.2f %12.2f %12.2f\n", names[s],
+           results[s].submit_us, results[s].frame_ms,
+           results[s].frame_ms * 1e3 / nsmall, results[s].latency_us,
+           results[s].kernel_us, results[s].concurrency);
+  }
+  printf("latency us includes the time a kernel waits behind the earlier "
+         "kernels of the frame.\n");
+  if (has_result[3])
+    printf("The command graph latency is that of the whole graph, and its "
+           "kernel us and concurrency\nuse the kernel time measured on the "
+           "in-order queue.\n");
+
+  sycl::free(d_counters, q);
+
+  if (!passed) printf("Scheduling benchmark results are not correct\n");
+  return passed;
+}
+
 int main(int argc, char **argv) {
   sycl::queue q_ct1 = sycl::queue(sycl::default_selector_v);
   int nkernels = 8;             // number of concurrent kernels
   int nstreams = nkernels + 1;  // use one more stream than concurrent kernel
   int nbytes = nkernels * sizeof(clock_t);  // number of data bytes
   float kernel_time = 10;                   // time the kernel should run in ms
+  int nsmall = 1024;  // number of small kernels per benchmark frame
+  int nchains = 8;    // number of independent chains of small kernels
+  int nframes = 20;   // number of timed benchmark frames
   float elapsed_time;                       // timing variables
   int cuda_device = 0;
 
@@ -95,6 +350,17 @@ int main(int argc, char **argv) {
     nkernels = getCmdLineArgumentInt(argc, (const char **)argv, "nkernels");
     nstreams = nkernels + 1;
   }
+  if (checkCmdLineFlag(argc, (const char **)argv, "nsmall"))
+    nsmall = getCmdLineArgumentInt(argc, (const char **)argv, "nsmall");
+  if (checkCmdLineFlag(argc, (const char **)argv, "nchains"))
+    nchains = getCmdLineArgumentInt(argc, (const char **)argv, "nchains");
+  if (checkCmdLineFlag(argc, (const char **)argv, "nframes"))
+    nframes = getCmdLineArgumentInt(argc, (const char **)argv, "nframes");
+  if (nchains < 1 || nsmall < nchains || nframes < 1) {
+    printf("Invalid benchmark size: need nchains >= 1, nsmall >= nchains and "
+           "nframes >= 1\n");
+    exit(EXIT_FAILURE);
+  }
   auto exception_handler = [](exception_list exceptions) {
     for (std::exception_ptr const &e : exceptions) {
       try {
@@ -225,6 +491,9 @@ int main(int argc, char **argv) {
 
   bool bTestResult = (a[0] > total_clocks);
 
+  bTestResult =
+      scheduling_benchmark(q_ct1, nsmall, nchains, nframes) && bTestResult;
+
   // release resources
   for (int i = 0; i < nkernels; i++) {
     free(streams[i]);
@@ -160,12 +160,17 @@ BilateralFilter1D(fpga_tools::ShiftReg<PixelT, filter_size>& buffer,
       // value is e^-(exp_power)
       const float exp_power = intensity_component + spatial_component;
 
-      // now that we have the exponential power value ('exp_power'), use the
-      // exponential LUT ('ExpLUT') to lookup the result of exp(-exp_power).
-      // NOTE: when creating the exponential LUT, we stored the values of
-      // exp(-x) = 1/exp(x). This avoids negating the value of 'exp_power'.
-      const auto exp_lut_idx = ExpLUT::QFP::FromFP32(exp_power);
-      filter_val = ExpLUT::QFP::ToFP32(exp_lut[exp_lut_idx]);
+      if constexpr (kUseQFPMath) {
+        // now that we have the exponential power value ('exp_power'), use the
+        // exponential LUT ('ExpLUT') to lookup the result of exp(-exp_power).
+        // NOTE: when creating the exponential LUT, we stored the values of
+        // exp(-x) = 1/exp(x). This avoids negating the value of 'exp_power'.
+        const auto exp_lut_idx = ExpLUT::QFP::FromFP32(exp_power);
+        filter_val = ExpLUT::QFP::ToFP32(exp_lut[exp_lut_idx]);
+      } else {
+        // full 32-bit floating-point exp(-exp_power)
+        filter_val = sycl::exp(-exp_power);
+      }
     }
 
     // compute the bilateral filter value
@@ -183,8 +188,12 @@ BilateralFilter1D(fpga_tools::ShiftReg<PixelT, filter_size>& buffer,
   // LUT to compute 1/filter_sum. This saves area by using a 32-bit
   // floating-point multiplication, instead of division.
   // Computes: filtered_pixel /= filter_sum
-  const auto inv_lut_idx = InvLUT::QFP::FromFP32(filter_sum);
-  filtered_pixel *= InvLUT::QFP::ToFP32(inv_lut[inv_lut_idx]);
+  if constexpr (kUseQFPMath) {
+    const auto inv_lut_idx = InvLUT::QFP::FromFP32(filter_sum);
+    filtered_pixel *= InvLUT::QFP::ToFP32(inv_lut[inv_lut_idx]);
+  } else {
+    filtered_pixel /= filter_sum;
+  }
 
   return filtered_pixel;
 }
@@ -277,12 +286,19 @@ struct HorizontalFunctor {
 //
 // Submit all of the ANR kernels (vertical and horizontal)
 //
+// The kernels process 'frames' frames of size 'rows' x 'cols' back-to-back
+// before exiting. Launching the kernels once for a stream of frames (instead
+// of once per frame) keeps them running persistently, avoids reloading the
+// intensity sigma LUT from device memory for every frame, and lets the
+// DMA kernels stream in the next frame while the current one is filtered.
+//
 template <typename IndexT, typename InPipe, typename OutPipe,
           unsigned filter_size, unsigned pixels_per_cycle,
           unsigned max_cols>
 std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
                                     ANRParams params,
-                                    float* sig_i_lut_data_ptr) {
+                                    float* sig_i_lut_data_ptr,
+                                    int frames = 1) {
   // the internal pipe between the vertical and horizontal kernels
   using IntraPipeT =
       fpga_tools::DataBundle<DataForwardStruct, pixels_per_cycle>;
@@ -308,6 +324,9 @@ std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
   } else if (rows <= 0) {
     std::cerr << "ERROR: rows must be strictly positive\n";
     std::terminate();
+  } else if (frames <= 0) {
+    std::cerr << "ERROR: frames must be strictly positive\n";
+    std::terminate();
   } else if ((cols % pixels_per_cycle) != 0) {
     std::cerr << "ERROR: the number of columns (" << cols
               << ") must be a multiple of the number of pixels per cycle ("
@@ -361,15 +380,17 @@ std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
     constexpr ExpLUT exp_lut;
     constexpr InvLUT inv_lut;
 
-    // Start the column stencil.
+    // Start the column stencil for every frame.
     // It will callback to 'vertical_func' with all of the additional
     // arguments listed after 'vertical_func' (i.e., spatial_power,
     // params, ...)
-    ColumnStencil<PixelT, DataForwardStruct, IndexT, InPipe,
-                  IntraPipe, filter_size, max_cols, pixels_per_cycle>(rows_k,
-                  cols_k, PixelT(0), vertical_func, spatial_power, params,
-                  std::cref(exp_lut), std::cref(inv_lut),
-                  std::ref(sig_i_lut));
+    for (int f = 0; f < frames; f++) {
+      ColumnStencil<PixelT, DataForwardStruct, IndexT, InPipe,
+                    IntraPipe, filter_size, max_cols, pixels_per_cycle>(rows_k,
+                    cols_k, PixelT(0), vertical_func, spatial_power, params,
+                    std::cref(exp_lut), std::cref(inv_lut),
+                    std::ref(sig_i_lut));
+    }
   });
 
   // submit the horizontal kernel using a row stencil
@@ -387,15 +408,17 @@ std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
     ANRParams::AlphaFixedT one_minus_alpha_fixed(params.one_minus_alpha);
 #endif
     
-    // Start the row stencil.
+    // Start the row stencil for every frame.
     // It will callback to 'horizontal_func' with the additional all of the
     // additional arguments listed after 'horizontal_func' (i.e.,
     // spatial_power, params, alpha_fixed, ...)
-    RowStencil<DataForwardStruct, PixelT, IndexT, IntraPipe, OutPipe,
-                filter_size, pixels_per_cycle>(rows_k, cols_k,
-                DataForwardStruct(0), horizontal_func, spatial_power,
-                params, alpha_fixed, one_minus_alpha_fixed, std::cref(exp_lut),
-                std::cref(inv_lut));
+    for (int f = 0; f < frames; f++) {
+      RowStencil<DataForwardStruct, PixelT, IndexT, IntraPipe, OutPipe,
+                  filter_size, pixels_per_cycle>(rows_k, cols_k,
+                  DataForwardStruct(0), horizontal_func, spatial_power,
+                  params, alpha_fixed, one_minus_alpha_fixed,
+                  std::cref(exp_lut), std::cref(inv_lut));
+    }
   });
 
   return {vertical_kernel, horizontal_kernel};
@@ -83,6 +83,15 @@ namespace std {
   };
 };
 
+// Selects how the bilateral filter computes exp(-x) and 1/x. When QFP_MATH is
+// 1 (the default), quantized floating-point (QFP) ROM LUTs are used, which
+// saves area and DSPs. When QFP_MATH is 0, full 32-bit floating-point math is
+// used, which is more accurate but costs more area.
+#ifndef QFP_MATH
+#define QFP_MATH 1
+#endif
+constexpr bool kUseQFPMath = (QFP_MATH != 0);
+
 // PSRN default threshold
 // https://en.wikipedia.org/wiki/Peak_signal-to-noise_ratio
 constexpr double kPSNRDefaultThreshold = 30.0;
@@ -33,6 +33,19 @@ void WriteOutputFile(std::string data_dir, std::vector<PixelT>& pixels,
 double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
               int frames, ANRParams params, float* sig_i_lut_data_ptr);
 
+double RunANRVideo(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols,
+                   int rows, int frames, ANRParams params,
+                   float* sig_i_lut_data_ptr,
+                   std::vector<double>& frame_latency_ms);
+
+std::vector<PixelT> TileFrame(const std::vector<PixelT>& pixels, int cols,
+                              int rows, int tiled_cols, int tiled_rows);
+
+int RunVideoMode(queue& q, std::vector<PixelT>& in_pixels,
+                 std::vector<PixelT>& ref_pixels, int cols, int rows,
+                 int video_cols, int video_rows, int runs, int frames,
+                 ANRParams params, float* sig_i_lut_data_ptr);
+
 bool Validate(PixelT* val, PixelT* ref, int rows, int cols,
               double psnr_thresh = kPSNRDefaultThreshold);
 ////////////////////////////////////////////////////////////////////////////////
@@ -49,6 +62,8 @@ int main(int argc, char* argv[]) {
   int runs = 2;
   int frames = 8;
 #endif
+  bool video = false;
+  int video_cols = -1, video_rows = -1;
 
   // get the input data directory
   if (argc > 1) {
@@ -65,6 +80,20 @@ int main(int argc, char* argv[]) {
     frames = atoi(argv[3]);
   }
 
+  // the fourth command line argument enables video mode, where 'frames'
+  // distinct frames are streamed through the design
+  if (argc > 4) {
+    video = atoi(argv[4]) != 0;
+  }
+
+  // the optional fifth and sixth command line arguments set the video
+  // resolution (e.g., 1920 1080 or 3840 2160). The test image is tiled to
+  // this resolution to create the frames.
+  if (argc > 6) {
+    video_cols = atoi(argv[5]);
+    video_rows = atoi(argv[6]);
+  }
+
   // enforce at least two runs
   if (runs < 2) {
     std::cerr << "ERROR: 'runs' must be 2 or more\n";
@@ -85,8 +114,10 @@ int main(int argc, char* argv[]) {
   ext::intel::fpga_selector selector;
 #endif
 
-  // create the device queue
-  queue q(selector, fpga_tools::exception_handler);
+  // create the device queue with profiling enabled, which is used to
+  // measure the per-frame latency in video mode
+  auto prop_list = property_list{property::queue::enable_profiling()};
+  queue q(selector, fpga_tools::exception_handler, prop_list);
 
   // make sure the device supports USM device allocations
   auto d = q.get_device();
@@ -103,6 +134,28 @@ int main(int argc, char* argv[]) {
   ParseFiles(data_dir, in_pixels, ref_pixels, cols, rows, params);
   pixel_count = cols * rows;
 
+  // allocate space for the intensity sigma LUT
+  float* sig_i_lut_data_ptr = IntensitySigmaLUT::AllocateDevice(q);
+
+  // create the intensity sigma LUT data locally on the host
+  IntensitySigmaLUT sig_i_lut_host(params);
+
+  // copy the intensity sigma LUT to the device
+  sig_i_lut_host.CopyDataToDevice(q, sig_i_lut_data_ptr).wait();
+
+  // run in video mode, if requested
+  if (video) {
+    if (video_cols < 0) {
+      video_cols = cols;
+      video_rows = rows;
+    }
+    int ret = RunVideoMode(q, in_pixels, ref_pixels, cols, rows, video_cols,
+                           video_rows, runs, frames, params,
+                           sig_i_lut_data_ptr);
+    sycl::free(sig_i_lut_data_ptr, q);
+    return ret;
+  }
+
   // create the output pixels (initialize to all 0s)
   std::vector<PixelT> out_pixels(in_pixels.size(), 0);
 
@@ -119,15 +172,6 @@ int main(int argc, char* argv[]) {
 
   // copy the input data to the device memory and wait for the copy to finish
   q.memcpy(in, in_pixels.data(), pixel_count * sizeof(PixelT)).wait();
-
-  // allocate space for the intensity sigma LUT
-  float* sig_i_lut_data_ptr = IntensitySigmaLUT::AllocateDevice(q);
-
-  // create the intensity sigma LUT data locally on the host
-  IntensitySigmaLUT sig_i_lut_host(params);
-
-  // copy the intensity sigma LUT to the device
-  sig_i_lut_host.CopyDataToDevice(q, sig_i_lut_data_ptr).wait();
   //////////////////////////////////////////////////////////////////////////////
 
   // track timing information in ms
@@ -219,14 +263,11 @@ double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
       SubmitOutputDMA<OutputKernelID, PixelT, ANROutPipe, kPixelsPerCycle>(q,
                       out_ptr, rows, cols, frames);
 
-  // launch all ANR kernels
-  std::vector<std::vector<event>> anr_kernel_events(frames);
-  for (int i = 0; i < frames; i++) {
-    anr_kernel_events[i] =
-        SubmitANRKernels<IndexT, ANRInPipe, ANROutPipe, kFilterSize,
+  // launch the ANR kernels, which process all of the frames before exiting
+  auto anr_kernel_events =
+      SubmitANRKernels<IndexT, ANRInPipe, ANROutPipe, kFilterSize,
                        kPixelsPerCycle, kMaxCols>(q, cols, rows, params,
-                       sig_i_lut_data_ptr);
-  }
+                       sig_i_lut_data_ptr, frames);
 
   // wait for the input and output kernels to finish
   auto start = high_resolution_clock::now();
@@ -235,10 +276,8 @@ double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
   auto end = high_resolution_clock::now();
 
   // wait for the ANR kernels to finish
-  for (auto& one_event_set : anr_kernel_events) {
-    for (auto& e : one_event_set) {
-      e.wait();
-    }
+  for (auto& e : anr_kernel_events) {
+    e.wait();
   }
 
   // return the duration in milliseconds, excluding memory transfers
@@ -246,6 +285,205 @@ double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
   return diff.count();
 }
 
+//
+// Run the ANR algorithm on the device for a video, i.e., a sequence of
+// 'frames' distinct frames stored back-to-back in device memory.
+//
+// The ANR kernels are launched once and persist across all of the frames.
+// The DMA kernels are launched once per frame so that each frame has its own
+// events. Since the ANR kernels are decoupled from the DMA kernels by pipes,
+// the DMA of frame N+1 overlaps the filtering of frame N. The per-frame
+// latency (from the start of the frame's input DMA to the end of its output
+// DMA) is returned in 'frame_latency_ms' and the total time to process all of
+// the frames is returned in milliseconds.
+//
+double RunANRVideo(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols,
+                   int rows, int frames, ANRParams params,
+                   float* sig_i_lut_data_ptr,
+                   std::vector<double>& frame_latency_ms) {
+  // the input and output pipe for the sorter
+  using PipeType = DataBundle<PixelT, kPixelsPerCycle>;
+  using ANRInPipe = sycl::ext::intel::pipe<ANRInPipeID, PipeType>;
+  using ANROutPipe = sycl::ext::intel::pipe<ANROutPipeID, PipeType>;
+
+  const size_t pixel_count = size_t(cols) * rows;
+
+  // launch the persistent ANR kernels
+  auto anr_kernel_events =
+      SubmitANRKernels<IndexT, ANRInPipe, ANROutPipe, kFilterSize,
+                       kPixelsPerCycle, kMaxCols>(q, cols, rows, params,
+                       sig_i_lut_data_ptr, frames);
+
+  // launch the input and output kernels for every frame
+  std::vector<event> input_kernel_events(frames);
+  std::vector<event> output_kernel_events(frames);
+  for (int f = 0; f < frames; f++) {
+    input_kernel_events[f] =
+        SubmitInputDMA<InputKernelID, PixelT, ANRInPipe, kPixelsPerCycle>(q,
+                       in_ptr + f * pixel_count, rows, cols, 1);
+    output_kernel_events[f] =
+        SubmitOutputDMA<OutputKernelID, PixelT, ANROutPipe, kPixelsPerCycle>(q,
+                        out_ptr + f * pixel_count, rows, cols, 1);
+  }
+
+  // wait for all of the kernels to finish
+  for (int f = 0; f < frames; f++) {
+    input_kernel_events[f].wait();
+    output_kernel_events[f].wait();
+  }
+  for (auto& e : anr_kernel_events) {
+    e.wait();
+  }
+
+  // compute the per-frame latency from the kernel profiling information
+  frame_latency_ms.resize(frames);
+  for (int f = 0; f < frames; f++) {
+    auto start_ns = input_kernel_events[f]
+        .get_profiling_info<info::event_profiling::command_start>();
+    auto end_ns = output_kernel_events[f]
+        .get_profiling_info<info::event_profiling::command_end>();
+    frame_latency_ms[f] = (end_ns - start_ns) * 1e-6;
+  }
+
+  // the total time is from the start of the first frame's input DMA to the
+  // end of the last frame's output DMA
+  auto first_start_ns = input_kernel_events.front()
+      .get_profiling_info<info::event_profiling::command_start>();
+  auto last_end_ns = output_kernel_events.back()
+      .get_profiling_info<info::event_profiling::command_end>();
+  return (last_end_ns - first_start_ns) * 1e-6;
+}
+
+//
+// Create a frame of size 'tiled_cols' x 'tiled_rows' by tiling (repeating)
+// the 'cols' x 'rows' image 'pixels'.
+//
+std::vector<PixelT> TileFrame(const std::vector<PixelT>& pixels, int cols,
+                              int rows, int tiled_cols, int tiled_rows) {
+  std::vector<PixelT> tiled(size_t(tiled_cols) * tiled_rows);
+  for (int r = 0; r < tiled_rows; r++) {
+    for (int c = 0; c < tiled_cols; c++) {
+      tiled[size_t(r) * tiled_cols + c] = pixels[(r % rows) * cols + (c % cols)];
+    }
+  }
+  return tiled;
+}
+
+//
+// Run the design in video mode and report the frame rate and the per-frame
+// latency. If the video resolution matches the test image, every output
+// frame is validated against the reference. Otherwise, the test image is
+// tiled to the video resolution and only performance is reported.
+//
+int RunVideoMode(queue& q, std::vector<PixelT>& in_pixels,
+                 std::vector<PixelT>& ref_pixels, int cols, int rows,
+                 int video_cols, int video_rows, int runs, int frames,
+                 ANRParams params, float* sig_i_lut_data_ptr) {
+  if (video_cols <= 0 || video_rows <= 0) {
+    std::cerr << "ERROR: the video resolution must be strictly positive\n";
+    std::terminate();
+  }
+  const bool validate = (video_cols == cols) && (video_rows == rows);
+  const size_t frame_pixels = size_t(video_cols) * video_rows;
+  const size_t total_pixels = frame_pixels * frames;
+
+  // build the input video by repeating the (tiled) test image for each frame
+  std::vector<PixelT> frame_pixels_host =
+      validate ? in_pixels
+               : TileFrame(in_pixels, cols, rows, video_cols, video_rows);
+  std::vector<PixelT> video_in(total_pixels);
+  for (int f = 0; f < frames; f++) {
+    std::copy(frame_pixels_host.begin(), frame_pixels_host.end(),
+              video_in.begin() + f * frame_pixels);
+  }
+  std::vector<PixelT> video_out(total_pixels, 0);
+
+  // allocate memory on the device for the input and output video
+  PixelT *in, *out;
+  if ((in = malloc_device<PixelT>(total_pixels, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate space for 'in'\n";
+    std::terminate();
+  }
+  if ((out = malloc_device<PixelT>(total_pixels, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate space for 'out'\n";
+    std::terminate();
+  }
+  q.memcpy(in, video_in.data(), total_pixels * sizeof(PixelT)).wait();
+
+  // print out some info
+  std::cout << "Video mode\n";
+  std::cout << "Runs:             " << runs << "\n";
+  std::cout << "Columns:          " << video_cols << "\n";
+  std::cout << "Rows:             " << video_rows << "\n";
+  std::cout << "Frames:           " << frames << "\n";
+  std::cout << "Filter Size:      " << kFilterSize << "\n";
+  std::cout << "Pixels Per Cycle: " << kPixelsPerCycle << "\n";
+  std::cout << "Maximum Columns:  " << kMaxCols << "\n";
+  std::cout << "QFP Math:         " << (kUseQFPMath ? "yes" : "no") << "\n";
+  std::cout << "\n";
+
+  bool passed = true;
+  std::vector<double> time(runs);
+  // the per-frame latencies of every run but the first (warmup) run
+  std::vector<double> latency_ms;
+  try {
+    for (int i = 0; i < runs; i++) {
+      std::vector<double> run_latency_ms;
+      time[i] = RunANRVideo(q, in, out, video_cols, video_rows, frames,
+                            params, sig_i_lut_data_ptr, run_latency_ms);
+      if (i > 0) {
+        latency_ms.insert(latency_ms.end(), run_latency_ms.begin(),
+                          run_latency_ms.end());
+      }
+    }
+    q.memcpy(video_out.data(), out, total_pixels * sizeof(PixelT)).wait();
+  } catch (exception const& e) {
+    std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+    std::terminate();
+  }
+
+  sycl::free(in, q);
+  sycl::free(out, q);
+
+  // validate every frame of the output video
+  if (validate) {
+    for (int f = 0; f < frames; f++) {
+      passed &= Validate(video_out.data() + f * frame_pixels,
+                         ref_pixels.data(), rows, cols);
+    }
+  } else {
+    std::cout << "NOTE: the video resolution differs from the test image, "
+              << "so the output is not validated\n";
+  }
+
+  if (!passed) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+  // print the performance results, ignoring the first (warmup) run
+  // NOTE: when run in emulation, these results do not accurately represent
+  // the performance of the kernels in actual FPGA hardware
+  double avg_time_ms =
+      std::accumulate(time.begin() + 1, time.end(), 0.0) / (runs - 1);
+  double avg_latency_ms =
+      std::accumulate(latency_ms.begin(), latency_ms.end(), 0.0) /
+      latency_ms.size();
+  double max_latency_ms =
+      *std::max_element(latency_ms.begin(), latency_ms.end());
+  double fps = frames / (avg_time_ms * 1e-3);
+  double input_count_mega = total_pixels * sizeof(PixelT) * 1e-6;
+
+  std::cout << "Execution time: " << avg_time_ms << " ms\n";
+  std::cout << "Throughput: " << (input_count_mega / (avg_time_ms * 1e-3))
+            << " MB/s\n";
+  std::cout << "Frame rate: " << fps << " fps\n";
+  std::cout << "Average frame latency: " << avg_latency_ms << " ms\n";
+  std::cout << "Maximum frame latency: " << max_latency_ms << " ms\n";
+  std::cout << "PASSED\n";
+  return 0;
+}
+
 //
 // Helper to parse pixel data files
 //
@@ -14,12 +14,22 @@ int main(int argc, char* argv[]) {
   // Default is to run all tests
   int test_to_run = 0;
 
+  // Default number of host threads doing transfers in the contention test
+  int num_streams = 4;
+
   // test_to_run value changed according to user selection if user has provided
   // an input using "-test=<test_number>" option (see PrintHelp function for
-  // test details)
-  if (argc == 2) {
-    std::string tmp_test(argv[1]);
-    if ((tmp_test.compare(0, 6, "-test=")) == 0) {
+  // test details), num_streams changed with the "-threads=<n>" option
+  for (int i = 1; i < argc; i++) {
+    std::string tmp_test(argv[i]);
+    if ((tmp_test.compare(0, 9, "-threads=")) == 0) {
+      num_streams = std::stoi(tmp_test.substr(9));
+      if (num_streams < 1) {
+        std::cerr << "Number of threads for the contention test must be at "
+                  << "least 1, please re-run binary with updated value.\n\n";
+        return 1;
+      }
+    } else if ((tmp_test.compare(0, 6, "-test=")) == 0) {
       test_to_run = std::stoi(tmp_test.substr(6));
       if (test_to_run < 0 || test_to_run > 7) {
         std::cerr
@@ -200,6 +210,15 @@ int main(int argc, char* argv[]) {
 
       ret |= hldshim.KernelMemBW(q);
     }
+
+    // Test 7 - Host transfers and kernel memory traffic contention
+    if (test_to_run == 0 || test_to_run == 7) {
+      std::cout << "\n*****************************************************************\n"
+                << "********  Host Transfer and Kernel Contention Test  ************\n"
+                << "*****************************************************************\n\n";
+
+      ret |= hldshim.ContentionTest(q, num_streams);
+    }
   }  // End of try block
 
   catch (sycl::exception const& e) {
@@ -1,7 +1,10 @@
 #include <sycl/sycl.hpp>
+#include <functional>
+#include <thread>
 #include <vector>
 
 #include "host_speed.hpp"
+#include "contention.hpp"
 
 // Pre-declare kernel name to prevent name mangling
 // This is an FPGA best practice that makes it easier to identify the kernel in
@@ -14,6 +17,7 @@ class MemReadWriteStream;
 class MemReadWriteStreamNDRange;
 class MemWriteStream;
 class MemReadStream;
+class MemReadWriteStreamContention;
 
 // Pipe used between KernelSender and KernelReceiver -
 // ShimMetrics::KernelLaunchTest(queue &q) function
@@ -38,6 +42,8 @@ using SendertoReceiverPipe =
 // KernelLaunchTest - Host to kernel interface check
 // KernelMemRW - Kernel to device global memory interface check
 // KernelMemBW - Kernel to device global memory bandwidth measurement
+// ContentionTest - Concurrent host transfers and kernel memory traffic
+// measurement
 
 class ShimMetrics {
  public:
@@ -50,7 +56,9 @@ class ShimMetrics {
         kernel_latency_{0},
         kernel_thruput_{0},
         kernel_mem_bw_{0},
-        kernel_mem_rw_test_{false} {
+        kernel_mem_rw_test_{false},
+        contention_dma_bw_{0},
+        contention_kernel_bw_{0} {
     max_buffer_size_ =
         q.get_device().get_info<sycl::info::device::global_mem_size>();
 #if defined(FPGA_EMULATOR)
@@ -80,6 +88,7 @@ class ShimMetrics {
   int KernelLatency(sycl::queue &q);
   int KernelMemRW(sycl::queue &q);
   int KernelMemBW(sycl::queue &q);
+  int ContentionTest(sycl::queue &q, size_t num_streams);
   void ReadBinary();
 
  private:
@@ -92,6 +101,8 @@ class ShimMetrics {
   float kernel_thruput_;
   float kernel_mem_bw_;
   bool kernel_mem_rw_test_;
+  float contention_dma_bw_;
+  float contention_kernel_bw_;
   cl_ulong max_buffer_size_;
   cl_ulong max_alloc_size_;
   struct BoardSpec {
@@ -1500,6 +1511,230 @@ int ShimMetrics::KernelMemBW(sycl::queue &q) {
   return 0;
 }
 
+///////////////////////////////////////
+// **** ContentionTest function **** //
+///////////////////////////////////////
+
+// Inputs:
+// 1. queue &q - queue to submit operation
+// 2. size_t num_streams - number of host threads doing transfers concurrently
+// Returns:
+// 0 if test passes, 1 if device max allocation size is 0 or verification fails
+
+// The function does the following tasks:
+// 1. Measures the bandwidth of a kernel that reads, modifies and writes device
+// global memory (MemReadWriteStreamContention) running alone
+// 2. Runs num_streams host threads (DMAStream function in contention.hpp),
+// each writing blocks of increasing size to the device and reading them back
+// on its own queue, with no kernel running
+// 3. Runs the same host threads while the kernel is launched back to back
+// until all threads are done
+// 4. Reports the aggregate and per-stream transfer throughput and the transfer
+// latency percentiles of steps 2 and 3, and compares the transfer throughput
+// and the kernel bandwidth with and without contention
+
+// Following additional functions are used in this test:
+// These are defined in contention.hpp
+// 1. void DMAStream(queue &q, size_t stream_id, atomic<size_t> &streams_done,
+// StreamResult &result)
+// 2. float Percentile(std::vector<float> samples, float p)
+
+int ShimMetrics::ContentionTest(sycl::queue &q, size_t num_streams) {
+  // Test fails if max alloc size is 0
+  if (max_alloc_size_ == 0) {
+    std::cerr << "Maximum global memory allocation supported by Sycl device is "
+              << "0! Cannot run contention test\n\n";
+    return 1;
+  }
+  if (num_streams == 0) {
+    std::cerr << "Number of host transfer threads must be at least 1! Cannot "
+              << "run contention test\n\n";
+    return 1;
+  }
+
+  // Size of the device buffer the kernel streams through, large enough for
+  // the kernel to keep the memory busy for many host transfers
+#if defined(FPGA_EMULATOR)
+  size_t kernel_bytes = 16 * kMB;
+#else
+  size_t kernel_bytes = 256 * kMB;
+#endif
+  // Leave room for the buffers of the host transfer threads
+  if (kernel_bytes > max_alloc_size_ / 2) kernel_bytes = max_alloc_size_ / 2;
+  size_t vector_size = kernel_bytes / sizeof(unsigned);
+
+  // The content of the buffer does not matter, the kernel only generates
+  // memory traffic
+  sycl::buffer<unsigned, 1> kernel_buf{sycl::range<1>(vector_size)};
+
+  // Data moved by one kernel launch (read and write of the buffer) in MB
+  const float kernel_mb = 2.0f * vector_size * sizeof(unsigned) / kMB;
+
+  auto launch_kernel = [&]() {
+    return q.submit([&](sycl::handler &h) {
+      sycl::accessor mem(kernel_buf, h);
+      // Same configuration as the MemReadWriteStreamNDRange kernel in
+      // KernelMemBW
+      constexpr size_t kWGSize = 1024 * 32;
+      constexpr size_t kSimdItems = 16;
+      size_t N = ((vector_size + kWGSize - 1) / kWGSize) * kWGSize;
+      h.parallel_for<MemReadWriteStreamContention>(
+          sycl::nd_range<1>(sycl::range<1>(N), sycl::range<1>(kWGSize)),
+          [=](sycl::nd_item<1> it)
+              [[intel::num_simd_work_items(kSimdItems),
+                sycl::reqd_work_group_size(1, 1, kWGSize)]] {
+                auto gid = it.get_global_id(0);
+                if (gid < vector_size) mem[gid] = mem[gid] + 2;
+              });
+    });
+  };
+
+  // Runs the host transfer threads, and the kernel if with_kernel is set, and
+  // returns the kernel bandwidth (MB/s) measured while the threads were running
+  auto run_streams = [&](bool with_kernel, std::vector<StreamResult> &results) {
+    results.assign(num_streams, StreamResult());
+    std::atomic<size_t> streams_done{0};
+    unsigned long kernel_ns = 0;
+    size_t launches = 0;
+
+    // Launch the kernel first so that the memory is busy from the first
+    // transfer on
+    sycl::event e;
+    if (with_kernel) e = launch_kernel();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_streams; t++) {
+      threads.emplace_back(DMAStream, std::ref(q), t, std::ref(streams_done),
+                           std::ref(results[t]));
+    }
+
+    // Keep launching the kernel until all threads are done
+    if (with_kernel) {
+      while (true) {
+        e.wait();
+        kernel_ns += SyclGetQStExecTimeNs(e);
+        launches++;
+        if (streams_done.load() == num_streams) break;
+        e = launch_kernel();
+      }
+    }
+
+    for (auto &t : threads) t.join();
+
+    if (launches == 0 || kernel_ns == 0) return 0.0f;
+    return (kernel_mb * launches) / (kernel_ns * 1.0e-9f);
+  };
+
+  // Reports the results of the host transfer threads and returns the
+  // aggregate throughput (MB/s); errors is incremented with the verification
+  // errors of the threads
+  auto report_streams = [&](const std::vector<StreamResult> &results,
+                            int &errors) {
+    auto first_start = results[0].start;
+    auto last_stop = results[0].stop;
+    size_t total_bytes = 0;
+    for (size_t t = 0; t < num_streams; t++) {
+      const StreamResult &r = results[t];
+      first_start = std::min(first_start, r.start);
+      last_stop = std::max(last_stop, r.stop);
+      total_bytes += r.total_bytes;
+      errors += r.errors;
+      std::chrono::duration<float> time = r.stop - r.start;  // in seconds
+      float stream_bw =
+          (time.count() > 0) ? ((float)r.total_bytes / kMB) / time.count() : 0;
+      std::cout << "  Stream " << t << ": " << stream_bw << " MB/s\n";
+    }
+    std::chrono::duration<float> time = last_stop - first_start;
+    float aggregate_bw =
+        (time.count() > 0) ? ((float)total_bytes / kMB) / time.count() : 0;
+    std::cout << "  Aggregate: " << aggregate_bw << " MB/s\n\n";
+
+    // Latency percentiles of all threads for each block size
+    std::cout << "  Transfer latency (us)   Write (host to device)       "
+              << "Read (device to host)\n"
+              << "  Block size (KB)         p50      p90      p99        "
+              << "p50      p90      p99\n";
+    for (size_t s = 0; s < kContentionNumSizes; s++) {
+      std::vector<float> wr, rd;
+      for (const StreamResult &r : results) {
+        wr.insert(wr.end(), r.wr_latency_us[s].begin(),
+                  r.wr_latency_us[s].end());
+        rd.insert(rd.end(), r.rd_latency_us[s].begin(),
+                  r.rd_latency_us[s].end());
+      }
+      std::cout << "  " << std::setw(8) << (BlockBytes(s) / kKB)
+                << "          " << std::setw(9) << Percentile(wr, 50)
+                << std::setw(9) << Percentile(wr, 90) << std::setw(9)
+                << Percentile(wr, 99) << "  " << std::setw(9)
+                << Percentile(rd, 50) << std::setw(9) << Percentile(rd, 90)
+                << std::setw(9) << Percentile(rd, 99) << "\n";
+    }
+    return aggregate_bw;
+  };
+
+  // Storing old state of std::cout to restore after output printed
+  std::ios old_state(nullptr);
+  old_state.copyfmt(std::cout);
+  std::cout << std::setprecision(2) << std::fixed;
+
+  std::cout << "Running " << num_streams << " host transfer threads with "
+            << "block sizes from " << (BlockBytes(0) / kKB) << " KB to "
+            << (BlockBytes(kContentionNumSizes - 1) / kKB) << " KB ("
+            << kContentionXfersPerSize << " write-read pairs per size) and "
+            << "a kernel streaming through " << (kernel_bytes / kMB)
+            << " MB of device global memory\n";
+
+  int errors = 0;
+  std::vector<StreamResult> results;
+
+  // **** Kernel alone **** //
+
+  // The first launch includes allocating the buffer on the device, only time
+  // the second one
+  launch_kernel().wait();
+  auto e = launch_kernel();
+  e.wait();
+  float iso_kernel_bw = kernel_mb / (SyclGetQStExecTimeNs(e) * 1.0e-9f);
+  std::cout << "\nKernel alone: " << iso_kernel_bw << " MB/s\n";
+
+  // **** Host transfers alone **** //
+
+  std::cout << "\nHost transfers alone:\n";
+  run_streams(false, results);
+  float iso_dma_bw = report_streams(results, errors);
+
+  // **** Host transfers and kernel concurrently **** //
+
+  std::cout << "\nHost transfers with the kernel running:\n";
+  contention_kernel_bw_ = run_streams(true, results);
+  contention_dma_bw_ = report_streams(results, errors);
+  std::cout << "\n  Kernel: " << contention_kernel_bw_ << " MB/s\n";
+
+  // **** Report contention results **** //
+
+  std::cout << "\nKERNEL-TO-MEMORY BANDWIDTH UNDER CONTENTION = "
+            << contention_kernel_bw_ << " MB/s ("
+            << (iso_kernel_bw > 0 ? 100.0f * contention_kernel_bw_ /
+                                        iso_kernel_bw
+                                  : 0.0f)
+            << "% of kernel alone)\n";
+  std::cout << "HOST TRANSFER THROUGHPUT UNDER CONTENTION = "
+            << contention_dma_bw_ << " MB/s ("
+            << (iso_dma_bw > 0 ? 100.0f * contention_dma_bw_ / iso_dma_bw
+                               : 0.0f)
+            << "% of host transfers alone)\n";
+
+  // Restoring old format
+  std::cout.copyfmt(old_state);
+
+  if (errors != 0) {
+    std::cerr << "Verification of the host transfers failed with " << errors
+              << " error(s)\n";
+    return 1;
+  }
+  return 0;
+}
+
 ///////////////////////////////////
 // **** ReadBinary function **** //
 ///////////////////////////////////
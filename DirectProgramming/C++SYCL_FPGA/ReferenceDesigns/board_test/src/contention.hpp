@@ -0,0 +1,173 @@
+// Header file to accompany the contention test
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "exception_handler.hpp"
+
+// Note: helper.hpp (constants such as kKB) has no include guard, it is
+// included through host_speed.hpp before this file in board_test.hpp
+
+// Block sizes (in bytes) used by each DMA stream of the contention test,
+// the stream cycles through kContentionNumSizes sizes starting at
+// kContentionMinBlock, each size 4x the previous one
+constexpr size_t kContentionMinBlock = 4 * kKB;
+#if defined(FPGA_EMULATOR)
+constexpr size_t kContentionNumSizes = 4;      // 4 KB to 256 KB
+constexpr size_t kContentionXfersPerSize = 4;  // write-read pairs per size
+#else
+constexpr size_t kContentionNumSizes = 6;       // 4 KB to 4 MB
+constexpr size_t kContentionXfersPerSize = 32;  // write-read pairs per size
+#endif
+
+// struct used to store the results of one DMA stream (i.e. one host thread)
+struct StreamResult {
+  // Latency (in microseconds) of every host to device (wr) and device to host
+  // (rd) transfer, indexed by block size
+  std::vector<std::vector<float>> wr_latency_us;
+  std::vector<std::vector<float>> rd_latency_us;
+  size_t total_bytes;  // bytes moved in both directions
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point stop;
+  int errors;  // number of blocks that did not read back correctly
+};
+
+///////////////////////////////////
+// **** BlockBytes function **** //
+///////////////////////////////////
+
+// Input:
+// size_t s - block size index (0 to kContentionNumSizes - 1)
+// Returns:
+// Size of the block in bytes
+
+size_t BlockBytes(size_t s) { return kContentionMinBlock << (2 * s); }
+
+///////////////////////////////////
+// **** Percentile function **** //
+///////////////////////////////////
+
+// Inputs:
+// 1. std::vector<float> samples - samples to compute the percentile of (copy,
+// as it is sorted)
+// 2. float p - percentile to compute (0 to 100)
+// Returns:
+// The nearest-rank p-th percentile of samples, or 0 if there are no samples
+
+float Percentile(std::vector<float> samples, float p) {
+  if (samples.empty()) return 0.0f;
+  std::sort(samples.begin(), samples.end());
+  size_t rank = static_cast<size_t>(p / 100.0f * samples.size() + 0.5f);
+  rank = std::min(std::max(rank, (size_t)1), samples.size());
+  return samples[rank - 1];
+}
+
+//////////////////////////////////
+// **** DMAStream function **** //
+//////////////////////////////////
+
+// Inputs:
+// 1. queue &q - queue used to create the stream's own queue (same device and
+// context)
+// 2. size_t stream_id - index of the stream (used to generate its data)
+// 3. std::atomic<size_t> &streams_done - incremented when the stream finishes
+// 4. StreamResult &result - results of the stream (written by this function)
+// Returns:
+// None
+
+// The function does the following tasks (run in its own host thread):
+// 1. Creates a queue and a device buffer that are private to the stream
+// 2. For each block size, writes a block to the device and reads it back
+// kContentionXfersPerSize times, timing each transfer from submission to
+// completion (i.e. the latency seen by the host)
+// 3. Verifies the data read back from the device
+
+void DMAStream(sycl::queue &q, size_t stream_id,
+               std::atomic<size_t> &streams_done, StreamResult &result) {
+  result.wr_latency_us.assign(kContentionNumSizes, std::vector<float>());
+  result.rd_latency_us.assign(kContentionNumSizes, std::vector<float>());
+  result.total_bytes = 0;
+  result.errors = 0;
+  result.start = result.stop = std::chrono::steady_clock::now();
+
+  const size_t max_block = BlockBytes(kContentionNumSizes - 1);
+  char *hostbuf_wr = new (std::nothrow) char[max_block];
+  char *hostbuf_rd = new (std::nothrow) char[max_block];
+  if (hostbuf_wr == NULL || hostbuf_rd == NULL) {
+    std::cerr << "Error: Allocation of host buffers for stream " << stream_id
+              << " failed\n";
+    if (hostbuf_wr) delete[] hostbuf_wr;
+    if (hostbuf_rd) delete[] hostbuf_rd;
+    result.errors = 1;
+    streams_done++;
+    return;
+  }
+
+  // Different data in every stream so that a transfer landing in the wrong
+  // stream's buffer is caught
+  for (size_t i = 0; i < max_block; i++) {
+    hostbuf_wr[i] = static_cast<char>(i + stream_id * 37);
+  }
+
+  try {
+    // Each stream has its own queue so that its transfers are not serialized
+    // behind the other streams or the kernel
+    sycl::queue sq(q.get_context(), q.get_device(),
+                   fpga_tools::exception_handler);
+    sycl::buffer<char, 1> device_buffer{sycl::range<1>(max_block)};
+
+    result.start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < kContentionNumSizes; s++) {
+      size_t block_bytes = BlockBytes(s);
+      for (size_t x = 0; x < kContentionXfersPerSize; x++) {
+        // **** Write to device **** //
+        auto t0 = std::chrono::steady_clock::now();
+        sq.submit([&](sycl::handler &h) {
+            sycl::accessor<char, 1, sycl::access::mode::write> mem(
+                device_buffer, h, sycl::range<1>(block_bytes));
+            h.copy(hostbuf_wr, mem);
+          }).wait();
+        auto t1 = std::chrono::steady_clock::now();
+
+        // **** Read from device **** //
+        sq.submit([&](sycl::handler &h) {
+            sycl::accessor<char, 1, sycl::access::mode::read> mem(
+                device_buffer, h, sycl::range<1>(block_bytes));
+            h.copy(mem, hostbuf_rd);
+          }).wait();
+        auto t2 = std::chrono::steady_clock::now();
+
+        result.wr_latency_us[s].push_back(
+            std::chrono::duration<float, std::micro>(t1 - t0).count());
+        result.rd_latency_us[s].push_back(
+            std::chrono::duration<float, std::micro>(t2 - t1).count());
+        result.total_bytes += 2 * block_bytes;
+      }
+
+      // **** Verification (last read back of each block size) **** //
+      if (std::memcmp(hostbuf_wr, hostbuf_rd, block_bytes) != 0) {
+        std::cerr << "Error: Stream " << stream_id << " read back incorrect "
+                  << "data for block size " << block_bytes << " bytes\n";
+        result.errors++;
+      }
+    }
+    result.stop = std::chrono::steady_clock::now();
+  } catch (sycl::exception const &e) {
+    // Exceptions cannot propagate out of the thread, report and count them as
+    // an error of the stream
+    std::cerr << "Caught a SYCL host exception in stream " << stream_id
+              << ":\n" << e.what() << "\n";
+    result.errors++;
+    result.stop = std::chrono::steady_clock::now();
+  }
+
+  delete[] hostbuf_wr;
+  delete[] hostbuf_rd;
+  streams_done++;
+}  // End of DMAStream
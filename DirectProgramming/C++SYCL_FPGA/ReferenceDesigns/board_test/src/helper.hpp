@@ -38,6 +38,8 @@ void PrintHelp(int details) {
               << "  Windows: board_test.exe -test=<test_number>\n"
               << "  > To see more details on what each test does use"
               << " -help option\n"
+              << "  > To set the number of host threads used by test 7 "
+              << "(default 4), add the \"-threads=<n>\" option\n"
               << "The tests are:\n"
               << "  1. Host Speed and Host Read Write Test\n"
               << "  2. Kernel Clock Frequency Test\n"
@@ -45,6 +47,7 @@ void PrintHelp(int details) {
               << "  4. Kernel Latency Measurement\n"
               << "  5. Kernel-to-Memory Read Write Test\n"
               << "  6. Kernel-to-Memory Bandwidth Test\n"
+              << "  7. Host Transfer and Kernel Contention Test\n"
               << "Note: Kernel Clock Frequency is run along with all tests "
               << "except 1 (Host Speed and Host Read Write test)\n\n";
   } else {
@@ -86,6 +89,15 @@ void PrintHelp(int details) {
         << "bandwidth defined in board_spec.xml file in the oneAPI shim/BSP.\n\n"
         << "    Note: This test assumes that design was compiled with "
         << "-Xsno-interleaving option\n\n"
+        << "  * 7. Host Transfer and Kernel Contention Test *\n"
+        << "    Host Transfer and Kernel Contention test runs several host "
+        << "threads (set with -threads=<n>) that each write blocks of "
+        << "increasing size to device global memory and read them back, "
+        << "while a kernel reads and writes device global memory.\n"
+        << "    The test reports the aggregate and per-thread transfer "
+        << "throughput, the transfer latency percentiles for each block size "
+        << "and the kernel bandwidth, and compares them with the transfers "
+        << "and the kernel running alone\n\n"
         << "Please use the commands shown at the beginning of this help to run "
         << "all or one of the above tests\n\n";
   }
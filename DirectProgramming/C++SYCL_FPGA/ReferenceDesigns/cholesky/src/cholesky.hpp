@@ -13,6 +13,7 @@
 // Included from DirectProgramming/C++SYCL_FPGA/include/
 #include "streaming_cholesky.hpp"
 #include "tuple.hpp"
+#include "usm_pool.hpp"
 
 // Forward declare the kernel and pipe names
 // (This prevents unwanted name mangling in the optimization report.)
@@ -38,6 +39,7 @@ void CholeskyDecompositionImpl(
     std::vector<TT> &a_matrix,  // Input matrix A to decompose
     std::vector<TT> &l_matrix,  // Output matrix L
     sycl::queue &q,             // Device queue
+    fpga_tools::USMPool &device_pool, // Pool for the FPGA DDR buffers
     int matrix_count,           // Number of matrices to decompose
     int repetitions             // Number of repetitions, for performance
                                 // evaluation
@@ -53,9 +55,10 @@ void CholeskyDecompositionImpl(
   using LMatrixPipe =
       sycl::ext::intel::pipe<LPipe, TT, kNumElementsPerDDRBurst * 4>;
 
-  // Allocate FPGA DDR memory.
-  TT *a_device = sycl::malloc_device<TT>(kAMatrixSize * matrix_count, q);
-  TT *l_device = sycl::malloc_device<TT>(kLMatrixSize * matrix_count, q);
+  // Allocate FPGA DDR memory for the A and L matrices from the caller's pool
+  // (both are returned to it at the end of this function)
+  TT *a_device = device_pool.Allocate<TT>(kAMatrixSize * matrix_count);
+  TT *l_device = device_pool.Allocate<TT>(kLMatrixSize * matrix_count);
 
   if ((a_device == nullptr) || (l_device == nullptr)) {
     std::cerr << "Error when allocating FPGA DDR" << std::endl;
@@ -156,8 +159,8 @@ void CholeskyDecompositionImpl(
       .wait();
 
   // Clean allocated FPGA memory
-  free(a_device, q);
-  free(l_device, q);
+  device_pool.Deallocate(a_device);
+  device_pool.Deallocate(l_device);
 }
 
 #endif /* __CHOLESKY_HPP__ */
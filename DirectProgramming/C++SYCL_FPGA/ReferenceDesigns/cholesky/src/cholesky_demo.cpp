@@ -22,16 +22,18 @@
                  The vector will only contain the lower triangular elements
                  of the matrix, in a row by row fashion.
   - q:           The device queue.
+  - device_pool: The pool that provides the FPGA DDR buffers.
   - matrix_count: Number of matrices to decompose.
   - repetitions: The number of repetitions of the computation to execute.
                  (for performance evaluation)
 */
 template <typename T, bool is_complex>
 void CholeskyDecomposition(std::vector<T> &a_matrix, std::vector<T> &l_matrix,
-                           sycl::queue &q, int matrix_count, int repetitions) {
+                           sycl::queue &q, fpga_tools::USMPool &device_pool,
+                           int matrix_count, int repetitions) {
   CholeskyDecompositionImpl<MATRIX_DIMENSION, FIXED_ITERATIONS, is_complex,
-                            float>(a_matrix, l_matrix, q, matrix_count,
-                                   repetitions);
+                            float>(a_matrix, l_matrix, q, device_pool,
+                                   matrix_count, repetitions);
 }
 
 /*
@@ -191,8 +193,12 @@ int main(int argc, char *argv[]) {
               << (kMatricesToDecompose > 1 ? "ces " : "x ") << repetitions
               << " times" << std::endl;
 
-    CholeskyDecomposition<T, kComplex>(a_matrix, l_matrix, q,
-                                          kMatricesToDecompose, repetitions);
+    // main owns the device pool so that it can print the pool's allocation
+    // statistics once the decomposition has returned
+    fpga_tools::USMPool device_pool(q, sycl::usm::alloc::device);
+    CholeskyDecomposition<T, kComplex>(a_matrix, l_matrix, q, device_pool,
+                                       kMatricesToDecompose, repetitions);
+    device_pool.PrintStats(std::cout, "device");
 
     // For output post-processing (op)
     T l_matrix_op[kRows][kColumns];
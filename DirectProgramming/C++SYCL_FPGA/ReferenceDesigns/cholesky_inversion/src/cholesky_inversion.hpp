@@ -14,6 +14,7 @@
 #include "streaming_cholesky.hpp"
 #include "streaming_cholesky_inversion.hpp"
 #include "tuple.hpp"
+#include "usm_pool.hpp"
 
 // Forward declare the kernel and pipe names
 // (This prevents unwanted name mangling in the optimization report.)
@@ -44,6 +45,7 @@ void CholeskyInversionImpl(
     std::vector<TT> &a_matrix,  // Input matrix A to invert
     std::vector<TT> &i_matrix,  // Output matrix I (inverse of A)
     sycl::queue &q,             // Device queue
+    fpga_tools::USMPool &device_pool, // Pool for the FPGA DDR buffers
     int matrix_count,           // Number of matrices to invert
     int repetitions             // Number of repetitions, for performance
                                 // evaluation
@@ -61,9 +63,10 @@ void CholeskyInversionImpl(
   using IMatrixPipe =
       sycl::ext::intel::pipe<IPipe, TT, kNumElementsPerDDRBurst * 4>;
 
-  // Allocate FPGA DDR memory.
-  TT *a_device = sycl::malloc_device<TT>(kAMatrixSize * matrix_count, q);
-  TT *i_device = sycl::malloc_device<TT>(kIMatrixSize * matrix_count, q);
+  // Allocate FPGA DDR memory for the A and inverse matrices. They come from
+  // the caller's pool, which aligns them to 64 bytes.
+  TT *a_device = device_pool.Allocate<TT>(kAMatrixSize * matrix_count);
+  TT *i_device = device_pool.Allocate<TT>(kIMatrixSize * matrix_count);
 
   if ((a_device == nullptr) || (i_device == nullptr)) {
     std::cerr << "Error when allocating FPGA DDR" << std::endl;
@@ -125,8 +128,8 @@ void CholeskyInversionImpl(
       .wait();
 
   // Clean allocated FPGA memory
-  free(a_device, q);
-  free(i_device, q);
+  device_pool.Deallocate(a_device);
+  device_pool.Deallocate(i_device);
 }
 
 #endif /* __CHOLESKY_INVERSION_HPP__ */
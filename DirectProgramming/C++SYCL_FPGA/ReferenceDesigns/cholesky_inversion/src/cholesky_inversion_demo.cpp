@@ -24,16 +24,18 @@
   - a_matrix:    The input matrix.
   - i_matrix     The inverse matrix. The function will overwrite this matrix.
   - q:           The device queue.
+  - device_pool: The pool that provides the FPGA DDR buffers.
   - matrix_count: Number of matrices to invert.
   - repetitions: The number of repetitions of the computation to execute.
                  (for performance evaluation)
 */
 template <typename T, bool is_complex>
 void CholeskyInversion(std::vector<T> &a_matrix, std::vector<T> &i_matrix,
-                       sycl::queue &q, int matrix_count, int repetitions) {
+                       sycl::queue &q, fpga_tools::USMPool &device_pool,
+                       int matrix_count, int repetitions) {
   CholeskyInversionImpl<MATRIX_DIMENSION, FIXED_ITERATIONS_DECOMPOSITION,
                         FIXED_ITERATIONS_INVERSION, is_complex, float>(
-      a_matrix, i_matrix, q, matrix_count, repetitions);
+      a_matrix, i_matrix, q, device_pool, matrix_count, repetitions);
 }
 
 /*
@@ -395,8 +397,12 @@ int main(int argc, char *argv[]) {
               << " times" << std::endl;
 
     // Invert the matrices
-    CholeskyInversion<T, kComplex>(a_matrix, i_matrix, q, kMatricesToInvert,
-                                   repetitions);
+    // The A and I device buffers come from this pool, which is kept in main
+    // so that its statistics can be reported after the call
+    fpga_tools::USMPool device_pool(q, sycl::usm::alloc::device);
+    CholeskyInversion<T, kComplex>(a_matrix, i_matrix, q, device_pool,
+                                   kMatricesToInvert, repetitions);
+    device_pool.PrintStats(std::cout, "device");
 
     // Check the returned matrices for correctness
     return CheckResults<kMatricesToInvert, kAMatrixSize, kIMatrixSize, kRows,
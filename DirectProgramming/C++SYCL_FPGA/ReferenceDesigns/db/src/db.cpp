@@ -38,10 +38,18 @@ using namespace sycl;
 
 // include files depending on the query selected
 #if (QUERY == 1)
+#if defined(COMPRESSED_Q1)
+#include "query1/query1_compressed_kernel.hpp"
+bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
+              std::string& args, std::vector<unsigned char>& column_file,
+              bool test, bool print, double& kernel_latency,
+              double& total_latency);
+#else
 #include "query1/query1_kernel.hpp"
 bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
               std::string& args, bool test, bool print, double& kernel_latency,
               double& total_latency);
+#endif
 #elif (QUERY == 11)
 #include "query11/query11_kernel.hpp"
 bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
@@ -71,6 +79,12 @@ void Help() {
   std::cout << "\t--print   print the query results to stdout\n";
   std::cout << "\t--runs    how many iterations of the query to run\n";
   std::cout << "\t--help    print this help message\n";
+#if defined(COMPRESSED_Q1)
+  std::cout << "\t--colfile=<file>   the compressed Q1 column file to "
+               "query. If not given, it is built from the LINEITEM table\n";
+  std::cout << "\t--dumpcols=<file>  write the uncompressed Q1 column file "
+               "for the LINEITEM table to <file> and exit\n";
+#endif
   std::cout << "\n";
 
   std::cout << "Examples:\n";
@@ -126,6 +140,10 @@ int main(int argc, char* argv[]) {
 #endif
   bool print_result = false;
   bool need_help = false;
+#if defined(COMPRESSED_Q1)
+  std::string q1_colfile = "";
+  std::string q1_dumpcols = "";
+#endif
 
   // parse the command line arguments
   for (int i = 1; i < argc; i++) {
@@ -154,6 +172,12 @@ int main(int argc, char* argv[]) {
 #else
         // for emulation, allow a single iteration and don't add a 'warmup' run
         runs = std::max(1, atoi(str_after_equals.c_str()));
+#endif
+#if defined(COMPRESSED_Q1)
+      } else if (StrStartsWith(arg, "--colfile=")) {
+        q1_colfile = str_after_equals;
+      } else if (StrStartsWith(arg, "--dumpcols=")) {
+        q1_dumpcols = str_after_equals;
 #endif
       } else {
         std::cout << "WARNING: ignoring unknown argument '" << arg << "'\n";
@@ -212,6 +236,21 @@ int main(int argc, char* argv[]) {
       return 1;
     }
 
+#if defined(COMPRESSED_Q1)
+    // write the uncompressed Q1 column file, if requested, so that it can be
+    // compressed with an external tool (e.g., gzip or snzip)
+    if (!q1_dumpcols.empty()) {
+      return WriteQuery1ColumnFile(dbinfo, q1_dumpcols) ? 0 : 1;
+    }
+
+    // the compressed Q1 column file is read (or built) once for all runs
+    std::vector<unsigned char> q1_column_file;
+    if (!LoadQuery1ColumnFile(dbinfo, q1_colfile, q1_column_file)) {
+      std::cerr << "ERROR: couldn't load the Q1 column file\n";
+      return 1;
+    }
+#endif
+
     // track timing information for each run
     std::vector<double> total_latency(runs);
     std::vector<double> kernel_latency(runs);
@@ -220,7 +259,11 @@ int main(int argc, char* argv[]) {
     for (unsigned int run = 0; run < runs && success; run++) {
       // run the selected query
       if (query == 1) {
-#if (QUERY == 1)
+#if (QUERY == 1) && defined(COMPRESSED_Q1)
+        success = DoQuery1(q, dbinfo, db_root_dir, args, q1_column_file,
+                           test_query, print_result,
+                           kernel_latency[run], total_latency[run]);
+#elif (QUERY == 1)
         success = DoQuery1(q, dbinfo, db_root_dir, args,
                            test_query, print_result,
                            kernel_latency[run], total_latency[run]);
@@ -288,9 +331,16 @@ int main(int argc, char* argv[]) {
 }
 
 #if (QUERY == 1)
+#if defined(COMPRESSED_Q1)
+bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
+              std::string& args, std::vector<unsigned char>& column_file,
+              bool test, bool print, double& kernel_latency,
+              double& total_latency) {
+#else
 bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
               std::string& args, bool test, bool print, double& kernel_latency,
               double& total_latency) {
+#endif
   // NOTE: this is fixed based on the TPCH docs
   Date date = Date("1998-12-01");
   unsigned int DELTA = 90;
@@ -327,10 +377,19 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
                                        avg_discount = {0}, count = {0};
 
   // perform the query
+#if defined(COMPRESSED_Q1)
+  // the decompressed column file streams from the decompression engine
+  // straight into the query kernel
+  bool success = SubmitQuery1Compressed(
+      q, dbinfo, column_file, low_date_compact, sum_qty, sum_base_price,
+      sum_disc_price, sum_charge, avg_qty, avg_price, avg_discount, count,
+      kernel_latency, total_latency);
+#else
   bool success =
       SubmitQuery1(q, dbinfo, low_date_compact, sum_qty, sum_base_price,
                    sum_disc_price, sum_charge, avg_qty, avg_price, avg_discount,
                    count, kernel_latency, total_latency);
+#endif
 
   if (success) {
     // validate the results of the query, if requested
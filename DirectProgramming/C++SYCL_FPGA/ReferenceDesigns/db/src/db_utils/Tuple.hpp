@@ -1,5 +1,5 @@
-#ifndef __TUPLE_HPP__
-#define __TUPLE_HPP__
+#ifndef __DB_TUPLE_HPP__
+#define __DB_TUPLE_HPP__
 #pragma once
 
 #include <type_traits>
@@ -112,4 +112,4 @@ using make_NTuple =
 template <int N, typename Type>
 using NTuple = make_NTuple<N, Type>;
 
-#endif /* __TUPLE_HPP__ */
+#endif /* __DB_TUPLE_HPP__ */
@@ -0,0 +1,567 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+#include "constexpr_math.hpp"  // included from ../../../../include
+
+// the decompression engine, included from ../../../decompress/src
+#include "common/common.hpp"
+
+// ensure only one of GZIP and SNAPPY is defined
+#if defined(GZIP) and defined(SNAPPY)
+static_assert(false, "Only one of GZIP and SNAPPY can be defined!");
+#endif
+
+// if neither of GZIP and SNAPPY is defined, default to SNAPPY
+#if not defined(GZIP) and not defined(SNAPPY)
+#define SNAPPY
+#endif
+
+// the number of literals the decompression engine produces at once, with the
+// same defaults as the decompress reference design
+#if not defined(LITERALS_PER_CYCLE)
+#if defined(GZIP)
+#define LITERALS_PER_CYCLE 4
+#endif
+#if defined(SNAPPY)
+#define LITERALS_PER_CYCLE 8
+#endif
+#endif
+constexpr unsigned kLiteralsPerCycle = LITERALS_PER_CYCLE;
+static_assert(kLiteralsPerCycle > 0);
+static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
+
+#if defined(GZIP)
+#include "gzip/gzip_decompressor.hpp"
+#else
+#include "snappy/snappy_data_gen.hpp"
+#include "snappy/snappy_decompressor.hpp"
+#endif
+
+#include "query1_compressed_kernel.hpp"
+
+#include "../db_utils/Accumulator.hpp"
+
+using namespace std::chrono;
+
+// the kernel name
+class Query1Compressed;
+
+// the results of the query kernel
+struct Query1Result {
+  DBDecimal sum_qty[kQuery1OutSize];
+  DBDecimal sum_base_price[kQuery1OutSize];
+  DBDecimal sum_disc_price[kQuery1OutSize];
+  DBDecimal sum_charge[kQuery1OutSize];
+  DBDecimal avg_qty[kQuery1OutSize];
+  DBDecimal avg_price[kQuery1OutSize];
+  DBDecimal avg_discount[kQuery1OutSize];
+  DBDecimal count[kQuery1OutSize];
+  unsigned rows;  // the number of rows the kernel scanned
+};
+
+//
+// Reads a 'bytes' byte little-endian value starting at buf[offset]
+//
+template <typename T, unsigned bytes, size_t n>
+T ReadLittleEndian(const unsigned char (&buf)[n], unsigned offset) {
+  static_assert(bytes <= sizeof(T));
+  T ret = 0;
+#pragma unroll
+  for (unsigned i = 0; i < bytes; i++) {
+    ret |= T(buf[offset + i]) << (8 * i);
+  }
+  return ret;
+}
+
+//
+// Writes the 'bytes' byte little-endian value 'val' starting at buf[offset]
+//
+void WriteLittleEndian(std::vector<unsigned char>& buf, size_t offset,
+                       unsigned long long val, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; i++) {
+    buf[offset + i] = (val >> (8 * i)) & 0xFF;
+  }
+}
+
+//
+// The Query 1 kernel. It reads the decompressed Q1 column file from 'InPipe',
+// 'literals_per_cycle' bytes at a time, rebuilds the rows of the file (see
+// query1_compressed_kernel.hpp) and performs the same filter and aggregation
+// as the Query1 kernel in query1_kernel.cpp.
+//
+// The rows are kQuery1RowBytes bytes and are not aligned to the pipe width,
+// so the kernel stages the bytes in a small shift register: when it holds a
+// whole row, the row is processed and shifted out, and the next bytes from
+// the pipe are appended after the bytes that remain. As long as a row is
+// wider than the pipe, the buffer always has room for a read after a row is
+// processed, so the kernel reads from the pipe every cycle.
+//
+template <typename Id, typename InPipe, unsigned literals_per_cycle>
+event SubmitQuery1Scan(queue& q, DBDate low_date, Query1Result* result_ptr) {
+  // the shift register holds up to a row plus one read from the pipe
+  constexpr unsigned kBufBytes = kQuery1RowBytes + literals_per_cycle;
+  constexpr unsigned kBufCountBits = fpga_tools::Log2(kBufBytes) + 1;
+
+  return q.single_task<Id>([=]() [[intel::kernel_args_restrict]] {
+    // local accumulation buffers
+    RegisterAccumulator<DBDecimal, 6, unsigned char> sum_qty_local;
+    RegisterAccumulator<DBDecimal, 6, unsigned char> sum_base_price_local;
+    RegisterAccumulator<DBDecimal, 6, unsigned char> sum_disc_price_local;
+    RegisterAccumulator<DBDecimal, 6, unsigned char> sum_charge_local;
+    RegisterAccumulator<DBDecimal, 6, unsigned char> avg_discount_local;
+    RegisterAccumulator<DBDecimal, 6, unsigned char> count_local;
+
+    // initialize the accumulators
+    sum_qty_local.Init();
+    sum_base_price_local.Init();
+    sum_disc_price_local.Init();
+    sum_charge_local.Init();
+    avg_discount_local.Init();
+    count_local.Init();
+
+    [[intel::fpga_register]] unsigned char buf[kBufBytes];
+    ac_uint<kBufCountBits> buf_count = 0;
+    unsigned rows = 0;
+    bool input_done = false;
+
+    // stream in the decompressed bytes until the decompression engine is done
+    // and there are no more whole rows in the buffer
+    [[intel::initiation_interval(1)]]
+    while (!input_done || buf_count >= kQuery1RowBytes) {
+      // is there a whole row at the front of the buffer
+      bool have_row = buf_count >= kQuery1RowBytes;
+
+      // parse the row
+      DBDecimal qty = ReadLittleEndian<DBDecimal, 8>(buf, kQuery1QuantityOffset);
+      DBDecimal extendedprice =
+          ReadLittleEndian<DBDecimal, 8>(buf, kQuery1ExtendedPriceOffset);
+      DBDecimal discount =
+          ReadLittleEndian<DBDecimal, 8>(buf, kQuery1DiscountOffset);
+      DBDecimal tax = ReadLittleEndian<DBDecimal, 8>(buf, kQuery1TaxOffset);
+      DBDate shipdate = ReadLittleEndian<DBDate, 4>(buf, kQuery1ShipDateOffset);
+      char rf = buf[kQuery1ReturnFlagOffset];
+      char ls = buf[kQuery1LineStatusOffset];
+
+      // determine if the row is valid
+      bool row_valid = have_row && (shipdate <= low_date);
+      rows += have_row ? 1 : 0;
+
+      // convert returnflag and linestatus into an index
+      unsigned char rf_idx;
+      if (rf == 'R') {
+        rf_idx = 0;
+      } else if (rf == 'A') {
+        rf_idx = 1;
+      } else {  // == 'N'
+        rf_idx = 2;
+      }
+      unsigned char ls_idx;
+      if (ls == 'O') {
+        ls_idx = 0;
+      } else {  // == 'F'
+        ls_idx = 1;
+      }
+      unsigned char out_idx = ls_idx * kReturnFlagSize + rf_idx;
+
+      // intermediate calculations
+      DBDecimal disc_price_tmp = extendedprice * (100 - discount);
+      DBDecimal charge_tmp =
+          extendedprice * (100 - discount) * (100 + tax);
+
+      // reduction accumulation
+      sum_qty_local.Accumulate(out_idx, row_valid ? qty : 0);
+      sum_base_price_local.Accumulate(out_idx, row_valid ? extendedprice : 0);
+      sum_disc_price_local.Accumulate(out_idx, row_valid ? disc_price_tmp : 0);
+      sum_charge_local.Accumulate(out_idx, row_valid ? charge_tmp : 0);
+      count_local.Accumulate(out_idx, row_valid ? 1 : 0);
+      avg_discount_local.Accumulate(out_idx, row_valid ? discount : 0);
+
+      // shift the row out of the buffer
+      ac_uint<kBufCountBits> remaining =
+          have_row ? ac_uint<kBufCountBits>(buf_count - kQuery1RowBytes)
+                   : buf_count;
+#pragma unroll
+      for (unsigned i = 0; i < kBufBytes; i++) {
+        if (have_row) {
+          buf[i] = (i + kQuery1RowBytes < kBufBytes) ? buf[i + kQuery1RowBytes]
+                                                     : 0;
+        }
+      }
+
+      // append the next decompressed bytes after the remaining bytes, if they
+      // fit. When 'literals_per_cycle' is at most kQuery1RowBytes, they
+      // always fit.
+      if (!input_done && remaining <= kQuery1RowBytes) {
+        bool pipe_data_valid;
+        auto pipe_data = InPipe::read(pipe_data_valid);
+        if (pipe_data_valid) {
+          input_done = pipe_data.flag;
+          if (!pipe_data.flag) {
+#pragma unroll
+            for (unsigned i = 0; i < kBufBytes; i++) {
+#pragma unroll
+              for (unsigned j = 0; j < literals_per_cycle; j++) {
+                if (i == remaining + j && j < pipe_data.data.valid_count) {
+                  buf[i] = pipe_data.data[j];
+                }
+              }
+            }
+            remaining += pipe_data.data.valid_count;
+          }
+        }
+      }
+
+      buf_count = remaining;
+    }
+
+    // perform averages and push back to global memory
+#pragma unroll
+    for (size_t i = 0; i < kQuery1OutSize; i++) {
+      DBDecimal count = count_local.Get(i);
+
+      result_ptr->sum_qty[i] = sum_qty_local.Get(i);
+      result_ptr->sum_base_price[i] = sum_base_price_local.Get(i);
+      result_ptr->sum_disc_price[i] = sum_disc_price_local.Get(i);
+      result_ptr->sum_charge[i] = sum_charge_local.Get(i);
+
+      result_ptr->avg_qty[i] = (count == 0) ? 0 : (sum_qty_local.Get(i) / count);
+      result_ptr->avg_price[i] =
+          (count == 0) ? 0 : (sum_base_price_local.Get(i) / count);
+      result_ptr->avg_discount[i] =
+          (count == 0) ? 0 : (avg_discount_local.Get(i) / count);
+
+      result_ptr->count[i] = count;
+    }
+    result_ptr->rows = rows;
+  });
+}
+
+//
+// Packs the Q1 columns of the LINEITEM table into the (uncompressed) Q1
+// column file format
+//
+std::vector<unsigned char> PackQuery1Columns(Database& dbinfo) {
+  const size_t rows = dbinfo.l.rows;
+  std::vector<unsigned char> ret(rows * kQuery1RowBytes);
+
+  for (size_t r = 0; r < rows; r++) {
+    size_t row_offset = r * kQuery1RowBytes;
+    WriteLittleEndian(ret, row_offset + kQuery1QuantityOffset,
+                      dbinfo.l.quantity[r], 8);
+    WriteLittleEndian(ret, row_offset + kQuery1ExtendedPriceOffset,
+                      dbinfo.l.extendedprice[r], 8);
+    WriteLittleEndian(ret, row_offset + kQuery1DiscountOffset,
+                      dbinfo.l.discount[r], 8);
+    WriteLittleEndian(ret, row_offset + kQuery1TaxOffset, dbinfo.l.tax[r], 8);
+    WriteLittleEndian(ret, row_offset + kQuery1ShipDateOffset,
+                      dbinfo.l.shipdate[r], 4);
+    ret[row_offset + kQuery1ReturnFlagOffset] = dbinfo.l.returnflag[r];
+    ret[row_offset + kQuery1LineStatusOffset] = dbinfo.l.linestatus[r];
+  }
+
+  return ret;
+}
+
+#if defined(GZIP)
+//
+// Wraps 'data' in a GZIP file made of uncompressed (stored) DEFLATE blocks.
+// This is only used when no column file is given on the command line, to be
+// able to run the design without an external compressor. Real GZIP files
+// (e.g., from 'gzip') are smaller and also exercise the Huffman decoder.
+//
+std::vector<unsigned char> BuildGzipColumnFile(
+    const std::vector<unsigned char>& data) {
+  // the header: magic number, DEFLATE, no flags, no time, unknown OS
+  std::vector<unsigned char> ret = {0x1F, 0x8B, 0x08, 0x00, 0x00,
+                                    0x00, 0x00, 0x00, 0x00, 0xFF};
+
+  // stored blocks hold at most 65535 bytes, and there is always at least 1
+  constexpr size_t kMaxStoredBlockBytes = 65535;
+  size_t offset = 0;
+  do {
+    size_t block_bytes = std::min(data.size() - offset, kMaxStoredBlockBytes);
+    bool last_block = (offset + block_bytes == data.size());
+
+    // BFINAL and a BTYPE of 0, padded to a byte, followed by LEN and NLEN
+    size_t idx = ret.size();
+    ret.resize(idx + 5);
+    ret[idx] = last_block ? 1 : 0;
+    WriteLittleEndian(ret, idx + 1, block_bytes, 2);
+    WriteLittleEndian(ret, idx + 3, ~block_bytes & 0xFFFF, 2);
+    ret.insert(ret.end(), data.begin() + offset,
+               data.begin() + offset + block_bytes);
+
+    offset += block_bytes;
+  } while (offset < data.size());
+
+  // the footer: the CRC-32 and size of the uncompressed data
+  size_t idx = ret.size();
+  ret.resize(idx + 8);
+  WriteLittleEndian(ret, idx, SimpleCRC32(0, data.data(), data.size()), 4);
+  WriteLittleEndian(ret, idx + 4, data.size(), 4);
+
+  return ret;
+}
+#endif
+
+bool WriteQuery1ColumnFile(Database& dbinfo, const std::string& filename) {
+  auto data = PackQuery1Columns(dbinfo);
+  std::cout << "Writing the Q1 column file (" << dbinfo.l.rows << " rows, "
+            << data.size() << " bytes) to '" << filename << "'\n";
+  WriteOutputFile(filename, data);
+  return true;
+}
+
+bool LoadQuery1ColumnFile(Database& dbinfo, const std::string& filename,
+                          std::vector<unsigned char>& column_file) {
+  if (!filename.empty()) {
+    column_file = ReadInputFile(filename);
+    std::cout << "Read the compressed Q1 column file '" << filename << "' ("
+              << column_file.size() << " bytes)\n";
+  } else {
+    auto data = PackQuery1Columns(dbinfo);
+#if defined(GZIP)
+    column_file = BuildGzipColumnFile(data);
+#else
+    column_file = GenerateSnappyFramedData(data);
+#endif
+    std::cout << "Built the Q1 column file from the LINEITEM table ("
+              << data.size() << " bytes, " << column_file.size()
+              << " bytes compressed)\n";
+  }
+
+  if (column_file.empty()) {
+    std::cerr << "ERROR: the Q1 column file is empty\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool SubmitQuery1Compressed(
+    queue& q, Database& dbinfo, std::vector<unsigned char>& column_file,
+    DBDate low_date, std::array<DBDecimal, kQuery1OutSize>& sum_qty,
+    std::array<DBDecimal, kQuery1OutSize>& sum_base_price,
+    std::array<DBDecimal, kQuery1OutSize>& sum_disc_price,
+    std::array<DBDecimal, kQuery1OutSize>& sum_charge,
+    std::array<DBDecimal, kQuery1OutSize>& avg_qty,
+    std::array<DBDecimal, kQuery1OutSize>& avg_price,
+    std::array<DBDecimal, kQuery1OutSize>& avg_discount,
+    std::array<DBDecimal, kQuery1OutSize>& count, double& kernel_latency,
+    double& total_latency) {
+  const unsigned in_count = column_file.size();
+
+#if defined(GZIP)
+  // the producer streams the GZIP file in 1 byte at a time
+  constexpr unsigned kInBytesPerCycle = 1;
+  if (in_count < 18) {
+    std::cerr << "ERROR: the Q1 column file is too small to be a GZIP file\n";
+    return false;
+  }
+#else
+  // the producer streams the Snappy stream in 'kLiteralsPerCycle' bytes at
+  // a time. Find the number of data chunks if the stream is framed.
+  constexpr unsigned kInBytesPerCycle = kLiteralsPerCycle;
+  bool framed = IsSnappyFramed(column_file);
+  unsigned expected_out_count = 0;
+  unsigned chunk_count = 0;
+  if (framed && !ParseSnappyFrames(column_file, expected_out_count,
+                                   chunk_count)) {
+    return false;
+  }
+  unsigned max_chunks = std::max(chunk_count, 1U);
+#endif
+  const unsigned in_count_padded =
+      fpga_tools::RoundUpToMultiple(in_count, kInBytesPerCycle);
+
+  // allocate the device memory
+  unsigned char* in = malloc_device<unsigned char>(in_count_padded, q);
+  Query1Result* result = malloc_device<Query1Result>(1, q);
+#if defined(GZIP)
+  GzipHeaderData* hdr_data = malloc_device<GzipHeaderData>(1, q);
+  int* crc = malloc_device<int>(1, q);
+  int* out_count = malloc_device<int>(1, q);
+  if (in == nullptr || result == nullptr || hdr_data == nullptr ||
+      crc == nullptr || out_count == nullptr) {
+#else
+  SnappyChunkInfo* chunk_info = malloc_device<SnappyChunkInfo>(max_chunks, q);
+  SnappyReaderStatus* status = malloc_device<SnappyReaderStatus>(1, q);
+  if (in == nullptr || result == nullptr || chunk_info == nullptr ||
+      status == nullptr) {
+#endif
+    std::cerr << "ERROR: could not allocate device memory for Query 1\n";
+    std::terminate();
+  }
+
+  // start timer
+  high_resolution_clock::time_point host_start = high_resolution_clock::now();
+
+  // only the compressed column file is copied to the device
+  q.memcpy(in, column_file.data(), in_count).wait();
+
+  /////////////////////////////////////////////////////////////////////////////
+  //// Producer -> decompression engine -> Query1 kernel
+  auto producer_event = SubmitProducer<ProducerId, InPipe, kInBytesPerCycle>(
+      q, in_count_padded, in);
+#if defined(GZIP)
+  auto decompress_events =
+      SubmitGzipDecompressKernels<InPipe, OutPipe, kLiteralsPerCycle>(
+          q, in_count, hdr_data, crc, out_count);
+#else
+  auto decompress_events =
+      SubmitSnappyDecompressKernels<InPipe, OutPipe, kLiteralsPerCycle>(
+          q, in_count, framed, chunk_info, max_chunks, status);
+#endif
+  auto query_event =
+      SubmitQuery1Scan<Query1Compressed, OutPipe, kLiteralsPerCycle>(
+          q, low_date, result);
+  /////////////////////////////////////////////////////////////////////////////
+
+  // wait for the kernels to finish
+  producer_event.wait();
+  query_event.wait();
+  for (auto& e : decompress_events) {
+    e.wait();
+  }
+
+  // copy the results back from the device
+  Query1Result result_host;
+  q.memcpy(&result_host, result, sizeof(Query1Result)).wait();
+
+  high_resolution_clock::time_point host_end = high_resolution_clock::now();
+  duration<double, std::milli> diff = host_end - host_start;
+
+  // check the decompression engine's view of the stream
+  bool success = true;
+  size_t decompressed_bytes = (size_t)result_host.rows * kQuery1RowBytes;
+#if defined(GZIP)
+  // 'crc' and 'out_count' are the CRC-32 and size from the GZIP footer
+  GzipHeaderData hdr_data_host;
+  unsigned crc_host, out_count_host;
+  q.memcpy(&hdr_data_host, hdr_data, sizeof(GzipHeaderData)).wait();
+  q.memcpy(&crc_host, crc, sizeof(int)).wait();
+  q.memcpy(&out_count_host, out_count, sizeof(int)).wait();
+  if (hdr_data_host.MagicNumber() != 0x1f8b) {
+    std::cerr << "ERROR: the Q1 column file is not a GZIP file\n";
+    success = false;
+  }
+#else
+  SnappyReaderStatus status_host;
+  q.memcpy(&status_host, status, sizeof(SnappyReaderStatus)).wait();
+  unsigned out_count_host = status_host.uncompressed_count;
+  if (status_host.error) {
+    std::cerr << "ERROR: the Snappy Reader kernel found a malformed framed "
+              << "stream\n";
+    success = false;
+  }
+#endif
+  if (out_count_host != decompressed_bytes) {
+    std::cerr << "ERROR: the Q1 column file holds " << out_count_host
+              << " bytes, which is not " << result_host.rows << " rows of "
+              << kQuery1RowBytes << " bytes\n";
+    success = false;
+  }
+  if (result_host.rows != dbinfo.l.rows) {
+    std::cerr << "ERROR: the Q1 column file has " << result_host.rows
+              << " rows, but the LINEITEM table has " << dbinfo.l.rows
+              << " rows\n";
+    success = false;
+  }
+
+  // The decompressed bytes stream straight into the query kernel and never
+  // reach the host, so the CRCs of the column file are checked against the
+  // Q1 columns packed from the LINEITEM table, which the column file must
+  // have been built from
+#if defined(GZIP)
+  if (success) {
+    auto expected = PackQuery1Columns(dbinfo);
+    unsigned expected_crc = SimpleCRC32(0, expected.data(), expected.size());
+    if (crc_host != expected_crc) {
+      std::cerr << "ERROR: the CRC-32 in the GZIP footer (0x" << std::hex
+                << crc_host << ") does not match the Q1 columns of the "
+                << "LINEITEM table (0x" << expected_crc << ")" << std::dec
+                << "\n";
+      success = false;
+    }
+  }
+#else
+  if (success && framed) {
+    if (status_host.chunk_count != chunk_count) {
+      std::cerr << "ERROR: the Snappy Reader kernel found "
+                << status_host.chunk_count << " data chunks, not "
+                << chunk_count << "\n";
+      success = false;
+    } else if (chunk_count > 0) {
+      std::vector<SnappyChunkInfo> chunk_info_host(chunk_count);
+      q.memcpy(chunk_info_host.data(), chunk_info,
+               chunk_count * sizeof(SnappyChunkInfo))
+          .wait();
+
+      auto expected = PackQuery1Columns(dbinfo);
+      size_t offset = 0;
+      for (unsigned i = 0; i < chunk_count; i++) {
+        auto& info = chunk_info_host[i];
+        if (offset + info.uncompressed_count > expected.size()) {
+          std::cerr << "ERROR: Snappy chunk " << i << " runs past the end of "
+                    << "the Q1 columns of the LINEITEM table\n";
+          success = false;
+          break;
+        }
+        unsigned expected_crc = SnappyMaskedCRC32C(expected.data() + offset,
+                                                   info.uncompressed_count);
+        if (info.masked_crc != expected_crc) {
+          std::cerr << "ERROR: the CRC-32C of Snappy chunk " << i << " (0x"
+                    << std::hex << info.masked_crc << ") does not match the "
+                    << "Q1 columns of the LINEITEM table (0x" << expected_crc
+                    << ")" << std::dec << "\n";
+          success = false;
+        }
+        offset += info.uncompressed_count;
+      }
+    }
+  }
+#endif
+
+  std::copy_n(result_host.sum_qty, kQuery1OutSize, sum_qty.begin());
+  std::copy_n(result_host.sum_base_price, kQuery1OutSize,
+              sum_base_price.begin());
+  std::copy_n(result_host.sum_disc_price, kQuery1OutSize,
+              sum_disc_price.begin());
+  std::copy_n(result_host.sum_charge, kQuery1OutSize, sum_charge.begin());
+  std::copy_n(result_host.avg_qty, kQuery1OutSize, avg_qty.begin());
+  std::copy_n(result_host.avg_price, kQuery1OutSize, avg_price.begin());
+  std::copy_n(result_host.avg_discount, kQuery1OutSize, avg_discount.begin());
+  std::copy_n(result_host.count, kQuery1OutSize, count.begin());
+
+  // gather profiling info, from the start of the producer to the end of the
+  // query kernel
+  auto kernel_start_time =
+      producer_event.get_profiling_info<info::event_profiling::command_start>();
+  auto kernel_end_time =
+      query_event.get_profiling_info<info::event_profiling::command_end>();
+
+  // calculating the kernel execution time in ms
+  auto kernel_execution_time = (kernel_end_time - kernel_start_time) * 1e-6;
+
+  kernel_latency = kernel_execution_time;
+  total_latency = diff.count();
+
+  // free the device memory
+  free(in, q);
+  free(result, q);
+#if defined(GZIP)
+  free(hdr_data, q);
+  free(crc, q);
+  free(out_count, q);
+#else
+  free(chunk_info, q);
+  free(status, q);
+#endif
+
+  return success;
+}
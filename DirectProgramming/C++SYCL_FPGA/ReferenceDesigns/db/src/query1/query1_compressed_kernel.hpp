@@ -0,0 +1,61 @@
+#ifndef __QUERY1_COMPRESSED_KERNEL_HPP__
+#define __QUERY1_COMPRESSED_KERNEL_HPP__
+#pragma once
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include <string>
+#include <vector>
+
+#include "../dbdata.hpp"
+
+using namespace sycl;
+
+//
+// The Q1 column file holds the 7 columns of the LINEITEM table that Q1 reads.
+// The columns are interleaved row by row, so that a single decompression
+// engine can stream whole rows into the query kernel. Each row is a
+// kQuery1RowBytes byte record, with all values stored in little-endian order:
+//    bytes [0, 8):   quantity (DBDecimal)
+//    bytes [8, 16):  extendedprice (DBDecimal)
+//    bytes [16, 24): discount (DBDecimal)
+//    bytes [24, 32): tax (DBDecimal)
+//    bytes [32, 36): shipdate (DBDate, compact format)
+//    byte 36:        returnflag (char)
+//    byte 37:        linestatus (char)
+// The file is compressed with the format the design is compiled for: a GZIP
+// file (e.g., from 'gzip') or a raw or framed Snappy stream (e.g., from
+// 'snzip'), see the decompress reference design.
+//
+constexpr unsigned kQuery1QuantityOffset = 0;
+constexpr unsigned kQuery1ExtendedPriceOffset = 8;
+constexpr unsigned kQuery1DiscountOffset = 16;
+constexpr unsigned kQuery1TaxOffset = 24;
+constexpr unsigned kQuery1ShipDateOffset = 32;
+constexpr unsigned kQuery1ReturnFlagOffset = 36;
+constexpr unsigned kQuery1LineStatusOffset = 37;
+constexpr unsigned kQuery1RowBytes = 38;
+
+// writes the uncompressed Q1 column file for the LINEITEM table to 'filename'
+bool WriteQuery1ColumnFile(Database& dbinfo, const std::string& filename);
+
+// reads the compressed Q1 column file 'filename' into 'column_file'. If
+// 'filename' is empty, the column file is built from the LINEITEM table and
+// compressed on the host instead
+bool LoadQuery1ColumnFile(Database& dbinfo, const std::string& filename,
+                          std::vector<unsigned char>& column_file);
+
+bool SubmitQuery1Compressed(
+    queue& q, Database& dbinfo, std::vector<unsigned char>& column_file,
+    DBDate low_date, std::array<DBDecimal, kQuery1OutSize>& sum_qty,
+    std::array<DBDecimal, kQuery1OutSize>& sum_base_price,
+    std::array<DBDecimal, kQuery1OutSize>& sum_disc_price,
+    std::array<DBDecimal, kQuery1OutSize>& sum_charge,
+    std::array<DBDecimal, kQuery1OutSize>& avg_qty,
+    std::array<DBDecimal, kQuery1OutSize>& avg_price,
+    std::array<DBDecimal, kQuery1OutSize>& avg_discount,
+    std::array<DBDecimal, kQuery1OutSize>& count, double& kernel_latency,
+    double& total_latency);
+
+#endif  //__QUERY1_COMPRESSED_KERNEL_HPP__
@@ -11,6 +11,7 @@
 #include "common_metaprogramming.hpp"
 #include "constexpr_math.hpp"  // included from ../../../../include
 #include "memory_utils.hpp"    // included from ../../../../include
+#include "usm_pool.hpp"        // included from ../../../../include
 
 // we only use unsigned ac_ints in this design, so this alias lets us not write
 // the 'false' template argument every where
@@ -241,6 +242,13 @@ void WriteOutputFile(const std::string& filename,
 //
 class DecompressorBase {
  public:
+  //
+  // The device memory pool is bound to 'q', which must be the queue passed to
+  // every later call of DecompressBytes and DecompressFile.
+  //
+  explicit DecompressorBase(sycl::queue& q)
+      : device_pool_(q, sycl::usm::alloc::device) {}
+
   //
   // A virtual function that must be overriden by a deriving class.
   // The overriding function performs the actual decompression using the FPGA.
@@ -287,6 +295,24 @@ class DecompressorBase {
       return false;
     }
   }
+
+  //
+  // Prints the hit/miss and memory statistics of the device memory pool
+  //
+  void PrintPoolStats(std::ostream& os) const {
+    device_pool_.PrintStats(os, "device");
+  }
+
+ protected:
+  //
+  // The pool for the device memory used by DecompressBytes. It is shared by
+  // all calls to DecompressBytes, so repeated decompressions (e.g., of many
+  // files) reuse the same device allocations.
+  //
+  fpga_tools::USMPool& DevicePool() { return device_pool_; }
+
+ private:
+  fpga_tools::USMPool device_pool_;
 };
 
 //
@@ -1,19 +1,18 @@
 #ifndef __SIMPLE_CRC32_HPP__
 #define __SIMPLE_CRC32_HPP__
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace detail {
 //
-// A simple CRC-32 implementation (not optimized for high performance).
-// Compute CRC-32 on 'len' elements in 'buf', starting with a CRC of 'init'.
-//
-// Arguments:
-//    init: the initial CRC value. This is used to string together multiple
-//      calls to SimpleCRC32. For the first iteration, use 0.
-//    buf: a pointer to the data
-//    len: the number of bytes pointer to by 'buf'
+// Compute the CRC on 'len' elements in 'buf', starting with a CRC of 'init',
+// using the (reflected) 'polynomial'.
 //
-unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
+template <uint32_t polynomial>
+unsigned int SimpleCRC(unsigned init, const void* buf, size_t len) {
   // generate the 256-element table
-  constexpr uint32_t polynomial = 0xEDB88320;
   constexpr auto table = [] {
     std::array<uint32_t, 256> a{};
     for (uint32_t i = 0; i < 256; i++) {
@@ -30,7 +29,7 @@ unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
     return a;
   }();
 
-  // compute the CRC-32 for the input data
+  // compute the CRC for the input data
   unsigned c = init ^ 0xFFFFFFFF;
   const uint8_t* u = static_cast<const uint8_t*>(buf);
   for (size_t i = 0; i < len; i++) {
@@ -38,5 +37,28 @@ unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
   }
   return c ^ 0xFFFFFFFF;
 }
+}  // namespace detail
+
+//
+// A simple CRC-32 implementation (not optimized for high performance).
+// Compute CRC-32 on 'len' elements in 'buf', starting with a CRC of 'init'.
+//
+// Arguments:
+//    init: the initial CRC value. This is used to string together multiple
+//      calls to SimpleCRC32. For the first iteration, use 0.
+//    buf: a pointer to the data
+//    len: the number of bytes pointer to by 'buf'
+//
+unsigned int SimpleCRC32(unsigned init, const void* buf, size_t len) {
+  return detail::SimpleCRC<0xEDB88320>(init, buf, len);
+}
+
+//
+// Same as SimpleCRC32, but computes the CRC-32C (Castagnoli), which is the
+// CRC used by the Snappy framing format.
+//
+unsigned int SimpleCRC32C(unsigned init, const void* buf, size_t len) {
+  return detail::SimpleCRC<0x82F63B78>(init, buf, len);
+}
 
 #endif /* __SIMPLE_CRC32_HPP__ */
\ No newline at end of file
@@ -119,6 +119,8 @@ using OutPipe =
 template <unsigned literals_per_cycle>
 class GzipDecompressor : public DecompressorBase {
  public:
+  using DecompressorBase::DecompressorBase;
+
   std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue &q, std::vector<unsigned char> &in_bytes, int runs,
       bool print_stats) {
@@ -156,26 +158,28 @@ class GzipDecompressor : public DecompressorBase {
 
     bool passed = true;
 
+    // the pool for the device memory (see ../common/common.hpp)
+    auto &pool = DevicePool();
+
     try {
       // allocate memory on the device
-      if ((in = sycl::malloc_device<unsigned char>(in_count, q)) == nullptr) {
+      if ((in = pool.Allocate<unsigned char>(in_count)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_device<unsigned char>(out_count_padded, q)) ==
-          nullptr) {
+      if ((out = pool.Allocate<unsigned char>(out_count_padded)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
       }
-      if ((hdr_data = sycl::malloc_device<GzipHeaderData>(1, q)) == nullptr) {
+      if ((hdr_data = pool.Allocate<GzipHeaderData>(1)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'hdr_data'\n";
         std::terminate();
       }
-      if ((crc = sycl::malloc_device<int>(1, q)) == nullptr) {
+      if ((crc = pool.Allocate<int>(1)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'crc'\n";
         std::terminate();
       }
-      if ((count = sycl::malloc_device<int>(1, q)) == nullptr) {
+      if ((count = pool.Allocate<int>(1)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'count'\n";
         std::terminate();
       }
@@ -258,12 +262,12 @@ class GzipDecompressor : public DecompressorBase {
       std::terminate();
     }
 
-    // free the allocated device memory
-    sycl::free(in, q);
-    sycl::free(out, q);
-    sycl::free(hdr_data, q);
-    sycl::free(crc, q);
-    sycl::free(count, q);
+    // return the device memory to the pool
+    pool.Deallocate(in);
+    pool.Deallocate(out);
+    pool.Deallocate(hdr_data);
+    pool.Deallocate(crc);
+    pool.Deallocate(count);
 
     // print the performance results
     if (passed && print_stats) {
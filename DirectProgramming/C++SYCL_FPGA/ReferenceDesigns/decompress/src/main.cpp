@@ -57,12 +57,12 @@ static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
 // aliases and testing functions specific to GZIP and SNAPPY decompression
 #if defined(GZIP)
 using GzipDecompressorT = GzipDecompressor<kLiteralsPerCycle>;
-bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
+bool RunGzipTest(sycl::queue& q, GzipDecompressorT& decompressor,
                  const std::string test_dir);
 std::string decompressor_name = "GZIP";
 #else
 using SnappyDecompressorT = SnappyDecompressor<kLiteralsPerCycle>;
-bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
+bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT& decompressor,
                    const std::string test_dir);
 std::string decompressor_name = "SNAPPY";
 #endif
@@ -138,9 +138,9 @@ int main(int argc, char* argv[]) {
 
   // create the decompressor based on which decompression version we are using
 #if defined(GZIP)
-  GzipDecompressorT decompressor;
+  GzipDecompressorT decompressor(q);
 #else
-  SnappyDecompressorT decompressor;
+  SnappyDecompressorT decompressor(q);
 #endif
 
   // perform the test or single file decompression
@@ -157,6 +157,8 @@ int main(int argc, char* argv[]) {
                                          true, true);
   }
 
+  decompressor.PrintPoolStats(std::cout);
+
   if (passed) {
     std::cout << "PASSED" << std::endl;
     return 0;
@@ -177,7 +179,7 @@ void PrintTestResults(std::string test_name, bool passed) {
 }
 
 #if defined(GZIP)
-bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
+bool RunGzipTest(sycl::queue& q, GzipDecompressorT& decompressor,
                  const std::string test_dir) {
   // the name of the files for the default test are fixed
   std::string uncompressed_filename = test_dir + "/uncompressed.gz";
@@ -216,7 +218,7 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
 #endif
 
 #if defined(SNAPPY)
-bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
+bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT& decompressor,
                    const std::string test_dir) {
   std::cout << ">>>>> Alice In Wonderland Test <<<<<" << std::endl;
   std::string alice_in_file = test_dir + "/alice29.txt.sz";
@@ -231,6 +233,56 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
   PrintTestResults("Alice In Wonderland Test", alice_test_pass);
   std::cout << std::endl;
 
+  std::cout << ">>>>> CRC-32C Check Value Test <<<<<" << std::endl;
+  // the standard check value of CRC-32C (Castagnoli), which the framing
+  // format uses for its chunk checksums
+  bool crc_test_pass = SimpleCRC32C(0, "123456789", 9) == 0xE3069283;
+  PrintTestResults("CRC-32C Check Value Test", crc_test_pass);
+  std::cout << std::endl;
+
+  std::cout << ">>>>> Reference Framed Stream Test <<<<<" << std::endl;
+  // a small '.sz' file with a skippable chunk, a padding chunk, compressed
+  // chunks and an uncompressed chunk, built independently of
+  // GenerateSnappyFramedData
+  std::string framed_in_file = test_dir + "/framed.txt.sz";
+  auto framed_in_bytes = ReadInputFile(framed_in_file);
+  auto framed_file_ret =
+      decompressor.DecompressBytes(q, framed_in_bytes, 1, false);
+
+  std::string framed_ref_file = test_dir + "/framed.ref.txt";
+  auto framed_ref_bytes = ReadInputFile(framed_ref_file);
+  bool framed_file_test_pass = (framed_file_ret != std::nullopt) &&
+                               (framed_file_ret.value() == framed_ref_bytes);
+  PrintTestResults("Reference Framed Stream Test", framed_file_test_pass);
+  std::cout << std::endl;
+
+  std::cout << ">>>>> Framed Stream Test <<<<<" << std::endl;
+  auto framed_bytes = GenerateSnappyFramedData(ref_bytes);
+  auto framed_ret = decompressor.DecompressBytes(q, framed_bytes, 1, false);
+  bool framed_test_pass =
+      (framed_ret != std::nullopt) && (framed_ret.value() == ref_bytes);
+  PrintTestResults("Framed Stream Test", framed_test_pass);
+  std::cout << std::endl;
+
+  std::cout << ">>>>> Framed Uncompressed Chunks Test <<<<<" << std::endl;
+  // pseudo-random data does not compress, so it is stored in uncompressed
+  // chunks
+  std::vector<unsigned char> random_bytes(100000);
+  unsigned lfsr = 0xACE1u;
+  for (auto& b : random_bytes) {
+    lfsr ^= lfsr << 13;
+    lfsr ^= lfsr >> 17;
+    lfsr ^= lfsr << 5;
+    b = lfsr & 0xFF;
+  }
+  auto framed_random_bytes = GenerateSnappyFramedData(random_bytes);
+  auto framed_random_ret =
+      decompressor.DecompressBytes(q, framed_random_bytes, 1, false);
+  bool framed_random_test_pass = (framed_random_ret != std::nullopt) &&
+                                 (framed_random_ret.value() == random_bytes);
+  PrintTestResults("Framed Uncompressed Chunks Test", framed_random_test_pass);
+  std::cout << std::endl;
+
   std::cout << ">>>>> Only Literal Strings Test <<<<<" << std::endl;
   auto test1_bytes = GenerateSnappyCompressedData(333, 3, 0, 0, 3);
   auto test1_ret = decompressor.DecompressBytes(q, test1_bytes, 1, false);
@@ -265,6 +317,8 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
   PrintTestResults("Throughput Test", test_tp_pass);
   std::cout << std::endl;
 
-  return test1_pass && test2_pass && test3_pass && test_tp_pass;
+  return alice_test_pass && crc_test_pass && framed_file_test_pass &&
+         framed_test_pass && framed_random_test_pass && test1_pass &&
+         test2_pass && test3_pass && test_tp_pass;
 }
 #endif
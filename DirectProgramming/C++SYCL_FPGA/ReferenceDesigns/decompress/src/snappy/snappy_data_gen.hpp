@@ -1,8 +1,11 @@
 #ifndef __SNAPPY_DATA_GEN_HPP__
 #define __SNAPPY_DATA_GEN_HPP__
 
+#include <algorithm>
 #include <vector>
 
+#include "snappy_framing.hpp"
+
 //
 // A function to generate compressed Snappy data for testing purposes.
 // Generates a file as follows:
@@ -156,4 +159,159 @@ std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
   return ret;
 }
 
+//
+// A simple Snappy compressor for testing purposes (it is much slower and
+// compresses less than the reference compressor). Compresses the 'count'
+// bytes in 'data' to a raw Snappy block: a preamble followed by literal
+// strings and 2-byte offset copies found with a hash table of 4-byte
+// sequences.
+//
+std::vector<unsigned char> SnappyCompressBlock(const unsigned char* data,
+                                               unsigned count) {
+  std::vector<unsigned char> ret;
+
+  // the preamble: the uncompressed length varint
+  unsigned len = count;
+  do {
+    unsigned char b = len & 0x7F;
+    len >>= 7;
+    ret.push_back(b | ((len != 0) ? 0x80 : 0x00));
+  } while (len != 0);
+
+  // write the literal string data[start, end)
+  auto write_literals = [&](unsigned start, unsigned end) {
+    if (start == end) return;
+    unsigned lit_len_minus_1 = end - start - 1;
+    if (lit_len_minus_1 < 60) {
+      ret.push_back(lit_len_minus_1 << 2);
+    } else {
+      unsigned extra_bytes = 1;
+      while (extra_bytes < 4 && (lit_len_minus_1 >> (8 * extra_bytes)) != 0) {
+        extra_bytes++;
+      }
+      ret.push_back((60 + extra_bytes - 1) << 2);
+      for (unsigned i = 0; i < extra_bytes; i++) {
+        ret.push_back((lit_len_minus_1 >> (8 * i)) & 0xFF);
+      }
+    }
+    ret.insert(ret.end(), data + start, data + end);
+  };
+
+  // the hash table holds the last position of each hashed 4-byte sequence
+  constexpr unsigned kHashBits = 14;
+  constexpr unsigned kMaxOffset = 65535;
+  constexpr unsigned kMaxCopyLen = 64;
+  std::vector<int> table(1 << kHashBits, -1);
+  auto load32 = [&](unsigned i) {
+    return (unsigned)data[i] | ((unsigned)data[i + 1] << 8) |
+           ((unsigned)data[i + 2] << 16) | ((unsigned)data[i + 3] << 24);
+  };
+  auto hash = [&](unsigned i) {
+    return (load32(i) * 0x1E35A7BD) >> (32 - kHashBits);
+  };
+
+  unsigned literal_start = 0;
+  unsigned i = 0;
+  while (i + 4 <= count) {
+    unsigned h = hash(i);
+    int candidate = table[h];
+    table[h] = i;
+
+    if (candidate >= 0 && i - candidate <= kMaxOffset &&
+        load32(candidate) == load32(i)) {
+      // extend the match
+      unsigned match_len = 4;
+      while (i + match_len < count &&
+             data[candidate + match_len] == data[i + match_len]) {
+        match_len++;
+      }
+
+      write_literals(literal_start, i);
+
+      // write the match as copies with 2-byte offsets (at most 64 bytes each)
+      unsigned offset = i - candidate;
+      unsigned copy_left = match_len;
+      while (copy_left > 0) {
+        unsigned copy_len = std::min(copy_left, kMaxCopyLen);
+        ret.push_back(((copy_len - 1) << 2) | 2);
+        ret.push_back(offset & 0xFF);
+        ret.push_back((offset >> 8) & 0xFF);
+        copy_left -= copy_len;
+      }
+
+      i += match_len;
+      literal_start = i;
+    } else {
+      i++;
+    }
+  }
+  write_literals(literal_start, count);
+
+  return ret;
+}
+
+//
+// Generates a framed Snappy stream (see snappy_framing.hpp) for testing
+// purposes from the uncompressed 'data'. The data is split into chunks of
+// 'chunk_size' bytes. Like the reference compressor, a chunk is stored as
+// an uncompressed chunk if compressing it saves less than 12.5%. A padding
+// chunk and a reserved skippable chunk are added after the first data chunk
+// to test that the decompressor skips them.
+//
+std::vector<unsigned char> GenerateSnappyFramedData(
+    const std::vector<unsigned char>& data,
+    unsigned chunk_size = kSnappyMaxChunkUncompressedCount) {
+  if (chunk_size == 0 || chunk_size > kSnappyMaxChunkUncompressedCount) {
+    std::cerr << "ERROR: 'chunk_size' must be in the range [1, "
+              << kSnappyMaxChunkUncompressedCount << "]" << std::endl;
+    std::terminate();
+  }
+
+  std::vector<unsigned char> ret(
+      kSnappyStreamIdentifier,
+      kSnappyStreamIdentifier + kSnappyStreamIdentifierBytes);
+
+  // append a chunk with the given type, the masked CRC (only for data
+  // chunks) and the chunk data
+  auto write_chunk = [&](unsigned char type, const unsigned char* chunk_data,
+                         unsigned chunk_data_len, bool has_crc,
+                         unsigned crc) {
+    unsigned chunk_len = chunk_data_len + (has_crc ? kSnappyChunkCRCBytes : 0);
+    ret.push_back(type);
+    for (int i = 0; i < 3; i++) {
+      ret.push_back((chunk_len >> (8 * i)) & 0xFF);
+    }
+    if (has_crc) {
+      for (int i = 0; i < 4; i++) {
+        ret.push_back((crc >> (8 * i)) & 0xFF);
+      }
+    }
+    ret.insert(ret.end(), chunk_data, chunk_data + chunk_data_len);
+  };
+
+  for (size_t start = 0; start < data.size(); start += chunk_size) {
+    unsigned count = std::min((size_t)chunk_size, data.size() - start);
+    const unsigned char* chunk = data.data() + start;
+    unsigned crc = SnappyMaskedCRC32C(chunk, count);
+
+    auto compressed = SnappyCompressBlock(chunk, count);
+    if (compressed.size() < count - count / 8) {
+      write_chunk(kSnappyCompressedChunk, compressed.data(), compressed.size(),
+                  true, crc);
+    } else {
+      write_chunk(kSnappyUncompressedChunk, chunk, count, true, crc);
+    }
+
+    if (start == 0) {
+      const std::vector<unsigned char> skipped(7, 0xAB);
+      write_chunk(kSnappyPaddingChunk, skipped.data(), skipped.size(), false,
+                  0);
+      write_chunk(kSnappyFirstSkippableChunk, skipped.data(), skipped.size(),
+                  false, 0);
+    }
+  }
+
+  return ret;
+}
+
 #endif /* __SNAPPY_DATA_GEN_HPP__ */
\ No newline at end of file
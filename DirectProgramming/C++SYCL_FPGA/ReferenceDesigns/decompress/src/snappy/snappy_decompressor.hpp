@@ -2,6 +2,7 @@
 #define __SNAPPY_DECOMPRESSOR_HPP__
 
 #include <sycl/sycl.hpp>
+#include <algorithm>
 #include <chrono>
 #include <optional>
 #include <sycl/ext/intel/ac_types/ac_int.hpp>
@@ -12,6 +13,7 @@
 #include "../common/lz77_decoder.hpp"
 #include "constexpr_math.hpp"         // included from ../../../../include
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "snappy_framing.hpp"
 #include "snappy_reader.hpp"
 
 // declare the kernel and pipe names globally to reduce name mangling
@@ -39,12 +41,19 @@ class LZ77ToByteStackerPipeID;
 //  Arguments:
 //    q: the SYCL queue
 //    in_count: the number of compressed bytes
-//    preamble_count: an output buffer for the uncompressed size read in the
-//      Snappy preamble
+//    framed: whether the input is a framed Snappy stream (see
+//      snappy_framing.hpp) or a single raw Snappy block
+//    chunk_info: an output buffer for the CRC and size of each data chunk of
+//      a framed stream
+//    max_chunks: the number of elements in 'chunk_info'
+//    status: an output buffer for the results of the Snappy Reader kernel,
+//      i.e., the total uncompressed size and the number of data chunks
 //
 template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
 std::vector<sycl::event> SubmitSnappyDecompressKernels(
-    sycl::queue& q, unsigned in_count, unsigned* preamble_count) {
+    sycl::queue& q, unsigned in_count, bool framed,
+    SnappyChunkInfo* chunk_info, unsigned max_chunks,
+    SnappyReaderStatus* status) {
   // check that the input and output pipe types are actually pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -62,7 +71,8 @@ std::vector<sycl::event> SubmitSnappyDecompressKernels(
 
   auto snappy_reader_event =
       SubmitSnappyReader<SnappyReaderKernelID, InPipe, SnappyReaderToLZ77Pipe,
-                         literals_per_cycle>(q, in_count, preamble_count);
+                         literals_per_cycle>(q, in_count, framed, chunk_info,
+                                             max_chunks, status);
 
   // the design only needs a ByteStacker kernel when literals_per_cycle > 1
   if constexpr (literals_per_cycle > 1) {
@@ -101,10 +111,14 @@ using OutPipe =
 
 //
 // The SNAPPY decompressor. See ../common/common.hpp for more information.
+// The input is either a single raw Snappy block or a framed Snappy stream
+// (e.g., a '.sz' file), which is detected from its stream identifier.
 //
 template <unsigned literals_per_cycle>
 class SnappyDecompressor : public DecompressorBase {
  public:
+  using DecompressorBase::DecompressorBase;
+
   std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue& q, std::vector<unsigned char>& in_bytes, int runs,
       bool print_stats) {
@@ -113,23 +127,33 @@ class SnappyDecompressor : public DecompressorBase {
     int in_count_padded =
         fpga_tools::RoundUpToMultiple(in_count, kLiteralsPerCycle);
 
-    // read the expected output size from the start of the file
-    // this is used to size the output buffer
+    // read the expected output size, which is used to size the output
+    // buffer. For a raw Snappy block, it is in the preamble at the start of
+    // the file. For a framed stream, it is the sum of the sizes of the data
+    // chunks.
+    bool framed = IsSnappyFramed(in_bytes);
     unsigned out_count = 0;
-    unsigned byte_idx = 0;
-    unsigned shift = 0;
-    bool keep_reading_preamble = true;
-    while (keep_reading_preamble) {
-      if (byte_idx > 4) {
-        std::cerr << "ERROR: uncompressed length should not span more than 5"
-                  << " bytes\n";
-        std::terminate();
+    unsigned chunk_count = 0;
+    if (framed) {
+      if (!ParseSnappyFrames(in_bytes, out_count, chunk_count)) {
+        return {};
+      }
+    } else {
+      unsigned byte_idx = 0;
+      unsigned shift = 0;
+      bool keep_reading_preamble = true;
+      while (keep_reading_preamble) {
+        if (byte_idx > 4) {
+          std::cerr << "ERROR: uncompressed length should not span more than 5"
+                    << " bytes\n";
+          std::terminate();
+        }
+        auto b = in_bytes[byte_idx];
+        keep_reading_preamble = (b >> 7) & 0x1;
+        out_count |= (b & 0x7F) << shift;
+        shift += 7;
+        byte_idx += 1;
       }
-      auto b = in_bytes[byte_idx];
-      keep_reading_preamble = (b >> 7) & 0x1;
-      out_count |= (b & 0x7F) << shift;
-      shift += 7;
-      byte_idx += 1;
     }
 
     std::vector<unsigned char> out_bytes(out_count);
@@ -140,29 +164,40 @@ class SnappyDecompressor : public DecompressorBase {
         fpga_tools::RoundUpToMultiple(out_count, kLiteralsPerCycle);
 
     // host variables for output from device
-    unsigned preamble_count_host;
+    SnappyReaderStatus status_host;
+    std::vector<SnappyChunkInfo> chunk_info_host(chunk_count);
+
+    // the chunk info buffer must have at least 1 element to be allocated
+    unsigned max_chunks = std::max(chunk_count, 1U);
 
     // track timing information in ms
     std::vector<double> time(runs);
 
     // input and output data pointers on the device using USM device allocations
     unsigned char *in, *out;
-    unsigned* preamble_count;
+    SnappyChunkInfo* chunk_info;
+    SnappyReaderStatus* status;
+
+    // the pool for the device memory (see ../common/common.hpp)
+    auto& pool = DevicePool();
 
     try {
       // allocate memory on the device for the input and output
-      if ((in = sycl::malloc_device<unsigned char>(in_count_padded, q)) ==
-          nullptr) {
+      if ((in = pool.Allocate<unsigned char>(in_count_padded)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'in'\n";
         std::terminate();
       }
-      if ((out = sycl::malloc_device<unsigned char>(out_count_padded, q)) ==
-          nullptr) {
+      if ((out = pool.Allocate<unsigned char>(out_count_padded)) == nullptr) {
         std::cerr << "ERROR: could not allocate space for 'out'\n";
         std::terminate();
       }
-      if ((preamble_count = sycl::malloc_device<unsigned>(1, q)) == nullptr) {
-        std::cerr << "ERROR: could not allocate space for 'preamble_count'\n";
+      if ((chunk_info = pool.Allocate<SnappyChunkInfo>(max_chunks)) ==
+          nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'chunk_info'\n";
+        std::terminate();
+      }
+      if ((status = pool.Allocate<SnappyReaderStatus>(1)) == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'status'\n";
         std::terminate();
       }
 
@@ -185,7 +220,7 @@ class SnappyDecompressor : public DecompressorBase {
         // run the decompression kernels
         auto snappy_decompress_events =
             SubmitSnappyDecompressKernels<InPipe, OutPipe, kLiteralsPerCycle>(
-                q, in_count, preamble_count);
+                q, in_count, framed, chunk_info, max_chunks, status);
 
         // wait for the producer and consumer to finish
         auto s = std::chrono::high_resolution_clock::now();
@@ -206,26 +241,32 @@ class SnappyDecompressor : public DecompressorBase {
         // Copy the output back from the device
         q.memcpy(out_bytes.data(), out, out_count * sizeof(unsigned char))
             .wait();
-        q.memcpy(&preamble_count_host, preamble_count, sizeof(int)).wait();
+        q.memcpy(&status_host, status, sizeof(SnappyReaderStatus)).wait();
 
         // validating the output
         // check the number of bytes we read
-        if (preamble_count_host != out_count) {
-          std::cerr << "ERROR: Out counts do not match: " << preamble_count_host
-                    << " != " << out_count
-                    << " (preamble_count_host != out_count)\n";
+        if (status_host.uncompressed_count != out_count) {
+          std::cerr << "ERROR: Out counts do not match: "
+                    << status_host.uncompressed_count << " != " << out_count
+                    << " (status_host.uncompressed_count != out_count)\n";
           passed = false;
         }
+
+        if (framed) {
+          passed &= CheckChunks(q, status_host, chunk_info, chunk_info_host,
+                                out_bytes);
+        }
       }
     } catch (sycl::exception const& e) {
       std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
       std::terminate();
     }
 
-    // free the allocated device memory
-    sycl::free(in, q);
-    sycl::free(out, q);
-    sycl::free(preamble_count, q);
+    // return the device memory to the pool
+    pool.Deallocate(in);
+    pool.Deallocate(out);
+    pool.Deallocate(chunk_info);
+    pool.Deallocate(status);
 
     // print the performance results
     if (passed && print_stats) {
@@ -240,10 +281,11 @@ class SnappyDecompressor : public DecompressorBase {
       }
 
       double compression_ratio =
-          (double)(preamble_count_host) / (double)(in_count);
+          (double)(status_host.uncompressed_count) / (double)(in_count);
 
       // the number of input and output megabytes, respectively
-      size_t out_mb = preamble_count_host * sizeof(unsigned char) * 1e-6;
+      size_t out_mb =
+          status_host.uncompressed_count * sizeof(unsigned char) * 1e-6;
 
       std::cout << "Execution time: " << avg_time_ms << " ms\n";
       std::cout << "Output Throughput: " << (out_mb / (avg_time_ms * 1e-3))
@@ -258,6 +300,58 @@ class SnappyDecompressor : public DecompressorBase {
       return {};
     }
   }
+
+ private:
+  //
+  // Checks the results of the Snappy Reader kernel for a framed stream:
+  // copies the information of each data chunk back from the device and
+  // checks the masked CRC-32C of each chunk of the output data against it.
+  // Returns whether all checks pass.
+  //
+  bool CheckChunks(sycl::queue& q, const SnappyReaderStatus& status_host,
+                   SnappyChunkInfo* chunk_info,
+                   std::vector<SnappyChunkInfo>& chunk_info_host,
+                   std::vector<unsigned char>& out_bytes) {
+    if (status_host.error) {
+      std::cerr << "ERROR: the Snappy Reader kernel found a malformed framed "
+                << "stream\n";
+      return false;
+    }
+    if (status_host.chunk_count != chunk_info_host.size()) {
+      std::cerr << "ERROR: chunk counts do not match: "
+                << status_host.chunk_count << " != " << chunk_info_host.size()
+                << "\n";
+      return false;
+    }
+    if (chunk_info_host.empty()) {
+      return true;
+    }
+
+    q.memcpy(chunk_info_host.data(), chunk_info,
+             chunk_info_host.size() * sizeof(SnappyChunkInfo))
+        .wait();
+
+    bool passed = true;
+    size_t offset = 0;
+    for (size_t i = 0; i < chunk_info_host.size(); i++) {
+      auto& info = chunk_info_host[i];
+      if (offset + info.uncompressed_count > out_bytes.size()) {
+        std::cerr << "ERROR: chunk " << i << " runs past the end of the "
+                  << "output\n";
+        return false;
+      }
+      auto crc = SnappyMaskedCRC32C(out_bytes.data() + offset,
+                                    info.uncompressed_count);
+      if (crc != info.masked_crc) {
+        std::cerr << "ERROR: CRC of chunk " << i << " does not match the "
+                  << "expected CRC " << std::hex << "0x" << crc << " != 0x"
+                  << info.masked_crc << std::dec << "\n";
+        passed = false;
+      }
+      offset += info.uncompressed_count;
+    }
+    return passed;
+  }
 };
 
 #endif /* __SNAPPY_DECOMPRESSOR_HPP__ */
\ No newline at end of file
@@ -0,0 +1,191 @@
+#ifndef __SNAPPY_FRAMING_HPP__
+#define __SNAPPY_FRAMING_HPP__
+
+#include <iostream>
+#include <vector>
+
+#include "../common/simple_crc32.hpp"
+
+//
+// The Snappy framing format (the format of '.sz' files) wraps raw Snappy
+// blocks in a stream of chunks. Each chunk starts with a 1-byte chunk type
+// and a 3-byte little-endian length of the chunk data that follows. The
+// stream starts with a stream identifier chunk. The chunk types are:
+//    0x00: compressed data. A 4-byte masked CRC-32C of the uncompressed data
+//      followed by a raw Snappy block (preamble and compressed data stream).
+//    0x01: uncompressed data. A 4-byte masked CRC-32C of the data followed by
+//      the data itself.
+//    0x02-0x7F: reserved unskippable chunks (an error if found)
+//    0x80-0xFD: reserved skippable chunks
+//    0xFE: padding
+//    0xFF: stream identifier, the 6 bytes "sNaPpY"
+// Each data chunk holds at most 65536 bytes of uncompressed data.
+// See https://github.com/google/snappy/blob/main/framing_format.txt
+//
+constexpr unsigned char kSnappyCompressedChunk = 0x00;
+constexpr unsigned char kSnappyUncompressedChunk = 0x01;
+constexpr unsigned char kSnappyFirstSkippableChunk = 0x80;
+constexpr unsigned char kSnappyPaddingChunk = 0xFE;
+constexpr unsigned char kSnappyStreamIdentifierChunk = 0xFF;
+constexpr unsigned kSnappyChunkHeaderBytes = 4;
+constexpr unsigned kSnappyChunkCRCBytes = 4;
+constexpr unsigned kSnappyMaxChunkUncompressedCount = 65536;
+
+// the stream identifier chunk, including its header
+constexpr unsigned char kSnappyStreamIdentifier[] = {
+    kSnappyStreamIdentifierChunk, 0x06, 0x00, 0x00, 's', 'N', 'a', 'P', 'p',
+    'Y'};
+constexpr unsigned kSnappyStreamIdentifierBytes =
+    sizeof(kSnappyStreamIdentifier);
+
+//
+// The information the Snappy Reader kernel records for each data chunk of a
+// framed stream, which the host uses to verify the CRC of the chunk
+//
+struct SnappyChunkInfo {
+  unsigned masked_crc;          // the masked CRC-32C from the chunk
+  unsigned uncompressed_count;  // the number of uncompressed bytes
+};
+
+//
+// The results of the Snappy Reader kernel
+//
+struct SnappyReaderStatus {
+  // the total number of uncompressed bytes (i.e., the preamble count for a
+  // raw Snappy block)
+  unsigned uncompressed_count;
+  // the number of data chunks (only for a framed stream)
+  unsigned chunk_count;
+  // whether the reader found a malformed framed stream
+  bool error;
+};
+
+//
+// Masks a CRC as done by the Snappy framing format. The CRC is masked
+// because computing the CRC of data that includes CRCs is error prone.
+//
+unsigned MaskSnappyCRC(unsigned crc) {
+  return ((crc >> 15) | (crc << 17)) + 0xA282EAD8;
+}
+
+//
+// Returns the masked CRC-32C of 'len' bytes in 'buf'
+//
+unsigned SnappyMaskedCRC32C(const void* buf, size_t len) {
+  return MaskSnappyCRC(SimpleCRC32C(0, buf, len));
+}
+
+//
+// Returns whether 'in_bytes' is a framed Snappy stream, i.e., whether it
+// starts with the stream identifier chunk
+//
+bool IsSnappyFramed(const std::vector<unsigned char>& in_bytes) {
+  if (in_bytes.size() < kSnappyStreamIdentifierBytes) {
+    return false;
+  }
+  for (unsigned i = 0; i < kSnappyStreamIdentifierBytes; i++) {
+    if (in_bytes[i] != kSnappyStreamIdentifier[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Walks the chunk headers of the framed Snappy stream in 'in_bytes' to find
+// the total number of uncompressed bytes (used to size the output buffer) and
+// the number of data chunks. Only the chunk headers and the preambles of the
+// compressed chunks are read, the chunk data is decoded by the kernels.
+// Returns false if the stream is malformed.
+//
+bool ParseSnappyFrames(const std::vector<unsigned char>& in_bytes,
+                       unsigned& out_count, unsigned& chunk_count) {
+  out_count = 0;
+  chunk_count = 0;
+  size_t idx = 0;
+  while (idx < in_bytes.size()) {
+    if (in_bytes.size() - idx < kSnappyChunkHeaderBytes) {
+      std::cerr << "ERROR: truncated Snappy chunk header at byte " << idx
+                << "\n";
+      return false;
+    }
+    unsigned char chunk_type = in_bytes[idx];
+    unsigned chunk_len = (unsigned)in_bytes[idx + 1] |
+                         ((unsigned)in_bytes[idx + 2] << 8) |
+                         ((unsigned)in_bytes[idx + 3] << 16);
+    size_t data_idx = idx + kSnappyChunkHeaderBytes;
+    if (in_bytes.size() - data_idx < chunk_len) {
+      std::cerr << "ERROR: Snappy chunk at byte " << idx << " has length "
+                << chunk_len << ", which runs past the end of the stream\n";
+      return false;
+    }
+
+    if (chunk_type == kSnappyCompressedChunk) {
+      // the chunk must hold the CRC and at least 1 preamble byte
+      if (chunk_len <= kSnappyChunkCRCBytes) {
+        std::cerr << "ERROR: compressed Snappy chunk at byte " << idx
+                  << " is too short\n";
+        return false;
+      }
+
+      // read the preamble of the raw Snappy block in the chunk
+      size_t preamble_idx = data_idx + kSnappyChunkCRCBytes;
+      size_t chunk_end = data_idx + chunk_len;
+      unsigned count = 0;
+      unsigned shift = 0;
+      bool keep_reading_preamble = true;
+      while (keep_reading_preamble) {
+        if (preamble_idx == chunk_end || shift > 28) {
+          std::cerr << "ERROR: bad preamble in Snappy chunk at byte " << idx
+                    << "\n";
+          return false;
+        }
+        auto b = in_bytes[preamble_idx++];
+        keep_reading_preamble = (b >> 7) & 0x1;
+        count |= (b & 0x7F) << shift;
+        shift += 7;
+      }
+
+      if (count > kSnappyMaxChunkUncompressedCount) {
+        std::cerr << "ERROR: compressed Snappy chunk at byte " << idx
+                  << " holds " << count << " uncompressed bytes (maximum is "
+                  << kSnappyMaxChunkUncompressedCount << ")\n";
+        return false;
+      }
+      out_count += count;
+      chunk_count++;
+    } else if (chunk_type == kSnappyUncompressedChunk) {
+      if (chunk_len < kSnappyChunkCRCBytes ||
+          chunk_len - kSnappyChunkCRCBytes > kSnappyMaxChunkUncompressedCount) {
+        std::cerr << "ERROR: uncompressed Snappy chunk at byte " << idx
+                  << " has an invalid length (" << chunk_len << ")\n";
+        return false;
+      }
+      out_count += chunk_len - kSnappyChunkCRCBytes;
+      chunk_count++;
+    } else if (chunk_type == kSnappyStreamIdentifierChunk) {
+      // the stream identifier may be repeated (e.g., when streams are
+      // concatenated), it must always be the same
+      for (unsigned i = 0; i < kSnappyStreamIdentifierBytes; i++) {
+        if (in_bytes.size() - idx < kSnappyStreamIdentifierBytes ||
+            in_bytes[idx + i] != kSnappyStreamIdentifier[i]) {
+          std::cerr << "ERROR: bad Snappy stream identifier at byte " << idx
+                    << "\n";
+          return false;
+        }
+      }
+    } else if (chunk_type < kSnappyFirstSkippableChunk) {
+      std::cerr << "ERROR: reserved unskippable Snappy chunk type 0x"
+                << std::hex << (unsigned)chunk_type << std::dec << " at byte "
+                << idx << "\n";
+      return false;
+    }
+    // else, a padding or reserved skippable chunk, which is skipped
+
+    idx = data_idx + chunk_len;
+  }
+
+  return true;
+}
+
+#endif /* __SNAPPY_FRAMING_HPP__ */
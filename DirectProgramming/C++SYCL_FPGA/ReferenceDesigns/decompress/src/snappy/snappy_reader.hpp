@@ -6,67 +6,111 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "byte_stream.hpp"
+#include "snappy_framing.hpp"
 #include "constexpr_math.hpp"         // included from ../../../../include
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
 
 //
-// Streams in bytes from InPipe 'literals_per_cycle' at a time and
-// generates LZ77InputData (see ../common/common.hpp) to the OutPipe for the
-// LZ77Decoder kernel.
+// The input of the Snappy Reader: a stream of bytes that is filled from InPipe
+// 'literals_per_cycle' bytes at a time. It keeps track of whether all of the
+// 'in_count' bytes of the input have been read from the pipe, which is needed
+// to decode the last few bytes of the input.
 //
 //  Template parameters:
 //    InPipe: a SYCL pipe that streams in compressed Snappy data,
 //      'literals_per_cycle' bytes at a time.
+//    literals_per_cycle: the number of bytes read from InPipe at once.
+//
+template <typename InPipe, unsigned literals_per_cycle>
+class SnappyInputStream {
+ public:
+  // the maximum number of bytes to read at once is max(literals_per_cycle, 5),
+  // cases:
+  //    - reading the preamble length is 1...5 bytes
+  //    - reading a literal length can be 1...5 bytes
+  //    - reading a copy command can be 1...5 bytes
+  //    - reading literals can be 1...literals_per_cycle bytes
+  static constexpr unsigned kMaxReadBytes =
+      fpga_tools::Max(literals_per_cycle, 5U);
+
+  // the stream size should be double the maximum bytes we will need on each
+  // iteration so that we always have bytes ready
+  static constexpr unsigned kByteStreamSize = kMaxReadBytes * 2;
+
+  SnappyInputStream(unsigned in_count)
+      : in_count_(in_count),
+        data_read_(0),
+        all_data_read_(in_count == 0),
+        all_data_read_next_(literals_per_cycle >= in_count) {}
+
+  //
+  // read the next 'literals_per_cycle' bytes from InPipe, if there is space
+  // for them
+  //
+  void Fill() {
+    if (byte_stream_.Space() >= literals_per_cycle) {
+      bool valid_read;
+      auto pipe_data = InPipe::read(valid_read);
+      if (valid_read) {
+        byte_stream_.template Write(pipe_data);
+        data_read_ += literals_per_cycle;
+        all_data_read_ = all_data_read_next_;
+        all_data_read_next_ = (data_read_ + literals_per_cycle) >= in_count_;
+      }
+    }
+  }
+
+  // whether all of the input has been read from InPipe
+  bool AllDataRead() const { return all_data_read_; }
+
+  auto Count() { return byte_stream_.Count(); }
+
+  template <int read_n>
+  auto Read() const {
+    return byte_stream_.template Read<read_n>();
+  }
+
+  template <typename ShiftCountT>
+  void Shift(ShiftCountT s) {
+    byte_stream_.Shift(s);
+  }
+
+ private:
+  ByteStream<kByteStreamSize, kMaxReadBytes> byte_stream_;
+  unsigned in_count_;
+  unsigned data_read_;
+  bool all_data_read_, all_data_read_next_;
+};
+
+//
+// Decodes a raw Snappy block (a preamble followed by the compressed data
+// stream) of 'block_count' bytes from the input stream 'in' and writes
+// LZ77InputData (see ../common/common.hpp) to the OutPipe for the LZ77Decoder
+// kernel.
+//
+//  Template parameters:
 //    OutPipe: a SYCL pipe that streams out either an array of literals with
 //      a valid count (when reading a literal string) or a {length, distance}
 //      pair (when doing a copy), in the form of LZ77InputData data.
 //      This is the input the LZ77 decoder.
 //    literals_per_cycle: the maximum number of literals read from the input
 //      (and written to the output) at once.
+//    InStreamT: the type of the input stream (a SnappyInputStream)
 //
 //  Arguments:
-//    in_count: the number of compressed bytes
+//    in: the input stream
+//    block_count: the number of bytes in the raw Snappy block
 //
-template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
-unsigned SnappyReader(unsigned in_count) {
-  // ensure the InPipe and OutPipe are SYCL pipes
-  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
-  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
-
-  // the input and output pipe data types
-  using InPipeBundleT = decltype(InPipe::read());
+//  Returns the uncompressed length from the preamble of the block.
+//
+template <typename OutPipe, unsigned literals_per_cycle, typename InStreamT>
+unsigned ReadSnappyBlock(InStreamT& in, unsigned block_count) {
   using OutPipeBundleT = decltype(OutPipe::read());
 
-  // make sure the input and output types are correct
-  static_assert(std::is_same_v<InPipeBundleT, ByteSet<literals_per_cycle>>);
-  static_assert(
-      std::is_same_v<OutPipeBundleT,
-                     FlagBundle<SnappyLZ77InputData<literals_per_cycle>>>);
-
   // the number of bits to count to 'literals_per_cycle'
   constexpr unsigned literals_per_cycle_bits =
       fpga_tools::Log2(literals_per_cycle) + 1;
 
-  // the maximum number of bytes to read at once is max(literals_per_cycle, 5),
-  // cases:
-  //    - reading the preamble length is 1...5 bytes
-  //    - reading a literal length can be 1...5 bytes
-  //    - reading a copy command can be 1...5 bytes
-  //    - reading literals can be 1...literals_per_cycle bytes
-  constexpr unsigned kMaxReadBytes = fpga_tools::Max(literals_per_cycle, 5U);
-
-  // the stream size should be double the maximum bytes we will need on each
-  // iteration so that we always have bytes ready
-  // the maximum number of bytes we need is the maximum of 5 and
-  // literals_per_cycle
-  constexpr unsigned kByteStreamSize = kMaxReadBytes * 2;
-
-  // the byte stream
-  using ByteStreamT = ByteStream<kByteStreamSize, kMaxReadBytes>;
-  ByteStreamT byte_stream;
-
-  unsigned data_read_in_preamble = 0;
-
   // the first 1...5 bytes indicate the number of bytes in the stream
   bool reading_preamble = true;
   unsigned preamble_count_local = 0;
@@ -78,18 +122,13 @@ unsigned SnappyReader(unsigned in_count) {
   // this loop to be our Fmax bottleneck, so increase the II.
   [[intel::initiation_interval(3)]]  // NO-FORMAT: Attribute
   while (reading_preamble) {
-    if (byte_stream.Space() >= literals_per_cycle) {
-      bool valid_read;
-      auto pipe_data = InPipe::read(valid_read);
-      if (valid_read) {
-        byte_stream.template Write(pipe_data);
-        data_read_in_preamble += literals_per_cycle;
-      }
-    }
+    in.Fill();
 
-    if (byte_stream.Count() >= 5) {
+    // the preamble of a small block at the end of the input can be followed
+    // by fewer than 5 bytes
+    if (in.Count() >= 5 || in.AllDataRead()) {
       // grab the 5 bytes
-      auto first_five_bytes = byte_stream.template Read<5>();
+      auto first_five_bytes = in.template Read<5>();
 
       // the uncompressed length is in the range [0, 2^32) and is encoded with
       // a varint between 1 to 5 bytes. the top bit of each byte indicates
@@ -140,7 +179,7 @@ unsigned SnappyReader(unsigned in_count) {
 
       // shift the byte stream by however many we used and flag that we
       // are done reading the preamble
-      byte_stream.Shift(bytes_processed_in_preamble);
+      in.Shift(bytes_processed_in_preamble);
       reading_preamble = false;
     }
   }
@@ -149,22 +188,17 @@ unsigned SnappyReader(unsigned in_count) {
   bool reading_literal = false;
   unsigned literal_len_counter;
 
-  unsigned data_read = data_read_in_preamble;
-  bool all_data_read = data_read >= in_count;
-  bool all_data_read_next = data_read >= (in_count - literals_per_cycle);
-
-
   // keep track of the number of bytes processed
   constexpr unsigned max_bytes_processed_inc =
       fpga_tools::Max((unsigned)5, literals_per_cycle);
   unsigned bytes_processed_next[max_bytes_processed_inc + 1];
-  bool bytes_processed_in_range = true;
+  bool bytes_processed_in_range = bytes_processed_in_preamble < block_count;
   bool bytes_processed_in_range_next[max_bytes_processed_inc + 1];
 #pragma unroll
   for (int i = 0; i < max_bytes_processed_inc + 1; i++) {
     bytes_processed_next[i] = bytes_processed_in_preamble + i;
     bytes_processed_in_range_next[i] =
-        bytes_processed_in_preamble + i < in_count;
+        bytes_processed_in_preamble + i < block_count;
   }
 
   // the output data
@@ -175,26 +209,15 @@ unsigned SnappyReader(unsigned in_count) {
   // keep going while there is input to read, or data to read from byte_stream
   while (bytes_processed_in_range) {
     // grab new bytes if there is space
-    if (byte_stream.Space() >= literals_per_cycle) {
-
-      bool valid_read;
-      auto pipe_data = InPipe::read(valid_read);
-      if (valid_read) {
-        byte_stream.template Write(pipe_data);
-        data_read += literals_per_cycle;
-        all_data_read = all_data_read_next;
-        all_data_read_next = data_read >= (in_count - literals_per_cycle);
-
-      }
-    }
+    in.Fill();
 
     if (!reading_literal) {
       // finding the next command, which is either a literal string
       // or copy command. We will need at most 5 bytes to get the command
       // in a single iteration, so make sure we have enough bytes to do so
-      if (byte_stream.Count() >= 5 || all_data_read) {
+      if (in.Count() >= 5 || in.AllDataRead()) {
         // grab the next 5 bytes
-        auto five_bytes = byte_stream.template Read<5>();
+        auto five_bytes = in.template Read<5>();
 
         // what type of command is this, literal or copy?
         ac_uint<8> first_byte(five_bytes.byte[0]);
@@ -302,7 +325,7 @@ unsigned SnappyReader(unsigned in_count) {
         }
 
         // shift by however many bytes we used
-        byte_stream.Shift(bytes_used);
+        in.Shift(bytes_used);
 
         auto bytes_processed_next_val = bytes_processed_next[bytes_used];
         bytes_processed_in_range = bytes_processed_in_range_next[bytes_used];
@@ -310,7 +333,7 @@ unsigned SnappyReader(unsigned in_count) {
         for (int i = 0; i < max_bytes_processed_inc + 1; i++) {
           bytes_processed_next[i] = bytes_processed_next_val + i;
           bytes_processed_in_range_next[i] =
-              bytes_processed_next_val < in_count - i;
+              bytes_processed_next_val + i < block_count;
         }
       }
     } else {
@@ -329,7 +352,7 @@ unsigned SnappyReader(unsigned in_count) {
       }
 
       // reading literals from input stream
-      if (byte_stream.Count() >= amount_to_read) {
+      if (in.Count() >= amount_to_read) {
         // figure out how many literals will be valid
         // we can always subtract by 'literals_per_cycle' since this will only
         // go negative on the last iteration, which we detect with
@@ -340,7 +363,7 @@ unsigned SnappyReader(unsigned in_count) {
         reading_literal = still_reading_literal;
 
         // read the literals (we know we have enough)
-        auto literals = byte_stream.template Read<literals_per_cycle>();
+        auto literals = in.template Read<literals_per_cycle>();
 
         // build the output data
         out_data.is_literal = true;
@@ -352,7 +375,7 @@ unsigned SnappyReader(unsigned in_count) {
         out_ready = true;
 
         // shift the byte stream by however many (valid) literals we wrote
-        byte_stream.Shift(amount_to_read);
+        in.Shift(amount_to_read);
 
         auto bytes_processed_next_val = bytes_processed_next[amount_to_read];
         bytes_processed_in_range =
@@ -361,7 +384,7 @@ unsigned SnappyReader(unsigned in_count) {
         for (int i = 0; i < max_bytes_processed_inc + 1; i++) {
           bytes_processed_next[i] = bytes_processed_next_val + i;
           bytes_processed_in_range_next[i] =
-              bytes_processed_next_val < in_count - i;
+              bytes_processed_next_val + i < block_count;
         }
       }
     }
@@ -373,22 +396,238 @@ unsigned SnappyReader(unsigned in_count) {
     }
   }
 
+  // return the preamble count
+  return preamble_count_local;
+}
+
+//
+// Writes the 'count' bytes of an uncompressed chunk of a framed stream from
+// the input stream 'in' to OutPipe as literal strings.
+//
+template <typename OutPipe, unsigned literals_per_cycle, typename InStreamT>
+void ReadSnappyLiterals(InStreamT& in, unsigned count) {
+  using OutPipeBundleT = decltype(OutPipe::read());
+  constexpr unsigned literals_per_cycle_bits =
+      fpga_tools::Log2(literals_per_cycle) + 1;
+
+  unsigned literals_left = count;
+  while (literals_left != 0) {
+    in.Fill();
+
+    ac_uint<literals_per_cycle_bits> amount_to_read =
+        (literals_left < literals_per_cycle) ? literals_left
+                                             : literals_per_cycle;
+    if (in.Count() >= amount_to_read) {
+      auto literals = in.template Read<literals_per_cycle>();
+      SnappyLZ77InputData<literals_per_cycle> out_data;
+      out_data.is_literal = true;
+      out_data.valid_count = amount_to_read;
+#pragma unroll
+      for (int i = 0; i < literals_per_cycle; i++) {
+        out_data.literal[i] = literals.byte[i];
+      }
+      OutPipe::write(OutPipeBundleT(out_data));
+
+      in.Shift(amount_to_read);
+      literals_left -= amount_to_read;
+    }
+  }
+}
+
+//
+// Consumes and discards 'count' bytes from the input stream 'in'
+//
+template <typename InStreamT>
+void SkipSnappyBytes(InStreamT& in, unsigned count) {
+  constexpr unsigned kMaxSkip = InStreamT::kMaxReadBytes;
+  unsigned bytes_left = count;
+  while (bytes_left != 0) {
+    in.Fill();
+    unsigned amount = (bytes_left < kMaxSkip) ? bytes_left : kMaxSkip;
+    if (in.Count() >= amount) {
+      in.Shift(amount);
+      bytes_left -= amount;
+    }
+  }
+}
+
+//
+// Reads a 4-byte little-endian word from the input stream 'in'. Sets 'valid'
+// to false if the input ends before 4 bytes could be read.
+//
+template <typename InStreamT>
+unsigned ReadSnappyWord(InStreamT& in, bool& valid) {
+  unsigned word = 0;
+  bool done = false;
+  valid = false;
+
+  // like the preamble, this loop is not performance critical
+  [[intel::initiation_interval(3)]]  // NO-FORMAT: Attribute
+  while (!done) {
+    in.Fill();
+    if (in.Count() >= 4) {
+      auto bytes = in.template Read<4>();
+#pragma unroll
+      for (int i = 0; i < 4; i++) {
+        word |= (unsigned)(bytes.byte[i]) << (i * 8);
+      }
+      in.Shift(4);
+      valid = true;
+      done = true;
+    } else if (in.AllDataRead()) {
+      done = true;
+    }
+  }
+
+  return word;
+}
+
+//
+// Streams in bytes from InPipe 'literals_per_cycle' at a time and
+// generates LZ77InputData (see ../common/common.hpp) to the OutPipe for the
+// LZ77Decoder kernel.
+//
+// The input is either a single raw Snappy block or a framed Snappy stream
+// (see snappy_framing.hpp). The chunks of a framed stream are decoded back to
+// back: the chunk headers are parsed, the data of the compressed chunks is
+// decoded by ReadSnappyBlock, the data of the uncompressed chunks is
+// forwarded as literals and the other chunks are skipped. Since the data of
+// each chunk only references itself, the LZ77 decoder sees a single stream.
+// The masked CRC and the uncompressed size of each data chunk are written to
+// 'chunk_info_ptr' so that the host can verify the CRCs.
+//
+//  Template parameters:
+//    InPipe: a SYCL pipe that streams in compressed Snappy data,
+//      'literals_per_cycle' bytes at a time.
+//    OutPipe: a SYCL pipe that streams out either an array of literals with
+//      a valid count (when reading a literal string) or a {length, distance}
+//      pair (when doing a copy), in the form of LZ77InputData data.
+//      This is the input the LZ77 decoder.
+//    literals_per_cycle: the maximum number of literals read from the input
+//      (and written to the output) at once.
+//
+//  Arguments:
+//    in_count: the number of compressed bytes
+//    framed: whether the input is a framed Snappy stream
+//    chunk_info_ptr: output for the information of each data chunk (only for
+//      a framed stream)
+//    max_chunks: the number of elements in 'chunk_info_ptr'
+//
+template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
+SnappyReaderStatus SnappyReader(unsigned in_count, bool framed,
+                                SnappyChunkInfo* chunk_info_ptr,
+                                unsigned max_chunks) {
+  // ensure the InPipe and OutPipe are SYCL pipes
+  static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
+  static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
+
+  // the input and output pipe data types
+  using InPipeBundleT = decltype(InPipe::read());
+  using OutPipeBundleT = decltype(OutPipe::read());
+
+  // make sure the input and output types are correct
+  static_assert(std::is_same_v<InPipeBundleT, ByteSet<literals_per_cycle>>);
+  static_assert(
+      std::is_same_v<OutPipeBundleT,
+                     FlagBundle<SnappyLZ77InputData<literals_per_cycle>>>);
+
+  SnappyInputStream<InPipe, literals_per_cycle> in(in_count);
+
+  SnappyReaderStatus status;
+  status.uncompressed_count = 0;
+  status.chunk_count = 0;
+  status.error = false;
+
+  if (!framed) {
+    status.uncompressed_count =
+        ReadSnappyBlock<OutPipe, literals_per_cycle>(in, in_count);
+  } else {
+    sycl::device_ptr<SnappyChunkInfo> chunk_info(chunk_info_ptr);
+
+    // the number of bytes of the input that have not been consumed yet
+    unsigned bytes_left = in_count;
+
+    while (bytes_left != 0) {
+      // read the chunk header: a 1-byte type and a 3-byte length
+      bool header_valid;
+      unsigned header = ReadSnappyWord(in, header_valid);
+      unsigned char chunk_type = header & 0xFF;
+      unsigned chunk_len = header >> 8;
+
+      if (!header_valid || bytes_left < kSnappyChunkHeaderBytes) {
+        // the input ends in the middle of a chunk header
+        status.error = true;
+        bytes_left = 0;
+      } else if (chunk_len > bytes_left - kSnappyChunkHeaderBytes) {
+        // the chunk runs past the end of the input, consume the rest of the
+        // input so that the kernel feeding InPipe does not stall
+        status.error = true;
+        SkipSnappyBytes(in, bytes_left - kSnappyChunkHeaderBytes);
+        bytes_left = 0;
+      } else {
+        bytes_left -= kSnappyChunkHeaderBytes + chunk_len;
+
+        bool is_compressed = chunk_type == kSnappyCompressedChunk;
+        bool is_uncompressed = chunk_type == kSnappyUncompressedChunk;
+
+        // a compressed chunk must hold at least 1 byte after the CRC (the
+        // preamble), and an uncompressed chunk must hold the CRC
+        bool is_data_chunk = is_compressed || is_uncompressed;
+        bool data_chunk_len_valid =
+            (is_compressed && chunk_len > kSnappyChunkCRCBytes) ||
+            (is_uncompressed && chunk_len >= kSnappyChunkCRCBytes);
+
+        if (is_data_chunk && data_chunk_len_valid) {
+          bool crc_valid;
+          unsigned masked_crc = ReadSnappyWord(in, crc_valid);
+          unsigned data_len = chunk_len - kSnappyChunkCRCBytes;
+
+          unsigned count;
+          if (is_compressed) {
+            count = ReadSnappyBlock<OutPipe, literals_per_cycle>(in, data_len);
+          } else {
+            ReadSnappyLiterals<OutPipe, literals_per_cycle>(in, data_len);
+            count = data_len;
+          }
+
+          if (status.chunk_count < max_chunks) {
+            SnappyChunkInfo info;
+            info.masked_crc = masked_crc;
+            info.uncompressed_count = count;
+            chunk_info[status.chunk_count] = info;
+          }
+          status.chunk_count++;
+          status.uncompressed_count += count;
+        } else {
+          // chunk types 0x02-0x7F are reserved and unskippable, as are data
+          // chunks that are too short. Skip them anyway so that the rest of
+          // the input is consumed, but flag the error.
+          if (chunk_type < kSnappyFirstSkippableChunk) {
+            status.error = true;
+          }
+          SkipSnappyBytes(in, chunk_len);
+        }
+      }
+    }
+  }
+
   // notify downstream that we are done
   OutPipe::write(OutPipeBundleT(true));
 
-  // return the preamble count
-  return preamble_count_local;
+  return status;
 }
 
 template <typename Id, typename InPipe, typename OutPipe,
           unsigned literals_per_cycle>
-sycl::event SubmitSnappyReader(sycl::queue& q, unsigned in_count,
-                               unsigned* preamble_count_ptr) {
+sycl::event SubmitSnappyReader(sycl::queue& q, unsigned in_count, bool framed,
+                               SnappyChunkInfo* chunk_info_ptr,
+                               unsigned max_chunks,
+                               SnappyReaderStatus* status_ptr) {
   return q.single_task<Id>([=] {
-    sycl::device_ptr<unsigned> preamble_count(preamble_count_ptr);
-    *preamble_count =
-        SnappyReader<InPipe, OutPipe, literals_per_cycle>(in_count);
+    sycl::device_ptr<SnappyReaderStatus> status(status_ptr);
+    *status = SnappyReader<InPipe, OutPipe, literals_per_cycle>(
+        in_count, framed, chunk_info_ptr, max_chunks);
   });
 }
 
-#endif /* __SNAPPY_READER_HPP__ */
\ No newline at end of file
+#endif /* __SNAPPY_READER_HPP__ */
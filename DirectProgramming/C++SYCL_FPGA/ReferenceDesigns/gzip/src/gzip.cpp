@@ -11,6 +11,7 @@
 #include "kernels.hpp"
 
 #include "exception_handler.hpp"
+#include "usm_pool.hpp"
 
 
 using namespace sycl;
@@ -19,9 +20,14 @@ using namespace sycl;
 // Any filesize less than this results in an error.
 constexpr int minimum_filesize = kVec + 1;
 
+const int N_BUFFERING = 3;  // Number of sets of I/O buffers to
+                            // allocate, for the purpose of overlapping kernel
+                            // execution with buffer preparation.
+
 bool help = false;
 
-int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
+int CompressFile(queue &q, fpga_tools::USMPool &host_pool,
+                 std::string &input_file, std::vector<std::string> outfilenames,
                  int iterations, bool report);
 
 void Help(void) {
@@ -154,19 +160,33 @@ int main(int argc, char *argv[]) {
     std::cout << "Launching High-Bandwidth DMA GZIP application with " << kNumEngines
               << " engines\n";
 
+    // The pool for the host-side input and output buffers. It is shared by all
+    // calls to CompressFile() so the buffers are allocated (and pinned) once,
+    // rather than on every call.
+    // If the device is S10, we pre-pin the buffers to improve DMA performance,
+    // which is needed to achieve peak kernel throughput. Pre-pinning is only
+    // supported on the PAC-S10-USM BSP. It's not needed on PAC-A10 to achieve
+    // peak performance.
+#ifdef FPGA_SIMULATOR
+    fpga_tools::USMPool host_pool(q, usm::alloc::unknown);
+#else
+    fpga_tools::USMPool host_pool(q, usm::alloc::host);
+#endif
+
 #ifdef FPGA_EMULATOR
-    CompressFile(q, infilename, outfilenames, 1, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 1, true);
 #elif FPGA_SIMULATOR
-    CompressFile(q, infilename, outfilenames, 2, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 2, true);
 #else
     // warmup run - use this run to warmup accelerator. There are some steps in
     // the runtime that are only executed on the first kernel invocation but not
     // on subsequent invocations. So execute all that stuff here before we
     // measure performance (in the next call to CompressFile().
-    CompressFile(q, infilename, outfilenames, 1, false);
+    CompressFile(q, host_pool, infilename, outfilenames, 1, false);
     // profile performance
-    CompressFile(q, infilename, outfilenames, 200, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 200, true);
 #endif
+    host_pool.PrintStats(std::cout, "host");
   } catch (sycl::exception const &e) {
     // Catches exceptions in the host code
     std::cerr << "Caught a SYCL host exception:\n" << e.what() << "\n";
@@ -191,7 +211,6 @@ struct KernelInfo {
   buffer<unsigned, 1> *current_crc;
   buffer<char, 1> *pobuf;
   buffer<char, 1> *pibuf;
-  char *pobuf_decompress;
 
   uint32_t buffer_crc[kMinBufferSize];
   uint32_t refcrc;
@@ -205,7 +224,8 @@ struct KernelInfo {
 };
 
 // returns 0 on success, otherwise a non-zero failure code.
-int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
+int CompressFile(queue &q, fpga_tools::USMPool &host_pool,
+                 std::string &input_file, std::vector<std::string> outfilenames,
                  int iterations, bool report) {
   size_t isz;
   char *pinbuf;
@@ -214,18 +234,10 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
   std::string device_string =
       q.get_device().get_info<info::device::name>().c_str();
 
-  // If
-  // the device is S10, we pre-pin some buffers to
-  // improve DMA performance, which is needed to
-  // achieve peak kernel throughput. Pre-pinning is
-  // only supported on the PAC-S10-USM BSP. It's not
-  // needed on PAC-A10 to achieve peak performance.
+  // The buffers from 'host_pool' are pre-pinned if the device supports USM
+  // host allocations (see main()).
   bool isS10 =  (device_string.find("s10") != std::string::npos);
-#ifdef FPGA_SIMULATOR
-  bool prepin = false;
-#else
-  bool prepin = q.get_device().has(aspect::usm_host_allocations);
-#endif
+  bool prepin = host_pool.Pinned();
 
   if (isS10 && !prepin) {
     std::cout << "Warning: Host allocations are not supported on this platform, which means that pre-pinning is not supported. DMA transfers may be slower than expected which may reduce application throughput.\n\n";
@@ -239,11 +251,10 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
                      std::ios::in | std::ios::binary | std::ios::ate);
   if (file.is_open()) {
     isz = file.tellg();
-    if (prepin) {
-      pinbuf = (char *)malloc_host(
-          isz + kInOutPadding, q.get_context());  // Pre-pin the buffer, for faster DMA
-    } else {                      // throughput, using malloc_host().
-      pinbuf = new char[isz + kInOutPadding];
+    pinbuf = host_pool.Allocate<char>(isz + kInOutPadding);
+    if (pinbuf == nullptr) {
+      std::cout << "Cannot allocate input buffer.\n";
+      return 1;
     }
     file.seekg(0, std::ios::beg);
     file.read(pinbuf, isz);
@@ -256,6 +267,7 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
   if (isz < minimum_filesize) {
     std::cout << "Minimum filesize for compression is " << minimum_filesize
               << "\n";
+    host_pool.Deallocate(pinbuf);
     return 1;
   }
 
@@ -281,16 +293,14 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
                                                    : (isz + kInOutPadding);
       const size_t input_alloc_size = isz + kInOutPadding;
 
-      // Pre-pin buffer using malloc_host() to improve DMA bandwidth.
-      if (i >= 3) {
-        kinfo[eng][i].poutput_buffer = kinfo[eng][i - 3].poutput_buffer;
+      // Only allocate N_BUFFERING output buffers and reuse them on subsequent
+      // iterations. The buffers come from the (pre-pinned) host pool to
+      // improve DMA bandwidth.
+      if (i >= N_BUFFERING) {
+        kinfo[eng][i].poutput_buffer =
+            kinfo[eng][i - N_BUFFERING].poutput_buffer;
       } else {
-        if (prepin) {
-          kinfo[eng][i].poutput_buffer =
-              (char *)malloc_host(outputSize, q.get_context());
-        } else {
-          kinfo[eng][i].poutput_buffer = (char *)malloc(outputSize);
-        }
+        kinfo[eng][i].poutput_buffer = host_pool.Allocate<char>(outputSize);
 
         std::cout << "outputSize: " << outputSize << " Prepin: "
                 << prepin << "\n";
@@ -310,17 +320,17 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
       kinfo[eng][i].pref_buffer = pinbuf;
 
       kinfo[eng][i].gzip_out_buf =
-          i >= 3 ? kinfo[eng][i - 3].gzip_out_buf
+          i >= N_BUFFERING ? kinfo[eng][i - N_BUFFERING].gzip_out_buf
                  : new buffer<struct GzipOutInfo, 1>(kMinBufferSize);
-      kinfo[eng][i].current_crc = i >= 3
-                                      ? kinfo[eng][i - 3].current_crc
+      kinfo[eng][i].current_crc = i >= N_BUFFERING
+                                      ? kinfo[eng][i - N_BUFFERING].current_crc
                                       : new buffer<unsigned, 1>(kMinBufferSize);
-      kinfo[eng][i].pibuf = i >= 3
-                                ? kinfo[eng][i - 3].pibuf
+      kinfo[eng][i].pibuf = i >= N_BUFFERING
+                                ? kinfo[eng][i - N_BUFFERING].pibuf
                                 : new buffer<char, 1>(input_alloc_size);
       kinfo[eng][i].pobuf =
-          i >= 3 ? kinfo[eng][i - 3].pobuf : new buffer<char, 1>(outputSize);
-      kinfo[eng][i].pobuf_decompress = (char *)malloc(kinfo[eng][i].file_size);
+          i >= N_BUFFERING ? kinfo[eng][i - N_BUFFERING].pobuf
+                           : new buffer<char, 1>(outputSize);
     }
   }
 
@@ -428,13 +438,9 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
     }
   }
 
-  // delete the file mapping now that all kernels are complete, and we've
-  // snapped the time delta
-  if (prepin) {
-    free(pinbuf, q.get_context());
-  } else {
-    delete pinbuf;
-  }
+  // return the input buffer to the pool now that all kernels are complete,
+  // and we've snapped the time delta
+  host_pool.Deallocate(pinbuf);
 
   // Write the output compressed data from the first iteration of each engine, to a file.
   for (int eng = 0; eng < kNumEngines; eng++) {
@@ -506,18 +512,13 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
   // Cleanup anything that was allocated by this routine.
   for (int eng = 0; eng < kNumEngines; eng++) {
     for (int i = 0; i < buffers_count; i++) {
-      if (i < 3) {
+      if (i < N_BUFFERING) {
         delete kinfo[eng][i].gzip_out_buf;
         delete kinfo[eng][i].current_crc;
         delete kinfo[eng][i].pibuf;
         delete kinfo[eng][i].pobuf;
-        if (prepin) {
-          free(kinfo[eng][i].poutput_buffer, q.get_context());
-        } else {
-          free(kinfo[eng][i].poutput_buffer);
-        }
+        host_pool.Deallocate(kinfo[eng][i].poutput_buffer);
       }
-      free(kinfo[eng][i].pobuf_decompress);
     }
     free(kinfo[eng]);
   }
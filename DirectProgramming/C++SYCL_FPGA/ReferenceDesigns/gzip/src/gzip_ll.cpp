@@ -11,6 +11,7 @@
 #include "kernels.hpp"
 
 #include "exception_handler.hpp"
+#include "usm_pool.hpp"
 
 
 using namespace sycl;
@@ -26,7 +27,8 @@ const int N_BUFFERING = 2;  // Number of sets of I/O buffers to
 
 bool help = false;
 
-int CompressFile(queue &q, std::string &input_file,
+int CompressFile(queue &q, fpga_tools::USMPool &host_pool,
+                 std::string &input_file,
                  std::vector<std::string> outfilenames, int iterations,
                  bool report);
 
@@ -160,19 +162,25 @@ int main(int argc, char *argv[]) {
     std::cout << "Launching Low-Latency GZIP application with " << kNumEngines
               << " engines\n";
 
+    // The pool for the host-side USM buffers that are accessed by the
+    // kernels. It is shared by all calls to CompressFile() so the buffers are
+    // allocated (and pinned) once, rather than on every call.
+    fpga_tools::USMPool host_pool(q, usm::alloc::host);
+
 #ifdef FPGA_EMULATOR
-    CompressFile(q, infilename, outfilenames, 10, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 10, true);
 #elif FPGA_SIMULATOR
-    CompressFile(q, infilename, outfilenames, 2, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 2, true);
 #else
     // warmup run - use this run to warmup accelerator. There are some steps in
     // the runtime that are only executed on the first kernel invocation but not
     // on subsequent invocations. So execute all that stuff here before we
     // measure performance (in the next call to CompressFile().
-    CompressFile(q, infilename, outfilenames, 1, false);
+    CompressFile(q, host_pool, infilename, outfilenames, 1, false);
     // profile performance
-    CompressFile(q, infilename, outfilenames, 200, true);
+    CompressFile(q, host_pool, infilename, outfilenames, 200, true);
 #endif
+    host_pool.PrintStats(std::cout, "host");
   } catch (sycl::exception const &e) {
     // Catches exceptions in the host code
     std::cerr << "Caught a SYCL host exception:\n" << e.what() << "\n";
@@ -212,19 +220,13 @@ struct KernelInfo {
 };
 
 // returns 0 on success, otherwise a non-zero failure code.
-int CompressFile(queue &q, std::string &input_file,
+int CompressFile(queue &q, fpga_tools::USMPool &host_pool,
+                 std::string &input_file,
                  std::vector<std::string> outfilenames, int iterations,
                  bool report) {
   size_t isz;
   char *pinbuf;
 
-  auto dev = q.get_device();
-  auto ctxt = q.get_context();
-  usm_allocator<GzipOutInfo, usm::alloc::host> alloc_GzipOutInfo(ctxt, dev);
-  usm_allocator<unsigned, usm::alloc::host> alloc_unsigned(ctxt, dev);
-  usm_allocator<char *, usm::alloc::host> alloc_char_ptr(ctxt, dev);
-  usm_allocator<char, usm::alloc::host> alloc_char(ctxt, dev);
-
   // Read the input file
   std::string device_string =
       q.get_device().get_info<info::device::name>().c_str();
@@ -236,7 +238,7 @@ int CompressFile(queue &q, std::string &input_file,
   // only supported on the PAC-S10-USM BSP. It's not
   // needed on PAC-A10 to achieve peak performance.
   bool isS10 = (device_string.find("s10") != std::string::npos);
-  bool prepin = q.get_device().has(aspect::usm_host_allocations);
+  bool prepin = host_pool.Pinned();
 
   if (isS10 && !prepin) {
     std::cout << "Warning: Host allocations are not supported on this "
@@ -253,11 +255,10 @@ int CompressFile(queue &q, std::string &input_file,
                      std::ios::in | std::ios::binary | std::ios::ate);
   if (file.is_open()) {
     isz = file.tellg();
-    if (prepin) {
-      pinbuf = (char *)malloc_host(
-          isz + kInOutPadding, q.get_context());  // Pre-pin the buffer, for faster DMA
-    } else {                      // throughput, using malloc_host().
-      pinbuf = new char[isz + kInOutPadding];
+    pinbuf = host_pool.Allocate<char>(isz + kInOutPadding);
+    if (pinbuf == nullptr) {
+      std::cout << "Cannot allocate input buffer.\n";
+      return 1;
     }
     file.seekg(0, std::ios::beg);
     file.read(pinbuf, isz);
@@ -304,12 +305,11 @@ int CompressFile(queue &q, std::string &input_file,
       // subsequent iterations.
       kinfo[eng][i].gzip_out_buf =
           i >= N_BUFFERING ? kinfo[eng][i - N_BUFFERING].gzip_out_buf
-                           : alloc_GzipOutInfo.allocate(BATCH_SIZE *
-                                                        sizeof(GzipOutInfo));
+                           : host_pool.Allocate<GzipOutInfo>(BATCH_SIZE);
       kinfo[eng][i].current_crc =
           i >= N_BUFFERING
               ? kinfo[eng][i - N_BUFFERING].current_crc
-              : alloc_unsigned.allocate(BATCH_SIZE * sizeof(uint32_t));
+              : host_pool.Allocate<uint32_t>(BATCH_SIZE);
 
       for (int b = 0; b < BATCH_SIZE; b++) {
         kinfo[eng][i].current_crc[b] = 0;
@@ -321,11 +321,11 @@ int CompressFile(queue &q, std::string &input_file,
       kinfo[eng][i].pibuf_ptr_array =
           i >= N_BUFFERING
               ? kinfo[eng][i - N_BUFFERING].pibuf_ptr_array
-              : alloc_char_ptr.allocate(BATCH_SIZE * sizeof(char *));
+              : host_pool.Allocate<char *>(BATCH_SIZE);
       kinfo[eng][i].pobuf_ptr_array =
           i >= N_BUFFERING
               ? kinfo[eng][i - N_BUFFERING].pobuf_ptr_array
-              : alloc_char_ptr.allocate(BATCH_SIZE * sizeof(char *));
+              : host_pool.Allocate<char *>(BATCH_SIZE);
 
       // For each pointer, allocated space for the input/output buffers
       if (i <
@@ -333,9 +333,9 @@ int CompressFile(queue &q, std::string &input_file,
                           // since the buffers get subsequently reused.
         for (int b = 0; b < BATCH_SIZE; b++) {
           kinfo[eng][i].pibuf_ptr_array[b] =
-              alloc_char.allocate(input_alloc_size * sizeof(char));
+              host_pool.Allocate<char>(input_alloc_size);
           kinfo[eng][i].pobuf_ptr_array[b] =
-              alloc_char.allocate(kinfo[eng][i].output_size * sizeof(char));
+              host_pool.Allocate<char>(kinfo[eng][i].output_size);
           memset(kinfo[eng][i].pobuf_ptr_array[b], 0,
                  kinfo[eng][i].output_size);  // Initialize output buf to zero.
         }
@@ -560,33 +560,23 @@ int CompressFile(queue &q, std::string &input_file,
 
   // delete the file mapping now that all kernels are complete, and we've
   // snapped the time delta
-  if (prepin) {
-    free(pinbuf, q.get_context());
-  } else {
-    delete pinbuf;
-  }
+  host_pool.Deallocate(pinbuf);
 
   for (int eng = 0; eng < kNumEngines; eng++) {
     for (int i = 0; i < buffers_count; i++) {
       if (i < N_BUFFERING) {
-        alloc_GzipOutInfo.deallocate(kinfo[eng][i].gzip_out_buf,
-                                     BATCH_SIZE * sizeof(GzipOutInfo));
-        alloc_unsigned.deallocate(kinfo[eng][i].current_crc,
-                                  BATCH_SIZE * sizeof(uint32_t));
+        host_pool.Deallocate(kinfo[eng][i].gzip_out_buf);
+        host_pool.Deallocate(kinfo[eng][i].current_crc);
 
-        // dealloc the input buffers
+        // return the input and output buffers to the pool
         for (int b = 0; b < BATCH_SIZE; b++) {
-          alloc_char.deallocate(kinfo[eng][i].pibuf_ptr_array[b],
-                                kinfo[eng][i].input_size * sizeof(char));
-          alloc_char.deallocate(kinfo[eng][i].pobuf_ptr_array[b],
-                                kinfo[eng][i].output_size * sizeof(char));
+          host_pool.Deallocate(kinfo[eng][i].pibuf_ptr_array[b]);
+          host_pool.Deallocate(kinfo[eng][i].pobuf_ptr_array[b]);
         }
 
-        // dealloc the array of input buffer pointers
-        alloc_char_ptr.deallocate(kinfo[eng][i].pibuf_ptr_array,
-                                  BATCH_SIZE * sizeof(char *));
-        alloc_char_ptr.deallocate(kinfo[eng][i].pobuf_ptr_array,
-                                  BATCH_SIZE * sizeof(char *));
+        // return the arrays of input and output buffer pointers to the pool
+        host_pool.Deallocate(kinfo[eng][i].pibuf_ptr_array);
+        host_pool.Deallocate(kinfo[eng][i].pobuf_ptr_array);
       }
     }
     delete[] kinfo[eng];
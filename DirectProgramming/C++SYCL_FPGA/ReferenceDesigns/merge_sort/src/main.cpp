@@ -16,6 +16,7 @@
 
 // Included from DirectProgramming/C++SYCL_FPGA/include/
 #include "constexpr_math.hpp"
+#include "usm_pool.hpp"
 
 using namespace sycl;
 using namespace std::chrono;
@@ -53,7 +54,8 @@ static_assert(fpga_tools::IsPow2(kSortWidth));
 ////////////////////////////////////////////////////////////////////////////////
 // Forward declare functions used in this file by main()
 template <typename ValueT, typename IndexT, typename KernelPtrType>
-double FPGASort(queue &q, ValueT *in_vec, ValueT *out_vec, IndexT count);
+double FPGASort(queue &q, fpga_tools::USMPool &device_pool, ValueT *in_vec,
+                ValueT *out_vec, IndexT count);
 
 template <typename T>
 bool Validate(T *val, T *ref, unsigned int count);
@@ -154,16 +156,23 @@ int main(int argc, char *argv[]) {
   std::copy(in_vec.begin(), in_vec.end(), ref.begin());
   std::sort(ref.begin(), ref.end());
 
+  // The pools for the input/output data and for the merge sort's temporary
+  // buffers. The temporary buffers are requested on every run of the sort,
+  // so the pool allocates them only once and reuses them for later runs.
+  fpga_tools::USMPool io_pool(q, kUseUSMHostAllocation ? usm::alloc::host
+                                                       : usm::alloc::device);
+  fpga_tools::USMPool device_pool(q, usm::alloc::device);
+
   // allocate the input and output data either in USM host or device allocations
   ValueT *in, *out;
   if constexpr (kUseUSMHostAllocation) {
     // using USM host allocations
-    if ((in = malloc_host<ValueT>(count, q)) == nullptr) {
+    if ((in = io_pool.Allocate<ValueT>(count)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'in' using "
                 << "malloc_host\n";
       std::terminate();
     }
-    if ((out = malloc_host<ValueT>(count, q)) == nullptr) {
+    if ((out = io_pool.Allocate<ValueT>(count)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'out' using "
                 << "malloc_host\n";
       std::terminate();
@@ -179,12 +188,12 @@ int main(int argc, char *argv[]) {
     std::fill(out, out + count, ValueT(0));
   } else {
     // using device allocations
-    if ((in = malloc_device<ValueT>(count, q)) == nullptr) {
+    if ((in = io_pool.Allocate<ValueT>(count)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'in' using "
                 << "malloc_device\n";
       std::terminate();
     }
-    if ((out = malloc_device<ValueT>(count, q)) == nullptr) {
+    if ((out = io_pool.Allocate<ValueT>(count)) == nullptr) {
       std::cerr << "ERROR: could not allocate space for 'out' using "
                 << "malloc_device\n";
       std::terminate();
@@ -213,7 +222,8 @@ int main(int argc, char *argv[]) {
     // run the sort multiple times to increase the accuracy of the timing
     for (int i = 0; i < runs; i++) {
       // run the sort
-      time[i] = FPGASort<ValueT, IndexT, KernelPtrType>(q, in, out, count);
+      time[i] = FPGASort<ValueT, IndexT, KernelPtrType>(q, device_pool, in,
+                                                        out, count);
 
       // Copy the output to 'out_vec'. In the case where we are using USM host
       // allocations this is unnecessary since we could simply deference
@@ -230,9 +240,10 @@ int main(int argc, char *argv[]) {
     std::terminate();
   }
 
-  // free the memory allocated with malloc_host or malloc_device
-  sycl::free(in, q);
-  sycl::free(out, q);
+  // return the input and output memory to the pool
+  io_pool.Deallocate(in);
+  io_pool.Deallocate(out);
+  device_pool.PrintStats(std::cout, "device");
 
   // print the performance results
   if (passed) {
@@ -265,7 +276,8 @@ class SortOutPipeID;
 // perform the actual sort on the FPGA.
 //
 template <typename ValueT, typename IndexT, typename KernelPtrType>
-double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
+double FPGASort(queue &q, fpga_tools::USMPool &device_pool, ValueT *in_ptr,
+                ValueT *out_ptr, IndexT count) {
   // the input and output pipe for the sorter
   using SortInPipe =
       sycl::ext::intel::pipe<SortInPipeID, sycl::vec<ValueT, kSortWidth>>;
@@ -279,11 +291,11 @@ double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
 
   // allocate some memory for the merge sort to use as temporary storage
   ValueT *buf_0, *buf_1;
-  if ((buf_0 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
+  if ((buf_0 = device_pool.Allocate<ValueT>(sorter_count)) == nullptr) {
     std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
     std::terminate();
   }
-  if ((buf_1 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
+  if ((buf_1 = device_pool.Allocate<ValueT>(sorter_count)) == nullptr) {
     std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
     std::terminate();
   }
@@ -362,9 +374,9 @@ double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
     e.wait();
   }
 
-  // free the memory allocated for the merge sort temporary buffers
-  sycl::free(buf_0, q);
-  sycl::free(buf_1, q);
+  // return the merge sort temporary buffers to the pool for the next run
+  device_pool.Deallocate(buf_0);
+  device_pool.Deallocate(buf_1);
 
   // return the duration of the sort in milliseconds, excluding memory transfers
   duration<double, std::milli> diff = end - start;
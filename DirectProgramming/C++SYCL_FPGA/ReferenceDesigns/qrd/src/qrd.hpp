@@ -14,6 +14,7 @@
 #include "memory_transfers.hpp"
 #include "streaming_qrd.hpp"
 #include "tuple.hpp"
+#include "usm_pool.hpp"
 
 // Forward declare the kernel and pipe names
 // (This prevents unwanted name mangling in the optimization report.)
@@ -43,6 +44,7 @@ void QRDecompositionImpl(
   std::vector<TT> &q_matrix, // Output matrix Q
   std::vector<TT> &r_matrix, // Output matrix R
   sycl::queue &q,            // Device queue
+  fpga_tools::USMPool &device_pool, // Pool for the FPGA DDR buffers
   int matrix_count,          // Number of matrices to decompose
   int repetitions           // Number of repetitions, for performance evaluation
 ) {
@@ -60,10 +62,11 @@ void QRDecompositionImpl(
   using RMatrixPipe = sycl::ext::intel::pipe<RPipe, TT,
                                                   kNumElementsPerDDRBurst * 4>;
 
-  // Allocate FPGA DDR memory.
-  TT *a_device = sycl::malloc_device<TT>(kAMatrixSize * matrix_count, q);
-  TT *q_device = sycl::malloc_device<TT>(kQMatrixSize * matrix_count, q);
-  TT *r_device = sycl::malloc_device<TT>(kRMatrixSize * matrix_count, q);
+  // Allocate FPGA DDR memory. The A, Q and R buffers are taken from
+  // device_pool and handed back to it once Q and R have been copied out.
+  TT *a_device = device_pool.Allocate<TT>(kAMatrixSize * matrix_count);
+  TT *q_device = device_pool.Allocate<TT>(kQMatrixSize * matrix_count);
+  TT *r_device = device_pool.Allocate<TT>(kRMatrixSize * matrix_count);
 
   q.memcpy(a_device, a_matrix.data(), kAMatrixSize * matrix_count
                                                           * sizeof(TT)).wait();
@@ -137,9 +140,9 @@ void QRDecompositionImpl(
                                                           * sizeof(TT)).wait();
 
   // Clean allocated FPGA memory
-  free(a_device, q);
-  free(q_device, q);
-  free(r_device, q);
+  device_pool.Deallocate(a_device);
+  device_pool.Deallocate(q_device);
+  device_pool.Deallocate(r_device);
 }
 
 #endif /* __QRD_HPP__ */
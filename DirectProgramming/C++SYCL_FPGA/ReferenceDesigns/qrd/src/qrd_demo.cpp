@@ -31,6 +31,7 @@
                  The vector will only contain the upper triangular elements
                  of the matrix, in a row by row fashion.
   - q:           The device queue.
+  - device_pool: The pool that provides the FPGA DDR buffers.
   - matrix_count: Number of matrices to decompose.
   - repetitions: The number of repetitions of the computation to execute.
                  (for performance evaluation)
@@ -39,24 +40,26 @@
 // Real single precision floating-point QR Decomposition
 void QRDecomposition(std::vector<float> &a_matrix, std::vector<float> &q_matrix,
                      std::vector<float> &r_matrix, sycl::queue &q,
-                     int matrix_count,
+                     fpga_tools::USMPool &device_pool, int matrix_count,
                      int repetitions) {
   constexpr bool is_complex = false;
   QRDecompositionImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS,
                        is_complex, float>(a_matrix, q_matrix, r_matrix, q,
-                                          matrix_count, repetitions);
+                                          device_pool, matrix_count,
+                                          repetitions);
 }
 #else
 // Complex single precision floating-point QR Decomposition
 void QRDecomposition(std::vector<ac_complex<float> > &a_matrix,
                      std::vector<ac_complex<float> > &q_matrix,
                      std::vector<ac_complex<float> > &r_matrix, sycl::queue &q,
-                     int matrix_count,
+                     fpga_tools::USMPool &device_pool, int matrix_count,
                      int repetitions) {
   constexpr bool is_complex = true;
   QRDecompositionImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS,
                        is_complex, float>(a_matrix, q_matrix, r_matrix, q,
-                                          matrix_count, repetitions);
+                                          device_pool, matrix_count,
+                                          repetitions);
 }
 #endif
 
@@ -192,8 +195,12 @@ int main(int argc, char *argv[]) {
               << " matri" << (kMatricesToDecompose > 1 ? "ces " : "x ")
               << repetitions << " times" << std::endl;
 
-    QRDecomposition(a_matrix, q_matrix, r_matrix, q, kMatricesToDecompose,
-                                                                  repetitions);
+    // The pool lives here rather than in QRDecomposition so that its
+    // statistics can be printed after the call
+    fpga_tools::USMPool device_pool(q, sycl::usm::alloc::device);
+    QRDecomposition(a_matrix, q_matrix, r_matrix, q, device_pool,
+                    kMatricesToDecompose, repetitions);
+    device_pool.PrintStats(std::cout, "device");
 
     // For output post-processing (op)
     T q_matrix_op[kRows][kColumns];
@@ -14,6 +14,7 @@
 #include "streaming_qrd.hpp"
 #include "streaming_qri.hpp"
 #include "tuple.hpp"
+#include "usm_pool.hpp"
 
 // Forward declare the kernel and pipe names
 // (This prevents unwanted name mangling in the optimization report.)
@@ -43,6 +44,7 @@ void QRIImpl(
     std::vector<TT> &a_matrix,       // Input matrix to inverse
     std::vector<TT> &inverse_matrix, // Output inverse matrix
     sycl::queue &q,                  // Device queue
+    fpga_tools::USMPool &device_pool, // Pool for the FPGA DDR buffers
     size_t matrix_count,             // Number of matrices to process
     size_t repetitions               // Number of repetitions (for performance
                                      // evaluation)
@@ -68,8 +70,9 @@ void QRIImpl(
 
 
   // Create buffers and allocate space for them.
-  TT *a_device = sycl::malloc_device<TT>(kAMatrixSize * matrix_count, q);
-  TT *i_device = sycl::malloc_device<TT>(kInverseMatrixSize * matrix_count, q);
+  // device_pool hands out 64-byte aligned device memory for A and the inverse.
+  TT *a_device = device_pool.Allocate<TT>(kAMatrixSize * matrix_count);
+  TT *i_device = device_pool.Allocate<TT>(kInverseMatrixSize * matrix_count);
 
   q.memcpy(a_device, a_matrix.data(),
                              kAMatrixSize * matrix_count * sizeof(TT)).wait();
@@ -128,6 +131,6 @@ void QRIImpl(
                kInverseMatrixSize * matrix_count * sizeof(TT)).wait();
 
   // Clean allocated FPGA memory
-    free(a_device, q);
-    free(i_device, q);
+    device_pool.Deallocate(a_device);
+    device_pool.Deallocate(i_device);
 }
\ No newline at end of file
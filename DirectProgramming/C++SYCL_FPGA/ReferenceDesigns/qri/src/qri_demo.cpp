@@ -33,6 +33,7 @@
   - inv_matrix:  The output matrix. The function will overwrite this matrix.
                 Will contain the inverse of a_matrix.
   - q:          The device queue.
+  - device_pool: The pool that provides the FPGA DDR buffers.
   - matrices:   The number of matrices to be processed.
                 The input matrices are read sequentially from the a_matrix
                 vector.
@@ -42,21 +43,25 @@
 #if COMPLEX == 0
 // Real single precision floating-point QR based inversion
 void QRI(std::vector<float> &a_matrix, std::vector<float> &inv_matrix,
-         sycl::queue &q, size_t matrices, size_t repetitions) {
+         sycl::queue &q, fpga_tools::USMPool &device_pool, size_t matrices,
+         size_t repetitions) {
   constexpr bool is_complex = false;
   QRIImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS_QRD,
            FIXED_ITERATIONS_QRI, is_complex, float>(a_matrix, inv_matrix, q,
-                                                   matrices, repetitions);
+                                                   device_pool, matrices,
+                                                   repetitions);
 }
 #else
 // Complex single precision floating-point QR based inversion
 void QRI(std::vector<ac_complex<float> > &a_matrix,
          std::vector<ac_complex<float> > &inv_matrix, sycl::queue &q,
-         size_t matrices, size_t repetitions) {
+         fpga_tools::USMPool &device_pool, size_t matrices,
+         size_t repetitions) {
   constexpr bool is_complex = true;
   QRIImpl<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS_QRD,
            FIXED_ITERATIONS_QRI, is_complex, float>(a_matrix, inv_matrix, q,
-                                                   matrices, repetitions);
+                                                   device_pool, matrices,
+                                                   repetitions);
 }
 #endif
 
@@ -440,7 +445,11 @@ int main(int argc, char *argv[]) {
               << std::endl;
 
     // Launch the compute kernel
-    QRI(a, inv_matrix, q, kMatricesToInvert, repetitions);
+    // QRI takes its A and inverse buffers from this pool; PrintStats then
+    // shows what that single call allocated
+    fpga_tools::USMPool device_pool(q, sycl::usm::alloc::device);
+    QRI(a, inv_matrix, q, device_pool, kMatricesToInvert, repetitions);
+    device_pool.PrintStats(std::cout, "device");
 
     // Count the number of errors found for this matrix
     int error_count = 0;
@@ -0,0 +1,242 @@
+#ifndef __USM_POOL_HPP__
+#define __USM_POOL_HPP__
+
+#include <sycl/sycl.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// A host-side pool allocator for USM allocations.
+//
+// Allocating (and, for host allocations, pinning) memory is expensive, and
+// doing it for every run of a design shows up both as a startup cost and as
+// jitter between runs. The USMPool caches freed allocations in free lists,
+// one per size class, and hands them back out for later requests of the same
+// size class instead of returning them to the runtime.
+//
+// Size classes are spaced four per power of two (e.g., 80, 96, 112 and 128
+// KiB), which bounds the wasted space to 25% of a request. Every allocation
+// is aligned to 'alignment' bytes (by default, the 64-byte DMA granularity).
+//
+// The kind of the pool is one of:
+//    sycl::usm::alloc::host:    pinned host memory (malloc_host). If the
+//                               device does not support USM host allocations,
+//                               the pool falls back to pageable host memory
+//                               and Pinned() returns false.
+//    sycl::usm::alloc::device:  device memory (malloc_device)
+//    sycl::usm::alloc::shared:  shared memory (malloc_shared)
+//    sycl::usm::alloc::unknown: pageable (i.e., regular) host memory
+//
+// All memory owned by the pool, in use or cached, is freed when the pool is
+// destroyed, so the pool must outlive any kernel that uses its memory.
+//
+// Example usage:
+//    fpga_tools::USMPool pool(q, sycl::usm::alloc::device);
+//    for (int i = 0; i < runs; i++) {
+//      int *ptr = pool.Allocate<int>(count);  // only allocates for i == 0
+//      ...
+//      pool.Deallocate(ptr);  // returns 'ptr' to the pool
+//    }
+//    pool.PrintStats(std::cout, "device");
+//
+namespace fpga_tools {
+
+class USMPool {
+ public:
+  // the default alignment, in bytes, of the pool's allocations
+  static constexpr size_t kDefaultAlignment = 64;
+
+  // statistics for the pool
+  struct Stats {
+    size_t requests = 0;       // number of calls to Allocate
+    size_t hits = 0;           // requests served from a free list
+    size_t misses = 0;         // requests that allocated new memory
+    size_t bytes_in_use = 0;   // bytes currently handed out by the pool
+    size_t bytes_cached = 0;   // bytes currently sitting in the free lists
+    size_t peak_bytes = 0;     // peak of bytes_in_use + bytes_cached
+  };
+
+  USMPool(sycl::queue &q, sycl::usm::alloc kind,
+          size_t alignment = kDefaultAlignment)
+      : q_(q), kind_(kind), alignment_(alignment), pinned_(false) {
+    if (alignment_ == 0 || (alignment_ & (alignment_ - 1)) != 0) {
+      std::cerr << "ERROR: USMPool alignment (" << alignment_
+                << ") must be a power of 2\n";
+      std::terminate();
+    }
+
+    if (kind_ == sycl::usm::alloc::host) {
+      pinned_ = q_.get_device().has(sycl::aspect::usm_host_allocations);
+    }
+  }
+
+  USMPool(const USMPool &) = delete;
+  USMPool &operator=(const USMPool &) = delete;
+
+  ~USMPool() {
+    Release();
+    for (auto &[ptr, size] : in_use_) {
+      FreeBlock(ptr);
+    }
+  }
+
+  //
+  // Allocate space for 'count' elements of type T.
+  // Returns nullptr if the allocation fails.
+  //
+  template <typename T>
+  T *Allocate(size_t count) {
+    return static_cast<T *>(AllocateBytes(count * sizeof(T)));
+  }
+
+  //
+  // Allocate 'bytes' bytes. Returns nullptr if the allocation fails.
+  //
+  void *AllocateBytes(size_t bytes) {
+    const size_t size = SizeClass(bytes, alignment_);
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_.requests++;
+
+    // reuse a cached block of the same size class, if there is one
+    void *ptr = nullptr;
+    auto it = free_lists_.find(size);
+    if (it != free_lists_.end() && !it->second.empty()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      stats_.hits++;
+      stats_.bytes_cached -= size;
+    } else {
+      ptr = AllocateBlock(size);
+      if (ptr == nullptr) {
+        return nullptr;
+      }
+      stats_.misses++;
+    }
+
+    in_use_[ptr] = size;
+    stats_.bytes_in_use += size;
+    stats_.peak_bytes =
+        std::max(stats_.peak_bytes, stats_.bytes_in_use + stats_.bytes_cached);
+    return ptr;
+  }
+
+  //
+  // Return 'ptr' to the pool. 'ptr' must have come from this pool's Allocate.
+  //
+  void Deallocate(void *ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = in_use_.find(ptr);
+    if (it == in_use_.end()) {
+      std::cerr << "ERROR: USMPool::Deallocate called with a pointer that was "
+                << "not allocated by the pool\n";
+      std::terminate();
+    }
+    const size_t size = it->second;
+    in_use_.erase(it);
+    free_lists_[size].push_back(ptr);
+    stats_.bytes_in_use -= size;
+    stats_.bytes_cached += size;
+  }
+
+  //
+  // Free all of the cached (i.e., not in use) memory back to the runtime
+  //
+  void Release() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto &[size, ptrs] : free_lists_) {
+      for (auto ptr : ptrs) {
+        FreeBlock(ptr);
+      }
+    }
+    free_lists_.clear();
+    stats_.bytes_cached = 0;
+  }
+
+  // whether the memory in the pool is pinned host memory
+  bool Pinned() const { return pinned_; }
+
+  sycl::usm::alloc Kind() const { return kind_; }
+  size_t Alignment() const { return alignment_; }
+  const Stats &GetStats() const { return stats_; }
+
+  void PrintStats(std::ostream &os, const std::string &name) const {
+    os << "USM pool '" << name << "': " << stats_.requests << " requests, "
+       << stats_.hits << " hits, " << stats_.misses << " misses, "
+       << stats_.bytes_in_use << " bytes in use, " << stats_.bytes_cached
+       << " bytes cached, " << stats_.peak_bytes << " peak bytes\n";
+  }
+
+  //
+  // The size class for a request of 'bytes' bytes: the request rounded up to
+  // the next quarter power of 2 and to a multiple of 'alignment'.
+  //
+  static size_t SizeClass(size_t bytes, size_t alignment) {
+    bytes = std::max(bytes, alignment);
+    size_t pow2 = 1;
+    while (pow2 < bytes) {
+      pow2 <<= 1;
+    }
+    // 'bytes' is in (pow2/2, pow2], which is split into 4 size classes
+    const size_t step = std::max(pow2 / 8, size_t(1));
+    const size_t size = ((bytes + step - 1) / step) * step;
+    return ((size + alignment - 1) / alignment) * alignment;
+  }
+
+ private:
+  void *AllocateBlock(size_t bytes) {
+    switch (kind_) {
+      case sycl::usm::alloc::host:
+        if (pinned_) {
+          return sycl::aligned_alloc_host(alignment_, bytes, q_);
+        }
+        return ::operator new(bytes, std::align_val_t(alignment_),
+                              std::nothrow);
+      case sycl::usm::alloc::device:
+        return sycl::aligned_alloc_device(alignment_, bytes, q_);
+      case sycl::usm::alloc::shared:
+        return sycl::aligned_alloc_shared(alignment_, bytes, q_);
+      default:
+        return ::operator new(bytes, std::align_val_t(alignment_),
+                              std::nothrow);
+    }
+  }
+
+  void FreeBlock(void *ptr) {
+    if (IsUSM()) {
+      sycl::free(ptr, q_);
+    } else {
+      ::operator delete(ptr, std::align_val_t(alignment_));
+    }
+  }
+
+  bool IsUSM() const {
+    return (kind_ == sycl::usm::alloc::host && pinned_) ||
+           kind_ == sycl::usm::alloc::device ||
+           kind_ == sycl::usm::alloc::shared;
+  }
+
+  sycl::queue q_;
+  sycl::usm::alloc kind_;
+  size_t alignment_;
+  bool pinned_;
+
+  std::mutex mtx_;
+  std::map<size_t, std::vector<void *>> free_lists_;
+  std::unordered_map<void *, size_t> in_use_;
+  Stats stats_;
+};
+
+}  // namespace fpga_tools
+
+#endif /* __USM_POOL_HPP__ */
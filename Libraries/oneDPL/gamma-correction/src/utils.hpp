@@ -11,6 +11,7 @@
 #include "utils/ImgAlgorithm.hpp"
 #include "utils/ImgFormat.hpp"
 #include "utils/ImgPixel.hpp"
+#include "utils/ImgToneMap.hpp"
 
 #include "utils/Other.hpp"
 
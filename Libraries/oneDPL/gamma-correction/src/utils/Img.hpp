@@ -63,6 +63,7 @@ class Img {
   ///////////////////
 
   void write(string const& filename) const;
+  bool read(string const& filename);
 
   template <typename Functor>
   void fill(Functor f);
@@ -166,6 +167,22 @@ void Img<Format>::write(string const& filename) const {
   _format.write(filestream, *this);
 }
 
+template <typename Format>
+bool Img<Format>::read(string const& filename) {
+  ifstream filestream(filename, ios::binary);
+  if (!filestream) {
+    cerr << "Img::read: cannot open " << filename << "\n";
+    return false;
+  }
+
+  if (!_format.read(filestream, *this)) {
+    cerr << "Img::read: unsupported image " << filename << "\n";
+    return false;
+  }
+
+  return true;
+}
+
 template <typename Format>
 template <typename Functor>
 void Img<Format>::fill(Functor f) {
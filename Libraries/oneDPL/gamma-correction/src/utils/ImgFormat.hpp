@@ -9,7 +9,10 @@
 
 #include "ImgPixel.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <vector>
 
 using namespace std;
 
@@ -89,6 +92,61 @@ struct BMP {
                   image.width() * image.height() * sizeof(image.data()[0]));
   }
 
+  // reads an uncompressed 24-bit or 32-bit image. The rows are stored
+  // bottom-up, like write does, so top-down files (negative height) are
+  // flipped
+  template <template <class> class Image, typename Format>
+  bool read(ifstream& istream, Image<Format>& image) {
+    FileHeader fileHeader;
+    InfoHeader infoHeader;
+
+    if (!istream.read(reinterpret_cast<char*>(&fileHeader.type), 14) ||
+        fileHeader.type != 0x4d42)
+      return false;
+    if (!istream.read(reinterpret_cast<char*>(&infoHeader), 40) ||
+        infoHeader.size < 40)
+      return false;
+    if (infoHeader.bitCount != 24 && infoHeader.bitCount != 32) return false;
+    // BI_RGB, or 32-bit BI_BITFIELDS with the default BGRA masks. The masks
+    // are the 12 bytes after the first 40 of the info header, and the alpha
+    // mask the next 4 for V3 and later headers
+    if (infoHeader.compression == 3) {
+      uint32_t masks[4] = {0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000};
+      size_t maskBytes = infoHeader.size >= 56 ? 16 : 12;
+      if (infoHeader.bitCount != 32 ||
+          !istream.read(reinterpret_cast<char*>(masks), maskBytes) ||
+          masks[0] != 0x00ff0000 || masks[1] != 0x0000ff00 ||
+          masks[2] != 0x000000ff || (masks[3] != 0xff000000 && masks[3] != 0))
+        return false;
+    } else if (infoHeader.compression != 0) {
+      return false;
+    }
+
+    int32_t width = infoHeader.width;
+    int32_t height = abs(infoHeader.height);
+    bool topDown = infoHeader.height < 0;
+    if (width <= 0 || height <= 0) return false;
+
+    image.reset(width, height);
+    istream.seekg(fileHeader.offBits);
+
+    uint32_t rowSize = (infoHeader.bitCount / 8 * width + 3) / 4 * 4;
+    vector<uint8_t> row(rowSize);
+    for (int32_t y = 0; y < height && istream; ++y) {
+      istream.read(reinterpret_cast<char*>(row.data()), rowSize);
+      ImgPixel* pixels = image.data() + (topDown ? height - 1 - y : y) * width;
+      if (infoHeader.bitCount == 32) {
+        copy_n(row.data(), width * sizeof(ImgPixel),
+               reinterpret_cast<uint8_t*>(pixels));
+      } else {
+        for (int32_t x = 0; x < width; ++x)
+          pixels[x].set(row[3 * x], row[3 * x + 1], row[3 * x + 2], 255);
+      }
+    }
+
+    return static_cast<bool>(istream);
+  }
+
   FileHeader const& fileHeader() const noexcept { return _fileHeader; }
   InfoHeader const& infoHeader() const noexcept { return _infoHeader; }
 };
@@ -0,0 +1,87 @@
+//==============================================================
+// Copyright © 2019 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef _GAMMA_UTILS_IMGTONEMAP_HPP
+#define _GAMMA_UTILS_IMGTONEMAP_HPP
+
+#include "ImgPixel.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Fused color transform of a pixel, with all nonlinear functions in lookup
+// tables (LUTs): decodes the channels with the input gamma, computes the
+// luminance, maps the luminance with the tone curve by scaling the channels,
+// and encodes the channels with the output gamma. The functor only holds
+// pointers to the LUTs, so that it can be passed to a device algorithm.
+struct ImgToneMap {
+  static constexpr int kToneLutSize = 1024;
+  static constexpr int kEncodeLutSize = 4096;
+
+  // size of all LUTs in bytes, stored one after another
+  static constexpr size_t kLutBytes = 256 * sizeof(float) +
+                                      (kToneLutSize + 1) * sizeof(float) +
+                                      (kEncodeLutSize + 1) * sizeof(uint8_t);
+
+  float const* decode;   // channel -> linear value in [0, 1]
+  float const* tone;     // luminance -> scale of the linear values
+  uint8_t const* encode;  // linear value -> channel
+
+  // LUTs stored from address luts
+  explicit ImgToneMap(void const* luts) {
+    decode = static_cast<float const*>(luts);
+    tone = decode + 256;
+    encode = reinterpret_cast<uint8_t const*>(tone + kToneLutSize + 1);
+  }
+
+  void operator()(ImgPixel& pixel) const {
+    float r = decode[pixel.r];
+    float g = decode[pixel.g];
+    float b = decode[pixel.b];
+
+    float v = 0.3f * r + 0.59f * g + 0.11f * b;
+    float scale = tone[static_cast<int>(v * kToneLutSize + 0.5f)];
+
+    auto encode_f = [this, scale](float c) {
+      c *= scale;
+      if (c > 1.0f) c = 1.0f;
+      return encode[static_cast<int>(c * kEncodeLutSize + 0.5f)];
+    };
+    pixel.set(encode_f(b), encode_f(g), encode_f(r), pixel.a);
+  }
+};
+
+// Builds the LUTs of ImgToneMap: the tone curve is the extended Reinhard
+// operator of the luminance multiplied by exposure, with white mapped to
+// white
+inline vector<uint8_t> MakeToneMapLuts(float gamma_in, float gamma_out,
+                                       float exposure) {
+  vector<uint8_t> luts(ImgToneMap::kLutBytes);
+  auto decode = reinterpret_cast<float*>(luts.data());
+  auto tone = decode + 256;
+  auto encode = reinterpret_cast<uint8_t*>(tone + ImgToneMap::kToneLutSize + 1);
+
+  for (int i = 0; i < 256; ++i) decode[i] = pow(i / 255.0f, gamma_in);
+
+  for (int i = 0; i <= ImgToneMap::kToneLutSize; ++i) {
+    float v = exposure * i / ImgToneMap::kToneLutSize;
+    float white2 = exposure * exposure;
+    float mapped = v * (1.0f + v / white2) / (1.0f + v);
+    tone[i] = (i == 0) ? exposure : mapped * ImgToneMap::kToneLutSize / i;
+  }
+
+  for (int i = 0; i <= ImgToneMap::kEncodeLutSize; ++i)
+    encode[i] = static_cast<uint8_t>(
+        255.0f * pow(float(i) / ImgToneMap::kEncodeLutSize, 1.0f / gamma_out) +
+        0.5f);
+
+  return luts;
+}
+
+#endif  // _GAMMA_UTILS_IMGTONEMAP_HPP
@@ -67,6 +67,15 @@ constexpr double t_high  = 2.0;
 constexpr double risk_free = 1.0;
 constexpr double volatility = 2.0;
 
+// ranges of the per-option parameters of the stream file
+constexpr double risk_free_low   = 0.0;
+constexpr double risk_free_high  = 0.1;
+
+constexpr double volatility_low  = 0.1;
+constexpr double volatility_high = 0.6;
+
+constexpr int64_t default_batch = 1 << 20;
+
 void preamble(sycl::device & dev) {
     std::string dev_name       = dev.template get_info<sycl::info::device::name>();
     std::string driver_version = dev.template get_info<sycl::info::device::version>();
@@ -163,26 +172,67 @@ void run(int64_t nopt, sycl::device & dev) {
     }
 }
 
+// Streams the options of a file (generated with nopt options if it does not
+// hold nopt options of type T yet) through the pricing engine with Greeks
+template <typename T>
+bool run_stream(int64_t nopt, const std::string & path, int64_t batch, sycl::device & dev) {
+    sycl::queue q { dev, async_sycl_error };
+
+    int64_t file_nopt = black_scholes::stream::file_options<T>(path);
+    if (file_nopt != nopt) {
+        if (file_nopt >= 0) {
+            std::cerr << path << " holds " << file_nopt << " options, not " << nopt << std::endl;
+        }
+        std::cerr << "generating " << nopt << " options in " << path << std::endl;
+        black_scholes::stream::generate_file(
+            path,
+            nopt,
+            static_cast<T>(s0_low), static_cast<T>(s0_high),
+            static_cast<T>(x_low), static_cast<T>(x_high),
+            static_cast<T>(t_low), static_cast<T>(t_high),
+            static_cast<T>(risk_free_low), static_cast<T>(risk_free_high),
+            static_cast<T>(volatility_low), static_cast<T>(volatility_high),
+            seed,
+            q);
+    } else {
+        std::cerr << "reading " << file_nopt << " options from " << path << std::endl;
+    }
+
+    std::cerr << "running stream dpcpp with Greeks" << std::endl;
+    return black_scholes::stream::run<T>(path, batch, q);
+}
 
-int sample_run(int64_t nopt) {
+int sample_run(int64_t nopt, const std::string & path, int64_t batch) {
     try {
         sycl::device dev{sycl::default_selector{}};
 
         preamble(dev);
 
+        bool ok = true;
+
         std::cerr << std::endl
                   << "running floating-point type float" << std::endl;
-        run<float>(nopt, dev);
+        if (path.empty()) {
+            run<float>(nopt, dev);
+        } else {
+            ok &= run_stream<float>(nopt, path + ".fp32", batch, dev);
+        }
 
         // check if double is supported and run if it is supported
         auto fp64_conf = dev.template get_info<sycl::info::device::double_fp_config>();
         if (0 != fp64_conf.size()) {
             std::cerr << std::endl
                       << "running floating-point type double" << std::endl;
-            run<double>(nopt, dev);
+            if (path.empty()) {
+                run<double>(nopt, dev);
+            } else {
+                ok &= run_stream<double>(nopt, path + ".fp64", batch, dev);
+            }
         } else {
             std::cerr << "floating-point type double is not supported on this device" << std::endl;
         }
+
+        if (!ok) { return 1; }
     }
     catch (sycl::exception const & re) {
         std::cerr << "SYCL exception occured with code " << code_wrapper(re) << " with " << re.what() << std::endl;
@@ -194,8 +244,14 @@ int sample_run(int64_t nopt) {
 
 } // anon. namespace
 
+// usage: black_scholes [nopt [stream_file [batch]]]
+// With a stream file, the options are read from <stream_file>.fp32 and
+// <stream_file>.fp64 in batches of batch options, and priced with Greeks.
+// A file that does not hold nopt options is regenerated with nopt options.
 int main(int argc, char * argv[]) {
     std::int64_t nopt;
+    std::string path;
+    std::int64_t batch = default_batch;
 
     if (argc > 1) {
         auto nopt_param = std::string { argv[1] };
@@ -208,5 +264,17 @@ int main(int argc, char * argv[]) {
         nopt = 10'000'000;
     }
 
-    return sample_run(nopt);
+    if (argc > 2) {
+        path = argv[2];
+    }
+
+    if (argc > 3) {
+        batch = std::stol(std::string { argv[3] });
+        if (batch <= 0) {
+            std::cerr << "batch <= 0" << std::endl;
+            return 1;
+        }
+    }
+
+    return sample_run(nopt, path, batch);
 }
@@ -15,6 +15,7 @@
 #include "black_scholes_usm_vml.hpp"
 #include "black_scholes_buffer_dpcpp.hpp"
 #include "black_scholes_buffer_vml.hpp"
+#include "black_scholes_stream.hpp"
 
 namespace black_scholes {
 
@@ -0,0 +1,429 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+/*******************************************************************************
+!  Content:
+!      Black-Scholes formula Intel(r) Math Kernel Library (Intel(r) MKL) VML based Example
+!      Streaming pricing engine: prices and Greeks of options read from a file
+!******************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace black_scholes {
+namespace stream {
+namespace impl {
+
+using std::int64_t;
+using std::uint64_t;
+using std::size_t;
+
+// Option record of the stream file, with its own risk-free rate and volatility
+template <typename T>
+struct option {
+    T s0;
+    T x;
+    T t;
+    T risk_free;
+    T volatility;
+};
+
+// Prices and Greeks of an option
+template <typename T>
+struct greeks {
+    T call;
+    T put;
+    T delta_call;
+    T delta_put;
+    T gamma;
+    T vega;
+    T theta_call;
+    T theta_put;
+    T rho_call;
+    T rho_put;
+};
+
+constexpr int ngreeks = sizeof(greeks<float>) / sizeof(float);
+
+constexpr const char * greeks_names[ngreeks] = {
+    "opt_call", "opt_put", "delta_call", "delta_put", "gamma",
+    "vega", "theta_call", "theta_put", "rho_call", "rho_put"
+};
+
+// The stream file is this header followed by nopt option<T> records
+struct file_header {
+    char magic[8];
+    uint64_t type_size;
+    uint64_t nopt;
+};
+
+constexpr char file_magic[8] = { 'b', 's', 's', 't', 'r', 'e', 'a', 'm' };
+
+// Returns the number of options of the stream file, or -1 if the file does
+// not exist or does not hold option<T> records
+template <typename T>
+int64_t file_options(const std::string & path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) { return -1; }
+    uint64_t size = static_cast<uint64_t>(in.tellg());
+
+    file_header header;
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0
+        || header.type_size != sizeof(T)
+        || size != sizeof(header) + header.nopt * sizeof(option<T>)) {
+        return -1;
+    }
+    return static_cast<int64_t>(header.nopt);
+}
+
+// Writes nopt random options to the stream file, generated in chunks with the
+// USM mkl::rng input generator
+template <typename T>
+void generate_file(
+        const std::string & path,
+        int64_t nopt,
+        T s0_low, T s0_high,
+        T x_low, T x_high,
+        T t_low, T t_high,
+        T risk_free_low, T risk_free_high,
+        T volatility_low, T volatility_high,
+        uint64_t seed,
+        sycl::queue & q
+    ) {
+    constexpr int64_t chunk = 1 << 22;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) { throw std::runtime_error("cannot create " + path); }
+
+    file_header header;
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.type_size = sizeof(T);
+    header.nopt = static_cast<uint64_t>(nopt);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::vector<T> s0(chunk), x(chunk), t(chunk), r(chunk), v(chunk), unused(chunk);
+    std::vector<option<T>> records(chunk);
+
+    for (int64_t first = 0; first < nopt; first += chunk) {
+        int64_t n = std::min(chunk, nopt - first);
+        uint64_t chunk_seed = seed + 2 * static_cast<uint64_t>(first / chunk);
+
+        input_generator::usm::rng::run(n,
+            s0_low, s0_high, s0.data(),
+            x_low, x_high, x.data(),
+            t_low, t_high, t.data(),
+            chunk_seed, q);
+        input_generator::usm::rng::run(n,
+            risk_free_low, risk_free_high, r.data(),
+            volatility_low, volatility_high, v.data(),
+            T(0), T(1), unused.data(),
+            chunk_seed + 1, q);
+
+        for (int64_t i = 0; i < n; ++i) {
+            records[i] = option<T> { s0[i], x[i], t[i], r[i], v[i] };
+        }
+        out.write(reinterpret_cast<const char *>(records.data()), n * sizeof(option<T>));
+    }
+
+    if (!out) { throw std::runtime_error("failed to write " + path); }
+}
+
+// Read-only memory mapping of a file
+class mapped_file {
+public:
+    explicit mapped_file(const std::string & path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) { throw std::runtime_error("cannot open " + path); }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_, &size);
+        size_ = static_cast<size_t>(size.QuadPart);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data_ = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (nullptr == data_) {
+            if (mapping_) { CloseHandle(mapping_); }
+            CloseHandle(file_);
+            throw std::runtime_error("cannot map " + path);
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) { throw std::runtime_error("cannot open " + path); }
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+            ::close(fd_);
+            throw std::runtime_error("cannot map " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (MAP_FAILED == data_) {
+            ::close(fd_);
+            throw std::runtime_error("cannot map " + path);
+        }
+        // the batches are read once, front to back
+        madvise(data_, size_, MADV_SEQUENTIAL);
+#endif
+    }
+
+    ~mapped_file() {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+#else
+        munmap(data_, size_);
+        ::close(fd_);
+#endif
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file & operator=(const mapped_file &) = delete;
+
+    const char * data() const { return static_cast<const char *>(data_); }
+    size_t size() const { return size_; }
+
+private:
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#else
+    int fd_;
+#endif
+    void * data_;
+    size_t size_;
+};
+
+// Prices and Greeks of n options in a single kernel
+template <typename T>
+sycl::event price(
+        int64_t n,
+        const option<T> * dev_options,
+        greeks<T> * dev_greeks,
+        sycl::event dep,
+        sycl::queue & q
+    ) {
+    return q.submit(
+    [&](sycl::handler & cgh) {
+        cgh.depends_on(dep);
+        sycl::range<1> range { static_cast<size_t>(n) };
+
+        constexpr T one            { 1.0 };
+        constexpr T one_above_two  { 0.5 };
+        constexpr T inv_sqrt_two   { 0.707106781186547524400844362104849039 };
+        constexpr T inv_sqrt_two_pi { 0.398942280401432677939946059934381868 };
+
+        cgh.parallel_for(range,
+        [=](sycl::id<1> id) {
+            size_t i = id.get(0);
+            option<T> o = dev_options[i];
+            greeks<T> g;
+
+            T sqrt_t = sycl::sqrt(o.t);
+            T sig_sqrt_t = o.volatility * sqrt_t;
+
+            T d1 = (sycl::log(o.s0 / o.x)
+                    + (o.risk_free + one_above_two * o.volatility * o.volatility) * o.t) / sig_sqrt_t;
+            T d2 = d1 - sig_sqrt_t;
+
+            // cumulative and density of the standard normal distribution
+            T n1 = one_above_two + one_above_two * sycl::erf(d1 * inv_sqrt_two);
+            T n2 = one_above_two + one_above_two * sycl::erf(d2 * inv_sqrt_two);
+            T p1 = inv_sqrt_two_pi * sycl::exp(-one_above_two * d1 * d1);
+
+            // discounted strike
+            T xe = o.x * sycl::exp(-o.risk_free * o.t);
+            T decay = -one_above_two * o.s0 * p1 * o.volatility / sqrt_t;
+
+            g.call       = o.s0 * n1 - xe * n2;
+            g.put        = g.call - o.s0 + xe;
+            g.delta_call = n1;
+            g.delta_put  = n1 - one;
+            g.gamma      = p1 / (o.s0 * sig_sqrt_t);
+            g.vega       = o.s0 * p1 * sqrt_t;
+            g.theta_call = decay - o.risk_free * xe * n2;
+            g.theta_put  = decay + o.risk_free * xe * (one - n2);
+            g.rho_call   = o.t * xe * n2;
+            g.rho_put    = -o.t * xe * (one - n2);
+
+            dev_greeks[i] = g;
+        } // [=]
+        ); // parallel_for
+    } // [&]
+    ); // submit
+}
+
+// Host reference of the kernel, in double precision
+template <typename T>
+greeks<double> reference(const option<T> & opt) {
+    double s0 = opt.s0, x = opt.x, t = opt.t, r = opt.risk_free, v = opt.volatility;
+    double sig_sqrt_t = v * std::sqrt(t);
+    double d1 = (std::log(s0 / x) + (r + 0.5 * v * v) * t) / sig_sqrt_t;
+    double d2 = d1 - sig_sqrt_t;
+    double n1 = 0.5 * std::erfc(-d1 / std::sqrt(2.0));
+    double n2 = 0.5 * std::erfc(-d2 / std::sqrt(2.0));
+    double p1 = std::exp(-0.5 * d1 * d1) / std::sqrt(2.0 * 3.14159265358979323846);
+    double xe = x * std::exp(-r * t);
+    double decay = -0.5 * s0 * p1 * v / std::sqrt(t);
+
+    greeks<double> g;
+    g.call       = s0 * n1 - xe * n2;
+    g.put        = xe * (1.0 - n2) - s0 * (1.0 - n1);
+    g.delta_call = n1;
+    g.delta_put  = n1 - 1.0;
+    g.gamma      = p1 / (s0 * sig_sqrt_t);
+    g.vega       = s0 * p1 * std::sqrt(t);
+    g.theta_call = decay - r * xe * n2;
+    g.theta_put  = decay + r * xe * (1.0 - n2);
+    g.rho_call   = t * xe * n2;
+    g.rho_put    = -t * xe * (1.0 - n2);
+    return g;
+}
+
+// One of the two buffers of the pipeline: while the device prices the batch
+// of one slot, the host reads the next batch from the file into the other
+template <typename T>
+struct slot {
+    option<T> * host_options = nullptr;
+    option<T> * dev_options  = nullptr;
+    greeks<T> * dev_greeks   = nullptr;
+    greeks<T> * host_greeks  = nullptr;
+    int64_t count = 0;
+    sycl::event done;
+};
+
+// Prices the options of the stream file in batches of at most batch options,
+// prints the portfolio averages of the prices and Greeks and the throughput,
+// and returns whether a sample of the results matches the host reference
+template <typename T>
+bool run(
+        const std::string & path,
+        int64_t batch,
+        sycl::queue & q
+    ) {
+    int64_t nopt = file_options<T>(path);
+    if (nopt <= 0) { throw std::runtime_error("invalid stream file " + path); }
+    batch = std::min(batch, nopt);
+
+    mapped_file file(path);
+    const option<T> * options = reinterpret_cast<const option<T> *>(file.data() + sizeof(file_header));
+
+    slot<T> slots[2];
+    for (auto & s : slots) {
+        s.host_options = sycl::malloc_host<option<T>>(batch, q);
+        s.dev_options  = sycl::malloc_device<option<T>>(batch, q);
+        s.dev_greeks   = sycl::malloc_device<greeks<T>>(batch, q);
+        s.host_greeks  = sycl::malloc_host<greeks<T>>(batch, q);
+        if (nullptr == s.host_options
+            || nullptr == s.dev_options
+            || nullptr == s.dev_greeks
+            || nullptr == s.host_greeks) {
+            std::cerr << "failed to allocate USM memory" << std::endl;
+            throw std::runtime_error("failed to allocate USM");
+        }
+    }
+
+    // every check_stride-th option is checked against the host reference
+    const int64_t check_stride = std::max<int64_t>(1, nopt / 100'000);
+    const double tolerance = sizeof(T) == sizeof(float) ? 1.0e-3 : 1.0e-9;
+    double sums[ngreeks] = {};
+    double max_err = 0.0;
+    int64_t consumed = 0;
+
+    // accumulates the results of a slot once its copy back has completed
+    auto consume = [&](slot<T> & s) {
+        if (0 == s.count) { return; }
+        s.done.wait_and_throw();
+
+        for (int64_t i = 0; i < s.count; ++i) {
+            const T * g = reinterpret_cast<const T *>(s.host_greeks + i);
+            for (int k = 0; k < ngreeks; ++k) { sums[k] += g[k]; }
+        }
+        for (int64_t i = (check_stride - consumed % check_stride) % check_stride; i < s.count; i += check_stride) {
+            greeks<double> ref = reference(s.host_options[i]);
+            const double * r = reinterpret_cast<const double *>(&ref);
+            const T * g = reinterpret_cast<const T *>(s.host_greeks + i);
+            for (int k = 0; k < ngreeks; ++k) {
+                max_err = std::max(max_err, std::fabs(g[k] - r[k]) / std::max(1.0, std::fabs(r[k])));
+            }
+        }
+        consumed += s.count;
+        s.count = 0;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    int64_t nbatches = (nopt + batch - 1) / batch;
+    for (int64_t b = 0; b < nbatches; ++b) {
+        int64_t first = b * batch;
+        slot<T> & s = slots[b % 2];
+        consume(s);
+
+        s.count = std::min(batch, nopt - first);
+        size_t bytes = s.count * sizeof(option<T>);
+
+        // the pages of the batch are read from the file here, while the
+        // device is busy with the batch of the other slot
+        std::memcpy(s.host_options, options + first, bytes);
+
+        auto copy_in = q.memcpy(s.dev_options, s.host_options, bytes);
+        auto priced = price(s.count, s.dev_options, s.dev_greeks, copy_in, q);
+        s.done = q.submit([&](sycl::handler & cgh) {
+            cgh.depends_on(priced);
+            cgh.memcpy(s.host_greeks, s.dev_greeks, s.count * sizeof(greeks<T>));
+        });
+    }
+    consume(slots[nbatches % 2]);
+    consume(slots[(nbatches + 1) % 2]);
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    for (auto & s : slots) {
+        sycl::free(s.host_greeks, q);
+        sycl::free(s.dev_greeks, q);
+        sycl::free(s.dev_options, q);
+        sycl::free(s.host_options, q);
+    }
+
+    for (int k = 0; k < ngreeks; ++k) {
+        std::cerr << "    <" << greeks_names[k] << "> = " << sums[k] / nopt << std::endl;
+    }
+    std::cerr << "    " << nopt << " options in batches of " << batch << ": "
+              << seconds << " s, " << nopt / seconds << " options/s" << std::endl;
+
+    bool ok = max_err <= tolerance;
+    std::cerr << "    max. relative error vs. host reference: " << max_err
+              << (ok ? " (PASSED)" : " (FAILED)") << std::endl;
+    return ok;
+}
+
+} // namespace impl
+
+using impl::file_options;
+using impl::generate_file;
+using impl::run;
+
+} // namespace stream
+} // namespace black_scholes
+
@@ -9,16 +9,22 @@
 *  Content:
 *      Function DGEBLTTRF for LU factorization of general block 
 *         tridiagonal matrix;
-*      Function PTLDGETRF for partial LU factorization of general 
-*         rectangular matrix.
+*      Function DGEBLTTRF_BATCH for LU factorizations of a batch of
+*         independent general block tridiagonal matrices;
+*      Function PTLDGETRF_BATCH for partial LU factorizations of a 
+*         batch of general rectangular matrices.
 ************************************************************************/
+#include <algorithm>
 #include <cstdint>
+#include <iostream>
+#include <vector>
 #include <sycl/sycl.hpp>
 #include "oneapi/mkl.hpp"
 
 using namespace oneapi;
 
-int64_t ptldgetrf(sycl::queue queue, int64_t m, int64_t n, int64_t k, double* a, int64_t lda, int64_t* ipiv);
+int64_t dgeblttrf_batch(sycl::queue queue, int64_t n, int64_t nb, int64_t batch, double* d, double* dl, double* du1, double* du2, int64_t* ipiv);
+sycl::event ptldgetrf_batch(sycl::queue queue, int64_t m, int64_t n, int64_t k, double* a, int64_t lda, int64_t stride_a, int64_t* ipiv, int64_t stride_ipiv, int64_t batch, double* scratchpad, int64_t scratchpad_size, const std::vector<sycl::event>& events);
 
 /************************************************************************
 * Definition:
@@ -100,157 +106,227 @@ int64_t ptldgetrf(sycl::queue queue, int64_t m, int64_t n, int64_t k, double* a,
 ***********************************************************************/
 int64_t dgeblttrf(sycl::queue queue, int64_t n, int64_t nb, double* d, double* dl, double* du1, double* du2, int64_t* ipiv) {
 
-    // Matrix accessors
-    auto D    = [=,&d]    (int64_t i, int64_t j) -> double&  { return  d[i + j*nb];    };
-    auto DL   = [=,&dl]   (int64_t i, int64_t j) -> double&  { return  dl[i + j*nb];   };
-    auto DU1  = [=,&du1]  (int64_t i, int64_t j) -> double&  { return  du1[i + j*nb];  };
-    auto DU2  = [=,&du2]  (int64_t i, int64_t j) -> double&  { return  du2[i + j*nb];  };
-    auto IPIV = [=,&ipiv] (int64_t i, int64_t j) -> int64_t& { return  ipiv[i + j*nb]; };
-    
+    // A single matrix is a batch of size 1
+    return dgeblttrf_batch(queue, n, nb, 1, d, dl, du1, du2, ipiv);
+}
+
+
+
+/************************************************************************
+* Definition:
+* ===========
+*   int64_t dgeblttrf_batch(sycl::queue queue, int64_t n, int64_t nb, int64_t batch, double* d, double* dl, double* du1, double* du2, int64_t* ipiv) {
+*
+* Purpose:
+* ========  
+* DGEBLTTRF_BATCH computes LU factorizations of BATCH independent 
+* general block tridiagonal matrices of the same dimensions, as 
+* DGEBLTTRF does for a single matrix. 
+* The block rows of a matrix depend on each other and are eliminated 
+* in sequence, but at each step the panels of all matrices are formed,
+* factored and stored with the same kernels: one kernel which stores 
+* the results of the previous step and forms the next 2*NB x 3*NB 
+* panels, and strided batch GETRF, TRSM and GEMM calls. So a step 
+* submits the same number of kernels for any BATCH, and no step waits 
+* for the host. The trailing blocks D'_K+1 and C'_K+1 of a panel stay 
+* in the device memory and become the leading blocks of the next panel.
+*
+* Arguments:
+* ==========  
+* QUEUE (input) sycl queue
+*     The device queue
+*
+* N (input) int64_t
+*     The number of block rows of each matrix.  N > 0.
+*
+* NB (input) int64_t
+*     The size of blocks.  NB > 0.
+*
+* BATCH (input) int64_t
+*     The number of matrices.  BATCH > 0.
+*
+* D, DL, DU1, DU2, IPIV (input/output)
+*     The arrays D, DL, DU1, DU2 and IPIV described in DGEBLTTRF of the
+*     BATCH matrices, stored one after the other: the arrays of matrix 
+*     S (0 <= S < BATCH) start at D + S*NB*N*NB, DL + S*NB*(N-1)*NB, 
+*     DU1 + S*NB*(N-1)*NB, DU2 + S*NB*(N-2)*NB and IPIV + S*NB*N.
+*     The arrays must be accessible from the device (USM).
+*
+* INFO (return) int64_t
+*     = 0:        successful exit
+*     = -1000     memory buffer could not be allocated
+*     < 0:        if INFO = -i, the i-th argument had an illegal value
+*     > 0:        if INFO = i, U(i,i) is exactly zero in one of the 
+*                 matrices, and i is the smallest such index. The 
+*                 factorizations are completed. 
+***********************************************************************/
+int64_t dgeblttrf_batch(sycl::queue queue, int64_t n, int64_t nb, int64_t batch, double* d, double* dl, double* du1, double* du2, int64_t* ipiv) {
+
     // Test the input arguments.
     int64_t info=0;
     if(n <= 0) 
         info = -1;
     else if(nb <= 0) 
         info = -2;
+    else if(batch <= 0) 
+        info = -3;
     if(info) 
         return info;
 
     sycl::context context = queue.get_context();
     sycl::device device = queue.get_device();
 
-    // Allocating a contiguous USM array for partial factorizations
+    // Distances between the arrays of consecutive matrices
+    const int64_t stride_d    = nb*n*nb;
+    const int64_t stride_dl   = nb*(n-1)*nb;
+    const int64_t stride_du2  = nb*std::max<int64_t>(n-2, 0)*nb;
+    const int64_t stride_ipiv = nb*n;
+
+    // Two sets of 2*NB x 3*NB panels (one panel per matrix): the panels 
+    // of step K are formed from the panels of step K-1
     const int64_t lda = 2*nb;
-    double* a = sycl::malloc_shared<double>(lda * 3*nb, device, context);
-    auto A = [=,&a](int64_t i, int64_t j) -> double& { return a[i + j*lda]; };
-    if (!a) {
+    const int64_t stride_a = lda * 3*nb;
+    double* a = nullptr;
+    double* scratchpad = nullptr;
+    int64_t* zero_pivot = nullptr;
+    std::int64_t scratchpad_size = 0;
+
+    a = sycl::malloc_device<double>(2 * stride_a * batch, device, context);
+    zero_pivot = sycl::malloc_shared<int64_t>(1, device, context);
+    if (n == 1)
+        scratchpad_size = mkl::lapack::getrf_batch_scratchpad_size<double>(queue, nb, nb, nb, stride_d, stride_ipiv, batch);
+    else
+        scratchpad_size = std::max(mkl::lapack::getrf_batch_scratchpad_size<double>(queue, 2*nb, nb, lda, stride_a, stride_ipiv, batch),
+                                   mkl::lapack::getrf_batch_scratchpad_size<double>(queue, 2*nb, 2*nb, lda, stride_a, stride_ipiv, batch));
+    scratchpad = sycl::malloc_device<double>(scratchpad_size, device, context);
+    if (!a || !zero_pivot || !scratchpad) {
         info = -1000;
         goto cleanup;
     }
 
-
-    for (int64_t k = 0; k < n-2; k++){
-        // Form a 2*NB x 3*NB submatrix
-        //     D_K   C_K 0
-        //     B_K D_K+1 C_K+1
-        for (int64_t j = 0; j < nb; j++) {
-            auto event1 = mkl::blas::copy(queue, nb,   &D(0,(k)*nb + j), 1,   &A(0,     j),1);
-            auto event2 = mkl::blas::copy(queue, nb,  &DL(0,(k)*nb + j), 1,   &A(nb,    j),1);
-            auto event3 = mkl::blas::copy(queue, nb, &DU1(0,(k)*nb + j), 1,   &A(0,  nb+j),1);
-            auto event4 = mkl::blas::copy(queue, nb,   &D(0,(k+1)*nb + j),     1,   &A(nb,  nb+j),1);
-            auto event5 = mkl::blas::copy(queue, nb, &DU1(0,(k+1)*nb + j),     1,   &A(nb,2*nb+j),1);
-            event1.wait_and_throw();
-            event2.wait_and_throw();
-            event3.wait_and_throw();
-            event4.wait_and_throw();
-            event5.wait_and_throw();
-
-            queue.submit([&](sycl::handler& cgh) {
-                    cgh.parallel_for(sycl::range<1>(nb), [=] (sycl::id<1> it) {
-                            const int64_t i = it[0];
-                            a[i + (2*nb + j)*lda] = 0.0;
-                            });
-                    });
-            queue.wait();
-
+    try {
+        std::vector<sycl::event> events;
+        if (n == 1) {
+            events = {mkl::lapack::getrf_batch(queue, nb, nb, d, nb, stride_d, ipiv, stride_ipiv, batch, scratchpad, scratchpad_size)};
         }
+        // Step K (0 <= K <= N-2) factors the panels in the buffer K%2, the 
+        // last step N-1 only stores the results of step N-2
+        for (int64_t k = 0; k < n && n > 1; k++) {
+            const double* prev = a + ((k+1)%2) * stride_a * batch;
+            double* next = a + (k%2) * stride_a * batch;
 
+            auto event1 = queue.submit([&](sycl::handler& cgh) {
+                cgh.depends_on(events);
+                cgh.parallel_for(sycl::range<3>(batch, 2*nb, 3*nb), [=] (sycl::id<3> it) {
+                    const int64_t s = it[0];
+                    const int64_t i = it[1];
+                    const int64_t j = it[2];
+                    const int64_t r = i / nb, ii = i % nb;
+                    const int64_t c = j / nb, jj = j % nb;
+                    double* ds   = d   + s*stride_d;
+                    double* dls  = dl  + s*stride_dl;
+                    double* du1s = du1 + s*stride_dl;
+                    double* du2s = du2 + s*stride_du2;
 
+                    // Results of step K-1 to be stored to arrays:
+                    // L_K-1,K-1, U_K-1,K-1 -> D
+                    // L_K,K-1 -> DL
+                    // U_K-1,K -> DU1
+                    // U_K-1,K+1 -> DU2 (not in the last panel)
+                    // L_N,N, U_N,N -> D (only in the last panel, D'_K and
+                    //     C'_K of the other panels are moved to panel K)
+                    if (k > 0) {
+                        const double v = prev[s*stride_a + i + j*lda];
+                        const int64_t col = (k-1)*nb + jj;
+                        if (r == 0 && c == 0)
+                            ds[ii + col*nb] = v;
+                        else if (r == 1 && c == 0)
+                            dls[ii + col*nb] = v;
+                        else if (r == 0 && c == 1)
+                            du1s[ii + col*nb] = v;
+                        else if (r == 0 && c == 2 && k-1 < n-2)
+                            du2s[ii + col*nb] = v;
+                        else if (r == 1 && c == 1 && k == n-1)
+                            ds[ii + (col+nb)*nb] = v;
+                    }
 
-        // Partial factorization of the submatrix
-        //     (D_K    C_K   0    )        (L_K,K    )   (U_K,K U_K,K+1, U_K,K+2)
-        //     (                  )  = P * (         ) *                          
-        //     (B_K  D_K+1   C_K+1)        (L_K+1,K+1)                            
-        //
-        //    (  0    0       0     )
-        //  + (                     )
-        //    (  0    D'_K+1  C'_K+1)
-        info = ptldgetrf(queue, 2*nb, 3*nb, nb, &A(0,0), lda, &IPIV(0,k));
-        if (info > 0) {
-        // INFO is equal to the 'global' index of the element u_ii of the factor 
-        // U which is equal to zero
-            return info + k*nb;
-        }
-
-        // Factorization results to be copied back to arrays:
-        // L_K,K, U_K,K, D'_K+1 -> D
-        // L_K+1,K -> DL
-        // U_K,K+1 -> DU1
-        // U_K,K+2 -> DU2
-        for(int64_t j = 0; j < nb; j++) {
-            auto event1 = mkl::blas::copy(queue, nb, &A( 0,     j), 1,   &D(0,k*nb + j), 1);
-            auto event2 = mkl::blas::copy(queue, nb, &A(nb,     j), 1,  &DL(0,k*nb + j), 1);
-            auto event3 = mkl::blas::copy(queue, nb, &A( 0,  nb+j), 1, &DU1(0,k*nb + j), 1);
-            auto event4 = mkl::blas::copy(queue, nb, &A(nb,  nb+j), 1,   &D(0,(k+1)*nb     + j), 1);
-            auto event5 = mkl::blas::copy(queue, nb, &A( 0,2*nb+j), 1, &DU2(0,k*nb + j), 1);
-            auto event6 = mkl::blas::copy(queue, nb, &A(nb,2*nb+j), 1, &DU1(0,(k+1)*nb     + j), 1);
-            event1.wait_and_throw();
-            event2.wait_and_throw();
-            event3.wait_and_throw();
-            event4.wait_and_throw();
-            event5.wait_and_throw();
-            event6.wait_and_throw();
-        }
-    }
+                    // Form a 2*NB x 3*NB submatrix (2*NB x 2*NB for the
+                    // last step)
+                    //     D_K   C_K 0
+                    //     B_K D_K+1 C_K+1
+                    // where D_K and C_K are D'_K and C'_K of panel K-1
+                    if (k < n-1) {
+                        double v = 0.0;
+                        if (r == 0 && c < 2 && k > 0)
+                            v = prev[s*stride_a + (nb+ii) + (nb+j)*lda];
+                        else if (r == 0 && c == 0)
+                            v = ds[ii + jj*nb];
+                        else if (r == 0 && c == 1)
+                            v = du1s[ii + jj*nb];
+                        else if (r == 1 && c == 0)
+                            v = dls[ii + (k*nb + jj)*nb];
+                        else if (r == 1 && c == 1)
+                            v = ds[ii + ((k+1)*nb + jj)*nb];
+                        else if (r == 1 && c == 2 && k < n-2)
+                            v = du1s[ii + ((k+1)*nb + jj)*nb];
+                        next[s*stride_a + i + j*lda] = v;
+                    }
+                });
+            });
+            events = {event1};
 
-    // Out of loop factorization of the last 2*NBx2*NB submatrix
-    //  (D_N-1    C_N-1)          (L_N-1,N-1      0)   (U_N-1,N-1   U_N-1,N )
-    //  (              ) = P_N-1* (                ) * (                    )
-    //  (B_N-1      D_N)          (  L_N,N-1  L_N,N)   (      0     U_N,N   )
-    for(int64_t j = 0; j < nb; j++) {
-        auto event1 = mkl::blas::copy(queue, nb,   &D(0, (n-2)*nb + j), 1, &A(0,    j), 1);
-        auto event2 = mkl::blas::copy(queue, nb,  &DL(0, (n-2)*nb + j), 1, &A(nb+0,    j), 1);
-        auto event3 = mkl::blas::copy(queue, nb, &DU1(0, (n-2)*nb + j), 1, &A(   0, nb+j), 1);
-        auto event4 = mkl::blas::copy(queue, nb,   &D(0, (n-1)*nb + j), 1, &A(nb+0, nb+j), 1);
-        event1.wait_and_throw();
-        event2.wait_and_throw();
-        event3.wait_and_throw();
-        event4.wait_and_throw();
-    }
-
-    // Pivoting array for the last factorization has 2*NB elements stored in
-    // two last columns of IPIV
-    try {
-        std::int64_t scratchpad_size = mkl::lapack::getrf_scratchpad_size<double>(queue, 2*nb, 2*nb, lda);
-        double* scratchpad = sycl::malloc_shared<double>(scratchpad_size, device, context);
-        if (!scratchpad) {
-            info = -1000;
-            goto cleanup;
+            if (k < n-2) {
+                // Partial factorization of the submatrix
+                //     (D_K    C_K   0    )        (L_K,K    )   (U_K,K U_K,K+1, U_K,K+2)
+                //     (                  )  = P * (         ) *                          
+                //     (B_K  D_K+1   C_K+1)        (L_K+1,K+1)                            
+                //
+                //    (  0    0       0     )
+                //  + (                     )
+                //    (  0    D'_K+1  C'_K+1)
+                events = {ptldgetrf_batch(queue, 2*nb, 3*nb, nb, next, lda, stride_a, ipiv + k*nb, stride_ipiv, batch, scratchpad, scratchpad_size, events)};
+            }
+            else if (k == n-2) {
+                // Factorization of the last 2*NBx2*NB submatrix
+                //  (D_N-1    C_N-1)          (L_N-1,N-1      0)   (U_N-1,N-1   U_N-1,N )
+                //  (              ) = P_N-1* (                ) * (                    )
+                //  (B_N-1      D_N)          (  L_N,N-1  L_N,N)   (      0     U_N,N   )
+                // Pivoting array for the last factorization has 2*NB elements 
+                // stored in two last columns of IPIV
+                events = {ptldgetrf_batch(queue, 2*nb, 2*nb, 2*nb, next, lda, stride_a, ipiv + k*nb, stride_ipiv, batch, scratchpad, scratchpad_size, events)};
+            }
         }
-        auto event1 = mkl::lapack::getrf(queue, 2*nb, 2*nb, &A(0,0), lda, &IPIV(0,n-2), scratchpad, scratchpad_size );
-        event1.wait_and_throw();
-        sycl::free(scratchpad, context);
+        for (auto& event : events)
+            event.wait_and_throw();
     } catch(mkl::lapack::exception const& e) {
         // Handle LAPACK related exceptions happened during synchronous call
         std::cout << "Unexpected exception caught during synchronous call to LAPACK API:\ninfo: " << e.info() << std::endl;
-        if (e.info() > 0) {
-        // INFO is equal to the 'global' index of the element u_ii of the factor  
-        // U which is equal to zero
-            info = e.info() + (n-2)*nb;
+        if (e.info() < 0) {
+            info = e.info();
+            goto cleanup;
         }
-        return info;
-    }
-
-    // Copy the last result back to arrays:
-    // L_N-1,N-1, L_N,N, U_N-1,N-1, U_N,N  -> D
-    // L_N,N-1  -> DL
-    // U_N-1,N  -> DU1
-    for (int64_t j = 0; j < nb; j++) {
-        auto event1 = mkl::blas::copy(queue, nb,    &A(0,      j), 1,   &D(0, (n-2)*nb + j), 1);
-        auto event2 = mkl::blas::copy(queue, nb, &A(nb+0,      j), 1,  &DL(0, (n-2)*nb + j), 1);
-        auto event3 = mkl::blas::copy(queue, nb,    &A(0, nb + j), 1, &DU1(0, (n-2)*nb + j), 1);
-        auto event4 = mkl::blas::copy(queue, nb, &A(nb+0, nb + j), 1,   &D(0, (n-1)*nb + j), 1);
-        event1.wait_and_throw();
-        event2.wait_and_throw();
-        event3.wait_and_throw();
-        event4.wait_and_throw();
+        queue.wait();
     }
 
-    sycl::free(a, context);
-    return info;
+    // INFO is equal to the smallest 'global' index of an element u_ii of 
+    // the factors U which is equal to zero
+    *zero_pivot = n*nb;
+    queue.submit([&](sycl::handler& cgh) {
+        cgh.parallel_for(sycl::range<2>(batch, n*nb), [=] (sycl::id<2> it) {
+            const int64_t i = it[1];
+            if (d[it[0]*stride_d + i%nb + i*nb] == 0.0) {
+                sycl::atomic_ref<int64_t, sycl::memory_order::relaxed, sycl::memory_scope::device> ref(*zero_pivot);
+                ref.fetch_min(i);
+            }
+        });
+    }).wait_and_throw();
+    if (*zero_pivot < n*nb)
+        info = *zero_pivot + 1;
 
 cleanup:
     sycl::free(a, context);
+    sycl::free(scratchpad, context);
+    sycl::free(zero_pivot, context);
     return info;
 
 }
@@ -260,123 +336,94 @@ cleanup:
 /**********************************************************************
 * Purpose:
 * ========  
-* PTLDGETRF computes partial (in a case K<min(M,N)) LU factorization 
-* of matrix A = P*(L*U+A1)
+* PTLDGETRF_BATCH computes partial (in a case K<min(M,N)) LU 
+* factorizations of BATCH matrices A_S = P_S*(L_S*U_S+A1_S), as the 
+* previous PTLDGETRF did for a single matrix. The row interchanges 
+* are applied to the last N-K columns on the device, so the kernels 
+* are only ordered by events.
 *
 * Arguments:
 * ==========     
+*  QUEUE (input) sycl queue
+*     The device queue
+*
 *  M (input) int64_t
-*     The number of rows of the matrix A.  M >= 0.
+*     The number of rows of the matrices A_S.  M >= 0.
 *
 *  N (input) int64_t
-*     The number of columns of the matrix A.  N >= 0.
+*     The number of columns of the matrices A_S.  N >= 0.
 *     
 *  K (input) int64_t
-*     The number of columns of the matrix A participating in 
+*     The number of columns of the matrices A_S participating in 
 *     factorization. N >= K >= 0
 *
-*  A (input/output) double array, dimension (LDA)*(N)
-*     On entry, the M-by-N matrix A to be factored.
+*  A (input/output) double array, dimension STRIDE_A*BATCH
+*     On entry, the M-by-N matrices A_S to be factored, A_S starts 
+*         at A + S*STRIDE_A.
 *     On exit:
-*         if K >= min(M,N), A is overwritten by details of its LU
+*         if K >= min(M,N), A_S is overwritten by details of its LU
 *                 factorization as returned by DGETRF.
-*         if K < min(M,N), partial factorization A = P * (L * U + A1) 
-*             is performed where P is permutation matrix (pivoting);
-*         L is M by K lower trapezoidal (with unit diagonal) matrix  
-*             stored in lower MxK trapezoid of A. Diagonal units 
+*         if K < min(M,N), partial factorization A_S = P_S * (L_S * U_S + A1_S) 
+*             is performed where P_S is permutation matrix (pivoting);
+*         L_S is M by K lower trapezoidal (with unit diagonal) matrix  
+*             stored in lower MxK trapezoid of A_S. Diagonal units 
 *                 are not stored.
-*         U is K by N upper trapezoidal matrix stored in upper 
-*             K by N trapezoid of A;
-*         A1 is (M-K) by (N-K) residual stored in intersection
-*             of last M-K rows and last N-K columns of A.
+*         U_S is K by N upper trapezoidal matrix stored in upper 
+*             K by N trapezoid of A_S;
+*         A1_S is (M-K) by (N-K) residual stored in intersection
+*             of last M-K rows and last N-K columns of A_S.
 *
 *  LDA (input) int64_t
-*     The leading dimension of the array A.  LDA >= max(1,M).
+*     The leading dimension of the matrices A_S.  LDA >= max(1,M).
 *
-*  IPIV (output) int64_t array, dimension (min(M,K))
+*  STRIDE_A (input) int64_t
+*     The distance between the starts of consecutive matrices A_S.
+*
+*  IPIV (output) int64_t array, dimension STRIDE_IPIV*BATCH
 *     The pivot indices; for 1 <= i <= min(M,K), row i of the
-*     matrix was interchanged with row IPIV(i).
+*     matrix A_S was interchanged with row IPIV(i + S*STRIDE_IPIV).
+*
+*  STRIDE_IPIV (input) int64_t
+*     The distance between the pivot indices of consecutive matrices.
+*
+*  BATCH (input) int64_t
+*     The number of matrices.
+*
+*  SCRATCHPAD (workspace) double array, dimension SCRATCHPAD_SIZE
+*     The workspace of GETRF_BATCH for M by min(N,K) matrices.
+*
+*  EVENTS (input) 
+*     The events the factorizations depend on.
 *
-*  INFO (return) int64_t
-*     = 0:  successful exit
-*     < 0:  if INFO = -i, the i-th argument had an illegal value
-*     > 0:  if INFO = i, U(i,i) is exactly zero. The factorization
-*           can be not completed. 
+*  Returns the event of the last submitted kernel. Errors are reported 
+*  by exceptions of oneMKL.
 ***********************************************************************/
-#undef    A
-#undef    D
-#undef   DL
-#undef  DU1
-#undef  DU2
-#undef IPIV
-int64_t ptldgetrf(sycl::queue queue, int64_t m, int64_t n, int64_t k, double* a, int64_t lda, int64_t* ipiv) {
+sycl::event ptldgetrf_batch(sycl::queue queue, int64_t m, int64_t n, int64_t k, double* a, int64_t lda, int64_t stride_a, int64_t* ipiv, int64_t stride_ipiv, int64_t batch, double* scratchpad, int64_t scratchpad_size, const std::vector<sycl::event>& events) {
 
-    auto A = [=,&a](int64_t i, int64_t j) -> double& { return a[i + j*lda]; };
+    if(k >= std::min<int64_t>(m,n))
+        return mkl::lapack::getrf_batch(queue, m, n, a, lda, stride_a, ipiv, stride_ipiv, batch, scratchpad, scratchpad_size, events);
 
-    sycl::context context = queue.get_context();
-    sycl::device device = queue.get_device();
-
-    int64_t info=0;
-    if(m < 0)
-        info = -1;
-    else if(n < 0)
-        info = -2;
-    else if( (k > n) || (k <0))
-        info = -3;
-    else if(lda < m)
-        info = -5;
-
-    if(info)
-        return info;
-
-    if(k < std::min<int64_t>(m,n)) {
+    // LU factorization of first K columns
+    auto event1 = mkl::lapack::getrf_batch(queue, m, k, a, lda, stride_a, ipiv, stride_ipiv, batch, scratchpad, scratchpad_size, events);
 
-        // LU factorization of first K columns
-        {
-            try {
-                std::int64_t scratchpad_size = mkl::lapack::getrf_scratchpad_size<double>(queue, m, k, lda);
-                double* scratchpad = sycl::malloc_shared<double>(scratchpad_size, device, context);
-                if (!scratchpad) {
-                    info = -1000;
-                    return info;
+    // Applying permutations returned by DGETRF to last N-K columns
+    auto event2 = queue.submit([&](sycl::handler& cgh) {
+        cgh.depends_on(event1);
+        cgh.parallel_for(sycl::range<2>(batch, n-k), [=] (sycl::id<2> it) {
+            double* col = a + it[0]*stride_a + (k + it[1])*lda;
+            const int64_t* piv = ipiv + it[0]*stride_ipiv;
+            for (int64_t i = 0; i < k; i++) {
+                const int64_t p = piv[i] - 1;
+                if (p != i) {
+                    const double t = col[i];
+                    col[i] = col[p];
+                    col[p] = t;
                 }
-                auto event1 = mkl::lapack::getrf(queue, m, k, &A(0,0), lda, &ipiv[0], scratchpad, scratchpad_size );
-                event1.wait_and_throw();
-                sycl::free(scratchpad, context);
-            } catch(mkl::lapack::exception const& e) {
-                // Handle LAPACK related exceptions happened during synchronous call
-                std::cout << "Unexpected exception caught during synchronous call to LAPACK API:\ninfo: " << e.info() << std::endl;
-                if (e.info() > 0) {
-                    info = e.info();
-                }
-                return info;
-            }
-        }
-        for (int64_t i = 0; i < k; i++) {
-            if(ipiv[i] != i+1) {
-                // Applying permutations returned by DGETRF to last N-K columns
-                auto event1 = mkl::blas::swap(queue, n-k, &A(i,k), lda, &A(ipiv[i]-1, k), lda);
-                event1.wait_and_throw();
             }
-        }
-        // Updating A1
-        {
-            auto event1 = mkl::blas::trsm(queue, mkl::side::left, mkl::uplo::lower, mkl::transpose::nontrans, mkl::diag::unit, k, n-k, 1.0, &A(0,0), lda, &A(0,k), lda);
-            auto event2 = mkl::blas::gemm(queue, mkl::transpose::nontrans, mkl::transpose::nontrans, m-k, n-k, k, -1.0, &A(k,0), lda, &A(0,k), lda, 1.0, &A(k,k), lda, {event1});
-            event2.wait_and_throw();
-        }
-    }
-    else {
-            std::int64_t scratchpad_size = mkl::lapack::getrf_scratchpad_size<double>(queue, m, n, lda);
-            double* scratchpad = sycl::malloc_shared<double>(scratchpad_size, device, context);
-            if (!scratchpad) {
-                info = -1000;
-                return info;
-            }
-            auto event1 = mkl::lapack::getrf(queue, m, n, &A(0,0), lda, &ipiv[0], scratchpad, scratchpad_size );
-            event1.wait_and_throw();
-            sycl::free(scratchpad, context);
-    }
+        });
+    });
 
-    return info;
+    // Updating A1
+    auto event3 = mkl::blas::trsm_batch(queue, mkl::side::left, mkl::uplo::lower, mkl::transpose::nontrans, mkl::diag::unit, k, n-k, 1.0, a, lda, stride_a, a + k*lda, lda, stride_a, batch, {event2});
+    return mkl::blas::gemm_batch(queue, mkl::transpose::nontrans, mkl::transpose::nontrans, m-k, n-k, k, -1.0, a + k, lda, stride_a, a + k*lda, lda, stride_a, 1.0, a + k + k*lda, lda, stride_a, batch, {event3});
 }
@@ -22,9 +22,15 @@
 * residual ||A-L*U||. Computation of the residual and its Frobenius norm  
 * is done by function resid1 (for source see file auxi.cpp). 
 * Input block tridiagonal matrix A is randomly generated.
+* The batched factorization provided by function dgeblttrf_batch is 
+* tested the same way on a batch of matrices, and the performance 
+* (GFLOP/s) of both functions is reported for several N and NB.
 */
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <iomanip>
 #include <iostream>
 #include <vector>
 
@@ -34,11 +40,52 @@
 using namespace oneapi;
 
 int64_t dgeblttrf(sycl::queue queue, int64_t n, int64_t nb, double* d, double* dl, double* du1, double* du2, int64_t* ipiv);
+int64_t dgeblttrf_batch(sycl::queue queue, int64_t n, int64_t nb, int64_t batch, double* d, double* dl, double* du1, double* du2, int64_t* ipiv);
 double resid1( int64_t n, int64_t nb, double* dl,  double* d,  double* du1,  double* du2,  int64_t* ipiv,  double* dlcpy, double* dcpy, double* du1cpy);
 
 template<typename T>
 using allocator_t = sycl::usm_allocator<T, sycl::usm::alloc::shared>;
 
+// Number of floating point operations of the factorization of one matrix:
+// each of the N-2 partial factorizations of 2*NB x 3*NB panels takes 
+// (5/3 + 2 + 4)*NB^3 (GETRF of the first NB columns, TRSM and GEMM), and 
+// the last 2*NB x 2*NB factorization takes 16/3*NB^3
+double flops_dgeblttrf(int64_t n, int64_t nb) {
+    const double nb3 = (double)nb * nb * nb;
+    return (n >= 2) ? (n-2) * 23.0/3.0 * nb3 + 16.0/3.0 * nb3 : 2.0/3.0 * nb3;
+}
+
+// Factors BATCH random matrices (with DGEBLTTRF if BATCH is 1) after one
+// warm-up run, and returns the time of the factorization in seconds
+double time_dgeblttrf(sycl::queue& queue, int64_t n, int64_t nb, int64_t batch, int64_t& info) {
+    sycl::context context = queue.get_context();
+    sycl::device device = queue.get_device();
+    allocator_t<double> allocator_d(context, device);
+    allocator_t<int64_t> allocator_i(context, device);
+
+    std::vector<double, allocator_t<double>> d(batch* nb* n*nb, allocator_d);
+    std::vector<double, allocator_t<double>> dl(batch* nb* (n-1)*nb, allocator_d);
+    std::vector<double, allocator_t<double>> du1(batch* nb* (n-1)*nb, allocator_d);
+    std::vector<double, allocator_t<double>> du2(batch* nb* std::max<int64_t>(n-2, 1)*nb, allocator_d);
+    std::vector<int64_t, allocator_t<int64_t>> ipiv(batch* nb* n, allocator_i);
+    std::vector<MKL_INT> iseed = {1, 2, 3, 5};
+
+    double time = 0.0;
+    for (int run = 0; run < 2 && !info; run++) {
+        LAPACKE_dlarnv(2, iseed.data(), d.size(), d.data());
+        LAPACKE_dlarnv(2, iseed.data(), dl.size(), dl.data());
+        LAPACKE_dlarnv(2, iseed.data(), du1.size(), du1.data());
+
+        auto start = std::chrono::steady_clock::now();
+        if (batch == 1)
+            info = dgeblttrf(queue, n, nb, d.data(), dl.data(), du1.data(), du2.data(), ipiv.data());
+        else
+            info = dgeblttrf_batch(queue, n, nb, batch, d.data(), dl.data(), du1.data(), du2.data(), ipiv.data());
+        time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return time;
+}
+
 int main(){
 
     if (sizeof(MKL_INT) != sizeof(int64_t)) {
@@ -132,5 +179,76 @@ int main(){
     double eps = resid1(n, nb, dl.data(), d.data(), du1.data(), du2.data(), ipiv.data(), dlcpy.data(), dcpy.data(), du1cpy.data());
     std::cout << "||A - LU||_F/||A||_F = " << eps << std::endl;
 
+    // Factoring a batch of matrices at once
+    const int64_t batch = 8;
+    std::vector<double, allocator_t<double>> bd(batch* nb* n*nb, allocator_d);
+    std::vector<double, allocator_t<double>> bdl(batch* nb* (n-1)*nb, allocator_d);
+    std::vector<double, allocator_t<double>> bdu1(batch* nb* (n-1)*nb, allocator_d);
+    std::vector<double, allocator_t<double>> bdu2(batch* nb* (n-2)*nb, allocator_d);
+    std::vector<int64_t, allocator_t<int64_t>> bipiv(batch* nb* n, allocator_i);
+
+    std::cout << std::endl;
+    std::cout << "Testing accuracy of batched LU factorization of " << batch << std::endl;
+    std::cout << "randomly generated block tridiagonal matrices." << std::endl;
+
+    LAPACKE_dlarnv(2, iseed.data(), bd.size(), bd.data());
+    LAPACKE_dlarnv(2, iseed.data(), bdl.size(), bdl.data());
+    LAPACKE_dlarnv(2, iseed.data(), bdu1.size(), bdu1.data());
+    std::vector<double> bdcpy(bd.begin(), bd.end());
+    std::vector<double> bdlcpy(bdl.begin(), bdl.end());
+    std::vector<double> bdu1cpy(bdu1.begin(), bdu1.end());
+
+    try {
+        info = dgeblttrf_batch(queue, n, nb, batch, bd.data(), bdl.data(), bdu1.data(), bdu2.data(), bipiv.data());
+    } catch(sycl::exception const& e) {
+        // Handle not LAPACK related exceptions happened during synchronous call
+        std::cout << "Unexpected exception caught during synchronous call to SYCL API:\n" << e.what() << std::endl;
+        info = -1;
+    }
+    if(info){
+        std::cout << "DGEBLTTRF_BATCH returned nonzero INFOi = " << info << std::endl;
+        return 1;
+    }
+
+    double eps_max = 0.0;
+    for (int64_t s = 0; s < batch; s++) {
+        eps = resid1(n, nb, &bdl[s*nb*(n-1)*nb], &bd[s*nb*n*nb], &bdu1[s*nb*(n-1)*nb], &bdu2[s*nb*(n-2)*nb], &bipiv[s*nb*n],
+                     &bdlcpy[s*nb*(n-1)*nb], &bdcpy[s*nb*n*nb], &bdu1cpy[s*nb*(n-1)*nb]);
+        eps_max = std::max(eps_max, eps);
+    }
+    std::cout << "max_(s=1,...,batch){||A(s) - LU(s)||_F/||A(s)||_F} = " << eps_max << std::endl;
+
+    // Performance of single and batched factorizations. The batch holds
+    // about 2^22 elements of D, to keep the memory use bounded for large N*NB^2
+    std::cout << std::endl;
+    std::cout << "Performance of LU factorization (GFLOP/s)" << std::endl;
+    std::cout << std::setw(6) << "N" << std::setw(6) << "NB"
+              << std::setw(14) << "DGEBLTTRF"
+              << std::setw(8) << "batch" << std::setw(14) << "batched"
+              << std::setw(14) << "ms/matrix" << std::endl;
+    for (int64_t pn : {16, 64, 256}) {
+        for (int64_t pnb : {8, 16, 32, 64}) {
+            const int64_t pbatch = std::min<int64_t>(256, std::max<int64_t>(1, (int64_t(1) << 22) / (pn*pnb*pnb)));
+            const double flops = flops_dgeblttrf(pn, pnb);
+            double time1 = 0.0, timeb = 0.0;
+            try {
+                time1 = time_dgeblttrf(queue, pn, pnb, 1, info);
+                timeb = time_dgeblttrf(queue, pn, pnb, pbatch, info);
+            } catch(sycl::exception const& e) {
+                std::cout << "Unexpected exception caught during synchronous call to SYCL API:\n" << e.what() << std::endl;
+                info = -1;
+            }
+            if(info){
+                std::cout << "DGEBLTTRF_BATCH returned nonzero INFOi = " << info << std::endl;
+                return 1;
+            }
+            std::cout << std::setw(6) << pn << std::setw(6) << pnb << std::fixed << std::setprecision(2)
+                      << std::setw(14) << flops / time1 * 1e-9
+                      << std::setw(8) << pbatch << std::setw(14) << pbatch * flops / timeb * 1e-9
+                      << std::setw(14) << std::setprecision(4) << timeb / pbatch * 1e3 << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+        }
+    }
+
     return 0;
 }
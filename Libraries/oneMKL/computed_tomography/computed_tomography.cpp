@@ -11,13 +11,20 @@
 ************************************************************************
 * Usage:
 * ======
-*      program.out p q input.bmp radon.bmp restored.bmp
+*      program.out p q input.bmp radon.bmp restored.bmp [nslices [batch [ring]]]
 *      Input:
 *      p, q - parameters of Radon transform
 *      input.bmp - must be a 24-bit uncompressed input bitmap
+*      nslices - number of slices of the volumetric reconstruction
+*                (default 0, no volumetric reconstruction)
+*      batch - number of slices reconstructed together (default 8)
+*      ring - number of batches in flight (default 3)
 *      Output:
 *      radon.bmp - p-by-(2q+1) result of Radon transform of input.bmp
 *      restored.bmp - 2q-by-2q result of FFT-based reconstruction
+*      sinograms.raw - nslices p-by-(2q+1) sinograms of the volume
+*      volume.raw - nslices 2q-by-2q reconstructed slices of the volume
+*      volume_slice.bmp - middle slice of volume.raw
 *
 * Steps:
 * ======
@@ -32,14 +39,30 @@
 *         onto Cartesian grid.
 *      3) Perform one 2-D inverse FFT to obtain the reconstructed
 *         image using oneMKL DFT DPCPP asynchronous USM API.
+*
+* Volumetric reconstruction:
+* ==========================
+*      - The sinograms of a stack of slices are written to sinograms.raw
+*        (slice z of the volume is input.bmp rotated by z*PI/nslices).
+*      - The slices are read from the file and reconstructed in batches
+*        of 'batch' slices: one 1-D FFT descriptor transforms the
+*        projections of all slices of a batch, and one 2-D inverse FFT
+*        descriptor the Cartesian grids of all slices of a batch.
+*      - The batches stream through a ring of 'ring' device buffers, so
+*        that reading the next batches and writing the previous ones to
+*        volume.raw overlap with the reconstruction, and the memory used
+*        does not depend on the number of slices.
 */
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <complex>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -104,6 +127,14 @@ sycl::event step3_ifft_2d(matrix_r &fhat,
                           sycl::queue &main_queue,
                           const std::vector<sycl::event> &deps = {});
 
+// Volumetric reconstruction functions
+void write_volume_sinograms(std::string fname, const matrix_r &radon_image, int nslices);
+void reconstruct_volume(std::string sinogram_fname, std::string volume_fname,
+                        int p, int q, int nslices, int batch, int ring,
+                        sycl::queue &main_queue);
+double reconstruct_slices(std::string sinogram_fname, matrix_r &fhat,
+                          int p, int q, int nslices, sycl::queue &main_queue);
+
 // Support functions
 void bmp_read(matrix_r &image, std::string fname);
 void bmp_write(std::string fname, const matrix_r &image, bool isComplex);
@@ -127,6 +158,10 @@ int main(int argc, char **argv)
     std::string radon_bmpname    = argc > 4 ? argv[4] : "radon.bmp";
     std::string restored_bmpname = argc > 5 ? argv[5] : "restored.bmp";
 
+    int nslices = argc > 6 ? atoi(argv[6]) : 0; // # of slices of the volume
+    int batch   = argc > 7 ? atoi(argv[7]) : 8; // # of slices reconstructed together
+    int ring    = argc > 8 ? atoi(argv[8]) : 3; // # of batches in flight
+
     auto exception_handler = [](sycl::exception_list exceptions) {
         for (std::exception_ptr const &e : exceptions) {
             try {
@@ -182,7 +217,66 @@ int main(int argc, char **argv)
     step3.wait(); // Wait for the reconstructed image
     bmp_write(restored_bmpname, fhat, true);
 
-    return 0;
+    bool passed = true;
+    if (nslices > 0) {
+        if (batch <= 0 || ring <= 0)
+            die("batch and ring must be positive\n");
+
+        std::cout << "Writing sinograms of " << nslices << " slices to sinograms.raw" << std::endl;
+        write_volume_sinograms("sinograms.raw", radon_image, nslices);
+
+        // Reference: the first slices reconstructed one by one as above
+        int nref = std::min(nslices, batch);
+        std::cout << "Restoring " << nref << " slices one by one" << std::endl;
+        matrix_r fref(main_queue);
+        double ref_time = reconstruct_slices("sinograms.raw", fref, p, q, nref, main_queue);
+        std::cout << "  " << ref_time / nref * 1e3 << " ms per slice" << std::endl;
+
+        std::cout << "Restoring " << nslices << " slices in batches of " << batch
+                  << " with " << ring << " batches in flight" << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        reconstruct_volume("sinograms.raw", "volume.raw", p, q, nslices, batch, ring, main_queue);
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "  " << time / nslices * 1e3 << " ms per slice, including file I/O" << std::endl;
+
+        // Check the last reference slice and save the middle slice of the volume
+        matrix_r slice(main_queue);
+        slice.allocate(2 * q, 2 * q, 2 * q);
+        if (!slice.data)
+            die("cannot allocate memory for slice\n");
+        std::fstream fp("volume.raw", std::fstream::in | std::fstream::binary);
+        fp.seekg(std::streamoff(sizeof(REAL_DATA)) * (nref - 1) * slice.h * slice.w);
+        fp.read((char *)slice.data, sizeof(REAL_DATA) * slice.h * slice.w);
+        if (!fp)
+            die("error reading volume.raw\n");
+        REAL_DATA maxdiff = 0, maxabs = 0;
+        for (int i = 0; i < slice.h; ++i)
+            for (int j = 0; j < slice.w; ++j) {
+                REAL_DATA ref = std::abs(((complex *)fref.data)[i * fref.ldw / 2 + j]);
+                maxdiff = std::max(maxdiff, std::abs(slice.data[i * slice.ldw + j] - ref));
+                maxabs  = std::max(maxabs, ref);
+            }
+        // Both reconstructions do the same operations, batched or not, so they
+        // only differ by rounding
+        const REAL_DATA tolerance = 1000 * std::numeric_limits<REAL_DATA>::epsilon();
+        REAL_DATA reldiff = maxdiff / maxabs;
+        std::cout << "Max relative difference of slice " << nref - 1
+                  << " to the one by one reconstruction: " << reldiff << std::endl;
+        if (!(reldiff <= tolerance)) {
+            std::cout << "Volumetric reconstruction FAILED: difference exceeds "
+                      << tolerance << std::endl;
+            passed = false;
+        }
+
+        fp.seekg(std::streamoff(sizeof(REAL_DATA)) * (nslices / 2) * slice.h * slice.w);
+        fp.read((char *)slice.data, sizeof(REAL_DATA) * slice.h * slice.w);
+        if (!fp)
+            die("error reading volume.raw\n");
+        std::cout << "Saving middle slice of the volume to volume_slice.bmp" << std::endl;
+        bmp_write("volume_slice.bmp", slice, false);
+    }
+
+    return passed ? 0 : 1;
 }
 
 // Step 1: batch of 1d r2c fft.
@@ -215,6 +309,47 @@ sycl::event step1_fft_1d(matrix_r &radon,
     return fft1d_ev;
 }
 
+// Interpolation of row i of the Cartesian grid ft (h-by-w complex'es)
+// from the radial grid rt (p-by-(q+1) complex'es)
+inline void interpolate_row(int i, const complex *rt, int q, int ldq, int p,
+                            complex *ft, int h, int w, int ldw)
+{
+    for (int j = 0; j < w; ++j) {
+        REAL_DATA yy    = 2.0 * i / h - 1; // yy = [-1...1]
+        REAL_DATA xx    = 2.0 * j / w - 1; // xx = [-1...1]
+        REAL_DATA r     = sycl::sqrt(xx * xx + yy * yy);
+        REAL_DATA phi   = sycl::atan2(yy, xx);
+        complex fhat_ij = complex(0.);
+        if (r <= 1) {
+            if (phi < 0) {
+                r = -r;
+                phi += M_PI;
+            }
+
+            int qq = sycl::floor(REAL_DATA(q + r * q + 0.5)) - q; // qq = [-q...q)
+            if (qq >= q)
+                qq = q - 1;
+
+            int pp = sycl::floor(REAL_DATA(phi / M_PI * p + 0.5)); // pp = [0...p)
+            if (pp >= p)
+                pp = p - 1;
+
+            if (qq >= 0)
+                fhat_ij = rt[pp * ldq + qq];
+            else
+                fhat_ij = std::conj(rt[pp * ldq - qq]);
+
+            if (is_odd(qq))
+                fhat_ij = -fhat_ij;
+            if (is_odd(i))
+                fhat_ij = -fhat_ij;
+            if (is_odd(j))
+                fhat_ij = -fhat_ij;
+        }
+        ft[i * ldw + j] = fhat_ij;
+    }
+}
+
 // Step 2: interpolation to Cartesian grid.
 // ifreq_dom[x, y] <-- interpolation( freq_dom[theta, ksi] )
 sycl::event step2_interpolation(matrix_r &fhat,
@@ -242,41 +377,7 @@ sycl::event step2_interpolation(matrix_r &fhat,
         auto interpolateKernel = [=](sycl::item<1> item) {
             const int i = item.get_id(0);
 
-            for (int j = 0; j < w; ++j) {
-                REAL_DATA yy    = 2.0 * i / h - 1; // yy = [-1...1]
-                REAL_DATA xx    = 2.0 * j / w - 1; // xx = [-1...1]
-                REAL_DATA r     = sycl::sqrt(xx * xx + yy * yy);
-                REAL_DATA phi   = sycl::atan2(yy, xx);
-                complex fhat_ij = complex(0.);
-                if (r <= 1) {
-                    if (phi < 0) {
-                        r = -r;
-                        phi += M_PI;
-                    }
-
-                    int qq = sycl::floor(REAL_DATA(q + r * q + 0.5)) - q; // qq = [-q...q)
-                    if (qq >= q)
-                        qq = q - 1;
-
-                    int pp = sycl::floor(REAL_DATA(phi / M_PI * p + 0.5)); // pp = [0...p)
-                    if (pp >= p)
-                        pp = p - 1;
-
-                    if (qq >= 0)
-                        fhat_ij = rt[pp * ldq + qq];
-                    else
-                        fhat_ij = std::conj(rt[pp * ldq - qq]);
-
-                    if (is_odd(qq))
-                        fhat_ij = -fhat_ij;
-                    if (is_odd(i))
-                        fhat_ij = -fhat_ij;
-                    if (is_odd(j))
-                        fhat_ij = -fhat_ij;
-                }
-                ft[i * ldw + j] = fhat_ij;
-            }
-
+            interpolate_row(i, rt, q, ldq, p, ft, h, w, ldw);
         };
 
         cgh.parallel_for<class interpolateKernelClass>(sycl::range<1>(h), interpolateKernel);
@@ -302,6 +403,226 @@ sycl::event step3_ifft_2d(matrix_r &fhat,
     return ifft2d_ev;
 }
 
+// Write the sinograms of a volume of nslices slices to fname. Slice z is the
+// object of radon_image rotated by z*PI/nslices: its projection i is the
+// projection i + shift of radon_image, where the projections past PI are
+// the first ones mirrored in s.
+void write_volume_sinograms(std::string fname, const matrix_r &radon_image, int nslices)
+{
+    int p = radon_image.h, w = radon_image.w, ldw = radon_image.ldw;
+
+    std::fstream fp;
+    fp.open(fname, std::fstream::out | std::fstream::binary);
+    if (fp.fail())
+        die("cannot open the file %s\n", fname);
+
+    std::vector<REAL_DATA> row(w);
+    for (int z = 0; z < nslices; ++z) {
+        int shift = int((long long)z * p / nslices);
+        for (int i = 0; i < p; ++i) {
+            int ii = (i + shift) % p;
+            const REAL_DATA *src = radon_image.data + ii * ldw;
+            for (int j = 0; j < w; ++j)
+                row[j] = (i + shift < p) ? src[j] : src[w - 1 - j];
+            fp.write((char *)row.data(), sizeof(REAL_DATA) * w);
+        }
+    }
+
+    if (!fp)
+        die("error writing %s\n", fname);
+    fp.close();
+}
+
+// Read count p-by-(2q+1) sinograms from fp to data, with leading dimension ldw
+void read_sinograms(std::fstream &fp, REAL_DATA *data, int count, int p, int w, int ldw)
+{
+    for (int i = 0; i < count * p; ++i)
+        fp.read((char *)(data + (std::size_t)i * ldw), sizeof(REAL_DATA) * w);
+    if (!fp)
+        die("error reading sinograms\n");
+}
+
+// Reconstruct the first nslices slices of sinogram_fname one by one with
+// steps 1-3, setting up the descriptors for every slice. The last slice is
+// left in fhat. Returns the time of the reconstructions in seconds.
+double reconstruct_slices(std::string sinogram_fname, matrix_r &fhat,
+                          int p, int q, int nslices, sycl::queue &main_queue)
+{
+    std::fstream fp;
+    fp.open(sinogram_fname, std::fstream::in | std::fstream::binary);
+    if (fp.fail())
+        die("cannot open the file %s\n", sinogram_fname);
+
+    matrix_r radon_image(main_queue);
+    radon_image.allocate(p, 2 * q + 1, 2 * q + 2);
+    fhat.allocate(2 * q, 2 * 2 * q, 2 * 2 * q);
+    if (!radon_image.data || !fhat.data)
+        die("cannot allocate memory for slices\n");
+
+    double time = 0;
+    for (int z = 0; z < nslices; ++z) {
+        read_sinograms(fp, radon_image.data, 1, p, radon_image.w, radon_image.ldw);
+
+        auto start = std::chrono::steady_clock::now();
+        descriptor_real fft1d((radon_image.w) - 1);
+        auto step1 = step1_fft_1d(radon_image, fft1d, main_queue);
+        auto step2 = step2_interpolation(fhat, radon_image, main_queue, {step1});
+        descriptor_complex ifft2d({fhat.h, (fhat.w) / 2});
+        auto step3 = step3_ifft_2d(fhat, ifft2d, main_queue, {step2});
+        step3.wait();
+        time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    fp.close();
+    return time;
+}
+
+// A slot of the ring of buffers for a batch of slices in flight, with its
+// own committed descriptors
+struct volume_slot {
+    REAL_DATA *sinograms = NULL; // host, batch p-by-ldw sinograms
+    REAL_DATA *slices    = NULL; // host, batch 2q-by-2q reconstructed slices
+    REAL_DATA *radon     = NULL; // device, batch p-by-ldw sinograms
+    REAL_DATA *fhat      = NULL; // device, batch 2q-by-4q Cartesian grids
+    REAL_DATA *image     = NULL; // device, batch 2q-by-2q reconstructed slices
+    descriptor_real *fft1d      = NULL;
+    descriptor_complex *ifft2d = NULL;
+    sycl::event done; // completion of the copy of slices to the host
+    int count = 0;    // # of slices of the batch in the slot
+};
+
+// Reconstruct the nslices sinograms of sinogram_fname to volume_fname in
+// batches of batch slices. Batch b uses slot b % ring: before the slot is
+// reused, its previous batch is written to volume_fname, and the slot is
+// filled with the sinograms of batch b while the other batches in flight
+// are reconstructed.
+void reconstruct_volume(std::string sinogram_fname, std::string volume_fname,
+                        int p, int q, int nslices, int batch, int ring,
+                        sycl::queue &main_queue)
+{
+    std::int64_t w     = 2 * q + 1;
+    std::int64_t ldw   = 2 * q + 2; // in REAL_DATA's, room for in-place r2c
+    std::int64_t h     = 2 * q;     // Cartesian grid is h-by-h complex'es
+    std::int64_t ldf   = 2 * q;     // in complex'es
+    std::int64_t sinogram_size = p * ldw;
+    std::int64_t fhat_size     = h * ldf; // in complex'es
+    std::int64_t slice_size    = h * h;
+    REAL_DATA scale = 1.0 / sqrt(0.0 + 2 * q);
+
+    std::fstream in, out;
+    in.open(sinogram_fname, std::fstream::in | std::fstream::binary);
+    if (in.fail())
+        die("cannot open the file %s\n", sinogram_fname);
+    out.open(volume_fname, std::fstream::out | std::fstream::binary);
+    if (out.fail())
+        die("cannot open the file %s\n", volume_fname);
+
+    sycl::device dev = main_queue.get_device();
+    sycl::context ctx = main_queue.get_context();
+
+    std::vector<volume_slot> slots(std::min(ring, (nslices + batch - 1) / batch));
+    for (auto &slot : slots) {
+        slot.sinograms = sycl::malloc_host<REAL_DATA>(batch * sinogram_size, ctx);
+        slot.slices    = sycl::malloc_host<REAL_DATA>(batch * slice_size, ctx);
+        slot.radon     = sycl::malloc_device<REAL_DATA>(batch * sinogram_size, dev, ctx);
+        slot.fhat      = sycl::malloc_device<REAL_DATA>(batch * 2 * fhat_size, dev, ctx);
+        slot.image     = sycl::malloc_device<REAL_DATA>(batch * slice_size, dev, ctx);
+        if (!slot.sinograms || !slot.slices || !slot.radon || !slot.fhat || !slot.image)
+            die("cannot allocate memory for the ring of slices\n");
+
+        // The p projections of every slice of the batch in one descriptor
+        slot.fft1d = new descriptor_real(2 * q);
+        slot.fft1d->set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS, batch * p);
+        slot.fft1d->set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE, ldw);     // in REAL_DATA's
+        slot.fft1d->set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE, ldw / 2); // in complex'es
+        slot.fft1d->set_value(oneapi::mkl::dft::config_param::FORWARD_SCALE, scale);
+        slot.fft1d->commit(main_queue);
+
+        // The Cartesian grids of every slice of the batch in one descriptor
+        std::int64_t strides[3] = {0, ldf, 1}; // in complex'es
+        slot.ifft2d = new descriptor_complex({h, h});
+        slot.ifft2d->set_value(oneapi::mkl::dft::config_param::INPUT_STRIDES, strides);
+        slot.ifft2d->set_value(oneapi::mkl::dft::config_param::NUMBER_OF_TRANSFORMS, batch);
+        slot.ifft2d->set_value(oneapi::mkl::dft::config_param::FWD_DISTANCE, fhat_size);
+        slot.ifft2d->set_value(oneapi::mkl::dft::config_param::BWD_DISTANCE, fhat_size);
+        slot.ifft2d->commit(main_queue);
+    }
+
+    // Wait for the batch in the slot and append it to the volume
+    auto drain = [&](volume_slot &slot) {
+        if (slot.count) {
+            slot.done.wait();
+            out.write((char *)slot.slices, sizeof(REAL_DATA) * slot.count * slice_size);
+            slot.count = 0;
+        }
+    };
+
+    int nbatches = (nslices + batch - 1) / batch;
+    for (int b = 0; b < nbatches; ++b) {
+        volume_slot &slot = slots[b % slots.size()];
+        drain(slot);
+
+        // The last batch may be partial, the remaining sinograms of the slot
+        // are reconstructed but not written
+        slot.count = std::min(batch, nslices - b * batch);
+        read_sinograms(in, slot.sinograms, slot.count, p, w, ldw);
+
+        auto load = main_queue.memcpy(slot.radon, slot.sinograms,
+                                      sizeof(REAL_DATA) * batch * sinogram_size);
+        auto step1 = oneapi::mkl::dft::compute_forward(*slot.fft1d, slot.radon, {load});
+
+        complex *rt = (complex *)slot.radon;
+        complex *ft = (complex *)slot.fhat;
+        std::int64_t ldq = ldw / 2;
+        auto step2 = main_queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(step1);
+            cgh.parallel_for<class interpolateBatchKernelClass>(
+                sycl::range<2>(batch, h), [=](sycl::item<2> item) {
+                    const int s = item.get_id(0);
+                    const int i = item.get_id(1);
+
+                    interpolate_row(i, rt + s * sinogram_size / 2, q, ldq, p,
+                                    ft + s * fhat_size, h, h, ldf);
+                });
+        });
+
+        auto step3 = oneapi::mkl::dft::compute_backward(*slot.ifft2d, slot.fhat, {step2});
+
+        REAL_DATA *image = slot.image;
+        auto magnitude = main_queue.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(step3);
+            cgh.parallel_for<class magnitudeKernelClass>(
+                sycl::range<2>(batch * h, h), [=](sycl::item<2> item) {
+                    const int i = item.get_id(0); // row of the batch
+                    const int j = item.get_id(1);
+
+                    complex f = ft[i * ldf + j];
+                    image[i * h + j] = sycl::sqrt(f.real() * f.real() + f.imag() * f.imag());
+                });
+        });
+
+        slot.done = main_queue.memcpy(slot.slices, slot.image,
+                                      sizeof(REAL_DATA) * batch * slice_size, magnitude);
+    }
+
+    // Write the batches still in flight, oldest first
+    for (int b = std::max(0, nbatches - int(slots.size())); b < nbatches; ++b)
+        drain(slots[b % slots.size()]);
+
+    if (!out)
+        die("error writing %s\n", volume_fname);
+
+    for (auto &slot : slots) {
+        delete slot.fft1d;
+        delete slot.ifft2d;
+        sycl::free(slot.sinograms, ctx);
+        sycl::free(slot.slices, ctx);
+        sycl::free(slot.radon, ctx);
+        sycl::free(slot.fhat, ctx);
+        sycl::free(slot.image, ctx);
+    }
+}
+
 // Simplified BMP structure.
 // See http://msdn.microsoft.com/en-us/library/dd183392(v=vs.85).aspx
 #pragma pack(push, 1)
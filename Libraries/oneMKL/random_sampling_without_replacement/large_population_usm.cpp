@@ -0,0 +1,338 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+/*
+*
+*  Content:
+*       This file contains Multiple Simple Random Sampling without replacement
+*       from large populations (Floyd's algorithm) and Multiple Weighted
+*       Random Sampling without replacement (alias method) for DPC++ USM-based
+*       interface and device API of random number generators
+*
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include "oneapi/mkl/rng/device.hpp"
+
+using namespace oneapi;
+
+// Initialization value for random number generator
+static const auto seed = 777;
+
+// Sampling default parameters
+static const size_t m_def = 100000; // sample size
+static const size_t n_def = 1000000000; // population size
+static const size_t num_exp_def = 64; // number of experiments
+// Population size of weighted sampling (it needs an alias table of n entries)
+static const size_t n_weighted_max = 10000000;
+// Draws of weighted sampling per sample element before an experiment gives up
+static const size_t max_draws_per_element = 16;
+
+// Entry of the alias table: column i is selected with probability
+// threshold / 2^32, otherwise its alias
+struct alias_entry {
+    std::uint32_t threshold;
+    std::uint32_t alias;
+};
+
+// Smallest power of 2 not less than 2 * m: the hash set of an experiment is
+// at most half full
+size_t hash_table_size(size_t m) {
+    size_t size = 1;
+    while (size < 2 * m) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Open-addressing hash set of population indices in global memory, with
+// linear probing. Stores index + 1, so that 0 marks an empty slot.
+struct hash_set {
+    std::uint32_t* table;
+    std::uint64_t mask;
+    int shift;
+
+    // Inserts v, returns false if v is already in the set
+    bool insert(std::uint32_t v) const {
+        std::uint32_t key = v + 1;
+        std::uint64_t slot = (static_cast<std::uint64_t>(key) * UINT64_C(0x9E3779B97F4A7C15)) >> shift;
+        while (table[slot] != 0) {
+            if (table[slot] == key) {
+                return false;
+            }
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = key;
+        return true;
+    }
+};
+
+// Random 64-bit integer from two 32-bit outputs of the engine
+template <typename Engine>
+std::uint64_t generate_bits64(Engine& engine) {
+    oneapi::mkl::rng::device::bits<std::uint32_t> distr;
+    std::uint64_t hi = oneapi::mkl::rng::device::generate(distr, engine);
+    std::uint64_t lo = oneapi::mkl::rng::device::generate(distr, engine);
+    return (hi << 32) | lo;
+}
+
+// Draws m of n numbers (1, ..., n) without replacement in each of num_exp
+// experiments with Floyd's algorithm: for j = n - m, ..., n - 1, a random
+// t from {0, ..., j} is added to the sample, or j if t is already in it.
+// Only the m sampled numbers are stored, in a hash set per experiment, so
+// n is only limited by the range of the 32-bit hash set entries. The
+// numbers of a sample are a uniformly random subset, but not in random order.
+double sample_floyd(sycl::queue& q, size_t m, size_t n, size_t num_exp, size_t* result_ptr) {
+    size_t table_size = hash_table_size(m);
+    std::uint32_t* table_ptr = sycl::malloc_device<std::uint32_t>(table_size * num_exp, q);
+    q.memset(table_ptr, 0, table_size * num_exp * sizeof(std::uint32_t)).wait_and_throw();
+
+    int shift = 64;
+    for (size_t size = table_size; size > 1; size /= 2) {
+        --shift;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    q.parallel_for(sycl::range<1>(num_exp), [=](sycl::id<1> idx) {
+        size_t id = idx[0];
+        hash_set set { table_ptr + id * table_size, table_size - 1, shift };
+        // Create an object of basic random numer generator (engine), each
+        // experiment uses 2 * m random numbers
+        oneapi::mkl::rng::device::philox4x32x10<> engine(seed, id * 2 * m);
+
+        for (size_t j = n - m, i = 0; j < n; ++j, ++i) {
+            // Generate random number t from {0, ..., j}
+            std::uint32_t t = static_cast<std::uint32_t>(sycl::mul_hi(generate_bits64(engine), static_cast<std::uint64_t>(j + 1)));
+            std::uint32_t v = set.insert(t) ? t : static_cast<std::uint32_t>(j);
+            if (v != t) {
+                set.insert(v);
+            }
+            result_ptr[id * m + i] = v + 1;
+        }
+    }).wait_and_throw();
+
+    auto end = std::chrono::steady_clock::now();
+
+    sycl::free(table_ptr, q);
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Builds the alias table of the weights with Vose's method
+std::vector<alias_entry> build_alias_table(const std::vector<double>& weights) {
+    size_t n = weights.size();
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+    std::vector<double> scaled(n);
+    std::vector<std::uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = weights[i] * n / total;
+        (scaled[i] < 1.0 ? small : large).push_back(static_cast<std::uint32_t>(i));
+    }
+
+    std::vector<alias_entry> table(n);
+    while (!small.empty() && !large.empty()) {
+        std::uint32_t s = small.back();
+        small.pop_back();
+        std::uint32_t l = large.back();
+        table[s].threshold = static_cast<std::uint32_t>(scaled[s] * 4294967296.0);
+        table[s].alias = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // The remaining columns are selected with probability 1 (up to rounding)
+    for (auto i : large) {
+        table[i] = { UINT32_MAX, i };
+    }
+    for (auto i : small) {
+        table[i] = { UINT32_MAX, i };
+    }
+    return table;
+}
+
+// Draws m of n numbers (1, ..., n) without replacement in each of num_exp
+// experiments, where number i + 1 is drawn with probability proportional to
+// its weight: numbers are drawn with the alias table in O(1) each, and
+// numbers already in the sample are redrawn. An experiment which needs more
+// than max_draws_per_element * m draws (weights concentrated on fewer than
+// about m numbers) gives up, and the rest of its sample is set to 0.
+double sample_weighted(sycl::queue& q, size_t m, const std::vector<alias_entry>& alias_table,
+                       size_t num_exp, size_t* result_ptr) {
+    size_t n = alias_table.size();
+    size_t max_draws = max_draws_per_element * m;
+    size_t table_size = hash_table_size(m);
+
+    alias_entry* alias_ptr = sycl::malloc_device<alias_entry>(n, q);
+    std::uint32_t* table_ptr = sycl::malloc_device<std::uint32_t>(table_size * num_exp, q);
+    q.memcpy(alias_ptr, alias_table.data(), n * sizeof(alias_entry));
+    q.memset(table_ptr, 0, table_size * num_exp * sizeof(std::uint32_t));
+    q.wait_and_throw();
+
+    int shift = 64;
+    for (size_t size = table_size; size > 1; size /= 2) {
+        --shift;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    q.parallel_for(sycl::range<1>(num_exp), [=](sycl::id<1> idx) {
+        size_t id = idx[0];
+        hash_set set { table_ptr + id * table_size, table_size - 1, shift };
+        // Each draw uses 3 random numbers
+        oneapi::mkl::rng::device::philox4x32x10<> engine(seed, id * 3 * max_draws);
+        oneapi::mkl::rng::device::bits<std::uint32_t> distr;
+
+        size_t i = 0;
+        for (size_t draw = 0; draw < max_draws && i < m; ++draw) {
+            // Select a column uniformly, then the column or its alias
+            std::uint64_t column = sycl::mul_hi(generate_bits64(engine), static_cast<std::uint64_t>(n));
+            alias_entry entry = alias_ptr[column];
+            std::uint32_t v = oneapi::mkl::rng::device::generate(distr, engine) < entry.threshold
+                                  ? static_cast<std::uint32_t>(column) : entry.alias;
+            if (set.insert(v)) {
+                result_ptr[id * m + i++] = v + 1;
+            }
+        }
+        for (; i < m; ++i) {
+            result_ptr[id * m + i] = 0;
+        }
+    }).wait_and_throw();
+
+    auto end = std::chrono::steady_clock::now();
+
+    sycl::free(table_ptr, q);
+    sycl::free(alias_ptr, q);
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// Checks that every sample consists of m distinct numbers from 1, ..., n,
+// returns the number of invalid samples
+size_t check_results(size_t* result_ptr, size_t m, size_t n, size_t num_exp) {
+    size_t invalid = 0;
+    std::vector<size_t> sample(m);
+    for (size_t i = 0; i < num_exp; ++i) {
+        std::copy(result_ptr + i * m, result_ptr + (i + 1) * m, sample.begin());
+        std::sort(sample.begin(), sample.end());
+        if (sample.front() < 1 || sample.back() > n
+            || std::adjacent_find(sample.begin(), sample.end()) != sample.end()) {
+            ++invalid;
+        }
+    }
+    return invalid;
+}
+
+// Prints the first numbers of the last 3 samples
+void print_results(size_t* result_ptr, size_t m, size_t num_exp) {
+    size_t count = std::min<size_t>(m, 6);
+    for (size_t i = num_exp - std::min<size_t>(num_exp, 3); i < num_exp; ++i) {
+        std::cout << "Sample " << i << " of " << num_exp << ": ";
+        for (size_t j = 0; j < count; ++j) {
+            std::cout << result_ptr[i * m + j] << ", ";
+        }
+        std::cout << (count < m ? "..." : "") << std::endl;
+    }
+}
+
+int main(int argc, char ** argv) {
+
+    std::cout << std::endl;
+    std::cout << "Multiple Simple Random Sampling without replacement" << std::endl;
+    std::cout << "Large population, Device API" << std::endl;
+    std::cout << "---------------------------------------------------" << std::endl;
+
+    size_t m = m_def;
+    size_t n = n_def;
+    size_t num_exp = num_exp_def;
+    if(argc >= 4) {
+        m = atol(argv[1]);
+        n = atol(argv[2]);
+        num_exp = atol(argv[3]);
+        if(m == 0 || n == 0 || num_exp == 0 || m > n || n >= UINT32_MAX) {
+            m = m_def;
+            n = n_def;
+            num_exp = num_exp_def;
+        }
+    }
+    size_t n_weighted = std::min(n, n_weighted_max);
+    size_t m_weighted = std::max<size_t>(1, std::min(m, n_weighted / 10));
+    std::cout << "M = " << m << ", N = " << n << ", Number of experiments = " << num_exp << std::endl;
+
+    // This exception handler will catch async exceptions
+    auto exception_handler = [&](sycl::exception_list exceptions) {
+        for(std::exception_ptr const& e : exceptions) {
+            try {
+                std::rethrow_exception(e);
+            } catch (sycl::exception const& e) {
+                std::cout << "Caught asynchronous SYCL exception:\n" << e.what() << std::endl;
+                std::terminate();
+            }
+        }
+    };
+
+    try {
+        // Queue constructor passed exception handler
+        sycl::queue q(sycl::default_selector{}, exception_handler);
+
+        // Simple random sampling with Floyd's algorithm
+        size_t* result_ptr = sycl::malloc_shared<size_t>(m * num_exp, q);
+        double time = sample_floyd(q, m, n, num_exp, result_ptr);
+
+        std::cout << "Results with Floyd's algorithm:" << std::endl;
+        print_results(result_ptr, m, num_exp);
+        double mean = std::accumulate(result_ptr, result_ptr + m * num_exp, 0.0) / (m * num_exp);
+        std::cout << "Invalid samples: " << check_results(result_ptr, m, n, num_exp) << std::endl;
+        std::cout << "Mean / expected mean: " << mean / (0.5 * (n + 1)) << std::endl;
+        std::cout << "Time: " << time << " s, " << m * num_exp / time << " samples/s" << std::endl;
+        std::cout << std::endl;
+        sycl::free(result_ptr, q);
+
+        // Weighted random sampling with the alias method: the weight of
+        // number i is 1 + (i - 1) % 10
+        std::cout << "M = " << m_weighted << ", N = " << n_weighted << ", Number of experiments = " << num_exp
+                  << ", weights 1, 2, ..., 10, 1, 2, ..." << std::endl;
+        std::vector<double> weights(n_weighted);
+        for (size_t i = 0; i < n_weighted; ++i) {
+            weights[i] = 1.0 + i % 10;
+        }
+        auto alias_table = build_alias_table(weights);
+
+        result_ptr = sycl::malloc_shared<size_t>(m_weighted * num_exp, q);
+        time = sample_weighted(q, m_weighted, alias_table, num_exp, result_ptr);
+
+        std::cout << "Results with alias method:" << std::endl;
+        print_results(result_ptr, m_weighted, num_exp);
+        std::cout << "Invalid samples: " << check_results(result_ptr, m_weighted, n_weighted, num_exp) << std::endl;
+        // Without replacement, heavy numbers are drawn slightly less often
+        // than their weight share, as they are more often already sampled
+        std::vector<double> frequency(10, 0.0);
+        for (size_t i = 0; i < m_weighted * num_exp; ++i) {
+            if (result_ptr[i] != 0) {
+                frequency[(result_ptr[i] - 1) % 10] += 1.0 / (m_weighted * num_exp);
+            }
+        }
+        std::cout << "Frequency of weight 1 / expected: " << frequency[0] * 55.0 << std::endl;
+        std::cout << "Frequency of weight 10 / expected: " << frequency[9] * 5.5 << std::endl;
+        std::cout << "Time: " << time << " s, " << m_weighted * num_exp / time << " samples/s" << std::endl;
+        std::cout << std::endl;
+        sycl::free(result_ptr, q);
+    } catch (...) {
+        // Some other exception detected
+        std::cout << "Failure" << std::endl;
+        std::terminate();
+    }
+
+    return 0;
+}
@@ -10,8 +10,8 @@
 *       This sample demonstrates use of oneAPI Math Kernel Library (oneMKL)
 *       sparse BLAS API to solve a system of linear equations (Ax=b).
 *
-*       It uses the preconditioned conjugate gradient method with a symmetric
-*       Gauss-Seidel preconditioner:
+*       It uses the preconditioned conjugate gradient method with a Jacobi,
+*       symmetric Gauss-Seidel (default) or ILU0 preconditioner:
 *
 *       Compute r_0 = b - Ax_0
 *       w_0 = B^{-1}*r_0 and p_0 = w_0
@@ -25,7 +25,21 @@
 *                   p_{k+1} = w_{k+1} + beta_k*p_k
 *           }
 *
-*       where A = -L+D-L^t; B = (D-L)*D^{-1}*(D-L^t).
+*       where A = -L+D-L^t; B = D for the Jacobi preconditioner,
+*       B = (D-L)*D^{-1}*(D-L^t) for the symmetric Gauss-Seidel one, and
+*       B = L_0*U_0 for the ILU0 one, where L_0 and U_0 are the incomplete
+*       LU factors of A with the sparsity pattern of A.
+*
+*       The matrix A is a 27-point stencil on a size x size x size grid, or
+*       it is read from a file in Matrix Market coordinate format:
+*
+*           sparse_cg [-p jacobi|sgs|ilu0] [-n size] [-tol tol]
+*                     [-maxit max_iterations] [-report interval] [matrix.mtx]
+*
+*       alpha_k and beta_k stay in device memory, and the vector updates and
+*       dot products of an iteration are fused into three kernels, so the
+*       host only waits for (w_k, w_k) once per iteration to check the
+*       convergence.
 *
 *       The supported floating point data types for gemm matrix data are:
 *           float
@@ -35,12 +49,18 @@
 
 // stl includes
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <list>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <sycl/sycl.hpp>
@@ -50,6 +70,26 @@
 
 using namespace oneapi;
 
+enum class preconditioner { jacobi, sgs, ilu0 };
+
+const char *preconditioner_name(preconditioner precond)
+{
+    switch (precond) {
+        case preconditioner::jacobi: return "Jacobi";
+        case preconditioner::sgs: return "symmetric Gauss-Seidel";
+        default: return "ILU0";
+    }
+}
+
+// Options of the example, set by the command line
+struct cg_options {
+    std::string matrix_file; // Matrix Market file, 27-point stencil if empty
+    std::int64_t size = 4;   // nx=ny=nz of the 27-point stencil
+    preconditioner precond = preconditioner::sgs;
+    double tol             = 1.e-3; // on the relative norm of correction
+    std::int32_t max_iter  = 100;
+    std::int32_t report    = 1; // iterations between convergence reports
+};
 
 template <typename fp, typename intType>
 static void diagonal_mv(sycl::queue main_queue,
@@ -58,7 +98,7 @@ static void diagonal_mv(sycl::queue main_queue,
                         sycl::buffer<fp, 1> &t_buffer)
 {
     main_queue.submit([&](sycl::handler &cgh) {
-        auto d = (d_buffer).template get_access<sycl::access::mode::write>(cgh);
+        auto d = (d_buffer).template get_access<sycl::access::mode::read>(cgh);
         auto t = (t_buffer).template get_access<sycl::access::mode::read_write>(cgh);
         auto diagonalMVKernel = [=](sycl::item<1> item) {
             const int row = item.get_id(0);
@@ -68,23 +108,213 @@ static void diagonal_mv(sycl::queue main_queue,
     });
 }
 
+// w = B^{-1}*r, t is a temporary vector. For the Jacobi preconditioner d
+// holds the inverse of the diagonal of A, otherwise the diagonal of A.
+template <typename fp, typename intType>
+static void precondition(sycl::queue main_queue,
+                         const preconditioner precond,
+                         const intType nrows,
+                         mkl::sparse::matrix_handle_t handle,
+                         mkl::sparse::matrix_handle_t ilu_handle,
+                         sycl::buffer<fp, 1> &d_buffer,
+                         sycl::buffer<fp, 1> &r_buffer,
+                         sycl::buffer<fp, 1> &t_buffer,
+                         sycl::buffer<fp, 1> &w_buffer)
+{
+    switch (precond) {
+        case preconditioner::jacobi:
+            mkl::blas::copy(main_queue, nrows, r_buffer, 1, w_buffer, 1);
+            diagonal_mv<fp, intType>(main_queue, nrows, d_buffer, w_buffer);
+            break;
+        case preconditioner::sgs:
+            mkl::sparse::trsv(main_queue, mkl::uplo::lower,
+                                      mkl::transpose::nontrans, mkl::diag::nonunit,
+                                      handle, r_buffer, t_buffer);
+            diagonal_mv<fp, intType>(main_queue, nrows, d_buffer, t_buffer);
+            mkl::sparse::trsv(main_queue, mkl::uplo::upper,
+                                      mkl::transpose::nontrans, mkl::diag::nonunit,
+                                      handle, t_buffer, w_buffer);
+            break;
+        case preconditioner::ilu0:
+            mkl::sparse::trsv(main_queue, mkl::uplo::lower,
+                                      mkl::transpose::nontrans, mkl::diag::unit,
+                                      ilu_handle, r_buffer, t_buffer);
+            mkl::sparse::trsv(main_queue, mkl::uplo::upper,
+                                      mkl::transpose::nontrans, mkl::diag::nonunit,
+                                      ilu_handle, t_buffer, w_buffer);
+            break;
+    }
+}
+
+// rw = (r, w) and ww = (w, w) in one kernel
+template <typename fp, typename intType>
+static void dot_rw_ww(sycl::queue main_queue,
+                      const intType nrows,
+                      sycl::buffer<fp, 1> &r_buffer,
+                      sycl::buffer<fp, 1> &w_buffer,
+                      sycl::buffer<fp, 1> &rw_buffer,
+                      sycl::buffer<fp, 1> &ww_buffer)
+{
+    main_queue.submit([&](sycl::handler &cgh) {
+        auto r      = (r_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto w      = (w_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto rw_sum = sycl::reduction(rw_buffer, cgh, sycl::plus<fp>(),
+                                      {sycl::property::reduction::initialize_to_identity()});
+        auto ww_sum = sycl::reduction(ww_buffer, cgh, sycl::plus<fp>(),
+                                      {sycl::property::reduction::initialize_to_identity()});
+        auto dotKernel = [=](sycl::item<1> item, auto &rw, auto &ww) {
+            const int row = item.get_id(0);
+            rw += r[row] * w[row];
+            ww += w[row] * w[row];
+        };
+        cgh.parallel_for(sycl::range<1>(nrows), rw_sum, ww_sum, dotKernel);
+    });
+}
+
+// pap = (p, t)
+template <typename fp, typename intType>
+static void dot_pap(sycl::queue main_queue,
+                    const intType nrows,
+                    sycl::buffer<fp, 1> &p_buffer,
+                    sycl::buffer<fp, 1> &t_buffer,
+                    sycl::buffer<fp, 1> &pap_buffer)
+{
+    main_queue.submit([&](sycl::handler &cgh) {
+        auto p       = (p_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto t       = (t_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto pap_sum = sycl::reduction(pap_buffer, cgh, sycl::plus<fp>(),
+                                       {sycl::property::reduction::initialize_to_identity()});
+        auto dotKernel = [=](sycl::item<1> item, auto &pap) {
+            const int row = item.get_id(0);
+            pap += p[row] * t[row];
+        };
+        cgh.parallel_for(sycl::range<1>(nrows), pap_sum, dotKernel);
+    });
+}
+
+// alpha = rw/pap, x = x + alpha*p and r = r - alpha*t in one kernel. With
+// the Jacobi preconditioner, the kernel also computes w = d*r and the dot
+// products rw_next = (r, w) and ww = (w, w) of the next iteration.
 template <typename fp, typename intType>
-void run_sparse_cg_example(const sycl::device &dev)
+static void update_solution(sycl::queue main_queue,
+                            const intType nrows,
+                            const bool jacobi,
+                            sycl::buffer<fp, 1> &rw_buffer,
+                            sycl::buffer<fp, 1> &pap_buffer,
+                            sycl::buffer<fp, 1> &p_buffer,
+                            sycl::buffer<fp, 1> &t_buffer,
+                            sycl::buffer<fp, 1> &d_buffer,
+                            sycl::buffer<fp, 1> &x_buffer,
+                            sycl::buffer<fp, 1> &r_buffer,
+                            sycl::buffer<fp, 1> &w_buffer,
+                            sycl::buffer<fp, 1> &rw_next_buffer,
+                            sycl::buffer<fp, 1> &ww_buffer)
 {
-    // Matrix data size
-    intType size  = 4;
-    intType nrows = size * size * size;
+    main_queue.submit([&](sycl::handler &cgh) {
+        auto rw  = (rw_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto pap = (pap_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto p   = (p_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto t   = (t_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto x   = (x_buffer).template get_access<sycl::access::mode::read_write>(cgh);
+        auto r   = (r_buffer).template get_access<sycl::access::mode::read_write>(cgh);
+        if (jacobi) {
+            auto d      = (d_buffer).template get_access<sycl::access::mode::read>(cgh);
+            auto w      = (w_buffer).template get_access<sycl::access::mode::write>(cgh);
+            auto rw_sum = sycl::reduction(rw_next_buffer, cgh, sycl::plus<fp>(),
+                                          {sycl::property::reduction::initialize_to_identity()});
+            auto ww_sum = sycl::reduction(ww_buffer, cgh, sycl::plus<fp>(),
+                                          {sycl::property::reduction::initialize_to_identity()});
+            auto updateKernel = [=](sycl::item<1> item, auto &rw_next, auto &ww) {
+                const int row = item.get_id(0);
+                const fp alpha = rw[0] / pap[0];
+                x[row] += alpha * p[row];
+                r[row] -= alpha * t[row];
+                w[row] = d[row] * r[row];
+                rw_next += r[row] * w[row];
+                ww += w[row] * w[row];
+            };
+            cgh.parallel_for(sycl::range<1>(nrows), rw_sum, ww_sum, updateKernel);
+        }
+        else {
+            auto updateKernel = [=](sycl::item<1> item) {
+                const int row = item.get_id(0);
+                const fp alpha = rw[0] / pap[0];
+                x[row] += alpha * p[row];
+                r[row] -= alpha * t[row];
+            };
+            cgh.parallel_for(sycl::range<1>(nrows), updateKernel);
+        }
+    });
+}
 
+// beta = rw_next/rw and p = w + beta*p
+template <typename fp, typename intType>
+static void update_direction(sycl::queue main_queue,
+                             const intType nrows,
+                             sycl::buffer<fp, 1> &rw_buffer,
+                             sycl::buffer<fp, 1> &rw_next_buffer,
+                             sycl::buffer<fp, 1> &w_buffer,
+                             sycl::buffer<fp, 1> &p_buffer)
+{
+    main_queue.submit([&](sycl::handler &cgh) {
+        auto rw      = (rw_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto rw_next = (rw_next_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto w       = (w_buffer).template get_access<sycl::access::mode::read>(cgh);
+        auto p       = (p_buffer).template get_access<sycl::access::mode::read_write>(cgh);
+        auto directionKernel = [=](sycl::item<1> item) {
+            const int row = item.get_id(0);
+            p[row] = w[row] + rw_next[0] / rw[0] * p[row];
+        };
+        cgh.parallel_for(sycl::range<1>(nrows), directionKernel);
+    });
+}
+
+template <typename fp, typename intType>
+void run_sparse_cg_example(const sycl::device &dev, const cg_options &opts)
+{
     // Input matrix in CSR format
     std::vector<intType> ia;
     std::vector<intType> ja;
     std::vector<fp> a;
+    intType nrows;
+
+    auto setup_start = std::chrono::steady_clock::now();
+    if (opts.matrix_file.empty()) {
+        // Matrix data size
+        intType size = opts.size;
+        nrows        = size * size * size;
 
-    ia.resize(nrows + 1);
-    ja.resize(27 * nrows);
-    a.resize(27 * nrows);
+        ia.resize(nrows + 1);
+        ja.resize(27 * nrows);
+        a.resize(27 * nrows);
 
-    generate_sparse_matrix<fp, intType>(size, ia, ja, a);
+        generate_sparse_matrix<fp, intType>(size, ia, ja, a);
+    }
+    else if (!read_matrix_market<fp, intType>(opts.matrix_file, nrows, ia, ja, a)) {
+        std::cout << "\t\tCannot read the matrix from " << opts.matrix_file << std::endl;
+        return;
+    }
+    else if (!is_symmetric<fp, intType>(nrows, ia, ja, a)) {
+        std::cout << "\t\tThe matrix in " << opts.matrix_file
+                  << " is not symmetric, which CG requires" << std::endl;
+        return;
+    }
+    else if (!has_nonzero_diagonal<fp, intType>(nrows, ia, ja, a)) {
+        std::cout << "\t\tThe matrix in " << opts.matrix_file
+                  << " has a missing or zero diagonal element" << std::endl;
+        return;
+    }
+    std::cout << "\t\tMatrix with " << nrows << " rows and " << ia[nrows]
+              << " nonzeros, " << preconditioner_name(opts.precond) << " preconditioner"
+              << std::endl;
+
+    // Incomplete factors for the ILU0 preconditioner, computed on the host
+    // (one dummy element for the other preconditioners)
+    std::vector<fp> lu(opts.precond == preconditioner::ilu0 ? 0 : 1);
+    if (opts.precond == preconditioner::ilu0 && !ilu0<fp, intType>(nrows, ia, ja, a, lu)) {
+        std::cout << "\t\tILU0 factorization failed: zero pivot" << std::endl;
+        return;
+    }
 
     // Vectors x and y
     std::vector<fp> x;
@@ -122,21 +352,29 @@ void run_sparse_cg_example(const sycl::device &dev)
     sycl::buffer<intType, 1> ia_buffer(ia.data(), nrows + 1);
     sycl::buffer<intType, 1> ja_buffer(ja.data(), ia[nrows]);
     sycl::buffer<fp, 1> a_buffer(a.data(), ia[nrows]);
+    sycl::buffer<fp, 1> lu_buffer(lu.data(), lu.size());
     sycl::buffer<fp, 1> x_buffer(x);
     sycl::buffer<fp, 1> b_buffer(b);
     sycl::buffer<fp, 1> r_buffer(nrows);
     sycl::buffer<fp, 1> w_buffer(nrows);
     sycl::buffer<fp, 1> p_buffer(nrows);
     sycl::buffer<fp, 1> t_buffer(nrows);
-    sycl::buffer<fp, 1> y_buffer(nrows);
     sycl::buffer<fp, 1> d_buffer(nrows);
-    sycl::buffer<fp, 1> temp_buffer(1);
 
-    // create and initialize handle for a Sparse Matrix in CSR format
+    // Scalars of the iterations: (r_k, w_k) alternates between two buffers,
+    // (r_k, w_k) of iteration k is read from rw_buffer[k % 2]
+    sycl::buffer<fp, 1> rw_buffer[2] = {sycl::buffer<fp, 1>(1), sycl::buffer<fp, 1>(1)};
+    sycl::buffer<fp, 1> pap_buffer(1);
+    sycl::buffer<fp, 1> ww_buffer(1);
+
+    // create and initialize handle for a Sparse Matrix in CSR format, and
+    // for its incomplete LU factors
     mkl::sparse::matrix_handle_t handle;
+    mkl::sparse::matrix_handle_t ilu_handle;
 
     try {
         mkl::sparse::init_matrix_handle(&handle);
+        mkl::sparse::init_matrix_handle(&ilu_handle);
 
         mkl::sparse::set_csr_data(handle, nrows, nrows, mkl::index_base::zero,
                                           ia_buffer, ja_buffer, a_buffer);
@@ -144,14 +382,28 @@ void run_sparse_cg_example(const sycl::device &dev)
         mkl::sparse::set_matrix_property(handle, mkl::sparse::property::symmetric);
         mkl::sparse::set_matrix_property(handle, mkl::sparse::property::sorted);
 
-        mkl::sparse::optimize_trsv(main_queue, mkl::uplo::lower,
-                                           mkl::transpose::nontrans,
-                                           mkl::diag::nonunit, handle);
-        mkl::sparse::optimize_trsv(main_queue, mkl::uplo::upper,
-                                           mkl::transpose::nontrans,
-                                           mkl::diag::nonunit, handle);
+        if (opts.precond == preconditioner::sgs) {
+            mkl::sparse::optimize_trsv(main_queue, mkl::uplo::lower,
+                                               mkl::transpose::nontrans,
+                                               mkl::diag::nonunit, handle);
+            mkl::sparse::optimize_trsv(main_queue, mkl::uplo::upper,
+                                               mkl::transpose::nontrans,
+                                               mkl::diag::nonunit, handle);
+        }
+        if (opts.precond == preconditioner::ilu0) {
+            mkl::sparse::set_csr_data(ilu_handle, nrows, nrows, mkl::index_base::zero,
+                                              ia_buffer, ja_buffer, lu_buffer);
+            mkl::sparse::set_matrix_property(ilu_handle, mkl::sparse::property::sorted);
+            mkl::sparse::optimize_trsv(main_queue, mkl::uplo::lower,
+                                               mkl::transpose::nontrans,
+                                               mkl::diag::unit, ilu_handle);
+            mkl::sparse::optimize_trsv(main_queue, mkl::uplo::upper,
+                                               mkl::transpose::nontrans,
+                                               mkl::diag::nonunit, ilu_handle);
+        }
         mkl::sparse::optimize_gemv(main_queue, mkl::transpose::nontrans, handle);
 
+        const bool jacobi = (opts.precond == preconditioner::jacobi);
         main_queue.submit([&](sycl::handler &cgh) {
             auto ia = (ia_buffer).template get_access<sycl::access::mode::read>(cgh);
             auto ja = (ja_buffer).template get_access<sycl::access::mode::read>(cgh);
@@ -161,118 +413,117 @@ void run_sparse_cg_example(const sycl::device &dev)
                 const int row = item.get_id(0);
                 for (intType i = ia[row]; i < ia[row + 1]; i++) {
                     if (ja[i] == row) {
-                        d[row] = a[i];
+                        d[row] = jacobi ? fp(1) / a[i] : a[i];
                         break;
                     }
                 }
             };
             cgh.parallel_for(sycl::range<1>(nrows), extractDiagonalKernel);
         });
+        main_queue.wait_and_throw();
+        double setup_time = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                          setup_start).count();
+
+        auto solve_start = std::chrono::steady_clock::now();
 
         // initial residual equal to RHS cause of zero initial vector
         mkl::blas::copy(main_queue, nrows, b_buffer, 1, r_buffer, 1);
 
         // Calculation B^{-1}r_0
-        {
-            mkl::sparse::trsv(main_queue, mkl::uplo::lower,
-                                      mkl::transpose::nontrans, mkl::diag::nonunit,
-                                      handle, r_buffer, t_buffer);
-            diagonal_mv<fp, intType>(main_queue, nrows, d_buffer, t_buffer);
-            mkl::sparse::trsv(main_queue, mkl::uplo::upper,
-                                      mkl::transpose::nontrans, mkl::diag::nonunit,
-                                      handle, t_buffer, w_buffer);
-        }
+        precondition<fp, intType>(main_queue, opts.precond, nrows, handle, ilu_handle,
+                                  d_buffer, r_buffer, t_buffer, w_buffer);
 
         mkl::blas::copy(main_queue, nrows, w_buffer, 1, p_buffer, 1);
 
-        // Calculate initial norm of correction
+        // Calculate (r_0, w_0) and initial norm of correction
+        dot_rw_ww<fp, intType>(main_queue, nrows, r_buffer, w_buffer, rw_buffer[0], ww_buffer);
         fp initial_norm_of_correction = 0;
-        mkl::blas::nrm2(main_queue, nrows, w_buffer, 1, temp_buffer);
         {
-            auto temp_accessor = temp_buffer.template get_access<sycl::access::mode::read>();
-            initial_norm_of_correction = temp_accessor[0];
+            auto temp_accessor = ww_buffer.template get_access<sycl::access::mode::read>();
+            initial_norm_of_correction = std::sqrt(temp_accessor[0]);
         }
         fp norm_of_correction = initial_norm_of_correction;
 
         // Start of main PCG algorithm
         std::int32_t k = 0;
-        fp alpha, beta, temp;
 
-        mkl::blas::dot(main_queue, nrows, r_buffer, 1, w_buffer, 1, temp_buffer);
-        {
-            auto temp_accessor = temp_buffer.template get_access<sycl::access::mode::read>();
-            temp               = temp_accessor[0];
-        }
+        while (norm_of_correction / initial_norm_of_correction > opts.tol && k < opts.max_iter) {
+            sycl::buffer<fp, 1> &rw      = rw_buffer[k % 2];
+            sycl::buffer<fp, 1> &rw_next = rw_buffer[(k + 1) % 2];
 
-        while (norm_of_correction / initial_norm_of_correction > 1.e-3 && k < 100) {
             // Calculate A*p
             mkl::sparse::gemv(main_queue, mkl::transpose::nontrans, 1.0, handle,
                                       p_buffer, 0.0, t_buffer);
 
-            // Calculate alpha_k
-            mkl::blas::dot(main_queue, nrows, p_buffer, 1, t_buffer, 1, temp_buffer);
-            {
-                auto temp_accessor =
-                        temp_buffer.template get_access<sycl::access::mode::read>();
-                alpha = temp / temp_accessor[0];
-            }
+            // Calculate (Ap_k, p_k)
+            dot_pap<fp, intType>(main_queue, nrows, p_buffer, t_buffer, pap_buffer);
 
-            // Calculate x_k = x_k + alpha*p_k
-            mkl::blas::axpy(main_queue, nrows, alpha, p_buffer, 1, x_buffer, 1);
-            // Calculate r_k = r_k - alpha*A*p_k
-            mkl::sparse::gemv(main_queue, mkl::transpose::nontrans, -alpha, handle,
-                                      p_buffer, 1.0, r_buffer);
+            // Calculate alpha_k, x_k = x_k + alpha*p_k and r_k = r_k - alpha*A*p_k
+            // (and w_k = B^{-1}r_k for the Jacobi preconditioner)
+            update_solution<fp, intType>(main_queue, nrows, jacobi, rw, pap_buffer, p_buffer,
+                                         t_buffer, d_buffer, x_buffer, r_buffer, w_buffer,
+                                         rw_next, ww_buffer);
 
-            // Calculate w_k = B^{-1}r_k
-            {
-                mkl::sparse::trsv(main_queue, mkl::uplo::lower,
-                                          mkl::transpose::nontrans,
-                                          mkl::diag::nonunit, handle, r_buffer, t_buffer);
-                diagonal_mv<fp, intType>(main_queue, nrows, d_buffer, t_buffer);
-                mkl::sparse::trsv(main_queue, mkl::uplo::upper,
-                                          mkl::transpose::nontrans,
-                                          mkl::diag::nonunit, handle, t_buffer, w_buffer);
+            // Calculate w_k = B^{-1}r_k, (r_k, w_k) and (w_k, w_k)
+            if (!jacobi) {
+                precondition<fp, intType>(main_queue, opts.precond, nrows, handle, ilu_handle,
+                                          d_buffer, r_buffer, t_buffer, w_buffer);
+                dot_rw_ww<fp, intType>(main_queue, nrows, r_buffer, w_buffer, rw_next, ww_buffer);
             }
 
+            // Calculate beta_k and p_k = w_k+beta*p_k, before the host waits for
+            // the norm of correction
+            update_direction<fp, intType>(main_queue, nrows, rw, rw_next, w_buffer, p_buffer);
+
             // Calculate current norm of correction
-            mkl::blas::nrm2(main_queue, nrows, w_buffer, 1, temp_buffer);
             {
-                auto temp_accessor = temp_buffer.template get_access<sycl::access::mode::read>();
-                norm_of_correction = temp_accessor[0];
+                auto temp_accessor = ww_buffer.template get_access<sycl::access::mode::read>();
+                norm_of_correction = std::sqrt(temp_accessor[0]);
             }
-            std::cout << "\t\trelative norm of residual on " << ++k
-                      << " iteration: " << norm_of_correction / initial_norm_of_correction
-                      << std::endl;
-            if (norm_of_correction <= 1.e-3)
-                break;
-
-            // Calculate beta_k
-            mkl::blas::dot(main_queue, nrows, r_buffer, 1, w_buffer, 1, temp_buffer);
-            {
-                auto temp_accessor = temp_buffer.template get_access<sycl::access::mode::read>();
-                beta = temp_accessor[0] / temp;
-                temp = temp_accessor[0];
-            }
-
-            // Calculate p_k = w_k+beta*p_k
-            mkl::blas::axpy(main_queue, nrows, beta, p_buffer, 1, w_buffer, 1);
-            mkl::blas::copy(main_queue, nrows, w_buffer, 1, p_buffer, 1);
+            ++k;
+            if (k % opts.report == 0 || norm_of_correction / initial_norm_of_correction <= opts.tol)
+                std::cout << "\t\trelative norm of residual on " << k
+                          << " iteration: " << norm_of_correction / initial_norm_of_correction
+                          << std::endl;
         }
+        main_queue.wait_and_throw();
+        double solve_time = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                          solve_start).count();
 
-        std::cout << "\n\t\tPreconditioned CG process has successfully converged, and\n"
-                  << "\t\tthe following solution has been obtained:\n\n";
+        if (norm_of_correction / initial_norm_of_correction <= opts.tol)
+            std::cout << "\n\t\tPreconditioned CG process has successfully converged, and\n"
+                      << "\t\tthe following solution has been obtained:\n\n";
+        else
+            std::cout << "\n\t\tPreconditioned CG process has not converged in " << k
+                      << " iterations,\n\t\tthe last approximation is:\n\n";
 
         auto result = x_buffer.template get_access<sycl::access::mode::read>();
-        for (std::int32_t i = 0; i < 4; i++) {
+        for (std::int32_t i = 0; i < std::min<intType>(4, nrows); i++) {
             std::cout << "\t\tx[" << i << "] = " << result[i] << std::endl;
         }
         std::cout << "\t\t..." << std::endl;
+
+        // True residual ||b - A*x|| / ||b||, computed on the host
+        double norm_r = 0, norm_b = 0;
+        for (intType row = 0; row < nrows; row++) {
+            double ax = 0;
+            for (intType i = ia[row]; i < ia[row + 1]; i++)
+                ax += double(a[i]) * result[ja[i]];
+            norm_r += (b[row] - ax) * (b[row] - ax);
+            norm_b += double(b[row]) * b[row];
+        }
+
+        std::cout << "\n\t\tsetup (matrix, preconditioner and optimize): " << setup_time * 1e3
+                  << " ms\n\t\tsolve: " << k << " iterations in " << solve_time * 1e3
+                  << " ms, " << (k ? solve_time / k * 1e3 : 0.0) << " ms per iteration"
+                  << "\n\t\t||b - A*x|| / ||b|| = " << std::sqrt(norm_r / norm_b) << std::endl;
     }
     catch (std::exception const &e) {
         std::cout << "\t\tCaught exception:\n" << e.what() << std::endl;
     }
     
     mkl::sparse::release_matrix_handle(&handle);
+    mkl::sparse::release_matrix_handle(&ilu_handle);
 }
 
 //
@@ -293,7 +544,7 @@ void print_banner()
                  "# where A is a symmetric sparse matrix in CSR format, and\n"
                  "#       x and b are dense vectors.\n"
                  "# \n"
-                 "# Uses the symmetric Gauss-Seidel preconditioner.\n"
+                 "# Uses the Jacobi, symmetric Gauss-Seidel or ILU0 preconditioner.\n"
                  "# \n"
                  "###############################################################"
                  "#########\n\n";
@@ -303,15 +554,53 @@ int main(int argc, char **argv)
 {
     print_banner();
 
+    cg_options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "jacobi")
+                opts.precond = preconditioner::jacobi;
+            else if (name == "sgs")
+                opts.precond = preconditioner::sgs;
+            else if (name == "ilu0")
+                opts.precond = preconditioner::ilu0;
+            else {
+                std::cout << "Unknown preconditioner " << name << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "-n" && i + 1 < argc)
+            opts.size = std::atoll(argv[++i]);
+        else if (arg == "-tol" && i + 1 < argc)
+            opts.tol = std::atof(argv[++i]);
+        else if (arg == "-maxit" && i + 1 < argc)
+            opts.max_iter = std::atoi(argv[++i]);
+        else if (arg == "-report" && i + 1 < argc)
+            opts.report = std::max(1, std::atoi(argv[++i]));
+        else if (arg[0] != '-')
+            opts.matrix_file = arg;
+        else {
+            std::cout << "Usage: " << argv[0] << " [-p jacobi|sgs|ilu0] [-n size] [-tol tol]"
+                      << " [-maxit max_iterations] [-report interval] [matrix.mtx]" << std::endl;
+            return 1;
+        }
+    }
+    if (opts.matrix_file.empty() && (opts.size < 1 || opts.size > 400)) {
+        // 27*size^3 nonzeros must fit in std::int32_t
+        std::cout << "The stencil size must be in 1..400" << std::endl;
+        return 1;
+    }
+
     sycl::device my_dev{sycl::default_selector{}};
 
     std::cout << "Running tests on " << my_dev.get_info<sycl::info::device::name>() << ".\n";
 
     std::cout << "\tRunning with single precision real data type:" << std::endl;
-    run_sparse_cg_example<float, std::int32_t>(my_dev);
+    run_sparse_cg_example<float, std::int32_t>(my_dev, opts);
 
     if (my_dev.get_info<sycl::info::device::double_fp_config>().size() != 0) {
         std::cout << "\tRunning with double precision real data type:" << std::endl;
-        run_sparse_cg_example<double, std::int32_t>(my_dev);
+        run_sparse_cg_example<double, std::int32_t>(my_dev, opts);
     }
 }
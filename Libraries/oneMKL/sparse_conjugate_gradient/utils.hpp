@@ -59,3 +59,179 @@ void generate_sparse_matrix(const intType nx,
     }         // end iz loop
 }
 
+
+// Read a square sparse matrix in Matrix Market coordinate format (real,
+// integer or pattern values; general or symmetric) from fname into the
+// 3arrays CSR representation (ia, ja, values) with zero-based and sorted
+// column indices. Only one triangle of a symmetric matrix is stored in the
+// file, it is expanded to the whole matrix.
+template <typename fp, typename intType>
+bool read_matrix_market(const std::string &fname,
+                        intType &nrows,
+                        std::vector<intType> &ia,
+                        std::vector<intType> &ja,
+                        std::vector<fp> &a)
+{
+    std::ifstream file(fname);
+    std::string line;
+    if (!file || !std::getline(file, line))
+        return false;
+
+    std::string banner, object, format, field, symmetry;
+    std::istringstream(line) >> banner >> object >> format >> field >> symmetry;
+    for (auto *word : {&object, &format, &field, &symmetry})
+        std::transform(word->begin(), word->end(), word->begin(), ::tolower);
+    if (banner != "%%MatrixMarket" || object != "matrix" || format != "coordinate" ||
+        field == "complex" || (symmetry != "general" && symmetry != "symmetric")) {
+        std::cout << "\t\tUnsupported Matrix Market format: " << line << std::endl;
+        return false;
+    }
+    bool pattern   = (field == "pattern");
+    bool symmetric = (symmetry == "symmetric");
+
+    // Skip comments up to the size line
+    while (std::getline(file, line) && line[0] == '%')
+        ;
+    long long m = 0, n = 0, entries = 0;
+    if (std::sscanf(line.c_str(), "%lld %lld %lld", &m, &n, &entries) != 3 || m != n ||
+        m <= 0 || m > std::numeric_limits<intType>::max())
+        return false;
+
+    std::vector<intType> rows, cols;
+    std::vector<fp> values;
+    rows.reserve(symmetric ? 2 * entries : entries);
+    cols.reserve(rows.capacity());
+    values.reserve(rows.capacity());
+    for (long long e = 0; e < entries; e++) {
+        if (!std::getline(file, line))
+            return false;
+        char *end;
+        long long i = std::strtoll(line.c_str(), &end, 10);
+        long long j = std::strtoll(end, &end, 10);
+        fp value    = pattern ? fp(1) : fp(std::strtod(end, &end));
+        if (i < 1 || i > m || j < 1 || j > n)
+            return false;
+        rows.push_back(intType(i - 1));
+        cols.push_back(intType(j - 1));
+        values.push_back(value);
+        if (symmetric && i != j) {
+            rows.push_back(intType(j - 1));
+            cols.push_back(intType(i - 1));
+            values.push_back(value);
+        }
+    }
+    if (rows.size() > std::size_t(std::numeric_limits<intType>::max()))
+        return false;
+
+    // Bucket the entries by rows, then sort every row by columns
+    nrows = intType(m);
+    ia.assign(nrows + 1, 0);
+    for (auto row : rows)
+        ia[row + 1]++;
+    for (intType row = 0; row < nrows; row++)
+        ia[row + 1] += ia[row];
+
+    ja.resize(rows.size());
+    a.resize(rows.size());
+    std::vector<intType> next(ia.begin(), ia.end() - 1);
+    for (std::size_t e = 0; e < rows.size(); e++) {
+        intType pos = next[rows[e]]++;
+        ja[pos]     = cols[e];
+        a[pos]      = values[e];
+    }
+
+    std::vector<std::pair<intType, fp>> row_entries;
+    for (intType row = 0; row < nrows; row++) {
+        row_entries.clear();
+        for (intType i = ia[row]; i < ia[row + 1]; i++)
+            row_entries.emplace_back(ja[i], a[i]);
+        std::sort(row_entries.begin(), row_entries.end(),
+                  [](const std::pair<intType, fp> &l, const std::pair<intType, fp> &r) {
+                      return l.first < r.first;
+                  });
+        for (intType i = ia[row]; i < ia[row + 1]; i++) {
+            ja[i] = row_entries[i - ia[row]].first;
+            a[i]  = row_entries[i - ia[row]].second;
+        }
+    }
+    return true;
+}
+
+// Checks that the CSR matrix (ia, ja, a) with sorted column indices is
+// symmetric, i.e. that every a_i,j has an equal a_j,i. A general Matrix Market
+// file may hold a symmetric matrix, but CG needs one.
+template <typename fp, typename intType>
+bool is_symmetric(const intType nrows,
+                  const std::vector<intType> &ia,
+                  const std::vector<intType> &ja,
+                  const std::vector<fp> &a)
+{
+    for (intType row = 0; row < nrows; row++) {
+        for (intType i = ia[row]; i < ia[row + 1]; i++) {
+            intType col = ja[i];
+            auto first  = ja.begin() + ia[col];
+            auto last   = ja.begin() + ia[col + 1];
+            auto it     = std::lower_bound(first, last, row);
+            if (it == last || *it != row || a[it - ja.begin()] != a[i])
+                return false;
+        }
+    }
+    return true;
+}
+
+// Checks that every row of the CSR matrix (ia, ja, a) stores a nonzero
+// diagonal element, which the Jacobi and Gauss-Seidel preconditioners divide by
+template <typename fp, typename intType>
+bool has_nonzero_diagonal(const intType nrows,
+                          const std::vector<intType> &ia,
+                          const std::vector<intType> &ja,
+                          const std::vector<fp> &a)
+{
+    for (intType row = 0; row < nrows; row++) {
+        bool found = false;
+        for (intType i = ia[row]; i < ia[row + 1] && !found; i++)
+            found = (ja[i] == row && a[i] != fp(0));
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+// Incomplete LU factorization with zero fill-in (ILU0) of the CSR matrix
+// (ia, ja, a) with sorted column indices. lu gets the factors in the
+// sparsity pattern of a: the strictly lower triangle holds L (with unit
+// diagonal, not stored), the upper triangle holds U. Returns false if a
+// diagonal element is missing or zero.
+template <typename fp, typename intType>
+bool ilu0(const intType nrows,
+          const std::vector<intType> &ia,
+          const std::vector<intType> &ja,
+          const std::vector<fp> &a,
+          std::vector<fp> &lu)
+{
+    lu = a;
+    std::vector<intType> diag(nrows, -1);
+    std::vector<intType> position(nrows, -1); // of the columns of the current row
+
+    for (intType row = 0; row < nrows; row++) {
+        for (intType i = ia[row]; i < ia[row + 1]; i++)
+            position[ja[i]] = i;
+
+        for (intType i = ia[row]; i < ia[row + 1] && ja[i] < row; i++) {
+            // l_row,k = a_row,k / u_k,k, and the row is updated with row k of U
+            intType k = ja[i];
+            lu[i] /= lu[diag[k]];
+            for (intType j = diag[k] + 1; j < ia[k + 1]; j++) {
+                if (position[ja[j]] >= 0)
+                    lu[position[ja[j]]] -= lu[i] * lu[j];
+            }
+        }
+
+        diag[row] = position[row];
+        for (intType i = ia[row]; i < ia[row + 1]; i++)
+            position[ja[i]] = -1;
+        if (diag[row] < 0 || lu[diag[row]] == fp(0))
+            return false;
+    }
+    return true;
+}
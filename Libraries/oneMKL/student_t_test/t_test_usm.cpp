@@ -13,8 +13,10 @@
  *******************************************************************************/
 
 #include <sycl/sycl.hpp>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 
 #include "oneapi/mkl.hpp"
@@ -31,6 +33,17 @@ static const auto expected_std_dev = 1.0f;
 // T-test threshold which corresponds to 5% significance level and infinite
 // degrees of freedom
 static const auto threshold = 1.95996f;
+// Maximum deviation of the batched t-statistics from the two-pass reference
+static const auto t_tolerance = 1e-3;
+// Quantity of A/B experiments tested in a batch
+static const auto n_experiments = 10000;
+// Quantity of observations of each group of an A/B experiment
+static const auto n_ab_points = 1000;
+// Quantity of blocks the observations of the A/B experiments arrive in
+static const auto n_ab_updates = 4;
+// Difference of means (in standard deviations) of the groups of the A/B
+// experiments with an effect
+static const auto effect_size = 0.5f;
 
 // T-test function with expected mean
 // Returns: -1 if something went wrong, 1 - in case of NULL hypothesis should be
@@ -122,6 +135,141 @@ std::int32_t t_test(sycl::queue& q, RealType* r1, std::int64_t n1,
   return res;
 }
 
+// Two-sided 5% critical value of Student's t-distribution with df degrees of
+// freedom, from the Cornish-Fisher expansion around the normal quantile
+// 'threshold'. It is accurate to 1e-3 for df >= 5 and tends to 'threshold'
+// as df grows.
+template <typename RealType>
+RealType t_critical_value(RealType df) {
+  const RealType z = static_cast<RealType>(threshold);
+  const RealType z2 = z * z;
+  const RealType g1 = z * (z2 + 1) / 4;
+  const RealType g2 = z * ((5 * z2 + 16) * z2 + 3) / 96;
+  const RealType g3 = z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / 384;
+  const RealType g4 =
+      z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / 92160;
+  const RealType inv_df = 1 / df;
+  return z + inv_df * (g1 + inv_df * (g2 + inv_df * (g3 + inv_df * g4)));
+}
+
+// Batched A/B tests: n_experiments independent experiments, each comparing
+// the observations of group 1 with the observations of group 2. The
+// observations are passed in blocks laid out column-major (as
+// oneapi::mkl::stats::layout::col_major datasets with one dimension per
+// experiment), i.e. observation i of experiment j is r[i * n_experiments + j].
+// Every block updates the running means and sums of squared deviations of all
+// experiments in a single kernel with Welford's algorithm, so the data is read
+// once, and new observations can be added at any time as they arrive.
+template <typename RealType>
+class ab_test_batch {
+ public:
+  ab_test_batch(sycl::queue& q, std::int64_t n_experiments)
+      : q_(q), n_experiments_(n_experiments) {
+    moments_ = sycl::malloc_device<RealType>(4 * n_experiments, q_);
+    if (moments_ == nullptr) {
+      throw std::runtime_error("failed to allocate USM memory");
+    }
+    q_.memset(moments_, 0, 4 * n_experiments * sizeof(RealType)).wait();
+  }
+
+  ~ab_test_batch() { sycl::free(moments_, q_); }
+
+  ab_test_batch(const ab_test_batch&) = delete;
+  ab_test_batch& operator=(const ab_test_batch&) = delete;
+
+  std::int64_t n_experiments() const { return n_experiments_; }
+  std::int64_t n1() const { return n1_; }
+  std::int64_t n2() const { return n2_; }
+
+  // Adds n1 new observations of group 1 (r1) and n2 new observations of
+  // group 2 (r2) to every experiment
+  sycl::event update(const RealType* r1, std::int64_t n1, const RealType* r2,
+                     std::int64_t n2,
+                     const std::vector<sycl::event>& deps = {}) {
+    std::int64_t n_exp = n_experiments_;
+    std::int64_t count1 = n1_;
+    std::int64_t count2 = n2_;
+    RealType* mean1 = moments_;
+    RealType* m2_1 = moments_ + n_exp;
+    RealType* mean2 = moments_ + 2 * n_exp;
+    RealType* m2_2 = moments_ + 3 * n_exp;
+
+    n1_ += n1;
+    n2_ += n2;
+
+    return q_.submit([&](sycl::handler& h) {
+      h.depends_on(deps);
+      h.parallel_for(sycl::range<1>(n_exp), [=](sycl::id<1> id) {
+        std::int64_t j = id[0];
+        // Work-item j reads element j of every row, so that consecutive
+        // work-items read consecutive memory
+        auto welford = [=](const RealType* r, std::int64_t n,
+                           std::int64_t count, RealType& mean, RealType& m2) {
+          RealType m = mean;
+          RealType s = m2;
+          for (std::int64_t i = 0; i < n; ++i) {
+            RealType x = r[i * n_exp + j];
+            RealType delta = x - m;
+            m += delta / static_cast<RealType>(count + i + 1);
+            s += delta * (x - m);
+          }
+          mean = m;
+          m2 = s;
+        };
+        welford(r1, n1, count1, mean1[j], m2_1[j]);
+        welford(r2, n2, count2, mean2[j], m2_2[j]);
+      });
+    });
+  }
+
+  // Welch's t-test of every experiment: writes the t-statistics, the
+  // Welch-Satterthwaite degrees of freedom, the sample means and variances
+  // and the results (1 - in case of NULL hypothesis should be accepted, 0 -
+  // in case of NULL hypothesis should be rejected)
+  sycl::event t_test(RealType* t, RealType* df, RealType* mean1,
+                     RealType* variance1, RealType* mean2,
+                     RealType* variance2, std::int32_t* res,
+                     const std::vector<sycl::event>& deps = {}) {
+    if (n1_ < 2 || n2_ < 2) {
+      throw std::runtime_error("t-test needs two observations per group");
+    }
+    std::int64_t n_exp = n_experiments_;
+    RealType n1 = static_cast<RealType>(n1_);
+    RealType n2 = static_cast<RealType>(n2_);
+    const RealType* moments = moments_;
+
+    return q_.submit([&](sycl::handler& h) {
+      h.depends_on(deps);
+      h.parallel_for(sycl::range<1>(n_exp), [=](sycl::id<1> id) {
+        std::int64_t j = id[0];
+        RealType m1 = moments[j];
+        RealType v1 = moments[n_exp + j] / (n1 - 1);
+        RealType m2 = moments[2 * n_exp + j];
+        RealType v2 = moments[3 * n_exp + j] / (n2 - 1);
+        RealType se1 = v1 / n1;
+        RealType se2 = v2 / n2;
+        RealType se = se1 + se2;
+
+        t[j] = (m1 - m2) / sycl::sqrt(se);
+        df[j] = se * se / (se1 * se1 / (n1 - 1) + se2 * se2 / (n2 - 1));
+        mean1[j] = m1;
+        variance1[j] = v1;
+        mean2[j] = m2;
+        variance2[j] = v2;
+        res[j] = (sycl::fabs(t[j]) < t_critical_value(df[j])) ? 1 : 0;
+      });
+    });
+  }
+
+ private:
+  sycl::queue q_;
+  std::int64_t n_experiments_;
+  std::int64_t n1_ = 0;
+  std::int64_t n2_ = 0;
+  // mean and sum of squared deviations of group 1, then of group 2
+  RealType* moments_ = nullptr;
+};
+
 int main(int argc, char** argv) {
   std::cout << "\nStudent's T-test Simulation\n";
   std::cout << "Unified Shared Memory Api\n";
@@ -152,6 +300,14 @@ int main(int argc, char** argv) {
     }
   }
 
+  std::int64_t n_exp = n_experiments;
+  if (argc >= 5) {
+    n_exp = std::atol(argv[4]);
+    if (n_exp < 2) {
+      n_exp = n_experiments;
+    }
+  }
+
   std::cout << "Number of random samples = " << n_points
             << " with mean = " << mean << ", std_dev = " << std_dev << "\n";
 
@@ -168,6 +324,8 @@ int main(int argc, char** argv) {
   };
 
   std::int32_t res0, res1;
+  std::int64_t n_rejected_aa = 0, n_rejected_ab = 0;
+  double max_t_error = 0.0;
 
   try {
     // Queue constructor passed exception handler
@@ -190,6 +348,78 @@ int main(int argc, char** argv) {
     // Free allocated memory
     sycl::free(rng_arr0, q);
     sycl::free(rng_arr1, q);
+
+    // Batched A/B tests: the first half of the experiments has no effect,
+    // group 2 of the second half is shifted by effect_size standard deviations
+    std::int64_t n_obs = n_ab_points * n_exp;
+    std::int64_t n_aa = n_exp / 2;
+    fp_type* group1 = sycl::malloc_shared<fp_type>(n_obs, q);
+    fp_type* group2 = sycl::malloc_shared<fp_type>(n_obs, q);
+    oneapi::mkl::rng::generate(distribution, engine, n_obs, group1);
+    oneapi::mkl::rng::generate(distribution, engine, n_obs, group2);
+    q.wait_and_throw();
+    fp_type shift = effect_size * std_dev;
+    q.parallel_for(sycl::range<2>(n_ab_points, n_exp - n_aa),
+                   [=](sycl::id<2> id) {
+                     group2[id[0] * n_exp + n_aa + id[1]] += shift;
+                   })
+        .wait_and_throw();
+
+    // The observations arrive in blocks of rows, each of which is a
+    // column-major block of all experiments
+    ab_test_batch<fp_type> batch(q, n_exp);
+    sycl::event updated;
+    for (std::int64_t u = 0; u < n_ab_updates; ++u) {
+      std::int64_t first = n_ab_points * u / n_ab_updates;
+      std::int64_t rows = n_ab_points * (u + 1) / n_ab_updates - first;
+      updated = batch.update(group1 + first * n_exp, rows,
+                             group2 + first * n_exp, rows, {updated});
+    }
+
+    fp_type* t = sycl::malloc_shared<fp_type>(n_exp, q);
+    fp_type* df = sycl::malloc_shared<fp_type>(n_exp, q);
+    fp_type* mean1 = sycl::malloc_shared<fp_type>(n_exp, q);
+    fp_type* variance1 = sycl::malloc_shared<fp_type>(n_exp, q);
+    fp_type* mean2 = sycl::malloc_shared<fp_type>(n_exp, q);
+    fp_type* variance2 = sycl::malloc_shared<fp_type>(n_exp, q);
+    std::int32_t* res = sycl::malloc_shared<std::int32_t>(n_exp, q);
+    batch.t_test(t, df, mean1, variance1, mean2, variance2, res, {updated})
+        .wait_and_throw();
+
+    // Check the t-statistics against a two-pass computation on the host
+    for (std::int64_t j = 0; j < n_exp; ++j) {
+      double m[2] = {0.0, 0.0}, v[2] = {0.0, 0.0};
+      const fp_type* groups[2] = {group1, group2};
+      for (int g = 0; g < 2; ++g) {
+        for (std::int64_t i = 0; i < n_ab_points; ++i)
+          m[g] += groups[g][i * n_exp + j];
+        m[g] /= n_ab_points;
+        for (std::int64_t i = 0; i < n_ab_points; ++i) {
+          double d = groups[g][i * n_exp + j] - m[g];
+          v[g] += d * d;
+        }
+        v[g] /= (n_ab_points - 1);
+      }
+      double t_ref = (m[0] - m[1]) / std::sqrt((v[0] + v[1]) / n_ab_points);
+      max_t_error = std::max(max_t_error, std::abs(t[j] - t_ref));
+
+      if (res[j] == 0) {
+        if (j < n_aa)
+          n_rejected_aa++;
+        else
+          n_rejected_ab++;
+      }
+    }
+
+    sycl::free(group1, q);
+    sycl::free(group2, q);
+    sycl::free(t, q);
+    sycl::free(df, q);
+    sycl::free(mean1, q);
+    sycl::free(variance1, q);
+    sycl::free(mean2, q);
+    sycl::free(variance2, q);
+    sycl::free(res, q);
   } catch (...) {
     // Some other exception detected
     std::cout << "Failure\n";
@@ -198,7 +428,23 @@ int main(int argc, char** argv) {
 
   // Printing results
   std::cout << "T-test result with expected mean: " << res0 << "\n";
-  std::cout << "T-test result with two input arrays: " << res1 << "\n\n";
+  std::cout << "T-test result with two input arrays: " << res1 << "\n";
+  std::cout << "Batched Welch's T-test of " << n_exp << " A/B experiments with "
+            << n_ab_points << " observations per group in " << n_ab_updates
+            << " updates:\n";
+  std::cout << "  rejected without effect: " << n_rejected_aa << " of "
+            << n_exp / 2 << "\n";
+  std::cout << "  rejected with effect of " << effect_size
+            << " std_dev: " << n_rejected_ab << " of " << n_exp - n_exp / 2
+            << "\n";
+  std::cout << "  max. deviation of t-statistics from two-pass reference: "
+            << max_t_error << "\n\n";
+
+  if (!(max_t_error <= t_tolerance)) {
+    std::cout << "Batched t-statistics deviate from the reference by more "
+              << "than " << t_tolerance << "\n";
+    return 1;
+  }
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+//==============================================================
+// Copyright © 2019 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef ASYNC_OFFLOAD_HPP
+#define ASYNC_OFFLOAD_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <tbb/flow_graph.h>
+
+// Service thread for a tbb::flow::async_node<Input, Output>: the node body
+// submits its input and gateway, and the service thread runs the work
+// function on the inputs in submission order, then puts the outputs to the
+// graph through the gateways. The thread sleeps on a condition variable while
+// there is no work, so it does not compete with the oneTBB workers.
+template <typename Input, typename Output>
+class AsyncService {
+ public:
+  using gateway_type =
+      typename tbb::flow::async_node<Input, Output>::gateway_type;
+
+  explicit AsyncService(std::function<Output(const Input&)> work)
+      : work_(std::move(work)), stop_(false), thread_([this] { Run(); }) {}
+
+  ~AsyncService() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  AsyncService(const AsyncService&) = delete;
+  AsyncService& operator=(const AsyncService&) = delete;
+
+  // Called from the async_node body
+  void submit(const Input& input, gateway_type& gateway) {
+    // Keeps graph.wait_for_all() waiting until the output is put
+    gateway.reserve_wait();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.emplace_back(input, &gateway);
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void Run() {
+    for (;;) {
+      std::pair<Input, gateway_type*> item;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        item = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      item.second->try_put(work_(item.first));
+      item.second->release_wait();
+    }
+  }
+
+  std::function<Output(const Input&)> work_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::pair<Input, gateway_type*>> queue_;
+  bool stop_;
+  std::thread thread_;
+};
+
+// Online estimate of the share of the work to offload, from the throughputs
+// of the CPU and the device measured on the previous chunks of work. The
+// share balances the two, so that both sides of a chunk finish at the same
+// time. The first warmup_chunks measurements are averaged, then the
+// throughputs follow an exponential moving average to adapt to changes of the
+// load. The share is clamped to [min_share, 1 - min_share], so that both
+// sides keep being measured.
+class AdaptiveRatio {
+ public:
+  AdaptiveRatio(float initial_ratio, int warmup_chunks = 4,
+                double smoothing = 0.25, float min_share = 0.02f)
+      : ratio_(initial_ratio),
+        warmup_chunks_(warmup_chunks),
+        smoothing_(smoothing),
+        min_share_(min_share) {}
+
+  // Share of the next chunk to offload to the device
+  float ratio() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ratio_;
+  }
+
+  // Adds the measurement of a chunk: device_items items in device_seconds on
+  // the device, and cpu_items items in cpu_seconds on the CPU
+  void Update(size_t device_items, double device_seconds, size_t cpu_items,
+              double cpu_seconds) {
+    if (device_items == 0 || cpu_items == 0 || device_seconds <= 0 ||
+        cpu_seconds <= 0)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    double device_rate = device_items / device_seconds;
+    double cpu_rate = cpu_items / cpu_seconds;
+    ++chunks_;
+    double weight =
+        chunks_ <= warmup_chunks_ ? 1.0 / chunks_ : smoothing_;
+    device_rate_ += weight * (device_rate - device_rate_);
+    cpu_rate_ += weight * (cpu_rate - cpu_rate_);
+
+    float ratio = static_cast<float>(device_rate_ / (device_rate_ + cpu_rate_));
+    ratio_ = std::min(std::max(ratio, min_share_), 1.0f - min_share_);
+  }
+
+  double device_rate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return device_rate_;
+  }
+
+  double cpu_rate() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cpu_rate_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  float ratio_;
+  int warmup_chunks_;
+  double smoothing_;
+  float min_share_;
+  int chunks_ = 0;
+  double device_rate_ = 0;
+  double cpu_rate_ = 0;
+};
+
+#endif  // ASYNC_OFFLOAD_HPP
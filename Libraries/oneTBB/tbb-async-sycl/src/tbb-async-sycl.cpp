@@ -5,11 +5,11 @@
 // =============================================================
 
 #include <cmath>  //for std::ceil
-#include <array>
-#include <atomic>
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
-#include <thread>
-#include <numeric>
+#include <tuple>
+#include <vector>
 
 #include <sycl/sycl.hpp>
 
@@ -21,157 +21,231 @@
 // e.g., $ONEAPI_ROOT/dev-utilities//include/dpc_common.hpp
 #include "dpc_common.hpp"
 
-struct done_tag{};
+#include "async_offload.hpp"
 
-const float ratio = 0.5;  // CPU to GPU offload ratio
+const float initial_ratio = 0.5;  // initial CPU to GPU offload ratio
 const float alpha = 0.5;  // coeff for triad calculation
 
-const size_t array_size = 16;
-std::array<float, array_size> a_array;  // input
-std::array<float, array_size> b_array;  // input
-std::array<float, array_size> c_array;  // output
-
-void PrintArr(const char* text, const std::array<float, array_size>& array) {
-  std::cout << text;
-  for (const auto& s : array) std::cout << s << ' ';
-  std::cout << "\n";
-}
-
-using async_node_type = tbb::flow::async_node<float, done_tag>;
-using gateway_type = async_node_type::gateway_type;
-
-class AsyncActivity {
-  gateway_type* gateway_ptr;
-  float offload_ratio;
-  std::atomic<bool> submit_flag;
-  std::thread service_thread;
-
- public:
-  AsyncActivity() : gateway_ptr(nullptr), offload_ratio(0), submit_flag(false),
-    service_thread( [this] {
-      while( !submit_flag ) {
-        std::this_thread::yield();
-      }
-      // Execute the kernel over a portion of the array range
-      size_t array_size_sycl = std::ceil(array_size * offload_ratio);
-      std::cout << "start index for GPU = 0; end index for GPU = "
-                << array_size_sycl << "\n";
-      const float coeff = alpha;  // coeff is a local varaible
+// Stream of triad requests c = a + alpha * b over large arrays, processed in
+// chunks, each of which is split between the GPU and the CPU
+const size_t num_requests = 6;
+const size_t chunk_size = 1 << 20;
+// Chunks in the graph at the same time: the GPU and the CPU can start their
+// part of the next chunk while the other side finishes the current one
+const size_t max_chunks_in_flight = 2;
+// Chunks whose measurements are printed
+const size_t chunks_to_print = 8;
+
+struct Request {
+  std::vector<float> a_array;  // input
+  std::vector<float> b_array;  // input
+  std::vector<float> c_array;  // output
+};
 
-      // By including all the SYCL work in a {} block, we ensure
-      // all SYCL tasks must complete before exiting the block
-      {  // starting SYCL code
-        sycl::range<1> n_items{array_size_sycl}; 
-        sycl::buffer a_buffer(a_array);
-        sycl::buffer b_buffer(b_array);
-        sycl::buffer c_buffer(c_array);
-
-        sycl::queue q(sycl::default_selector{}, dpc_common::exception_handler);
-        q.submit([&](sycl::handler& h) {     
-              sycl::accessor a_accessor(a_buffer, h, sycl::read_only);
-              sycl::accessor b_accessor(b_buffer, h, sycl::read_only);
-              sycl::accessor c_accessor(c_buffer, h, sycl::write_only);
-
-              h.parallel_for( n_items, [=](sycl::id<1> index) {
-                    c_accessor[index] = a_accessor[index] + b_accessor[index] * coeff;
-                  });  // end of the kernel -- parallel for
-            }).wait();
-      }  // end of the scope for SYCL code; wait unti queued work completes;
-
-      gateway_ptr->try_put(done_tag{});
-      gateway_ptr->release_wait();
-    } ) {}
-
-  ~AsyncActivity() {
-    service_thread.join();
-  }
+// Elements [begin, split) of a request are computed on the GPU and
+// [split, end) on the CPU
+struct Chunk {
+  size_t seq;  // sequence number in the stream
+  size_t request;
+  size_t begin;
+  size_t split;
+  size_t end;
+};
 
-  void submit(float ratio, gateway_type& gateway) {
-    gateway.reserve_wait();
-    offload_ratio = ratio;
-    gateway_ptr = &gateway;
-    submit_flag = true;
-  }
+// Elements of a chunk computed by one side, and the time it took
+struct ChunkTime {
+  size_t seq;
+  size_t items;
+  double seconds;
 };
 
-int main() {
-  // init input arrays
-  std::iota(a_array.begin(), a_array.end(), 0);
-  std::iota(b_array.begin(), b_array.end(), 0);
+// Runs the stream of requests through the graph, with the offload ratio
+// adapted to the measured throughputs if adaptive is set, or fixed to
+// initial_ratio otherwise. Returns the elements computed per second.
+double RunStream(std::vector<Request>& requests, bool adaptive) {
+  sycl::queue q(sycl::default_selector{}, dpc_common::exception_handler,
+                sycl::property::queue::in_order());
+  float* a_device = sycl::malloc_device<float>(chunk_size, q);
+  float* b_device = sycl::malloc_device<float>(chunk_size, q);
+  float* c_device = sycl::malloc_device<float>(chunk_size, q);
 
-  int nth = 4; // number of threads
+  AdaptiveRatio ratio(initial_ratio);
+  size_t total_items = 0;
+  for (auto& r : requests) total_items += r.c_array.size();
 
-  auto mp = tbb::global_control::max_allowed_parallelism;
-  tbb::global_control gc(mp, nth + 1);  // One more thread, but sleeping
   tbb::flow::graph g;
 
-  // Input node:
-  tbb::flow::input_node<float> in_node{g,
-                                        [&](tbb::flow_control& fc) -> float {
-                                          static bool has_run = false;
-                                          if (has_run) fc.stop();
-                                          has_run = true;
-                                          return ratio;
-                                        }
-                                      };
+  // Input node: the chunks of all requests, in order
+  size_t next_request = 0, next_begin = 0, next_seq = 0;
+  tbb::flow::input_node<Chunk> in_node{
+      g, [&](tbb::flow_control& fc) -> Chunk {
+        if (next_request == requests.size()) {
+          fc.stop();
+          return Chunk{};
+        }
+        size_t size = requests[next_request].c_array.size();
+        Chunk chunk{next_seq++, next_request, next_begin, next_begin,
+                    std::min(next_begin + chunk_size, size)};
+        next_begin = chunk.end;
+        if (next_begin == size) {
+          ++next_request;
+          next_begin = 0;
+        }
+        return chunk;
+      }};
+
+  tbb::flow::limiter_node<Chunk> limiter{g, max_chunks_in_flight};
+
+  // Split node: splits the chunk with the current offload ratio
+  tbb::flow::function_node<Chunk, Chunk> split_node{
+      g, tbb::flow::serial, [&](Chunk chunk) {
+        float offload_ratio = adaptive ? ratio.ratio() : initial_ratio;
+        chunk.split = chunk.begin + static_cast<size_t>(std::ceil(
+                                        (chunk.end - chunk.begin) * offload_ratio));
+        return chunk;
+      }};
 
   // CPU node
-  tbb::flow::function_node<float, done_tag> cpu_node{
-      g, tbb::flow::unlimited, [&](float offload_ratio) {
-        size_t i_start = static_cast<size_t>(std::ceil(array_size * offload_ratio));
-        size_t i_end = static_cast<size_t>(array_size);
-        std::cout << "start index for CPU = " << i_start
-                  << "; end index for CPU = " << i_end << "\n";
-
-        tbb::parallel_for(tbb::blocked_range<size_t>{i_start, i_end},
-                          [&](const tbb::blocked_range<size_t>& r) {
-                            for (size_t i = r.begin(); i < r.end(); ++i)
-                              c_array[i] = a_array[i] + alpha * b_array[i];
+  tbb::flow::function_node<Chunk, ChunkTime> cpu_node{
+      g, tbb::flow::serial, [&](const Chunk& chunk) {
+        dpc_common::TimeInterval timer;
+        Request& r = requests[chunk.request];
+        tbb::parallel_for(tbb::blocked_range<size_t>{chunk.split, chunk.end},
+                          [&](const tbb::blocked_range<size_t>& range) {
+                            for (size_t i = range.begin(); i < range.end(); ++i)
+                              r.c_array[i] = r.a_array[i] + alpha * r.b_array[i];
                           });
-        return done_tag{};
+        return ChunkTime{chunk.seq, chunk.end - chunk.split, timer.Elapsed()};
       }};
 
-  // async node -- GPU
-  AsyncActivity async_act;
-  async_node_type a_node{
+  // async node -- GPU, including the transfers of the chunk
+  AsyncService<Chunk, ChunkTime> gpu_service([&](const Chunk& chunk) {
+    dpc_common::TimeInterval timer;
+    size_t n = chunk.split - chunk.begin;
+    if (n > 0) {
+      Request& r = requests[chunk.request];
+      const float coeff = alpha;  // coeff is a local varaible
+      q.memcpy(a_device, r.a_array.data() + chunk.begin, n * sizeof(float));
+      q.memcpy(b_device, r.b_array.data() + chunk.begin, n * sizeof(float));
+      q.parallel_for(sycl::range<1>{n}, [=](sycl::id<1> index) {
+        c_device[index] = a_device[index] + b_device[index] * coeff;
+      });
+      q.memcpy(r.c_array.data() + chunk.begin, c_device, n * sizeof(float))
+          .wait();
+    }
+    return ChunkTime{chunk.seq, n, timer.Elapsed()};
+  });
+  tbb::flow::async_node<Chunk, ChunkTime> a_node{
       g, tbb::flow::unlimited,
-      [&async_act](const float& offload_ratio, gateway_type& gateway) {
-        async_act.submit(offload_ratio, gateway);
+      [&gpu_service](const Chunk& chunk,
+                     AsyncService<Chunk, ChunkTime>::gateway_type& gateway) {
+        gpu_service.submit(chunk, gateway);
       }};
 
-  // join node
-  using join_t =
-      tbb::flow::join_node<std::tuple<done_tag, done_tag>, tbb::flow::queueing>;
-  join_t node_join{g};
-
-  // out node
-  tbb::flow::function_node<join_t::output_type> out_node{
-      g, tbb::flow::unlimited, [&](const join_t::output_type&) {
-        // Serial execution
-        std::array<float, array_size> c_gold;
-        for (size_t i = 0; i < array_size; ++i)
-          c_gold[i] = a_array[i] + alpha * b_array[i];
-
-        // Compare golden triad with heterogeneous triad
-        if (!std::equal(std::begin(c_array), std::end(c_array),
-                        std::begin(c_gold)))
-          std::cout << "Heterogenous triad error.\n";
-        else
-          std::cout << "Heterogenous triad correct.\n";
-
-        PrintArr("c_array: ", c_array);
-        PrintArr("c_gold : ", c_gold);
-      }};  // end of out node
+  // join node: matches both sides of a chunk by sequence number
+  using join_t = tbb::flow::join_node<std::tuple<ChunkTime, ChunkTime>,
+                                      tbb::flow::key_matching<size_t>>;
+  join_t node_join{g, [](const ChunkTime& t) { return t.seq; },
+                   [](const ChunkTime& t) { return t.seq; }};
+
+  // out node: feeds the measurements back to the offload ratio
+  tbb::flow::function_node<join_t::output_type, tbb::flow::continue_msg>
+      out_node{g, tbb::flow::serial, [&](const join_t::output_type& times) {
+                 const ChunkTime& gpu = std::get<0>(times);
+                 const ChunkTime& cpu = std::get<1>(times);
+                 // The short last chunks of the requests are dominated by
+                 // overheads and do not measure the throughputs
+                 if (gpu.items + cpu.items >= chunk_size / 2)
+                   ratio.Update(gpu.items, gpu.seconds, cpu.items, cpu.seconds);
+
+                 if (gpu.seq < chunks_to_print) {
+                   std::cout << "  chunk " << gpu.seq << ": GPU "
+                             << gpu.items << " elements in " << gpu.seconds * 1e3
+                             << " ms, CPU " << cpu.items << " elements in "
+                             << cpu.seconds * 1e3 << " ms\n";
+                 }
+                 return tbb::flow::continue_msg{};
+               }};
 
   // construct graph
-  tbb::flow::make_edge(in_node, a_node);
-  tbb::flow::make_edge(in_node, cpu_node);
+  tbb::flow::make_edge(in_node, limiter);
+  tbb::flow::make_edge(limiter, split_node);
+  tbb::flow::make_edge(split_node, a_node);
+  tbb::flow::make_edge(split_node, cpu_node);
   tbb::flow::make_edge(a_node, tbb::flow::input_port<0>(node_join));
   tbb::flow::make_edge(cpu_node, tbb::flow::input_port<1>(node_join));
   tbb::flow::make_edge(node_join, out_node);
+  tbb::flow::make_edge(out_node, limiter.decrementer());
 
+  dpc_common::TimeInterval timer;
   in_node.activate();
   g.wait_for_all();
+  double seconds = timer.Elapsed();
+
+  sycl::free(a_device, q);
+  sycl::free(b_device, q);
+  sycl::free(c_device, q);
+
+  if (adaptive) {
+    std::cout << "  measured GPU " << ratio.device_rate() * 1e-6
+              << " Melements/s, CPU " << ratio.cpu_rate() * 1e-6
+              << " Melements/s, final offload ratio " << ratio.ratio() << "\n";
+  }
+  return total_items / seconds;
+}
+
+bool CheckRequests(const std::vector<Request>& requests) {
+  for (const auto& r : requests) {
+    for (size_t i = 0; i < r.c_array.size(); ++i) {
+      if (r.c_array[i] != r.a_array[i] + alpha * r.b_array[i]) return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  int nth = 4; // number of threads
+
+  auto mp = tbb::global_control::max_allowed_parallelism;
+  tbb::global_control gc(mp, nth + 1);  // One more thread, but sleeping
+
+  // init input arrays, the requests have different sizes
+  std::vector<Request> requests(num_requests);
+  for (size_t r = 0; r < num_requests; ++r) {
+    size_t size = (r % 3 + 2) * chunk_size + r * 1000;
+    requests[r].a_array.resize(size);
+    requests[r].b_array.resize(size);
+    requests[r].c_array.resize(size);
+    tbb::parallel_for(tbb::blocked_range<size_t>{0, size},
+                      [&](const tbb::blocked_range<size_t>& range) {
+                        for (size_t i = range.begin(); i < range.end(); ++i) {
+                          requests[r].a_array[i] = static_cast<float>(i % 1000);
+                          requests[r].b_array[i] = static_cast<float>(i % 777);
+                        }
+                      });
+  }
+
+  bool correct = true;
+  std::cout << "Fixed offload ratio " << initial_ratio << ":\n";
+  double fixed_rate = RunStream(requests, false);
+  correct &= CheckRequests(requests);
+
+  for (auto& r : requests) std::fill(r.c_array.begin(), r.c_array.end(), 0.0f);
+
+  std::cout << "Adaptive offload ratio:\n";
+  double adaptive_rate = RunStream(requests, true);
+  correct &= CheckRequests(requests);
+
+  std::cout << "Throughput with fixed ratio:    " << fixed_rate * 1e-6
+            << " Melements/s\n";
+  std::cout << "Throughput with adaptive ratio: " << adaptive_rate * 1e-6
+            << " Melements/s\n";
+
+  if (!correct) {
+    std::cout << "Heterogenous triad error.\n";
+    return 1;
+  }
+  std::cout << "Heterogenous triad correct.\n";
 
   return 0;
 }
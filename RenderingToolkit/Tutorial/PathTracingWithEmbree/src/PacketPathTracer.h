@@ -0,0 +1,289 @@
+#pragma once
+#ifndef FILE_PACKETPATHTRACERSEEN
+#define FILE_PACKETPATHTRACERSEEN
+
+#include "Lights.h"
+#include "RandomSampler.h"
+#include "SceneGraph.h"
+#include "definitions.h"
+
+/* One path per pixel of a tile is traced at a time */
+#define MAX_TILE_PATHS (TILE_SIZE_X * TILE_SIZE_Y)
+
+/* Structure of arrays (SoA) state of the paths of a tile. For each bounce the
+ * rays of the paths still alive are gathered from here into packets */
+struct alignas(64) PathStateSoA {
+  float org_x[MAX_TILE_PATHS], org_y[MAX_TILE_PATHS], org_z[MAX_TILE_PATHS];
+  float dir_x[MAX_TILE_PATHS], dir_y[MAX_TILE_PATHS], dir_z[MAX_TILE_PATHS];
+  float tnear[MAX_TILE_PATHS];
+  /* path throughput */
+  float Lw_x[MAX_TILE_PATHS], Lw_y[MAX_TILE_PATHS], Lw_z[MAX_TILE_PATHS];
+  /* radiance gathered along the path */
+  float L_x[MAX_TILE_PATHS], L_y[MAX_TILE_PATHS], L_z[MAX_TILE_PATHS];
+  /* eta of the current medium, and of the medium behind the next
+   * refraction */
+  float eta[MAX_TILE_PATHS];
+  float next_eta[MAX_TILE_PATHS];
+  RandomSampler sampler[MAX_TILE_PATHS];
+
+  /* indices of the paths still alive */
+  unsigned int active[MAX_TILE_PATHS];
+  unsigned int numActive;
+
+  Vec3fa org(unsigned int k) const {
+    return Vec3fa(org_x[k], org_y[k], org_z[k]);
+  }
+  Vec3fa dir(unsigned int k) const {
+    return Vec3fa(dir_x[k], dir_y[k], dir_z[k]);
+  }
+  Vec3fa Lw(unsigned int k) const {
+    return Vec3fa(Lw_x[k], Lw_y[k], Lw_z[k]);
+  }
+  Vec3fa L(unsigned int k) const { return Vec3fa(L_x[k], L_y[k], L_z[k]); }
+
+  void set_ray(unsigned int k, const Vec3fa& o, const Vec3fa& d, float tn) {
+    org_x[k] = o.x;
+    org_y[k] = o.y;
+    org_z[k] = o.z;
+    dir_x[k] = d.x;
+    dir_y[k] = d.y;
+    dir_z[k] = d.z;
+    tnear[k] = tn;
+  }
+  void set_Lw(unsigned int k, const Vec3fa& v) {
+    Lw_x[k] = v.x;
+    Lw_y[k] = v.y;
+    Lw_z[k] = v.z;
+  }
+  void add_L(unsigned int k, const Vec3fa& v) {
+    L_x[k] += v.x;
+    L_y[k] += v.y;
+    L_z[k] += v.z;
+  }
+};
+
+/* Path tracer that traces all paths of a screen tile together. Primary rays
+ * of neighboring pixels are coherent and traced as packets; secondary and
+ * shadow rays are traced in packets of the paths still alive, which are
+ * compacted after each bounce so the packets stay full. The light transport
+ * is the same as in PathTracer::render_path, and each path draws the same
+ * random numbers in the same order. */
+struct PacketPathTracer {
+ public:
+  PacketPathTracer(unsigned int max_path_length);
+
+  ~PacketPathTracer();
+
+  /* Traces one path per pixel of the tile [x0, x1) x [y0, y1) for the sample
+   * sampleID, and adds the radiance of the pixels to L, in row major order.
+   * Returns the number of rays cast */
+  unsigned long long render_tile(unsigned int x0, unsigned int x1,
+                                 unsigned int y0, unsigned int y1,
+                                 unsigned int sampleID,
+                                 std::shared_ptr<SceneGraph> sg, Vec3fa* L);
+
+ private:
+  /* Intersects the packet of paths, gathers emitted and direct light, and
+   * samples the continuation of the paths. The indices of the paths still
+   * alive are appended to state.active at numAlive. Returns the number of rays
+   * cast */
+  unsigned long long trace_packet(PathStateSoA& state,
+                                  const unsigned int* paths,
+                                  unsigned int count, bool coherent,
+                                  SceneGraph& sg, unsigned int& numAlive);
+
+  unsigned int m_max_path_length;
+
+  /* "Time" set to 0.0f for all rays as there is no motion blur, nor frame
+   * interpolation, nor animation */
+  const float m_time = 0.0f;
+};
+
+PacketPathTracer::PacketPathTracer(unsigned int max_path_length)
+    : m_max_path_length(max_path_length) {}
+
+unsigned long long PacketPathTracer::render_tile(
+    unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1,
+    unsigned int sampleID, std::shared_ptr<SceneGraph> sg, Vec3fa* L) {
+  PathStateSoA state;
+
+  /* Primary rays, with the same random offsets as the scalar path tracer */
+  const Vec3fa camOrg = sg->get_camera_origin();
+  unsigned int numPaths = 0;
+  for (unsigned int y = y0; y < y1; y++)
+    for (unsigned int x = x0; x < x1; x++) {
+      const unsigned int k = numPaths++;
+      state.sampler[k].seed(x, y, sampleID);
+      float fx = x + state.sampler[k].get_float();
+      float fy = y + state.sampler[k].get_float();
+      state.set_ray(k, camOrg, sg->get_direction_from_pixel(fx, fy), 0.0f);
+      state.set_Lw(k, Vec3fa(1.0f));
+      state.L_x[k] = state.L_y[k] = state.L_z[k] = 0.0f;
+      state.eta[k] = state.next_eta[k] = 1.f;
+      state.active[k] = k;
+    }
+  state.numActive = numPaths;
+
+  unsigned long long numRays = 0;
+  for (unsigned int i = 0; i < m_max_path_length && state.numActive > 0;
+       i++) {
+    /* terminate paths if contribution too low */
+    unsigned int numActive = 0;
+    for (unsigned int j = 0; j < state.numActive; j++) {
+      const unsigned int k = state.active[j];
+      if (max(state.Lw_x[k], max(state.Lw_y[k], state.Lw_z[k])) >= 0.01f)
+        state.active[numActive++] = k;
+    }
+
+    /* Paths still alive after the bounce are compacted in place: a packet
+     * never writes past the indices it has read */
+    unsigned int numAlive = 0;
+    for (unsigned int first = 0; first < numActive; first += PACKET_SIZE) {
+      unsigned int paths[PACKET_SIZE];
+      const unsigned int count =
+          min((unsigned int)PACKET_SIZE, numActive - first);
+      for (unsigned int j = 0; j < count; j++)
+        paths[j] = state.active[first + j];
+      numRays += trace_packet(state, paths, count, i == 0, *sg, numAlive);
+    }
+    state.numActive = numAlive;
+  }
+
+  for (unsigned int k = 0; k < numPaths; k++) L[k] = L[k] + state.L(k);
+
+  return numRays;
+}
+
+unsigned long long PacketPathTracer::trace_packet(PathStateSoA& state,
+                                                  const unsigned int* paths,
+                                                  unsigned int count,
+                                                  bool coherent,
+                                                  SceneGraph& sg,
+                                                  unsigned int& numAlive) {
+  RayHitPacket rayhit;
+  // rtcIntersect4/8/16 require the valid mask aligned to the packet size
+  alignas(4 * PACKET_SIZE) int valid[PACKET_SIZE];
+  for (unsigned int j = 0; j < PACKET_SIZE; j++) {
+    valid[j] = j < count ? -1 : 0;
+    if (j < count) {
+      const unsigned int k = paths[j];
+      init_RayHitPacket(rayhit, j, state.org(k), state.dir(k), state.tnear[k],
+                        inf, m_time);
+    }
+  }
+  sg.intersect_packet(valid, rayhit, coherent);
+  unsigned long long numRays = count;
+
+  /* Material discovery, per lane. See PathTracer::render_path */
+  DifferentialGeometry dg[PACKET_SIZE];
+  Vec3fa albedo[PACKET_SIZE];
+  MaterialType materialType[PACKET_SIZE];
+  Vec2f randomMatSample[PACKET_SIZE];
+  /* lanes with a path continuing after the hit, and with direct light */
+  bool shade[PACKET_SIZE];
+  bool direct[PACKET_SIZE];
+  for (unsigned int j = 0; j < PACKET_SIZE; j++) {
+    shade[j] = direct[j] = false;
+    if (j >= count || rayhit.hit.geomID[j] == RTC_INVALID_GEOMETRY_ID)
+      continue;
+
+    const unsigned int k = paths[j];
+    const unsigned int geomID = rayhit.hit.geomID[j];
+    const unsigned int primID = rayhit.hit.primID[j];
+    sg.get_differential_geometry(state.org(k), state.dir(k),
+                                 rayhit.ray.tfar[j], get_RTCHit(rayhit, j),
+                                 dg[j]);
+
+    materialType[j] = sg.m_mapGeomToPrim[geomID].materialTable[primID];
+    if (materialType[j] == MaterialType::MATERIAL_EMITTER) {
+      std::shared_ptr<Light> light = sg.get_light_from_geomID(geomID);
+      Light_EvalRes le = light->eval(state.org(k), state.dir(k));
+      state.add_L(k, state.Lw(k) * le.value);
+      continue;
+    }
+    albedo[j] = sg.m_mapGeomToPrim[geomID].primColorTable[primID];
+
+    randomMatSample[j] = Vec2f(state.sampler[k].get_float(),
+                               state.sampler[k].get_float());
+    shade[j] = true;
+    direct[j] = Material_direct_illumination(materialType[j]);
+  }
+
+  /* One packet of shadow rays per light */
+  for (const std::shared_ptr<Light>& light : sg.m_lights) {
+    RayPacket shadow;
+    alignas(4 * PACKET_SIZE) int shadowValid[PACKET_SIZE];
+    Light_SampleRes ls[PACKET_SIZE];
+    Vec2f randomLightSample[PACKET_SIZE];
+    bool any = false;
+    for (unsigned int j = 0; j < PACKET_SIZE; j++) {
+      shadowValid[j] = 0;
+      if (!direct[j]) continue;
+
+      const unsigned int k = paths[j];
+      randomLightSample[j] = Vec2f(state.sampler[k].get_float(),
+                                   state.sampler[k].get_float());
+      ls[j] = light->sample(dg[j], randomLightSample[j]);
+
+      /* If the sample probability density evaluation is 0 then no need to
+       * consider this shadow ray */
+      if (ls[j].pdf <= 0.0f) continue;
+
+      init_RayPacket(shadow, j, dg[j].P, ls[j].dir, dg[j].eps, ls[j].dist,
+                     m_time);
+      shadowValid[j] = -1;
+      any = true;
+      numRays++;
+    }
+    if (!any) continue;
+
+    sg.occluded_packet(shadowValid, shadow);
+    for (unsigned int j = 0; j < PACKET_SIZE; j++) {
+      if (!shadowValid[j] || shadow.tfar[j] < 0.0f) continue;
+
+      const unsigned int k = paths[j];
+      Medium medium;
+      medium.eta = state.eta[k];
+      const Vec3fa Lw = state.Lw(k);
+      state.add_L(k, Lw * ls[j].weight *
+                         Material_eval(albedo[j], materialType[j], Lw,
+                                       -state.dir(k), dg[j], ls[j].dir, medium,
+                                       randomLightSample[j]));
+    }
+  }
+
+  /* Sample the next segment of the paths */
+  for (unsigned int j = 0; j < PACKET_SIZE; j++) {
+    if (!shade[j]) continue;
+
+    const unsigned int k = paths[j];
+    const Vec3fa Lw = state.Lw(k);
+    const Vec3fa wo = -state.dir(k);
+    Medium medium, nextMedium;
+    medium.eta = state.eta[k];
+    nextMedium.eta = state.next_eta[k];
+
+    Vec3fa c = Vec3fa(1.0f);
+    Vec3fa wi1 = Material_sample(materialType[j], Lw, wo, dg[j], medium,
+                                 nextMedium, randomMatSample[j]);
+    c = c * Material_eval(albedo[j], materialType[j], Lw, wo, dg[j], wi1,
+                          medium);
+    float nextPDF = Material_pdf(materialType[j], Lw, wo, dg[j], medium, wi1);
+
+    if (nextPDF <= 1E-4f) continue;
+    state.set_Lw(k, Lw * c / nextPDF);
+
+    /* setup secondary ray */
+    state.eta[k] = state.next_eta[k] = nextMedium.eta;
+    float sign = dot(wi1, dg[j].Ng) < 0.0f ? -1.0f : 1.0f;
+    const Vec3fa org = dg[j].P + sign * dg[j].eps * dg[j].Ng;
+    state.set_ray(k, org, normalize(wi1), dg[j].eps);
+    state.active[numAlive++] = k;
+  }
+
+  return numRays;
+}
+
+PacketPathTracer::~PacketPathTracer() {}
+
+#endif /* FILE_PACKETPATHTRACERSEEN */
@@ -24,10 +24,11 @@ struct PathTracer {
 
   ~PathTracer();
 
-  /* task that renders a single path pixel */
+  /* task that renders a single path pixel, numRays is incremented by the
+   * number of rays cast */
   Vec3fa render_path(float x, float y, RandomSampler& randomSampler,
                                  std::shared_ptr<SceneGraph> sg,
-                                 unsigned int pxID);
+                                 unsigned int pxID, unsigned long long& numRays);
 
  private:
   unsigned int m_max_path_length;
@@ -52,7 +53,8 @@ PathTracer::PathTracer(unsigned int max_path_length, unsigned int width,
 /* task that renders a single screen pixel */
 Vec3fa PathTracer::render_path(float x, float y, RandomSampler& randomSampler,
                                std::shared_ptr<SceneGraph> sg,
-                               unsigned int pxID) {
+                               unsigned int pxID,
+                               unsigned long long& numRays) {
   Vec3fa dir = sg->get_direction_from_pixel(x, y);
   Vec3fa org = sg->get_camera_origin();
 
@@ -75,6 +77,7 @@ Vec3fa PathTracer::render_path(float x, float y, RandomSampler& randomSampler,
     /* terminate if contribution too low */
     if (max(Lw.x, max(Lw.y, Lw.z)) < 0.01f) break;
 
+    numRays++;
     if (!sg->intersect_path_and_scene(org, dir, rayhit, dg)) break;
 
     const Vec3fa wo = -dir;
@@ -120,8 +123,8 @@ Vec3fa PathTracer::render_path(float x, float y, RandomSampler& randomSampler,
 
     if (Material_direct_illumination(materialType)) {
       /* Cast shadow ray(s) from the hit point */
-      sg->cast_shadow_rays(dg, albedo, materialType, Lw, wo, medium, m_time, L,
-                           randomSampler);
+      numRays += sg->cast_shadow_rays(dg, albedo, materialType, Lw, wo, medium,
+                                      m_time, L, randomSampler);
     }
 
     /* Sample, Eval, and PDF computation are split and internally perform some
@@ -6,15 +6,31 @@
 #include <embree3/rtcore.h>
 #include <tbb/parallel_for.h>
 
+#include <atomic>
+#include <limits>
+#include <queue>
+
+#include "PacketPathTracer.h"
 #include "PathTracer.h"
 #include "SceneGraph.h"
 #include "definitions.h"
 
+/* Adaptive sampling: number of uniform accumulations before tiles are
+ * scheduled by their error, so that the variance estimates are meaningful */
+#define ADAPTIVE_MIN_ACCUMULATIONS 8
+/* Adaptive sampling: fraction (1/N) of the tiles rendered per adaptive pass */
+#define ADAPTIVE_BATCH_DIVISOR 8
+
+/* Selects how the paths of a tile are traced: one ray at a time, or all paths
+ * of the tile together in ray packets */
+enum class TraversalMode { SCALAR, PACKET };
+
 struct Renderer {
  public:
   Renderer(unsigned int width, unsigned int height, unsigned int channels,
            unsigned int samples_per_pixel, unsigned int accumulation_limit,
-           unsigned int max_path_length, SceneSelector SELECTED_SCENE);
+           unsigned int max_path_length, SceneSelector SELECTED_SCENE,
+           TraversalMode traversal = TraversalMode::PACKET);
   ~Renderer();
 
   static void handle_error(void* userPtr, const RTCError code,
@@ -27,20 +43,48 @@ struct Renderer {
   /* called by the C++ code to render */
   void render_accumulation();
 
+  /* called by the C++ code to render progressively with adaptive sampling:
+   * renders one more sample in the noisiest tiles. Returns false once the
+   * error of every tile is below target_error, or the tiles above it have
+   * reached the accumulation limit */
+  bool render_adaptive(float target_error);
+
+  /* renders tiles[0, numTasks) in parallel, or all tiles if tiles is null */
+  void render_tiles(const int* tiles, size_t numTasks);
+
   /* task that renders a single screen tile */
   void render_tile_task(
       int taskIndex, int threadIndex, const int numTilesX, const int numTilesY,
       RandomSampler& randomSampler);
 
   Vec3fa render_pixel_samples(
-      int x, int y, RandomSampler& randomSampler);
+      int x, int y, unsigned int pass, RandomSampler& randomSampler,
+      unsigned long long& numRays);
+
+  /* relative standard error of the mean luminance of the pixels of a tile */
+  float compute_tile_error(unsigned int x0, unsigned int x1, unsigned int y0,
+                           unsigned int y1);
+
+  /* largest error over all tiles */
+  float get_max_tile_error();
+
+  /* number of pixel samples rendered since the start */
+  unsigned long long get_sample_count();
+
+  /* adds a sample to the accumulation buffer and updates the framebuffer */
+  void write_pixel(unsigned int x, unsigned int y, const Vec3fa& Lsample);
 
   unsigned char* get_pixels();
 
+  /* number of rays cast by the last accumulation or adaptive pass */
+  unsigned long long get_ray_count();
+
   unsigned char* m_pixels = nullptr;
 
  private:
   std::shared_ptr<PathTracer> m_pt;
+  std::shared_ptr<PacketPathTracer> m_ppt;
+  TraversalMode m_traversal;
   /* We might want to use this function outside of our path tracer at somepoint
    */
   inline Vec3fa face_forward(const Vec3fa& dir, const Vec3fa& _Ng);
@@ -55,8 +99,22 @@ struct Renderer {
   std::shared_ptr<SceneGraph> m_sg;
 
   /* Additions for pathtracer */
-  std::vector<std::shared_ptr<Vec3ff>> m_accu;
+  /* One contiguous, cache line aligned accumulation buffer */
+  Vec3ff* m_accu = nullptr;
+  /* sum of the squared luminance of the samples of each pixel, for the
+   * variance estimate of adaptive sampling */
+  float* m_accu_lum2 = nullptr;
   unsigned int m_accu_count = 0;
+  std::atomic<unsigned long long> m_ray_count{0};
+  std::atomic<unsigned long long> m_sample_count{0};
+
+  /* Additions for adaptive sampling: per tile accumulation count and error,
+   * and the tiles above the target error, noisiest first */
+  int m_numTilesX;
+  int m_numTilesY;
+  std::vector<unsigned int> m_tile_passes;
+  std::vector<float> m_tile_error;
+  std::priority_queue<std::pair<float, int>> m_tile_queue;
   unsigned int m_max_path_length;
   unsigned int m_spp;
   SceneSelector m_sceneSelector;
@@ -71,8 +129,10 @@ struct Renderer {
 Renderer::Renderer(unsigned int width, unsigned int height,
                    unsigned int channels, unsigned int samples_per_pixel,
                    unsigned int accumulation_limit,
-                   unsigned int max_path_length, SceneSelector SELECTED_SCENE)
-    : m_width(width),
+                   unsigned int max_path_length, SceneSelector SELECTED_SCENE,
+                   TraversalMode traversal)
+    : m_traversal(traversal),
+      m_width(width),
       m_height(height),
       m_channels(channels),
       m_spp(samples_per_pixel),
@@ -86,9 +146,18 @@ Renderer::Renderer(unsigned int width, unsigned int height,
 
   /* accumulation buffer used for convenience here, but is critical in
    * interactive/future applications */
-  m_accu.resize(m_width * m_height);
-  for (auto i = 0; i < m_width * m_height; i++)
-    m_accu[i] = std::make_shared<Vec3ff>(0.0f);
+  m_accu = (Vec3ff*)alignedMalloc(m_width * m_height * sizeof(Vec3ff), 64);
+  m_accu_lum2 = (float*)alignedMalloc(m_width * m_height * sizeof(float), 64);
+  for (auto i = 0; i < m_width * m_height; i++) {
+    m_accu[i] = Vec3ff(0.0f);
+    m_accu_lum2[i] = 0.0f;
+  }
+
+  m_numTilesX = (m_width + TILE_SIZE_X - 1) / TILE_SIZE_X;
+  m_numTilesY = (m_height + TILE_SIZE_Y - 1) / TILE_SIZE_Y;
+  m_tile_passes.assign(m_numTilesX * m_numTilesY, 0);
+  m_tile_error.assign(m_numTilesX * m_numTilesY,
+                      std::numeric_limits<float>::infinity());
 
   init_device(nullptr);
 
@@ -98,6 +167,7 @@ Renderer::Renderer(unsigned int width, unsigned int height,
   //  For Multiple Importance sampling we need per pixel storage for light PDFs
   m_pt = std::make_shared<PathTracer>(max_path_length, m_width, m_height,
                                       m_sg->getNumLights());
+  m_ppt = std::make_shared<PacketPathTracer>(max_path_length);
 }
 
 void Renderer::handle_error(void* userPtr, const RTCError code,
@@ -151,25 +221,65 @@ void Renderer::init_scene(char* cfg, unsigned int width, unsigned int height) {
 
 /* called by the C++ code to render */
 void Renderer::render_accumulation() {
-  const int numTilesX = (m_width + TILE_SIZE_X - 1) / TILE_SIZE_X;
-  const int numTilesY = (m_height + TILE_SIZE_Y - 1) / TILE_SIZE_Y;
+  render_tiles(nullptr, m_numTilesX * m_numTilesY);
+
+  m_accu_count++;
+}
+
+bool Renderer::render_adaptive(float target_error) {
+  /* Uniform accumulations first, then all tiles still above the target
+   * error are queued */
+  if (m_accu_count < ADAPTIVE_MIN_ACCUMULATIONS) {
+    render_accumulation();
+    if (m_accu_count < ADAPTIVE_MIN_ACCUMULATIONS) return true;
+
+    m_tile_queue = std::priority_queue<std::pair<float, int>>();
+    for (int i = 0; i < m_numTilesX * m_numTilesY; i++)
+      if (m_tile_error[i] > target_error && m_tile_passes[i] < m_accu_limit)
+        m_tile_queue.push(std::make_pair(m_tile_error[i], i));
+    return !m_tile_queue.empty();
+  }
+
+  if (m_tile_queue.empty()) return false;
+
+  /* One more sample in the noisiest tiles. Enough tiles are taken at a time
+   * to keep all threads busy */
+  const size_t batch =
+      max(m_numTilesX * m_numTilesY / ADAPTIVE_BATCH_DIVISOR, 1);
+  std::vector<int> tiles;
+  while (!m_tile_queue.empty() && tiles.size() < batch) {
+    tiles.push_back(m_tile_queue.top().second);
+    m_tile_queue.pop();
+  }
+
+  render_tiles(tiles.data(), tiles.size());
+
+  /* The error of the tiles rendered is updated, the others are unchanged */
+  for (int tile : tiles)
+    if (m_tile_error[tile] > target_error && m_tile_passes[tile] < m_accu_limit)
+      m_tile_queue.push(std::make_pair(m_tile_error[tile], tile));
+
+  return !m_tile_queue.empty();
+}
+
+void Renderer::render_tiles(const int* tiles, size_t numTasks) {
+  m_ray_count = 0;
   tbb::task_group_context tgContext;
   tbb::parallel_for(
-      tbb::blocked_range<size_t>(0, numTilesX * numTilesY, 1),
+      tbb::blocked_range<size_t>(0, numTasks, 1),
       [&](const tbb::blocked_range<size_t>& r) {
         const int threadIndex = tbb::this_task_arena::current_thread_index();
 
         RandomSampler randomSampler;
 
         for (size_t i = r.begin(); i < r.end(); i++) {
-          render_tile_task((int)i, threadIndex, numTilesX, numTilesY, randomSampler);
+          render_tile_task(tiles ? tiles[i] : (int)i, threadIndex, m_numTilesX,
+                           m_numTilesY, randomSampler);
         }
       },
       tgContext);
   if (tgContext.is_group_execution_cancelled())
     throw std::runtime_error("fail: oneTBB task cancelled");
-
-  m_accu_count++;
 }
 
 /* task that renders a single screen tile */
@@ -183,40 +293,74 @@ void Renderer::render_tile_task(
   const unsigned int y0 = tileY * TILE_SIZE_Y;
   const unsigned int y1 = min(y0 + TILE_SIZE_Y, m_height);
 
-  for (unsigned int y = y0; y < y1; y++)
-    for (unsigned int x = x0; x < x1; x++) {
-      Vec3fa Lsample = render_pixel_samples(x, y, randomSampler);
-
-      /* In case you run into issues with visibility try manual debug */
-      //#define MY_DEBUG
+  unsigned long long numRays = 0;
+  /* Tiles get different numbers of samples with adaptive sampling, so the
+   * random sequences are indexed by the accumulations of the tile */
+  const unsigned int pass = m_tile_passes[taskIndex];
+
+  if (m_traversal == TraversalMode::PACKET) {
+    /* All paths of the tile are traced together, one sample at a time */
+    Vec3fa L[TILE_SIZE_X * TILE_SIZE_Y];
+    for (unsigned int i = 0; i < (x1 - x0) * (y1 - y0); i++)
+      L[i] = Vec3fa(0.0f);
+
+    for (int i = 0; i < m_spp; i++)
+      numRays +=
+          m_ppt->render_tile(x0, x1, y0, y1, pass * m_spp + i, m_sg, L);
+
+    unsigned int k = 0;
+    for (unsigned int y = y0; y < y1; y++)
+      for (unsigned int x = x0; x < x1; x++)
+        write_pixel(x, y, L[k++] / (float)m_spp);
+  } else {
+    for (unsigned int y = y0; y < y1; y++)
+      for (unsigned int x = x0; x < x1; x++) {
+        Vec3fa Lsample =
+            render_pixel_samples(x, y, pass, randomSampler, numRays);
+
+        /* In case you run into issues with visibility try manual debug */
+        //#define MY_DEBUG
 #ifdef MY_DEBUG
-      if (max(max(color.x, color.y), color.z) > 0.0f)
-        std::cout << "Hit pixel at :" << x << " , " << y << ": " << color.x
-                  << " " << color.y << " " << color.z << "\n";
+        if (max(max(color.x, color.y), color.z) > 0.0f)
+          std::cout << "Hit pixel at :" << x << " , " << y << ": " << color.x
+                    << " " << color.y << " " << color.z << "\n";
 #endif
-      /* write color to accumulation buffer */
-
-      Vec3ff accu_color =
-          *m_accu[y * m_width + x] + Vec3ff(Lsample.x, Lsample.y, Lsample.z, 1.0f);
-      *m_accu[y * m_width + x] = accu_color;
-      float f = rcp(max(0.001f, accu_color.w));
-
-      /* write color from accumulation buffer to framebuffer */
-      unsigned char r =
-          (unsigned char)(255.0f * clamp(accu_color.x * f, 0.0f, 1.0f));
-      unsigned char g =
-          (unsigned char)(255.0f * clamp(accu_color.y * f, 0.0f, 1.0f));
-      unsigned char b =
-          (unsigned char)(255.0f * clamp(accu_color.z * f, 0.0f, 1.0f));
-      m_pixels[y * m_width * m_channels + x * m_channels] = r;
-      m_pixels[y * m_width * m_channels + x * m_channels + 1] = g;
-      m_pixels[y * m_width * m_channels + x * m_channels + 2] = b;
-    }
+        write_pixel(x, y, Lsample);
+      }
+  }
+
+  m_ray_count += numRays;
+  m_sample_count += (x1 - x0) * (y1 - y0) * m_spp;
+  m_tile_passes[taskIndex] = pass + 1;
+  m_tile_error[taskIndex] = compute_tile_error(x0, x1, y0, y1);
+}
+
+void Renderer::write_pixel(unsigned int x, unsigned int y,
+                           const Vec3fa& Lsample) {
+  /* write color to accumulation buffer */
+  Vec3ff accu_color =
+      m_accu[y * m_width + x] + Vec3ff(Lsample.x, Lsample.y, Lsample.z, 1.0f);
+  m_accu[y * m_width + x] = accu_color;
+  const float lum = luminance(Lsample);
+  m_accu_lum2[y * m_width + x] += lum * lum;
+  float f = rcp(max(0.001f, accu_color.w));
+
+  /* write color from accumulation buffer to framebuffer */
+  unsigned char r =
+      (unsigned char)(255.0f * clamp(accu_color.x * f, 0.0f, 1.0f));
+  unsigned char g =
+      (unsigned char)(255.0f * clamp(accu_color.y * f, 0.0f, 1.0f));
+  unsigned char b =
+      (unsigned char)(255.0f * clamp(accu_color.z * f, 0.0f, 1.0f));
+  m_pixels[y * m_width * m_channels + x * m_channels] = r;
+  m_pixels[y * m_width * m_channels + x * m_channels + 1] = g;
+  m_pixels[y * m_width * m_channels + x * m_channels + 2] = b;
 }
 
 /* task that renders a single screen pixel */
 Vec3fa Renderer::render_pixel_samples(
-    int x, int y, RandomSampler& randomSampler) {
+    int x, int y, unsigned int pass, RandomSampler& randomSampler,
+    unsigned long long& numRays) {
   Vec3fa L = Vec3fa(0.0f);
 
   for (int i = 0; i < m_spp; i++) {
@@ -227,14 +371,15 @@ Vec3fa Renderer::render_pixel_samples(
     */
 
 
-    randomSampler.seed(x, y, m_accu_count * m_spp + i);
+    randomSampler.seed(x, y, pass * m_spp + i);
     /* calculate pixel color, slightly offset the ray cast orientation randomly
      * so each sample occurs at a slightly different location within a pixel */
     /* Note: random offsets for samples within a pixel provide natural
      * anti-aliasing (smoothing) near object edges */
     float fx = x + randomSampler.get_float();
     float fy = y + randomSampler.get_float();
-    L = L + m_pt->render_path(fx, fy, randomSampler, m_sg, y * m_width + x);
+    L = L + m_pt->render_path(fx, fy, randomSampler, m_sg, y * m_width + x,
+                              numRays);
     /* If you are not seeing anything, try some printf debug */
     //#define MY_DEBUG
 #ifdef MY_DEBUG
@@ -250,7 +395,48 @@ Vec3fa Renderer::render_pixel_samples(
 
 unsigned char* Renderer::get_pixels() { return m_pixels; }
 
+unsigned long long Renderer::get_ray_count() { return m_ray_count; }
+
+/* The error of a pixel is the standard error of its mean luminance relative
+ * to the mean, from the samples accumulated so far; the tile error is the
+ * root mean square over its pixels. The offset in the denominator keeps dark
+ * pixels from dominating the error */
+float Renderer::compute_tile_error(unsigned int x0, unsigned int x1,
+                                   unsigned int y0, unsigned int y1) {
+  float sum = 0.0f;
+  for (unsigned int y = y0; y < y1; y++)
+    for (unsigned int x = x0; x < x1; x++) {
+      const Vec3ff& accu = m_accu[y * m_width + x];
+      const float n = accu.w;
+      if (n < 2.0f) return std::numeric_limits<float>::infinity();
+
+      const float mean = luminance(Vec3fa(accu.x, accu.y, accu.z)) / n;
+      const float variance =
+          max(0.0f, m_accu_lum2[y * m_width + x] / n - mean * mean) * n /
+          (n - 1.0f);
+      const float error = variance / n / ((mean + 0.01f) * (mean + 0.01f));
+      sum += error;
+    }
+  return std::sqrt(sum / ((x1 - x0) * (y1 - y0)));
+}
+
+float Renderer::get_max_tile_error() {
+  float error = 0.0f;
+  for (float e : m_tile_error) error = max(error, e);
+  return error;
+}
+
+unsigned long long Renderer::get_sample_count() { return m_sample_count; }
+
 Renderer::~Renderer() {
+  if (m_accu) {
+    alignedFree(m_accu);
+    m_accu = nullptr;
+  }
+  if (m_accu_lum2) {
+    alignedFree(m_accu_lum2);
+    m_accu_lum2 = nullptr;
+  }
   if (m_pixels) {
     delete m_pixels;
     m_pixels = nullptr;
@@ -31,7 +31,15 @@ struct SceneGraph {
                                             RTCRayHit& rayhit,
                                             DifferentialGeometry& dg);
 
-  void cast_shadow_rays(
+  void get_differential_geometry(const Vec3fa& org, const Vec3fa& dir,
+                                 float tfar, const RTCHit& hit,
+                                 DifferentialGeometry& dg);
+
+  void intersect_packet(const int* valid, RayHitPacket& rayhit, bool coherent);
+
+  void occluded_packet(const int* valid, RayPacket& ray);
+
+  unsigned int cast_shadow_rays(
       DifferentialGeometry& dg, Vec3fa& albedo, MaterialType materialType,
       const Vec3fa& Lw, const Vec3fa& wo, const Medium& medium, float time,
       Vec3fa& L, RandomSampler& randomSampler);
@@ -162,38 +170,65 @@ bool SceneGraph::intersect_path_and_scene(Vec3fa& org, Vec3fa& dir,
    * insteead */
   if (rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID) return false;
 
-  Vec3fa Ng = Vec3fa(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
+  get_differential_geometry(org, dir, rayhit.ray.tfar, rayhit.hit, dg);
+
+  return true;
+}
+
+void SceneGraph::get_differential_geometry(const Vec3fa& org,
+                                           const Vec3fa& dir, float tfar,
+                                           const RTCHit& hit,
+                                           DifferentialGeometry& dg) {
+  Vec3fa Ng = Vec3fa(hit.Ng_x, hit.Ng_y, hit.Ng_z);
   Vec3fa Ns = normalize(Ng);
 
   /* compute differential geometry */
   for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
-    dg.instIDs[i] = rayhit.hit.instID[i];
+    dg.instIDs[i] = hit.instID[i];
 
-  dg.geomID = rayhit.hit.geomID;
-  dg.primID = rayhit.hit.primID;
-  dg.u = rayhit.hit.u;
-  dg.v = rayhit.hit.v;
+  dg.geomID = hit.geomID;
+  dg.primID = hit.primID;
+  dg.u = hit.u;
+  dg.v = hit.v;
 
-  dg.P = org + rayhit.ray.tfar * dir;
+  dg.P = org + tfar * dir;
   dg.Ng = Ng;
   dg.Ns = Ns;
 
   /* Reference epsilon value to move away from the plane, avoid artifacts */
-  dg.eps =
-      32.0f * 1.19209e-07f *
-      max(max(abs(dg.P.x), abs(dg.P.y)), max(abs(dg.P.z), rayhit.ray.tfar));
+  dg.eps = 32.0f * 1.19209e-07f *
+           max(max(abs(dg.P.x), abs(dg.P.y)), max(abs(dg.P.z), tfar));
 
   dg.Ng = face_forward(dir, normalize(dg.Ng));
   dg.Ns = face_forward(dir, normalize(dg.Ns));
+}
 
-  return true;
+/* Packet traversal uses its own intersect context, so that the coherent flag
+ * of primary ray packets does not race with other threads */
+void SceneGraph::intersect_packet(const int* valid, RayHitPacket& rayhit,
+                                  bool coherent) {
+  RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
+  context.flags =
+      coherent ? RTCIntersectContextFlags::RTC_INTERSECT_CONTEXT_FLAG_COHERENT
+               : RTCIntersectContextFlags::RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+  rtcIntersectPacket(valid, m_scene, &context, &rayhit);
+}
+
+void SceneGraph::occluded_packet(const int* valid, RayPacket& ray) {
+  RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
+  context.flags =
+      RTCIntersectContextFlags::RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+  rtcOccludedPacket(valid, m_scene, &context, &ray);
 }
 
-void SceneGraph::cast_shadow_rays(
+/* Returns the number of shadow rays cast */
+unsigned int SceneGraph::cast_shadow_rays(
     DifferentialGeometry& dg, Vec3fa& albedo, MaterialType materialType,
     const Vec3fa& Lw, const Vec3fa& wo, const Medium& medium, float time,
     Vec3fa& L, RandomSampler& randomSampler) {
-  Vec3fa ret;
+  unsigned int numRays = 0;
 
   for (std::shared_ptr<Light> light : m_lights) {
     Vec2f randomLightSample(randomSampler.get_float(), randomSampler.get_float());
@@ -206,12 +241,14 @@ void SceneGraph::cast_shadow_rays(
     RTCRayHit shadow;
     init_RayHit(shadow, dg.P, ls.dir, dg.eps, ls.dist, time);
     rtcOccluded1(m_scene, &m_context, &shadow.ray);
+    numRays++;
     if (shadow.ray.tfar >= 0.0f) {
       L = L + Lw * ls.weight *
                   Material_eval(albedo, materialType, Lw, wo, dg, ls.dir,
                                 medium, randomLightSample);
     }
   }
+  return numRays;
 }
 
 float SceneGraph::cast_shadow_ray(const Vec3fa& org, const Vec3fa& dir,
@@ -31,6 +31,22 @@ using rkcommon::math::LinearSpace3fa;
 #define TILE_SIZE_X 8
 #define TILE_SIZE_Y 8
 
+/* Ray packet width used by the packet tile renderer. 8 matches AVX/AVX2
+ * traversal kernels, 16 can be used on CPUs with AVX-512 */
+#define PACKET_SIZE 8
+
+#if PACKET_SIZE == 16
+typedef RTCRayHit16 RayHitPacket;
+typedef RTCRay16 RayPacket;
+#define rtcIntersectPacket rtcIntersect16
+#define rtcOccludedPacket rtcOccluded16
+#else
+typedef RTCRayHit8 RayHitPacket;
+typedef RTCRay8 RayPacket;
+#define rtcIntersectPacket rtcIntersect8
+#define rtcOccludedPacket rtcOccluded8
+#endif
+
 using Vec3fa = rkcommon::math::vec_t<float, 3, 1>;
 using rkcommon::math::cross;
 using rkcommon::math::deg2rad;
@@ -185,6 +201,11 @@ inline float uniformSampleDiskPDF(const float radius) {
   return rcp(float(M_PI) * (radius * radius));
 }
 
+/* Added for adaptive sampling: relative luminance of a linear color */
+inline float luminance(const Vec3fa& c) {
+  return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
+
 /* Added for pathtracer */
 inline Vec3fa face_forward(const Vec3fa& dir, const Vec3fa& _Ng) {
   const Vec3fa Ng = _Ng;
@@ -209,6 +230,55 @@ inline void init_RayHit(RTCRayHit& rayhit, const Vec3fa& org, const Vec3fa& dir,
   rayhit.ray.mask = -1;
 }
 
+/* Added for packet tracing: Initializes one lane of a ray packet */
+inline void init_RayHitPacket(RayHitPacket& rayhit, int lane, const Vec3fa& org,
+                              const Vec3fa& dir, float tnear, float tfar,
+                              float time) {
+  rayhit.ray.dir_x[lane] = dir.x;
+  rayhit.ray.dir_y[lane] = dir.y;
+  rayhit.ray.dir_z[lane] = dir.z;
+  rayhit.ray.org_x[lane] = org.x;
+  rayhit.ray.org_y[lane] = org.y;
+  rayhit.ray.org_z[lane] = org.z;
+  rayhit.ray.tnear[lane] = tnear;
+  rayhit.ray.time[lane] = time;
+  rayhit.ray.tfar[lane] = tfar;
+  rayhit.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+  rayhit.hit.primID[lane] = RTC_INVALID_GEOMETRY_ID;
+  rayhit.ray.mask[lane] = -1;
+}
+
+/* Added for packet tracing: Initializes one lane of a shadow ray packet */
+inline void init_RayPacket(RayPacket& ray, int lane, const Vec3fa& org,
+                           const Vec3fa& dir, float tnear, float tfar,
+                           float time) {
+  ray.dir_x[lane] = dir.x;
+  ray.dir_y[lane] = dir.y;
+  ray.dir_z[lane] = dir.z;
+  ray.org_x[lane] = org.x;
+  ray.org_y[lane] = org.y;
+  ray.org_z[lane] = org.z;
+  ray.tnear[lane] = tnear;
+  ray.time[lane] = time;
+  ray.tfar[lane] = tfar;
+  ray.mask[lane] = -1;
+}
+
+/* Added for packet tracing: Extracts the hit of one lane of a ray packet */
+inline RTCHit get_RTCHit(const RayHitPacket& rayhit, int lane) {
+  RTCHit hit;
+  hit.Ng_x = rayhit.hit.Ng_x[lane];
+  hit.Ng_y = rayhit.hit.Ng_y[lane];
+  hit.Ng_z = rayhit.hit.Ng_z[lane];
+  hit.u = rayhit.hit.u[lane];
+  hit.v = rayhit.hit.v[lane];
+  hit.primID = rayhit.hit.primID[lane];
+  hit.geomID = rayhit.hit.geomID[lane];
+  for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
+    hit.instID[i] = rayhit.hit.instID[i][lane];
+  return hit;
+}
+
 AffineSpace3fa positionCamera(Vec3fa from, Vec3fa to, Vec3fa up, float fov,
                               size_t width, size_t height) {
   /* There are many ways to set up a camera projection. This one is consolidated
@@ -105,7 +105,88 @@ int write_image_all_accumulations(SceneSelector sceneSelector,
   return ret;
 }
 
-int main() {
+/* Renders a few accumulations of a scene with scalar and with packet ray
+ * traversal and reports the ray throughput of both */
+void benchmark_traversal(SceneSelector sceneSelector, const string& name,
+                         unsigned int width, unsigned int height,
+                         unsigned int channels, unsigned int spp,
+                         unsigned int max_path_length) {
+  const unsigned int accumulations = 8;
+
+  for (TraversalMode mode : {TraversalMode::SCALAR, TraversalMode::PACKET}) {
+    Renderer r(width, height, channels, spp, accumulations, max_path_length,
+               sceneSelector, mode);
+
+    unsigned long long rays = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < accumulations; i++) {
+      r.render_accumulation();
+      rays += r.get_ray_count();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> time = end - start;
+
+    std::cout << name
+              << (mode == TraversalMode::SCALAR ? " scalar: " : " packet: ")
+              << rays / time.count() * 1e-6 << " Mrays/s (" << rays
+              << " rays in " << time.count() << "s)\n";
+  }
+}
+
+/* Renders a scene until the error of every tile is below target_error, once
+ * with uniform sampling and once with adaptive sampling, and reports the time
+ * to reach that quality with both */
+void compare_adaptive_sampling(SceneSelector sceneSelector, const string& name,
+                               unsigned int width, unsigned int height,
+                               unsigned int channels, unsigned int spp,
+                               unsigned long long accu_limit,
+                               unsigned int max_path_length,
+                               float target_error) {
+  double times[2];
+
+  for (int adaptive = 0; adaptive < 2; adaptive++) {
+    Renderer r(width, height, channels, spp, accu_limit, max_path_length,
+               sceneSelector);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (adaptive) {
+      while (r.render_adaptive(target_error)) {
+      }
+    } else {
+      for (unsigned long long i = 0; i < accu_limit; i++) {
+        r.render_accumulation();
+        if (r.get_max_tile_error() <= target_error) break;
+      }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> time = end - start;
+    times[adaptive] = time.count();
+
+    const char* mode = adaptive ? "adaptive" : "uniform";
+    std::cout << name << " " << mode << ": " << time.count() << "s, "
+              << (double)r.get_sample_count() / (width * height)
+              << " samples per pixel on average, max tile error "
+              << r.get_max_tile_error();
+    if (r.get_max_tile_error() > target_error)
+      std::cout << " (target not reached within " << accu_limit
+                << " accumulations)";
+    std::cout << "\n";
+
+    string filename = string("pathtracer-") + mode + "-" + name + "-err" +
+                      std::to_string(target_error).substr(0, 5) + "-" +
+                      std::to_string(width) + "x" + std::to_string(height) +
+                      ".png";
+    if (stbi_write_png(filename.c_str(), width, height, channels,
+                       r.get_pixels(), width * channels))
+      std::cout << "Output image: '" << filename << "'... written to disk\n";
+  }
+
+  std::cout << name << " time to error " << target_error
+            << ": adaptive sampling is " << times[0] / times[1]
+            << "x faster than uniform sampling\n";
+}
+
+int main(int argc, char* argv[]) {
   /* create an image buffer initialize it with all zeroes */
   const unsigned int width = 512;
   const unsigned int height = 512;
@@ -117,6 +198,33 @@ int main() {
   const unsigned int spp = 1;
   const unsigned int max_path_length = 8;
 
+  /* rkPathTracer --benchmark compares the ray throughput of scalar and packet
+   * traversal on the Cornell Box and pool scenes */
+  if (argc > 1 && string(argv[1]) == "--benchmark") {
+    benchmark_traversal(SceneSelector::SHOW_CORNELL_BOX, "cornell", width,
+                        height, channels, spp, max_path_length);
+    benchmark_traversal(SceneSelector::SHOW_POOL, "pool", width, height,
+                        channels, spp, max_path_length);
+    std::cout << "success\n";
+    return 0;
+  }
+
+  /* rkPathTracer --adaptive [target_error] compares the time to reach a
+   * target error with uniform and with adaptive sampling on the Cornell Box
+   * scene. The target is the relative error of the pixels, so 0.25 is still
+   * visibly noisy; the accumulation limit is raised so that uniform sampling
+   * can reach it */
+  if (argc > 1 && string(argv[1]) == "--adaptive") {
+    const float target_error = argc > 2 ? std::stof(argv[2]) : 0.25f;
+    const unsigned long long adaptive_accu_limit = 2000;
+    compare_adaptive_sampling(SceneSelector::SHOW_CORNELL_BOX, "cornell",
+                              width, height, channels, spp,
+                              adaptive_accu_limit, max_path_length,
+                              target_error);
+    std::cout << "success\n";
+    return 0;
+  }
+
   std::unique_ptr<Renderer> r;
 
   // SceneSelector sceneSelector = SceneSelector::SHOW_POOL;
@@ -133,7 +241,8 @@ int main() {
   auto end = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> accum_time = end - start;
   std::cout << "Accumulation 1 of " << accu_limit << ": " << accum_time.count()
-            << "s\n";
+            << "s, " << r->get_ray_count() / accum_time.count() * 1e-6
+            << " Mrays/s\n";
 
   write_image_first_accumulation(sceneSelector, width, height, channels, spp,
                                  accu_limit, max_path_length, r->get_pixels());
@@ -147,7 +256,9 @@ int main() {
     end = std::chrono::high_resolution_clock::now();
     accum_time = end - start;
     std::cout << "Accumulation " << i + 1 << " of " << accu_limit << ": "
-              << accum_time.count() << "s" << std::endl;
+              << accum_time.count() << "s, "
+              << r->get_ray_count() / accum_time.count() * 1e-6 << " Mrays/s"
+              << std::endl;
   }
 
   write_image_all_accumulations(sceneSelector, width, height, channels, spp,